@@ -0,0 +1,263 @@
+/**
+ * @file decode_bench.c
+ * @brief Benchmark of decoding throughput, per codec.
+ *
+ * Decodes every file given on the command line from start to end a few
+ * times with the same decoders kew plays through, and prints for each
+ * file extension how many times faster than real time it decodes and
+ * how fast it gets through the compressed input. Run with
+ * `make bench-decode FILES="..."`.
+ */
+
+#define MA_NO_DEVICE_IO
+#define MA_NO_ENGINE
+#define MINIAUDIO_IMPLEMENTATION
+
+#include <miniaudio.h>
+#include <miniaudio_libopus.h>
+#include <miniaudio_libvorbis.h>
+
+#include "sound/m4a.h"
+#include "sound/webm.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define BENCH_ROUNDS 3
+#define BENCH_CHUNK_FRAMES 4096
+#define MAX_FORMATS 16
+
+typedef struct {
+        char extension[16];
+        int files;
+        double decode_ns;
+        double audio_seconds;
+        double input_bytes;
+} FormatTimes;
+
+typedef union {
+        ma_decoder builtin;
+        ma_libvorbis vorbis;
+        ma_libopus opus;
+        ma_webm webm;
+#ifdef USE_FAAD
+        m4a_decoder m4a;
+#endif
+} AnyDecoder;
+
+typedef enum {
+        BENCH_BUILTIN,
+        BENCH_VORBIS,
+        BENCH_OPUS,
+        BENCH_WEBM,
+        BENCH_M4A
+} DecoderKind;
+
+static FormatTimes formats[MAX_FORMATS];
+static int format_count = 0;
+
+// The m4a and webm decoders log through these, which need the whole app
+void k_log(const char *fmt, ...)
+{
+        va_list args;
+        va_start(args, fmt);
+        vfprintf(stderr, fmt, args);
+        va_end(args);
+}
+
+void set_error_message(const char *message)
+{
+        fprintf(stderr, "%s\n", message);
+}
+
+static double now_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static const char *get_extension(const char *path)
+{
+        const char *dot = strrchr(path, '.');
+        return dot ? dot + 1 : "";
+}
+
+static FormatTimes *get_format(const char *extension)
+{
+        for (int i = 0; i < format_count; i++) {
+                if (strcasecmp(formats[i].extension, extension) == 0)
+                        return &formats[i];
+        }
+
+        if (format_count == MAX_FORMATS)
+                return NULL;
+
+        FormatTimes *format = &formats[format_count++];
+        snprintf(format->extension, sizeof(format->extension), "%s", extension);
+
+        return format;
+}
+
+static DecoderKind get_kind(const char *extension)
+{
+        if (strcasecmp(extension, "ogg") == 0)
+                return BENCH_VORBIS;
+        if (strcasecmp(extension, "opus") == 0)
+                return BENCH_OPUS;
+        if (strcasecmp(extension, "webm") == 0)
+                return BENCH_WEBM;
+        if (strcasecmp(extension, "m4a") == 0 || strcasecmp(extension, "aac") == 0 ||
+            strcasecmp(extension, "mp4") == 0)
+                return BENCH_M4A;
+
+        return BENCH_BUILTIN;
+}
+
+static ma_result open_decoder(DecoderKind kind, const char *path, AnyDecoder *decoder)
+{
+        ma_decoding_backend_config backend = ma_decoding_backend_config_init(ma_format_f32, 0);
+
+        switch (kind) {
+        case BENCH_VORBIS:
+                return ma_libvorbis_init_file(path, &backend, NULL, &decoder->vorbis);
+        case BENCH_OPUS:
+                return ma_libopus_init_file(path, &backend, NULL, &decoder->opus);
+        case BENCH_WEBM:
+                return ma_webm_init_file(path, &backend, NULL, &decoder->webm);
+        case BENCH_M4A:
+#ifdef USE_FAAD
+                return m4a_decoder_init_file(path, &backend, NULL, &decoder->m4a);
+#else
+                return MA_NOT_IMPLEMENTED;
+#endif
+        default: {
+                ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 0, 0);
+                return ma_decoder_init_file(path, &config, &decoder->builtin);
+        }
+        }
+}
+
+static void close_decoder(DecoderKind kind, AnyDecoder *decoder)
+{
+        switch (kind) {
+        case BENCH_VORBIS:
+                ma_libvorbis_uninit(&decoder->vorbis, NULL);
+                break;
+        case BENCH_OPUS:
+                ma_libopus_uninit(&decoder->opus, NULL);
+                break;
+        case BENCH_WEBM:
+                ma_webm_uninit(&decoder->webm, NULL);
+                break;
+        case BENCH_M4A:
+#ifdef USE_FAAD
+                m4a_decoder_uninit(&decoder->m4a, NULL);
+#endif
+                break;
+        default:
+                ma_decoder_uninit(&decoder->builtin);
+                break;
+        }
+}
+
+static void bench_file(const char *path, float *pcm)
+{
+        const char *extension = get_extension(path);
+        FormatTimes *format = get_format(extension);
+        DecoderKind kind = get_kind(extension);
+        AnyDecoder *decoder = malloc(sizeof(AnyDecoder));
+        struct stat st;
+
+        if (format == NULL || decoder == NULL || stat(path, &st) != 0) {
+                free(decoder);
+                return;
+        }
+
+        double decode_ns = 0.0;
+        ma_uint64 frames = 0;
+        ma_uint32 sample_rate = 0;
+
+        for (int r = 0; r < BENCH_ROUNDS; r++) {
+                double start = now_ns();
+
+                if (open_decoder(kind, path, decoder) != MA_SUCCESS) {
+                        fprintf(stderr, "Can't decode %s\n", path);
+                        free(decoder);
+                        return;
+                }
+
+                ma_uint32 channels = 0;
+                ma_data_source_get_data_format(decoder, NULL, &channels, &sample_rate, NULL, 0);
+
+                if (channels == 0 || channels > MA_MAX_CHANNELS) {
+                        close_decoder(kind, decoder);
+                        free(decoder);
+                        return;
+                }
+
+                frames = 0;
+
+                for (;;) {
+                        ma_uint64 read = 0;
+                        ma_result result = ma_data_source_read_pcm_frames(
+                            decoder, pcm, BENCH_CHUNK_FRAMES * MA_MAX_CHANNELS / channels, &read);
+
+                        frames += read;
+
+                        if (result != MA_SUCCESS || read == 0)
+                                break;
+                }
+
+                close_decoder(kind, decoder);
+
+                decode_ns += now_ns() - start;
+        }
+
+        free(decoder);
+
+        if (sample_rate == 0)
+                return;
+
+        format->decode_ns += decode_ns / BENCH_ROUNDS;
+        format->audio_seconds += (double)frames / sample_rate;
+        format->input_bytes += (double)st.st_size;
+        format->files++;
+}
+
+int main(int argc, char *argv[])
+{
+        if (argc < 2) {
+                fprintf(stderr, "Usage: %s <audio file>...\n", argv[0]);
+                return 1;
+        }
+
+        float *pcm = malloc(BENCH_CHUNK_FRAMES * MA_MAX_CHANNELS * sizeof(float));
+        if (pcm == NULL)
+                return 1;
+
+        for (int i = 1; i < argc; i++)
+                bench_file(argv[i], pcm);
+
+        free(pcm);
+
+        printf("%-8s %6s %12s %12s %12s\n", "format", "files", "audio", "realtime", "input");
+
+        for (int i = 0; i < format_count; i++) {
+                double seconds = formats[i].decode_ns / 1e9;
+
+                if (seconds <= 0.0)
+                        continue;
+
+                printf("%-8s %6d %10.1f s %11.0fx %7.1f MB/s\n", formats[i].extension, formats[i].files,
+                       formats[i].audio_seconds, formats[i].audio_seconds / seconds,
+                       formats[i].input_bytes / seconds / 1e6);
+        }
+
+        return 0;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file dsp_bench.c
+ * @brief Microbenchmark of the DSP kernels.
+ *
+ * Times every kernel of every kernel set the CPU supports and prints the
+ * cost in nanoseconds per sample. Also checks that each set produces the
+ * same output as the scalar one. Run with `make bench`.
+ */
+
+#include "utils/dsp_kernels.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define BENCH_FRAMES 4096
+#define BENCH_CHANNELS 2
+#define BENCH_SAMPLES (BENCH_FRAMES * BENCH_CHANNELS)
+#define BENCH_ROUNDS 2000
+
+static const char *kernel_sets[] = {"scalar", "sse4.1", "avx2", "neon"};
+
+static float a[BENCH_SAMPLES];
+static float b[BENCH_SAMPLES];
+static float out[BENCH_SAMPLES];
+static float gain_a[BENCH_FRAMES];
+static float gain_b[BENCH_FRAMES];
+static int16_t s16[BENCH_SAMPLES];
+static uint8_t s24[BENCH_SAMPLES * 3];
+
+// Outputs of the scalar set, to compare the others against
+static float ref_crossfade[BENCH_SAMPLES];
+static float ref_downmix[BENCH_FRAMES];
+static float ref_sum_squares;
+
+// Keeps results alive, so the compiler can't drop the work
+static volatile float sink;
+
+static double now_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void fill_inputs(void)
+{
+        srand(1);
+
+        for (int i = 0; i < BENCH_SAMPLES; i++) {
+                a[i] = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+                b[i] = (float)rand() / RAND_MAX * 2.0f - 1.0f;
+                s16[i] = (int16_t)(rand() & 0xFFFF);
+                s24[i * 3] = (uint8_t)rand();
+                s24[i * 3 + 1] = (uint8_t)rand();
+                s24[i * 3 + 2] = (uint8_t)rand();
+        }
+
+        for (int i = 0; i < BENCH_FRAMES; i++) {
+                gain_a[i] = (float)i / BENCH_FRAMES;
+                gain_b[i] = 1.0f - gain_a[i];
+        }
+}
+
+static void print_result(const char *kernel, double ns, size_t samples)
+{
+        printf("  %-12s %8.3f ns/sample\n", kernel, ns / ((double)samples * BENCH_ROUNDS));
+}
+
+// Returns false if the output differs from the scalar set
+static bool bench_set(bool reference)
+{
+        bool same = true;
+        double start;
+
+        start = now_ns();
+        for (int r = 0; r < BENCH_ROUNDS; r++) {
+                memcpy(out, a, sizeof(out));
+                dsp_apply_gain_f32(out, BENCH_SAMPLES, 0.5f);
+        }
+        print_result("apply_gain", now_ns() - start, BENCH_SAMPLES);
+
+        start = now_ns();
+        for (int r = 0; r < BENCH_ROUNDS; r++)
+                dsp_crossfade_f32(a, gain_a, b, gain_b, out, BENCH_FRAMES, BENCH_CHANNELS);
+        print_result("crossfade", now_ns() - start, BENCH_SAMPLES);
+
+        if (reference)
+                memcpy(ref_crossfade, out, sizeof(out));
+        else if (memcmp(ref_crossfade, out, sizeof(out)) != 0)
+                same = false;
+
+        start = now_ns();
+        for (int r = 0; r < BENCH_ROUNDS; r++)
+                dsp_downmix_f32(a, out, BENCH_FRAMES, BENCH_CHANNELS);
+        print_result("downmix", now_ns() - start, BENCH_SAMPLES);
+
+        if (reference)
+                memcpy(ref_downmix, out, sizeof(ref_downmix));
+        else if (memcmp(ref_downmix, out, sizeof(ref_downmix)) != 0)
+                same = false;
+
+        start = now_ns();
+        for (int r = 0; r < BENCH_ROUNDS; r++)
+                dsp_s16_to_f32(s16, out, BENCH_SAMPLES);
+        print_result("s16_to_f32", now_ns() - start, BENCH_SAMPLES);
+
+        start = now_ns();
+        for (int r = 0; r < BENCH_ROUNDS; r++)
+                dsp_s24_to_f32(s24, out, BENCH_SAMPLES);
+        print_result("s24_to_f32", now_ns() - start, BENCH_SAMPLES);
+
+        start = now_ns();
+        for (int r = 0; r < BENCH_ROUNDS; r++) {
+                memcpy(out, a, sizeof(out));
+                dsp_multiply_f32(out, b, BENCH_SAMPLES);
+        }
+        print_result("multiply", now_ns() - start, BENCH_SAMPLES);
+
+        float sum = 0.0f;
+        start = now_ns();
+        for (int r = 0; r < BENCH_ROUNDS; r++)
+                sum = dsp_sum_squares_f32(a, BENCH_SAMPLES);
+        print_result("sum_squares", now_ns() - start, BENCH_SAMPLES);
+        sink = sum;
+
+        if (reference)
+                ref_sum_squares = sum;
+        else if (sum != ref_sum_squares)
+                same = false;
+
+        return same;
+}
+
+int main(void)
+{
+        bool ok = true;
+
+        fill_inputs();
+
+        for (size_t i = 0; i < sizeof(kernel_sets) / sizeof(kernel_sets[0]); i++) {
+                if (!dsp_kernels_select(kernel_sets[i]))
+                        continue;
+
+                printf("%s\n", kernel_sets[i]);
+
+                if (!bench_set(i == 0)) {
+                        printf("  output differs from scalar\n");
+                        ok = false;
+                }
+        }
+
+        return ok ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file tag_bench.c
+ * @brief Benchmark of reading tags, per file format.
+ *
+ * Reads the tags of every file given on the command line a few times, the
+ * way the loader does, and prints the average time per file for each file
+ * extension. Run with `make bench-tags FILES="..."`.
+ */
+
+#include "loader/lyrics.h"
+#include "loader/tagLibWrapper.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#define BENCH_ROUNDS 20
+#define MAX_FORMATS 16
+
+typedef struct {
+        char extension[16];
+        int files;
+        double extract_ns;
+        double track_info_ns;
+} FormatTimes;
+
+static FormatTimes formats[MAX_FORMATS];
+static int format_count = 0;
+
+// tagLibWrapper logs through k_log, which needs the whole app
+void k_log(const char *fmt, ...)
+{
+        va_list args;
+        va_start(args, fmt);
+        vfprintf(stderr, fmt, args);
+        va_end(args);
+}
+
+static double now_ns(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static FormatTimes *get_format(const char *path)
+{
+        const char *dot = strrchr(path, '.');
+        const char *extension = dot ? dot + 1 : "";
+
+        for (int i = 0; i < format_count; i++) {
+                if (strcasecmp(formats[i].extension, extension) == 0)
+                        return &formats[i];
+        }
+
+        if (format_count == MAX_FORMATS)
+                return NULL;
+
+        FormatTimes *format = &formats[format_count++];
+        snprintf(format->extension, sizeof(format->extension), "%s", extension);
+
+        return format;
+}
+
+static void bench_file(const char *path)
+{
+        FormatTimes *format = get_format(path);
+        TagSettings *tags = malloc(sizeof(TagSettings));
+
+        if (format == NULL || tags == NULL) {
+                free(tags);
+                return;
+        }
+
+        double start = now_ns();
+
+        for (int r = 0; r < BENCH_ROUNDS; r++) {
+                double duration = 0.0;
+                unsigned char *cover = NULL;
+                size_t cover_size = 0;
+                Lyrics *lyrics = NULL;
+
+                memset(tags, 0, sizeof(TagSettings));
+                extractTags(path, tags, &duration, &cover, &cover_size, &lyrics, true);
+
+                free(cover);
+                freeLyrics(lyrics);
+        }
+
+        double middle = now_ns();
+
+        for (int r = 0; r < BENCH_ROUNDS; r++) {
+                uint32_t track = 0, disc = 0;
+                getTrackInfo(path, &track, &disc);
+        }
+
+        format->extract_ns += middle - start;
+        format->track_info_ns += now_ns() - middle;
+        format->files++;
+
+        free(tags);
+}
+
+int main(int argc, char *argv[])
+{
+        if (argc < 2) {
+                fprintf(stderr, "Usage: %s <audio file>...\n", argv[0]);
+                return 1;
+        }
+
+        for (int i = 1; i < argc; i++)
+                bench_file(argv[i]);
+
+        printf("%-8s %6s %16s %16s\n", "format", "files", "extractTags", "getTrackInfo");
+
+        for (int i = 0; i < format_count; i++) {
+                double runs = (double)formats[i].files * BENCH_ROUNDS;
+
+                printf("%-8s %6d %13.3f ms %13.3f ms\n", formats[i].extension, formats[i].files,
+                       formats[i].extract_ns / runs / 1e6, formats[i].track_info_ns / runs / 1e6);
+        }
+
+        return 0;
+}
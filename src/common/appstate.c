@@ -27,6 +27,7 @@ static int win32_stdout_is_file = 0;
 
 #include "common/appstate.h"
 #include "common/model.h"
+#include "data/playlist_snapshot.h"
 #include "utils/file.h"
 #include "utils/term.h"
 #include "utils/utils.h"
@@ -62,6 +63,8 @@ void free_playlist(PlayList **plist)
 
         empty_playlist(list);
 
+        playlist_snapshot_release(list);
+
         pthread_mutex_destroy(&list->mutex);
 
         free(list);
@@ -80,6 +83,10 @@ void create_playlist(PlayList **playlist)
                 (*playlist)->count = 0;
                 (*playlist)->head = NULL;
                 (*playlist)->tail = NULL;
+                atomic_init(&(*playlist)->version, 0);
+                atomic_init(&(*playlist)->needs_rebuild, false);
+                (*playlist)->snapshot = NULL;
+                (*playlist)->shuffle = NULL;
                 pthread_mutex_init(&(*playlist)->mutex, NULL);
         }
 }
@@ -393,6 +400,7 @@ void playlists_shutdown(void)
         free_playlist(&model->playlist);
         free_playlist(&model->unshuffled_playlist);
         free_playlist(&model->favorites_playlist);
+        playlist_snapshot_reclaim();
 }
 
 void mutexes_shutdown(void)
@@ -178,7 +178,7 @@ struct Msg {
         int chosen_name_len;
         bool found_chosen;
 
-        Node *chosen_song;
+        int chosen_song_id; // Node id, -1 when no row was chosen
 
         FileSystemEntry *current_lib_entry;
         int num_rows;
@@ -197,6 +197,8 @@ struct Msg {
         bool clicked_song;
 
         int lyrics_offset;
+
+        bool ok; // Result of a background operation, such as saving a playlist
 };
 
 typedef struct {
@@ -391,6 +393,7 @@ typedef struct
 
         int visualizer_bar_mode;        /**< 0=Thin bars, 1=Double width bars, 2=Auto (default). */
         int replayGainCheckFirst;       /**< Priority of replay gain mode (track vs album). */
+        int bufferMode;                 /**< 0=Balanced, 1=Power saving, 2=Low latency. */
         bool saveRepeatShuffleSettings; /**< Persist repeat/shuffle settings between sessions. */
         int repeatState;                /**< 0=Disabled, 1=Repeat track, 2=Repeat list. */
         bool shuffle_enabled;           /**< Whether shuffle mode is enabled. */
@@ -429,6 +432,9 @@ typedef struct
         int fade_quick_ms;
         int fade_medium_ms;
         int fade_slow_ms;
+        int crossfade_curve;            /**< 0=Equal power (default), 1=Linear, 2=S-curve. */
+        int song_cache_entries;         /**< Loaded songs kept in memory, 0 disables the song cache. */
+        int song_cache_mb;              /**< Memory limit of the song cache. */
 } UISettings;
 
 typedef struct {
@@ -437,11 +443,6 @@ typedef struct {
         int previous_chosen_row;
 } TreeContext;
 
-typedef struct {
-        PixelData colors[16];
-        int count;
-} ColorPalette;
-
 /**
  * @brief Stores dynamic UI runtime state.
  */
@@ -699,6 +700,7 @@ typedef struct
         char currentSongSeconds[12];
         char visualizer_bar_width[2];
         char replayGainCheckFirst[2];
+        char bufferMode[2];
         char saveRepeatShuffleSettings[2];
         char repeatState[2];
         char shuffle_enabled[2];
@@ -715,6 +717,9 @@ typedef struct
         char fade_quick_ms[12];
         char fade_medium_ms[12];
         char fade_slow_ms[12];
+        char crossfade_curve[2];
+        char song_cache_entries[6];
+        char song_cache_mb[6];
 } AppSettings;
 
 /**
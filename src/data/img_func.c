@@ -153,8 +153,15 @@ retirePassthroughWorkarounds_tmux(void)
         return result;
 }
 
-static void detect_terminal(ChafaTermInfo **term_info_out, ChafaCanvasMode *mode_out, ChafaPixelMode *pixel_mode_out,
-                            ChafaPassthrough *passthrough_out, ChafaSymbolMap **symbol_map_out)
+// The terminal doesn't change while kew runs, so it is only examined once
+static ChafaTermInfo *detected_term_info = NULL;
+static ChafaCanvasMode detected_mode;
+static ChafaPixelMode detected_pixel_mode;
+static ChafaPassthrough detected_passthrough;
+static ChafaSymbolMap *detected_symbol_map = NULL;
+
+static void query_terminal(ChafaTermInfo **term_info_out, ChafaCanvasMode *mode_out, ChafaPixelMode *pixel_mode_out,
+                           ChafaPassthrough *passthrough_out, ChafaSymbolMap **symbol_map_out)
 {
         ChafaCanvasMode mode;
         ChafaPixelMode pixel_mode;
@@ -199,9 +206,28 @@ static void detect_terminal(ChafaTermInfo **term_info_out, ChafaCanvasMode *mode
         g_strfreev(envp);
 }
 
+static void detect_terminal(ChafaTermInfo **term_info_out, ChafaCanvasMode *mode_out, ChafaPixelMode *pixel_mode_out,
+                            ChafaPassthrough *passthrough_out, ChafaSymbolMap **symbol_map_out)
+{
+        if (detected_term_info == NULL)
+                query_terminal(&detected_term_info, &detected_mode, &detected_pixel_mode,
+                               &detected_passthrough, &detected_symbol_map);
+
+        *term_info_out = chafa_term_info_ref(detected_term_info);
+        *mode_out = detected_mode;
+        *pixel_mode_out = detected_pixel_mode;
+        *passthrough_out = detected_passthrough;
+        *symbol_map_out = chafa_symbol_map_ref(detected_symbol_map);
+}
+
 #else
 
-static void detect_terminal(ChafaTermInfo **term_info_out, ChafaCanvasMode *mode_out, ChafaPixelMode *pixel_mode_out)
+// The terminal doesn't change while kew runs, so it is only examined once
+static ChafaTermInfo *detected_term_info = NULL;
+static ChafaCanvasMode detected_mode;
+static ChafaPixelMode detected_pixel_mode;
+
+static void query_terminal(ChafaTermInfo **term_info_out, ChafaCanvasMode *mode_out, ChafaPixelMode *pixel_mode_out)
 {
         ChafaCanvasMode mode;
         ChafaPixelMode pixel_mode;
@@ -247,6 +273,16 @@ static void detect_terminal(ChafaTermInfo **term_info_out, ChafaCanvasMode *mode
 
         g_strfreev(envp);
 }
+
+static void detect_terminal(ChafaTermInfo **term_info_out, ChafaCanvasMode *mode_out, ChafaPixelMode *pixel_mode_out)
+{
+        if (detected_term_info == NULL)
+                query_terminal(&detected_term_info, &detected_mode, &detected_pixel_mode);
+
+        *term_info_out = chafa_term_info_ref(detected_term_info);
+        *mode_out = detected_mode;
+        *pixel_mode_out = detected_pixel_mode;
+}
 #endif
 
 static ChafaPixelMode style_to_pixel_mode(const char *style)
@@ -321,8 +357,13 @@ convert_image(const void *pixels, gint pix_width, gint pix_height,
                 chafa_symbol_map_add_by_tags(symbol_map, style_to_symbol_tag(cover_style));
         }
 
-        if (passthrough == CHAFA_PASSTHROUGH_TMUX)
+        // Spawns tmux, so only once
+        static gboolean tmux_workarounds_applied = FALSE;
+
+        if (passthrough == CHAFA_PASSTHROUGH_TMUX && !tmux_workarounds_applied) {
                 apply_passthrough_workarounds_tmux();
+                tmux_workarounds_applied = TRUE;
+        }
 
         config = chafa_canvas_config_new();
         chafa_canvas_config_set_canvas_mode(config, mode);
@@ -523,6 +564,94 @@ float get_aspect_ratio()
         return (float)cell_height / (float)cell_width;
 }
 
+// Printable output of recent covers, so redrawing one at the same size,
+// after switching views or a notification, doesn't render it again
+#define RENDER_CACHE_SIZE 4
+
+typedef struct {
+        bool used;
+        size_t img_hash;
+        int width;
+        int height;
+        int width_cells;
+        int height_cells;
+        int cell_width;
+        int cell_height;
+        char cover_style[16];
+        uint8_t *data;
+        size_t data_len;
+        unsigned long last_use;
+} RenderedCover;
+
+static RenderedCover render_cache[RENDER_CACHE_SIZE];
+static unsigned long render_cache_clock = 0;
+
+static RenderedCover *find_rendered_cover(size_t img_hash, int width, int height,
+                                          int width_cells, int height_cells,
+                                          int cell_width, int cell_height, const char *cover_style)
+{
+        for (int i = 0; i < RENDER_CACHE_SIZE; i++) {
+                RenderedCover *r = &render_cache[i];
+
+                if (r->used && r->img_hash == img_hash &&
+                    r->width == width && r->height == height &&
+                    r->width_cells == width_cells && r->height_cells == height_cells &&
+                    r->cell_width == cell_width && r->cell_height == cell_height &&
+                    strcmp(r->cover_style, cover_style) == 0) {
+                        r->last_use = ++render_cache_clock;
+                        return r;
+                }
+        }
+
+        return NULL;
+}
+
+static void store_rendered_cover(size_t img_hash, int width, int height,
+                                 int width_cells, int height_cells,
+                                 int cell_width, int cell_height, const char *cover_style,
+                                 const uint8_t *data, size_t data_len)
+{
+        RenderedCover *slot = &render_cache[0];
+
+        for (int i = 0; i < RENDER_CACHE_SIZE; i++) {
+                if (!render_cache[i].used) {
+                        slot = &render_cache[i];
+                        break;
+                }
+
+                if (render_cache[i].last_use < slot->last_use)
+                        slot = &render_cache[i];
+        }
+
+        uint8_t *copy = malloc(data_len);
+        if (!copy)
+                return;
+
+        memcpy(copy, data, data_len);
+        free(slot->data);
+
+        slot->used = true;
+        slot->img_hash = img_hash;
+        slot->width = width;
+        slot->height = height;
+        slot->width_cells = width_cells;
+        slot->height_cells = height_cells;
+        slot->cell_width = cell_width;
+        slot->cell_height = cell_height;
+        snprintf(slot->cover_style, sizeof(slot->cover_style), "%s", cover_style);
+        slot->data = copy;
+        slot->data_len = data_len;
+        slot->last_use = ++render_cache_clock;
+}
+
+static void clear_render_cache(void)
+{
+        for (int i = 0; i < RENDER_CACHE_SIZE; i++) {
+                free(render_cache[i].data);
+                render_cache[i] = (RenderedCover){0};
+        }
+}
+
 void free_image_payload(ImagePayload **img)
 {
         if (!*img)
@@ -642,20 +771,41 @@ int draw_square_bitmap_to_buf(DrawBuffer *buf, int row, int col,
         img->screen_w = corrected_width;
 
         if (!just_mark_cover) {
-                GString *printable = convert_image(
-                    pixels, width, height,
-                    width * 4,
-                    CHAFA_PIXEL_RGBA8_UNASSOCIATED,
-                    corrected_width, corrected_height,
-                    cell_width, cell_height, cover_style);
-
-                if (!printable) {
-                        free(img);
-                        return 0;
-                }
+                const RenderedCover *rendered = find_rendered_cover(img_hash, width, height,
+                                                                    corrected_width, corrected_height,
+                                                                    cell_width, cell_height, cover_style);
+
+                if (rendered) {
+                        img->data = malloc(rendered->data_len);
 
-                img->data_len = printable->len;
-                img->data = (uint8_t *)g_string_free(printable, FALSE);
+                        if (!img->data) {
+                                free(img);
+                                return 0;
+                        }
+
+                        memcpy(img->data, rendered->data, rendered->data_len);
+                        img->data_len = rendered->data_len;
+                } else {
+                        GString *printable = convert_image(
+                            pixels, width, height,
+                            width * 4,
+                            CHAFA_PIXEL_RGBA8_UNASSOCIATED,
+                            corrected_width, corrected_height,
+                            cell_width, cell_height, cover_style);
+
+                        if (!printable) {
+                                free(img);
+                                return 0;
+                        }
+
+                        img->data_len = printable->len;
+                        img->data = (uint8_t *)g_string_free(printable, FALSE);
+
+                        store_rendered_cover(img_hash, width, height,
+                                             corrected_width, corrected_height,
+                                             cell_width, cell_height, cover_style,
+                                             img->data, img->data_len);
+                }
         }
 
         printf("\033[%d;%dH", row, col);
@@ -707,4 +857,18 @@ void chafa_shutdown(void)
 #ifdef CHAFA_VERSION_1_16
         retirePassthroughWorkarounds_tmux();
 #endif
+
+        clear_render_cache();
+
+#if CHAFA_VERSION_CUR_STABLE >= G_ENCODE_VERSION(1, 16)
+        if (detected_symbol_map) {
+                chafa_symbol_map_unref(detected_symbol_map);
+                detected_symbol_map = NULL;
+        }
+#endif
+
+        if (detected_term_info) {
+                chafa_term_info_unref(detected_term_info);
+                detected_term_info = NULL;
+        }
 }
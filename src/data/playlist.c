@@ -17,6 +17,9 @@
 #include "common/common.h"
 
 #include "directorytree.h"
+#include "playlist_snapshot.h"
+#include "playlist_writer.h"
+#include "shuffle_perm.h"
 
 #include "ops/library_ops.h"
 
@@ -45,6 +48,263 @@ static bool shuffle = false;
 static int num_dirs = 0;
 static Node *current_song = NULL;
 static int node_id_counter = 0;
+static unsigned int shuffle_epoch_counter = 0;
+
+#define SHUFFLE_ANCHOR_SPAN 64
+
+typedef struct
+{
+        Node *node;
+        uint64_t position;
+} ShuffleAnchor;
+
+// A shuffled list is kept as the songs already put in play order (head up
+// to frontier) followed by the rest in the order they were added. The
+// positions in that remainder are shuffled by a seeded permutation, and the
+// node for the next step is only moved up behind the frontier when it is
+// about to play. Previous songs stay linked, so going back is just prev.
+struct ShuffleCursor {
+        ShufflePerm perm;       // Over positions in the remainder
+        uint64_t step;          // Nodes taken from the remainder so far
+        uint64_t low;           // Lowest position still in the remainder, right after frontier
+        uint64_t high;          // Highest position still in the remainder, at the tail
+        Node *frontier;         // Last node in play order, NULL before the first one
+        unsigned int epoch;     // Stamped on nodes as they are linked
+        int count;              // List count the positions belong to, -1 once they no longer hold
+        ShuffleAnchor *anchors; // One per SHUFFLE_ANCHOR_SPAN positions, filled in while walking
+        size_t num_anchors;
+        size_t anchors_reach;   // No anchor at or past this block has been filled yet
+};
+
+static void shuffle_cursor_free(PlayList *list)
+{
+        if (list->shuffle == NULL)
+                return;
+
+        free(list->shuffle->anchors);
+        free(list->shuffle);
+        list->shuffle = NULL;
+}
+
+// Called by anything that links, unlinks or reorders nodes of a shuffled list
+static void shuffle_invalidate(PlayList *list)
+{
+        if (list->shuffle != NULL)
+                list->shuffle->count = -1;
+}
+
+static bool shuffle_is_taken(const struct ShuffleCursor *c, uint64_t position)
+{
+        return c->step > 0 && shuffle_perm_invert(&c->perm, position) < c->step;
+}
+
+// Starts a new permutation over whatever follows the frontier. Used when the
+// list was changed and positions in the remainder no longer hold.
+static void shuffle_cursor_rebase(PlayList *list, struct ShuffleCursor *c)
+{
+        uint64_t linked = 0;
+
+        if (c->frontier != NULL) {
+                Node *node = list->head;
+
+                while (node != NULL) {
+                        linked++;
+                        if (node == c->frontier)
+                                break;
+                        node = node->next;
+                }
+
+                if (node == NULL) {
+                        c->frontier = NULL;
+                        linked = 0;
+                }
+        }
+
+        uint64_t remaining = ((uint64_t)list->count > linked) ? (uint64_t)list->count - linked : 0;
+
+        shuffle_perm_init(&c->perm, remaining, shuffle_perm_random_seed());
+        c->step = 0;
+        c->low = 0;
+        c->high = remaining ? remaining - 1 : 0;
+        c->count = list->count;
+
+        size_t num_anchors = (size_t)(remaining / SHUFFLE_ANCHOR_SPAN) + 1;
+        ShuffleAnchor *anchors = realloc(c->anchors, num_anchors * sizeof(ShuffleAnchor));
+
+        if (anchors == NULL) {
+                k_log("shuffle_cursor_rebase: realloc\n");
+                free(c->anchors);
+                c->anchors = NULL;
+                c->num_anchors = 0;
+        } else {
+                memset(anchors, 0, num_anchors * sizeof(ShuffleAnchor));
+                c->anchors = anchors;
+                c->num_anchors = num_anchors;
+        }
+        c->anchors_reach = 0;
+}
+
+static void shuffle_note_anchor(struct ShuffleCursor *c, Node *node, uint64_t position)
+{
+        size_t block = (size_t)(position / SHUFFLE_ANCHOR_SPAN);
+
+        if (block >= c->num_anchors || c->anchors[block].node != NULL)
+                return;
+
+        c->anchors[block].node = node;
+        c->anchors[block].position = position;
+
+        if (block >= c->anchors_reach)
+                c->anchors_reach = block + 1;
+}
+
+// Finds the remainder node at a position. Starts from the closest of the
+// nearest anchor below it, the start of the remainder and its end, and
+// skips positions that were already taken as it walks.
+static Node *shuffle_remainder_at(PlayList *list, struct ShuffleCursor *c, uint64_t position)
+{
+        Node *node = (c->frontier != NULL) ? c->frontier->next : list->head;
+        uint64_t at = c->low;
+
+        if (c->anchors_reach > 0) {
+                size_t block = (size_t)(position / SHUFFLE_ANCHOR_SPAN);
+                size_t lowest = (size_t)(c->low / SHUFFLE_ANCHOR_SPAN);
+
+                if (block >= c->anchors_reach)
+                        block = c->anchors_reach - 1;
+
+                while (block >= lowest) {
+                        ShuffleAnchor *anchor = &c->anchors[block];
+
+                        if (anchor->node != NULL && anchor->position <= position) {
+                                if (anchor->position > at) {
+                                        node = anchor->node;
+                                        at = anchor->position;
+                                }
+                                break;
+                        }
+
+                        if (block == 0)
+                                break;
+                        block--;
+                }
+        }
+
+        if (c->high - position < position - at) {
+                node = list->tail;
+                at = c->high;
+
+                while (node != NULL && at > position) {
+                        do
+                                at--;
+                        while (shuffle_is_taken(c, at));
+
+                        node = node->prev;
+                        if (node != NULL)
+                                shuffle_note_anchor(c, node, at);
+                }
+
+                return node;
+        }
+
+        while (node != NULL && at < position) {
+                do
+                        at++;
+                while (shuffle_is_taken(c, at));
+
+                node = node->next;
+                if (node != NULL)
+                        shuffle_note_anchor(c, node, at);
+        }
+
+        return node;
+}
+
+// Moves a remainder node up to right behind the frontier and makes it the
+// new frontier.
+static void shuffle_link_after_frontier(PlayList *list, struct ShuffleCursor *c, Node *node)
+{
+        Node *first = (c->frontier != NULL) ? c->frontier->next : list->head;
+
+        if (node != first) {
+                node->prev->next = node->next;
+                if (node->next != NULL)
+                        node->next->prev = node->prev;
+                else
+                        list->tail = node->prev;
+
+                node->prev = c->frontier;
+                node->next = first;
+                if (c->frontier != NULL)
+                        c->frontier->next = node;
+                else
+                        list->head = node;
+                first->prev = node;
+        }
+
+        node->shuffle_epoch = c->epoch;
+        c->frontier = node;
+}
+
+// Takes the next step of the permutation and links its node into play order.
+static Node *shuffle_link_next(PlayList *list)
+{
+        struct ShuffleCursor *c = list->shuffle;
+
+        if (c->count != list->count)
+                shuffle_cursor_rebase(list, c);
+
+        if (c->step >= c->perm.n)
+                return NULL;
+
+        uint64_t position = shuffle_perm_apply(&c->perm, c->step);
+        Node *node = shuffle_remainder_at(list, c, position);
+
+        if (node == NULL) {
+                // The list is shorter than its count says, start over on the next call
+                shuffle_invalidate(list);
+                return NULL;
+        }
+
+        shuffle_link_after_frontier(list, c, node);
+
+        size_t block = (size_t)(position / SHUFFLE_ANCHOR_SPAN);
+        if (block < c->num_anchors && c->anchors[block].node == node)
+                c->anchors[block].node = NULL;
+
+        c->step++;
+
+        while (c->low < c->perm.n && shuffle_is_taken(c, c->low))
+                c->low++;
+        while (c->high > c->low && shuffle_is_taken(c, c->high))
+                c->high--;
+
+        playlist_mark_changed(list);
+
+        return node;
+}
+
+// Keeps the song after the current one linked in play order. A song picked
+// from outside the played part is moved up behind the frontier first, and
+// the rest is shuffled again from there.
+static void shuffle_follow(Node *node)
+{
+        PlayList *list = get_playlist();
+
+        if (node == NULL || list == NULL || list->shuffle == NULL)
+                return;
+
+        struct ShuffleCursor *c = list->shuffle;
+
+        if (node->shuffle_epoch != c->epoch) {
+                shuffle_link_after_frontier(list, c, node);
+                playlist_mark_changed(list);
+                shuffle_invalidate(list);
+        }
+
+        if (node == c->frontier)
+                shuffle_link_next(list);
+}
 
 void clear_current_song(void)
 {
@@ -54,6 +314,8 @@ void clear_current_song(void)
 void set_current_song(Node *node)
 {
         current_song = node;
+
+        shuffle_follow(node);
 }
 
 Node *get_current_song(void)
@@ -63,7 +325,15 @@ Node *get_current_song(void)
 
 Node *get_list_next(Node *node)
 {
-        return (node == NULL) ? NULL : node->next;
+        if (node == NULL)
+                return NULL;
+
+        PlayList *list = get_playlist();
+
+        if (list != NULL && list->shuffle != NULL && node == list->shuffle->frontier)
+                shuffle_link_next(list);
+
+        return node->next;
 }
 
 Node *get_list_prev(Node *node)
@@ -91,6 +361,9 @@ int add_to_list(PlayList *list, Node *new_node)
                 list->tail = new_node;
         }
 
+        shuffle_invalidate(list);
+        playlist_mark_appended(list);
+
         return 0;
 }
 
@@ -118,6 +391,9 @@ void move_up_list(PlayList *list, Node *node, bool change_library_status)
         else
                 list->tail = prev_node;
 
+        shuffle_invalidate(list);
+        playlist_mark_changed(list);
+
         if (change_library_status) {
                 // Is_enqueued in library stores the position of the song in the playlist and needs to be updated
                 FileSystemEntry *library = get_library();
@@ -156,6 +432,9 @@ void move_down_list(PlayList *list, Node *node, bool change_library_status)
         else
                 list->tail = node;
 
+        shuffle_invalidate(list);
+        playlist_mark_changed(list);
+
         if (change_library_status) {
                 // Is_enqueued in library stores the position of the song in the playlist and needs to be updated
                 FileSystemEntry *library = get_library();
@@ -176,6 +455,10 @@ Node *delete_from_list(PlayList *list, Node *node)
 
         Node *next_node = node->next;
 
+        if (list->shuffle != NULL && list->shuffle->frontier == node)
+                list->shuffle->frontier = node->prev;
+        shuffle_invalidate(list);
+
         // Adjust head and tail
         if (list->head == node)
                 list->head = next_node;
@@ -199,6 +482,8 @@ Node *delete_from_list(PlayList *list, Node *node)
 
         list->count--;
 
+        playlist_mark_changed(list);
+
         return next_node;
 }
 
@@ -218,50 +503,45 @@ void empty_playlist(PlayList *list)
         list->head = NULL;
         list->tail = NULL;
         list->count = 0;
+
+        shuffle_cursor_free(list);
+
+        playlist_mark_changed(list);
 }
 
-void shuffle_playlist(PlayList *playlist)
+static void shuffle_cursor_start(PlayList *playlist)
 {
-        if (playlist == NULL || playlist->count <= 1) {
-                return; // No need to shuffle
+        if (playlist->shuffle == NULL) {
+                playlist->shuffle = calloc(1, sizeof(struct ShuffleCursor));
+                if (playlist->shuffle == NULL) {
+                        printf(_("Memory allocation error.\n"));
+                        quit();
+                }
         }
 
-        // Check for overflow before malloc
-        if ((size_t)playlist->count > SIZE_MAX / sizeof(Node *)) {
-                printf(_("Playlist too large to allocate.\n"));
-                quit();
-        }
+        // A new epoch makes every node count as not linked yet
+        shuffle_epoch_counter++;
+        if (shuffle_epoch_counter == 0)
+                shuffle_epoch_counter++;
 
-        // Convert the linked list to an array
-        Node **nodes = (Node **)malloc(playlist->count * sizeof(Node *));
-        if (nodes == NULL) {
-                printf(_("Memory allocation error.\n"));
-                quit();
-        }
+        playlist->shuffle->epoch = shuffle_epoch_counter;
+        playlist->shuffle->frontier = NULL;
 
-        Node *current = playlist->head;
-        int i = 0;
-        while (current != NULL) {
-                nodes[i++] = current;
-                current = current->next;
-        }
+        shuffle_cursor_rebase(playlist, playlist->shuffle);
+}
 
-        // Shuffle the array using Fisher-Yates algorithm
-        for (int j = playlist->count - 1; j >= 1; --j) {
-                int k = rand() % (j + 1);
-                Node *tmp = nodes[j];
-                nodes[j] = nodes[k];
-                nodes[k] = tmp;
+void shuffle_playlist(PlayList *playlist)
+{
+        if (playlist == NULL || playlist->count <= 1) {
+                return; // No need to shuffle
         }
 
-        playlist->head = nodes[0];
-        playlist->tail = nodes[playlist->count - 1];
-        for (int j = 0; j < playlist->count; ++j) {
-                nodes[j]->next =
-                    (j < playlist->count - 1) ? nodes[j + 1] : NULL;
-                nodes[j]->prev = (j > 0) ? nodes[j - 1] : NULL;
-        }
-        free(nodes);
+        shuffle_cursor_start(playlist);
+
+        // Only the first song and the one after it are put in place now
+        Node *first = shuffle_link_next(playlist);
+        if (first != NULL)
+                shuffle_link_next(playlist);
 }
 
 void insert_as_first(Node *current_song, PlayList *playlist)
@@ -294,14 +574,28 @@ void insert_as_first(Node *current_song, PlayList *playlist)
                         playlist->head = current_song;
                 }
         }
+
+        shuffle_invalidate(playlist);
+        playlist_mark_changed(playlist);
 }
 
 void shuffle_playlist_starting_from_song(PlayList *playlist, Node *song)
 {
-        shuffle_playlist(playlist);
-        if (song != NULL && playlist->count > 1) {
-                insert_as_first(song, playlist);
+        if (song == NULL) {
+                shuffle_playlist(playlist);
+                return;
         }
+
+        if (playlist == NULL || playlist->count <= 1)
+                return;
+
+        shuffle_cursor_start(playlist);
+
+        shuffle_link_after_frontier(playlist, playlist->shuffle, song);
+        playlist_mark_changed(playlist);
+        shuffle_invalidate(playlist);
+
+        shuffle_link_next(playlist);
 }
 
 void create_node(Node **node, const char *directory_path, int id)
@@ -322,6 +616,7 @@ void create_node(Node **node, const char *directory_path, int id)
         (*node)->next = NULL;
         (*node)->prev = NULL;
         (*node)->id = id;
+        (*node)->shuffle_epoch = 0;
 }
 
 void destroy_node(Node *node)
@@ -729,6 +1024,9 @@ int join_playlist(PlayList *dest, PlayList *src)
         src->tail = NULL;
         src->count = 0;
 
+        playlist_mark_appended(dest);
+        playlist_mark_changed(src);
+
         return 1;
 }
 
@@ -939,42 +1237,6 @@ int make_playlist(PlayList **playlist, int argc, char *argv[], bool exact_search
         return 0;
 }
 
-#ifdef _WIN32
-#include <stdlib.h>
-#include <windows.h>
-
-static wchar_t *utf8_to_wide(const char *s)
-{
-        int size = MultiByteToWideChar(
-            CP_UTF8,
-            0,
-            s,
-            -1,
-            NULL,
-            0);
-
-        if (size <= 0)
-                return NULL;
-
-        wchar_t *result = malloc(size * sizeof(wchar_t));
-        if (!result)
-                return NULL;
-
-        if (MultiByteToWideChar(
-                CP_UTF8,
-                0,
-                s,
-                -1,
-                result,
-                size) <= 0) {
-                free(result);
-                return NULL;
-        }
-
-        return result;
-}
-#endif
-
 void generate_m3_u_filename(const char *base_path, const char *file_path,
                             char *m3u_filename, size_t size)
 {
@@ -1009,29 +1271,34 @@ void generate_m3_u_filename(const char *base_path, const char *file_path,
 
 void write_m3u_file(const char *filename, const PlayList *playlist)
 {
-        FILE *file;
-
-#ifdef _WIN32
-        wchar_t *wfilename = utf8_to_wide(filename);
-        if (!wfilename)
+        if (filename == NULL || playlist == NULL)
                 return;
 
-        file = _wfopen(wfilename, L"w");
-        free(wfilename);
-#else
-        file = fopen(filename, "w");
-#endif
+        // Serialize into one buffer here, the writer thread does the disk I/O
+        size_t size = 0;
+        for (Node *node = playlist->head; node != NULL; node = node->next) {
+                if (node->song.file_path != NULL)
+                        size += strlen(node->song.file_path) + 1;
+        }
 
-        if (file == NULL)
+        char *data = malloc(size > 0 ? size : 1);
+        if (data == NULL) {
+                k_log("write_m3u_file: malloc\n");
                 return;
+        }
 
-        Node *current_node = playlist->head;
-        while (current_node != NULL) {
-                fprintf(file, "%s\n", current_node->song.file_path);
-                current_node = current_node->next;
+        char *dst = data;
+        for (Node *node = playlist->head; node != NULL; node = node->next) {
+                if (node->song.file_path == NULL)
+                        continue;
+
+                size_t len = strlen(node->song.file_path);
+                memcpy(dst, node->song.file_path, len);
+                dst += len;
+                *dst++ = '\n';
         }
 
-        fclose(file);
+        playlist_writer_submit(filename, data, size);
 }
 
 void load_playlist(const char *directory, const char *playlist_name,
@@ -1079,6 +1346,7 @@ void insert_at_position(PlayList *playlist, Node *node, int position)
                         playlist->tail = node;
 
                 playlist->head = node;
+                playlist_mark_changed(playlist);
                 return;
         }
 
@@ -1099,6 +1367,8 @@ void insert_at_position(PlayList *playlist, Node *node, int position)
                 playlist->tail = node;
 
         current->next = node;
+
+        playlist_mark_changed(playlist);
 }
 
 void add_enqueued_songs_to_playlist(FileSystemEntry *root, PlayList *playlist)
@@ -1113,6 +1383,7 @@ void add_enqueued_songs_to_playlist(FileSystemEntry *root, PlayList *playlist)
                 node->id = root->id;
                 node->song.duration = 0.0;
                 node->prev = node->next = NULL;
+                node->shuffle_epoch = 0;
 
                 insert_at_position(playlist, node, root->is_enqueued);
                 playlist->count++;
@@ -1207,6 +1478,7 @@ Node *deep_copy_node(Node *original_node)
         new_node->song.duration = original_node->song.duration;
         new_node->prev = NULL;
         new_node->id = original_node->id;
+        new_node->shuffle_epoch = 0;
         new_node->next = deep_copy_node(original_node->next);
 
         if (new_node->next != NULL) {
@@ -1245,11 +1517,15 @@ void deep_copy_list(const PlayList *original_list, PlayList **new_list)
                 pthread_mutex_init(&(*new_list)->mutex, NULL);
         } else if ((*new_list)->count > 0) {
                 empty_playlist(*new_list);
+        } else {
+                shuffle_cursor_free(*new_list);
         }
 
         (*new_list)->head = deep_copy_node(original_list->head);
         (*new_list)->tail = find_tail((*new_list)->head);
         (*new_list)->count = original_list->count;
+
+        playlist_mark_changed(*new_list);
 }
 
 Node *find_path_in_playlist(const char *path, PlayList *playlist)
@@ -1457,46 +1733,38 @@ void add_albums_to_play_list(FileSystemEntry *entry, PlayList *list,
         }
 }
 
-void shuffle_entries(FileSystemEntry **array, size_t n)
-{
-        if (n > 1) {
-                for (size_t i = 0; i < n - 1; i++) {
-                        size_t j = get_random_number(i, n - 1);
-
-                        // Swap entries at i and j
-                        FileSystemEntry *tmp = array[i];
-                        array[i] = array[j];
-                        array[j] = tmp;
-                }
-        }
-}
-
-void collect_albums(FileSystemEntry *entry, FileSystemEntry **albums,
-                    size_t *count)
+static void collect_albums(FileSystemEntry *entry, FileSystemEntry ***albums,
+                           size_t *count, size_t *capacity)
 {
-        if (entry == NULL)
-                return;
+        while (entry != NULL) {
+                if (entry->is_directory && contains_music_files(entry)) {
+                        if (*count == *capacity) {
+                                size_t new_capacity = *capacity ? *capacity * 2 : 256;
+                                FileSystemEntry **tmp = realloc(*albums, new_capacity * sizeof(FileSystemEntry *));
+                                if (tmp == NULL) {
+                                        k_log("collect_albums: realloc\n");
+                                        return;
+                                }
+                                *albums = tmp;
+                                *capacity = new_capacity;
+                        }
 
-        if (entry->is_directory && contains_music_files(entry)) {
-                albums[*count] = entry;
-                (*count)++;
-        }
+                        (*albums)[(*count)++] = entry;
+                }
 
-        if (entry->is_directory && entry->children != NULL) {
-                collect_albums(entry->children, albums, count);
-        }
+                if (entry->is_directory && entry->children != NULL)
+                        collect_albums(entry->children, albums, count, capacity);
 
-        if (entry->next != NULL) {
-                collect_albums(entry->next, albums, count);
+                entry = entry->next;
         }
 }
 
 void add_shuffled_albums_to_play_list(FileSystemEntry *root, PlayList *list,
                                       int playlist_max)
 {
-        size_t maxAlbums = 2000;
-        FileSystemEntry *albums[maxAlbums];
-        size_t albumCount = 0;
+        FileSystemEntry **albums = NULL;
+        size_t album_count = 0;
+        size_t album_capacity = 0;
         bool sort = true;
         unsigned long file_count = count_music_files_in_directory(root);
         if (file_count > MAX_SORT_SIZE) {
@@ -1504,19 +1772,28 @@ void add_shuffled_albums_to_play_list(FileSystemEntry *root, PlayList *list,
                 sort = false;
         }
 
-        collect_albums(root, albums, &albumCount);
+        collect_albums(root, &albums, &album_count, &album_capacity);
 
-        shuffle_entries(albums, albumCount);
+        if (album_count == 0) {
+                free(albums);
+                return;
+        }
 
-        if (sort) {
-                for (size_t i = 0; i < albumCount && list->count < playlist_max; i++) {
-                        add_album_to_play_list(list, albums[i], playlist_max);
-                }
-        } else {
-                for (size_t i = 0; i < albumCount && list->count < playlist_max; i++) {
-                        add_album_to_play_list_unsorted(list, albums[i], playlist_max);
-                }
+        // Albums are visited in permuted order, so nothing is swapped up front
+        // and the loop stops as soon as the playlist is full.
+        ShufflePerm perm;
+        shuffle_perm_init(&perm, album_count, shuffle_perm_random_seed());
+
+        for (size_t i = 0; i < album_count && list->count < playlist_max; i++) {
+                FileSystemEntry *album = albums[shuffle_perm_apply(&perm, i)];
+
+                if (sort)
+                        add_album_to_play_list(list, album, playlist_max);
+                else
+                        add_album_to_play_list_unsorted(list, album, playlist_max);
         }
+
+        free(albums);
 }
 
 int increment_node_id()
@@ -31,8 +31,11 @@ void clear_current_song(void);
 /**
  * @brief Sets the currently selected song.
  *
+ * When the playlist is shuffled, also links the song after it into play
+ * order. A song that was not reached yet is moved up to play next.
+ *
  * @param node Pointer to the node representing the song to set
- *             as the current song. May be NULL.
+ *             as the current song. Must belong to the playlist. May be NULL.
  */
 void set_current_song(Node *node);
 
@@ -46,6 +49,9 @@ Node *get_current_song(void);
 /**
  * @brief Returns the next node in the playlist.
  *
+ * On a shuffled playlist this is where the next song in play order is
+ * picked and linked in, one step at a time.
+ *
  * @param node The current node.
  * @return Pointer to the next node, or NULL if node is NULL
  *         or if there is no next node.
@@ -131,7 +137,9 @@ void empty_playlist(PlayList *list);
  *
  * @param playlist Pointer to the playlist.
  *
- * @note Uses the Fisher-Yates shuffle algorithm.
+ * @note The shuffle is lazy: a seeded Feistel permutation picks songs
+ *       one at a time and they are linked in as they come up, so only
+ *       the first two are placed here.
  *       Exits the program on memory allocation failure.
  */
 void shuffle_playlist(PlayList *playlist);
@@ -142,8 +150,8 @@ void shuffle_playlist(PlayList *playlist);
  * @param playlist Pointer to the playlist.
  * @param song Pointer to the song that should remain first after shuffle.
  *
- * @note The playlist is shuffled first, then the specified song
- *       is moved to the head if present.
+ * @note The song is moved to the head and the rest is shuffled lazily,
+ *       as with shuffle_playlist.
  */
 void shuffle_playlist_starting_from_song(PlayList *playlist, Node *song);
 
@@ -213,6 +221,9 @@ int make_playlist(PlayList **playlist, int argc, char *argv[],
 /**
  * @brief Writes a playlist to an M3U file.
  *
+ * The file is written in the background and replaced atomically, see
+ * playlist_writer.h.
+ *
  * @param filename Output file path.
  * @param playlist Playlist to write.
  */
@@ -0,0 +1,350 @@
+/**
+ * @file playlist_snapshot.c
+ * @brief Immutable, versioned copies of a playlist for lock-free readers.
+ *
+ * Builds flat copies of a playlist under its mutex and publishes them
+ * through an atomic pointer. See playlist_snapshot.h for the rules on
+ * when a snapshot may be read and when it is freed.
+ *
+ * The entries live in a store that a run of snapshots shares. A snapshot
+ * only reads the first count entries, and those are never written again,
+ * so the next snapshot can append behind them. Paths are copied into
+ * blocks that never move, so a store can be grown by copying just the
+ * entry array.
+ */
+
+#include "playlist_snapshot.h"
+
+#include "utils/k_log.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PATH_BLOCK_SIZE (64 * 1024)
+#define MIN_STORE_CAPACITY 64
+
+typedef struct PathBlock {
+        struct PathBlock *next;
+        size_t used;
+        size_t size;
+        char data[];
+} PathBlock;
+
+// Path storage, shared by every store grown from the same rebuild
+typedef struct {
+        int refs;
+        PathBlock *blocks; // Newest first
+} PathArena;
+
+typedef struct SnapshotStore {
+        int refs; // Snapshots using it. Only touched on the main loop.
+        int used; // Entries written
+        int capacity;
+        PlaylistSnapshotEntry *entries;
+        PathArena *paths;
+} SnapshotStore;
+
+static PlaylistSnapshot *retired = NULL;
+
+static void release_paths(PathArena *paths)
+{
+        if (paths == NULL || --paths->refs > 0)
+                return;
+
+        PathBlock *block = paths->blocks;
+
+        while (block != NULL) {
+                PathBlock *next = block->next;
+                free(block);
+                block = next;
+        }
+
+        free(paths);
+}
+
+static void release_store(SnapshotStore *store)
+{
+        if (store == NULL || --store->refs > 0)
+                return;
+
+        release_paths(store->paths);
+        free(store->entries);
+        free(store);
+}
+
+static void free_snapshot(PlaylistSnapshot *snap)
+{
+        if (snap == NULL)
+                return;
+
+        release_store(snap->store);
+        free(snap);
+}
+
+static const char *copy_path(PathArena *paths, const char *path)
+{
+        size_t len = strlen(path) + 1;
+        PathBlock *block = paths->blocks;
+
+        if (block == NULL || block->size - block->used < len) {
+                size_t size = len > PATH_BLOCK_SIZE ? len : PATH_BLOCK_SIZE;
+
+                block = malloc(sizeof(PathBlock) + size);
+                if (block == NULL)
+                        return NULL;
+
+                block->used = 0;
+                block->size = size;
+                block->next = paths->blocks;
+                paths->blocks = block;
+        }
+
+        char *dst = block->data + block->used;
+        memcpy(dst, path, len);
+        block->used += len;
+
+        return dst;
+}
+
+static SnapshotStore *create_store(int capacity, PathArena *paths)
+{
+        SnapshotStore *store = calloc(1, sizeof(SnapshotStore));
+        if (store == NULL)
+                return NULL;
+
+        if (capacity < MIN_STORE_CAPACITY)
+                capacity = MIN_STORE_CAPACITY;
+
+        store->entries = malloc(capacity * sizeof(PlaylistSnapshotEntry));
+        if (store->entries == NULL) {
+                free(store);
+                return NULL;
+        }
+
+        if (paths == NULL) {
+                paths = calloc(1, sizeof(PathArena));
+                if (paths == NULL) {
+                        free(store->entries);
+                        free(store);
+                        return NULL;
+                }
+        }
+
+        paths->refs++;
+        store->paths = paths;
+        store->capacity = capacity;
+        store->refs = 1;
+
+        return store;
+}
+
+// Copies count nodes starting at node into the store, behind its used entries
+static bool append_nodes(SnapshotStore *store, Node *node, int count, double *total_duration)
+{
+        for (int i = 0; i < count && node != NULL; i++, node = node->next) {
+                PlaylistSnapshotEntry *entry = &store->entries[store->used];
+
+                entry->id = node->id;
+                entry->duration = node->song.duration;
+                entry->file_path = NULL;
+
+                if (node->song.file_path != NULL) {
+                        entry->file_path = copy_path(store->paths, node->song.file_path);
+                        if (entry->file_path == NULL)
+                                return false;
+                }
+
+                *total_duration += node->song.duration;
+                store->used++;
+        }
+
+        return true;
+}
+
+static PlaylistSnapshot *build_snapshot(const PlayList *list, unsigned long version)
+{
+        PlaylistSnapshot *snap = calloc(1, sizeof(PlaylistSnapshot));
+        if (snap == NULL) {
+                k_log("build_snapshot: calloc\n");
+                return NULL;
+        }
+
+        snap->version = version;
+
+        int count = 0;
+        for (Node *node = list->head; node != NULL; node = node->next)
+                count++;
+
+        // Room to grow, so a queue that is being filled appends in place
+        snap->store = create_store(count + count / 2, NULL);
+
+        if (snap->store == NULL ||
+            !append_nodes(snap->store, list->head, count, &snap->total_duration)) {
+                k_log("build_snapshot: malloc\n");
+                free_snapshot(snap);
+                return NULL;
+        }
+
+        snap->entries = snap->store->entries;
+        snap->count = snap->store->used;
+
+        return snap;
+}
+
+// Publishes the nodes added at the tail since prev, sharing prev's entries.
+// Returns NULL if the list didn't only grow, or prev's store was appended to.
+static PlaylistSnapshot *extend_snapshot(const PlayList *list, const PlaylistSnapshot *prev,
+                                         unsigned long version)
+{
+        SnapshotStore *store = prev->store;
+        int added = list->count - prev->count;
+
+        if (store == NULL || added < 0 || store->used != prev->count)
+                return NULL;
+
+        // Walk back from the tail to the first new node
+        Node *first = list->tail;
+        for (int i = 1; i < added && first != NULL; i++)
+                first = first->prev;
+
+        if (added > 0 && first == NULL)
+                return NULL;
+
+        PlaylistSnapshot *snap = calloc(1, sizeof(PlaylistSnapshot));
+        if (snap == NULL)
+                return NULL;
+
+        if (store->used + added > store->capacity) {
+                // Grow by copying the entries, the paths stay where they are
+                SnapshotStore *bigger = create_store((store->used + added) * 2, store->paths);
+                if (bigger == NULL) {
+                        free(snap);
+                        return NULL;
+                }
+
+                memcpy(bigger->entries, store->entries, store->used * sizeof(PlaylistSnapshotEntry));
+                bigger->used = store->used;
+                store = bigger;
+        } else {
+                store->refs++;
+        }
+
+        snap->store = store;
+        snap->version = version;
+        snap->appended_from = prev->count;
+        snap->total_duration = prev->total_duration;
+
+        if (added > 0 && !append_nodes(store, first, added, &snap->total_duration)) {
+                free_snapshot(snap);
+                return NULL;
+        }
+
+        snap->entries = store->entries;
+        snap->count = store->used;
+
+        return snap;
+}
+
+void playlist_mark_changed(PlayList *list)
+{
+        if (list == NULL)
+                return;
+
+        // The flag before the version, so a refresh that sees the new
+        // version also sees that it can't just append
+        atomic_store_explicit(&list->needs_rebuild, true, memory_order_relaxed);
+        atomic_fetch_add_explicit(&list->version, 1, memory_order_release);
+}
+
+void playlist_mark_appended(PlayList *list)
+{
+        if (list != NULL)
+                atomic_fetch_add_explicit(&list->version, 1, memory_order_release);
+}
+
+bool playlist_snapshot_refresh(PlayList *list)
+{
+        if (list == NULL)
+                return false;
+
+        if (pthread_mutex_trylock(&list->mutex) != 0)
+                return false;
+
+        PlaylistSnapshot *current = atomic_load_explicit(&list->snapshot, memory_order_relaxed);
+        unsigned long version = atomic_load_explicit(&list->version, memory_order_acquire);
+
+        if (current != NULL && current->version == version) {
+                pthread_mutex_unlock(&list->mutex);
+                return false;
+        }
+
+        bool rebuild = atomic_exchange_explicit(&list->needs_rebuild, false, memory_order_relaxed);
+
+        PlaylistSnapshot *snap = NULL;
+
+        if (!rebuild && current != NULL)
+                snap = extend_snapshot(list, current, version);
+
+        if (snap == NULL)
+                snap = build_snapshot(list, version);
+
+        // A change that landed during the copy is only known to be an append
+        // if its flag was not taken above, so copy everything next time
+        if (atomic_load_explicit(&list->version, memory_order_acquire) != version)
+                atomic_store_explicit(&list->needs_rebuild, true, memory_order_relaxed);
+
+        pthread_mutex_unlock(&list->mutex);
+
+        if (snap == NULL)
+                return false;
+
+        PlaylistSnapshot *old = atomic_exchange_explicit(&list->snapshot, snap, memory_order_acq_rel);
+
+        if (old != NULL) {
+                old->retired_next = retired;
+                retired = old;
+        }
+
+        return true;
+}
+
+void playlist_snapshot_reclaim(void)
+{
+        PlaylistSnapshot *snap = retired;
+        retired = NULL;
+
+        while (snap != NULL) {
+                PlaylistSnapshot *next = snap->retired_next;
+                free_snapshot(snap);
+                snap = next;
+        }
+}
+
+const PlaylistSnapshot *playlist_snapshot_get(const PlayList *list)
+{
+        if (list == NULL)
+                return NULL;
+
+        return atomic_load_explicit(&((PlayList *)list)->snapshot, memory_order_acquire);
+}
+
+int playlist_snapshot_count(const PlayList *list)
+{
+        const PlaylistSnapshot *snap = playlist_snapshot_get(list);
+
+        return snap ? snap->count : 0;
+}
+
+void playlist_snapshot_release(PlayList *list)
+{
+        if (list == NULL)
+                return;
+
+        PlaylistSnapshot *old = atomic_exchange_explicit(&list->snapshot, NULL, memory_order_acq_rel);
+
+        if (old != NULL) {
+                old->retired_next = retired;
+                retired = old;
+        }
+}
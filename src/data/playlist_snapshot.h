@@ -0,0 +1,105 @@
+/**
+ * @file playlist_snapshot.h
+ * @brief Immutable, versioned copies of a playlist for lock-free readers.
+ *
+ * Writers keep mutating the linked list under its mutex and bump its
+ * version. Once per tick the main loop publishes a flat copy of the list,
+ * and the renderer and the MPRIS property getters read that copy through
+ * an atomic pointer without taking any lock. When songs were only added
+ * at the end, the new copy shares the entries of the previous one and only
+ * the added songs are copied.
+ *
+ * Old copies are retired rather than freed, and reclaimed at the start of
+ * the next tick. All readers run on the main loop, so a copy that was
+ * replaced a tick ago can no longer be referenced by anyone.
+ */
+
+#ifndef PLAYLIST_SNAPSHOT_H
+#define PLAYLIST_SNAPSHOT_H
+
+#include "playlist_type.h"
+
+#include <stdbool.h>
+
+typedef struct
+{
+        int id;
+        const char *file_path;
+        double duration;
+} PlaylistSnapshotEntry;
+
+struct SnapshotStore;
+
+typedef struct PlaylistSnapshot {
+        unsigned long version;
+        int count;
+        int appended_from; // Entries before this were in the previous snapshot too
+        double total_duration;
+        const PlaylistSnapshotEntry *entries;
+        struct SnapshotStore *store; // Shared with the snapshots it was appended to
+        struct PlaylistSnapshot *retired_next;
+} PlaylistSnapshot;
+
+/**
+ * @brief Marks a playlist as changed so the next refresh republishes it.
+ *
+ * Must be called by any code that unlinks, reorders or edits nodes. Safe
+ * to call without the playlist mutex.
+ *
+ * @param list The playlist that was modified.
+ */
+void playlist_mark_changed(PlayList *list);
+
+/**
+ * @brief Marks a playlist as grown at the tail only.
+ *
+ * The next refresh copies just the new nodes, unless something else
+ * changed too. Safe to call without the playlist mutex.
+ *
+ * @param list The playlist that nodes were appended to.
+ */
+void playlist_mark_appended(PlayList *list);
+
+/**
+ * @brief Publishes a new snapshot of the playlist if it has changed.
+ *
+ * Never blocks: if a writer currently holds the playlist mutex the
+ * previous snapshot stays in place and the refresh is retried on the
+ * next call. The replaced snapshot is retired, not freed.
+ *
+ * Must be called from the main loop thread.
+ *
+ * @param list The playlist to publish.
+ * @return true if a new snapshot was published.
+ */
+bool playlist_snapshot_refresh(PlayList *list);
+
+/**
+ * @brief Frees the snapshots retired during the previous tick.
+ *
+ * Must be called from the main loop thread, before the tick's refreshes.
+ */
+void playlist_snapshot_reclaim(void);
+
+/**
+ * @brief Returns the latest published snapshot of the playlist.
+ *
+ * The result is valid until the next call to playlist_snapshot_reclaim()
+ * and must not be kept across ticks.
+ *
+ * @param list The playlist.
+ * @return The snapshot, or NULL if none has been published yet.
+ */
+const PlaylistSnapshot *playlist_snapshot_get(const PlayList *list);
+
+/**
+ * @brief Returns the number of entries in the latest snapshot, or 0.
+ */
+int playlist_snapshot_count(const PlayList *list);
+
+/**
+ * @brief Frees the published snapshot of a playlist that is being destroyed.
+ */
+void playlist_snapshot_release(PlayList *list);
+
+#endif
@@ -2,6 +2,8 @@
 #define PLAYLIST_STRUCT
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 
 typedef struct
 {
@@ -14,14 +16,22 @@ typedef struct Node {
         SongInfo song;
         struct Node *next;
         struct Node *prev;
+        unsigned int shuffle_epoch; // Equals the list's shuffle epoch once linked into play order
 } Node;
 
+struct PlaylistSnapshot;
+struct ShuffleCursor;
+
 typedef struct
 {
         Node *head;
         Node *tail;
         int count;
         pthread_mutex_t mutex;
+        _Atomic unsigned long version;             // Bumped by every change
+        atomic_bool needs_rebuild;                 // Set by changes other than appends at the tail
+        struct PlaylistSnapshot *_Atomic snapshot; // Last published immutable copy, see playlist_snapshot.h
+        struct ShuffleCursor *shuffle;             // Lazy shuffle state, NULL when the list is in plain order
 } PlayList;
 
 #endif
@@ -0,0 +1,280 @@
+/**
+ * @file playlist_writer.c
+ * @brief Background, crash-safe writing of playlist files.
+ *
+ * Coalescing job queue and the worker that writes temp files, syncs
+ * them and renames them into place.
+ */
+
+#include "playlist_writer.h"
+
+#include "common/events.h"
+#include "common/model.h"
+#include "common/path_max.h"
+
+#include "update/messages.h"
+
+#include "utils/k_log.h"
+#include "utils/utils.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+typedef struct WriteJob {
+        char path[KEW_PATH_MAX];
+        char *data;
+        size_t size;
+        struct WriteJob *next;
+} WriteJob;
+
+static WriteJob *jobs_head = NULL;
+static WriteJob *jobs_tail = NULL;
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t writer_thread;
+static bool writer_running = false;
+static bool stop_writer = false;
+
+#ifdef _WIN32
+static wchar_t *utf8_to_wide(const char *s)
+{
+        int size = MultiByteToWideChar(
+            CP_UTF8,
+            0,
+            s,
+            -1,
+            NULL,
+            0);
+
+        if (size <= 0)
+                return NULL;
+
+        wchar_t *result = malloc(size * sizeof(wchar_t));
+        if (!result)
+                return NULL;
+
+        if (MultiByteToWideChar(
+                CP_UTF8,
+                0,
+                s,
+                -1,
+                result,
+                size) <= 0) {
+                free(result);
+                return NULL;
+        }
+
+        return result;
+}
+#endif
+
+static FILE *open_for_write(const char *path)
+{
+#ifdef _WIN32
+        wchar_t *wpath = utf8_to_wide(path);
+        if (!wpath)
+                return NULL;
+
+        FILE *file = _wfopen(wpath, L"wb");
+        free(wpath);
+
+        return file;
+#else
+        return fopen(path, "wb");
+#endif
+}
+
+static int replace_file(const char *tmp_path, const char *path)
+{
+#ifdef _WIN32
+        wchar_t *wtmp = utf8_to_wide(tmp_path);
+        wchar_t *wpath = utf8_to_wide(path);
+        int res = -1;
+
+        if (wtmp && wpath && MoveFileExW(wtmp, wpath, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+                res = 0;
+
+        free(wtmp);
+        free(wpath);
+
+        return res;
+#else
+        return rename(tmp_path, path);
+#endif
+}
+
+static void remove_file(const char *path)
+{
+#ifdef _WIN32
+        wchar_t *wpath = utf8_to_wide(path);
+        if (wpath) {
+                _wremove(wpath);
+                free(wpath);
+        }
+#else
+        unlink(path);
+#endif
+}
+
+static int write_atomically(const char *path, const char *data, size_t size)
+{
+        char tmp_path[KEW_PATH_MAX + 8];
+
+        if (snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path))
+                return -1;
+
+        FILE *file = open_for_write(tmp_path);
+        if (file == NULL)
+                return -1;
+
+        bool ok = fwrite(data, 1, size, file) == size;
+
+        ok = fflush(file) == 0 && ok;
+
+#ifdef _WIN32
+        ok = _commit(_fileno(file)) == 0 && ok;
+#else
+        ok = fsync(fileno(file)) == 0 && ok;
+#endif
+
+        ok = fclose(file) == 0 && ok;
+
+        if (!ok || replace_file(tmp_path, path) != 0) {
+                remove_file(tmp_path);
+                return -1;
+        }
+
+        return 0;
+}
+
+static void *writer_thread_func(void *arg)
+{
+        (void)arg;
+
+        pthread_mutex_lock(&writer_mutex);
+
+        while (true) {
+                if (jobs_head == NULL) {
+                        if (stop_writer)
+                                break;
+
+                        pthread_cond_wait(&writer_cond, &writer_mutex);
+                        continue;
+                }
+
+                WriteJob *job = jobs_head;
+                jobs_head = job->next;
+                if (jobs_head == NULL)
+                        jobs_tail = NULL;
+
+                pthread_mutex_unlock(&writer_mutex);
+
+                int res = write_atomically(job->path, job->data, job->size);
+
+                if (res != 0)
+                        k_log("Failed to save playlist: %s\n", job->path);
+
+                struct Msg msg = {.type = MSG_PLAYLIST_SAVED, .chosen_song_id = -1, .ok = (res == 0)};
+                dispatch_msg(msg);
+
+                free(job->data);
+                free(job);
+
+                pthread_mutex_lock(&writer_mutex);
+        }
+
+        pthread_mutex_unlock(&writer_mutex);
+
+        return NULL;
+}
+
+void playlist_writer_submit(const char *path, char *data, size_t size)
+{
+        if (path == NULL || data == NULL) {
+                free(data);
+                return;
+        }
+
+        pthread_mutex_lock(&writer_mutex);
+
+        // A newer save of the same file supersedes one that hasn't been written yet
+        for (WriteJob *job = jobs_head; job != NULL; job = job->next) {
+                if (strcmp(job->path, path) == 0) {
+                        free(job->data);
+                        job->data = data;
+                        job->size = size;
+                        pthread_mutex_unlock(&writer_mutex);
+                        return;
+                }
+        }
+
+        WriteJob *job = malloc(sizeof(WriteJob));
+        if (job == NULL) {
+                pthread_mutex_unlock(&writer_mutex);
+                free(data);
+                return;
+        }
+
+        c_strcpy(job->path, path, sizeof(job->path));
+        job->data = data;
+        job->size = size;
+        job->next = NULL;
+
+        if (jobs_tail)
+                jobs_tail->next = job;
+        else
+                jobs_head = job;
+        jobs_tail = job;
+
+        if (!writer_running && !stop_writer) {
+                if (pthread_create(&writer_thread, NULL, writer_thread_func, NULL) == 0)
+                        writer_running = true;
+                else
+                        k_log("Failed to create playlist writer thread.\n");
+        }
+
+        pthread_cond_signal(&writer_cond);
+
+        pthread_mutex_unlock(&writer_mutex);
+
+        // Without a worker, write on the caller's thread rather than lose the save
+        if (!writer_running) {
+                pthread_mutex_lock(&writer_mutex);
+                WriteJob *pending = jobs_head;
+                jobs_head = jobs_tail = NULL;
+                pthread_mutex_unlock(&writer_mutex);
+
+                while (pending != NULL) {
+                        WriteJob *next = pending->next;
+                        if (write_atomically(pending->path, pending->data, pending->size) != 0)
+                                k_log("Failed to save playlist: %s\n", pending->path);
+                        free(pending->data);
+                        free(pending);
+                        pending = next;
+                }
+        }
+}
+
+void playlist_writer_shutdown(void)
+{
+        pthread_mutex_lock(&writer_mutex);
+        stop_writer = true;
+        pthread_cond_signal(&writer_cond);
+        bool running = writer_running;
+        pthread_mutex_unlock(&writer_mutex);
+
+        if (running) {
+                pthread_join(writer_thread, NULL);
+                writer_running = false;
+        }
+}
@@ -0,0 +1,36 @@
+/**
+ * @file playlist_writer.h
+ * @brief Background, crash-safe writing of playlist files.
+ *
+ * Playlists are serialized on the caller's thread into a single buffer and
+ * handed to a worker thread, which writes it to a temporary file next to
+ * the target, syncs it and renames it over the target. A crash mid-save
+ * leaves either the old or the new file, never a truncated one.
+ *
+ * Saves to a path that is still waiting in the queue replace the pending
+ * buffer, so repeated saves of the same list are written once. Each
+ * finished write is reported with a MSG_PLAYLIST_SAVED message.
+ */
+
+#ifndef PLAYLIST_WRITER_H
+#define PLAYLIST_WRITER_H
+
+#include <stddef.h>
+
+/**
+ * @brief Queues a buffer to be written atomically to a file.
+ *
+ * Starts the worker thread on first use.
+ *
+ * @param path Destination file path.
+ * @param data Contents to write. Ownership passes to the writer, which frees it.
+ * @param size Number of bytes in data.
+ */
+void playlist_writer_submit(const char *path, char *data, size_t size);
+
+/**
+ * @brief Writes out everything still queued and stops the worker thread.
+ */
+void playlist_writer_shutdown(void);
+
+#endif
@@ -0,0 +1,89 @@
+/**
+ * @file shuffle_perm.c
+ * @brief Seeded, invertible permutations over an index range.
+ *
+ * Four Feistel rounds over two half-words. Values that land outside
+ * [0, n) are fed through again until they land inside; the domain is at
+ * most 4n, so that takes a few rounds on average.
+ */
+
+#include "shuffle_perm.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+static uint64_t splitmix64(uint64_t *state)
+{
+        uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+}
+
+void shuffle_perm_init(ShufflePerm *perm, uint64_t n, uint64_t seed)
+{
+        unsigned int bits = 2;
+        while (bits < 64 && ((uint64_t)1 << bits) < n)
+                bits++;
+
+        perm->n = n;
+        perm->half_bits = (bits + 1) / 2;
+        perm->half_mask = (uint32_t)(((uint64_t)1 << perm->half_bits) - 1);
+
+        for (int i = 0; i < 4; i++)
+                perm->keys[i] = (uint32_t)splitmix64(&seed);
+}
+
+uint64_t shuffle_perm_random_seed(void)
+{
+        return ((uint64_t)rand() << 32) ^ (uint64_t)rand() ^ (uint64_t)time(NULL);
+}
+
+static uint32_t shuffle_perm_round(uint32_t value, uint32_t key)
+{
+        uint32_t h = (value ^ key) * 0x85EBCA6Bu;
+        h ^= h >> 13;
+        h *= 0xC2B2AE35u;
+        h ^= h >> 16;
+        return h;
+}
+
+uint64_t shuffle_perm_apply(const ShufflePerm *perm, uint64_t index)
+{
+        uint64_t x = index;
+
+        do {
+                uint32_t left = (uint32_t)(x >> perm->half_bits) & perm->half_mask;
+                uint32_t right = (uint32_t)x & perm->half_mask;
+
+                for (int i = 0; i < 4; i++) {
+                        uint32_t tmp = right;
+                        right = left ^ (shuffle_perm_round(right, perm->keys[i]) & perm->half_mask);
+                        left = tmp;
+                }
+
+                x = ((uint64_t)left << perm->half_bits) | right;
+        } while (x >= perm->n);
+
+        return x;
+}
+
+uint64_t shuffle_perm_invert(const ShufflePerm *perm, uint64_t position)
+{
+        uint64_t x = position;
+
+        do {
+                uint32_t left = (uint32_t)(x >> perm->half_bits) & perm->half_mask;
+                uint32_t right = (uint32_t)x & perm->half_mask;
+
+                for (int i = 3; i >= 0; i--) {
+                        uint32_t tmp = left;
+                        left = right ^ (shuffle_perm_round(left, perm->keys[i]) & perm->half_mask);
+                        right = tmp;
+                }
+
+                x = ((uint64_t)left << perm->half_bits) | right;
+        } while (x >= perm->n);
+
+        return x;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file shuffle_perm.h
+ * @brief Seeded, invertible permutations over an index range.
+ *
+ * A small Feistel network over the smallest even-width bit domain that
+ * covers n, cycle-walked back into [0, n). Maps any index to its shuffled
+ * position and back in constant time, without storing the order.
+ */
+
+#ifndef SHUFFLE_PERM_H
+#define SHUFFLE_PERM_H
+
+#include <stdint.h>
+
+typedef struct
+{
+        uint64_t n;
+        unsigned int half_bits;
+        uint32_t half_mask;
+        uint32_t keys[4];
+} ShufflePerm;
+
+/**
+ * @brief Sets up a permutation of [0, n) from a seed.
+ *
+ * @param perm Permutation to initialize.
+ * @param n Size of the index range.
+ * @param seed Any 64-bit value; equal seeds give equal orders.
+ */
+void shuffle_perm_init(ShufflePerm *perm, uint64_t n, uint64_t seed);
+
+/**
+ * @brief Returns a fresh seed from the process random state and the clock.
+ */
+uint64_t shuffle_perm_random_seed(void);
+
+/**
+ * @brief Maps a step in the shuffled order to a position in [0, n).
+ *
+ * @param perm Initialized permutation.
+ * @param index Step, must be below perm->n.
+ * @return The position played at that step.
+ */
+uint64_t shuffle_perm_apply(const ShufflePerm *perm, uint64_t index);
+
+/**
+ * @brief Inverse of shuffle_perm_apply: the step at which a position plays.
+ *
+ * @param perm Initialized permutation.
+ * @param position Position, must be below perm->n.
+ * @return The step that maps to position.
+ */
+uint64_t shuffle_perm_invert(const ShufflePerm *perm, uint64_t position);
+
+#endif
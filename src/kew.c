@@ -66,6 +66,8 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. */
 #include "update/messages.h"
 #include "update/update.h"
 
+#include "loader/duration_probe.h"
+#include "loader/song_cache.h"
 #include "loader/song_loader.h"
 
 #include "ops/library_ops.h"
@@ -76,6 +78,8 @@ OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE. */
 #include "ops/track_manager.h"
 
 #include "data/img_func.h"
+#include "data/playlist_snapshot.h"
+#include "data/playlist_writer.h"
 #include "data/theme.h"
 
 #include "utils/file.h"
@@ -129,12 +133,32 @@ bool is_resize_cooldown_elapsed(int milli_seconds)
         return elapsed_milliseconds >= milli_seconds;
 }
 
+/**
+ * @brief Publishes new snapshots of the playlists.
+ *
+ * Needs neither the library nor the switch mutex, so it also runs on ticks
+ * that are skipped because another thread holds one of them.
+ */
+static void publish_playlists(Model *model)
+{
+        // Fill in durations found by the background probe
+        PlayList *lists[] = {model->unshuffled_playlist, model->playlist};
+        duration_probe_update(lists, 2);
+
+        if (playlist_snapshot_refresh(model->unshuffled_playlist))
+                duration_probe_queue_snapshot(playlist_snapshot_get(model->unshuffled_playlist));
+        playlist_snapshot_refresh(model->playlist);
+}
+
 /**
  * @brief Runs the Model-View-Update Tick
  *
  */
 void player_tick(Model *model, RenderContext *ctx)
 {
+        // Nobody can still hold a snapshot replaced during the previous tick
+        playlist_snapshot_reclaim();
+
         // Run MSG_TICK first so the songdata variable is set at the very start
         // Otherwise we get stale pointers and used after free, because we are using an old songdata from a previous lock.
         struct Msg msg = (struct Msg){.type = MSG_TICK};
@@ -160,6 +184,9 @@ void player_tick(Model *model, RenderContext *ctx)
                 }
         }
 
+        // Publish the lists as they are after this tick's updates
+        publish_playlists(model);
+
         if (can_refresh_player()) {
 
                 if (is_resize_cooldown_elapsed(COOLDOWN_RESIZE_MS)) // Don't re-render too often while resizing
@@ -254,6 +281,7 @@ void kew_shutdown()
         bool no_music_found = (model->library == NULL || model->library->children == NULL);
 
         songdata_shutdown();
+        duration_probe_shutdown();
         sound_system_shutdown();
         chroma_shutdown();
         chafa_shutdown();
@@ -262,6 +290,7 @@ void kew_shutdown()
         search_shutdown();
         mpris_shutdown();
         settings_shutdown();
+        playlist_writer_shutdown();
         library_shutdown();
         ui_shutdown();
         visualizer_shutdown();
@@ -376,6 +405,8 @@ gboolean mainloop_callback(gpointer data)
 
         if (mutex_result != 0) {
                 k_log("Failed to lock library mutex.\n");
+                playlist_snapshot_reclaim();
+                publish_playlists(model);
                 return TRUE;
         }
 
@@ -384,6 +415,8 @@ gboolean mainloop_callback(gpointer data)
         if (mutex_result2 != 0) {
                 k_log("Failed to lock switch mutex.\n");
                 pthread_mutex_unlock(&(model->state.library_mutex));
+                playlist_snapshot_reclaim();
+                publish_playlists(model);
                 return TRUE;
         }
 
@@ -644,6 +677,7 @@ void kew_init(bool set_library_enqueued_status)
         rand_init();
         library_init(set_library_enqueued_status);
         artists_db_init();
+        duration_probe_init();
         mpris_init();
         ui_init();
 
@@ -772,6 +806,8 @@ void state_init(void)
         state->settings.fade_quick_ms = 2000;
         state->settings.fade_medium_ms = 3000;
         state->settings.fade_slow_ms = 5000;
+        state->settings.song_cache_entries = SONG_CACHE_DEFAULT_ENTRIES;
+        state->settings.song_cache_mb = SONG_CACHE_DEFAULT_MB;
         state->ui.numDirectoryTreeEntries = 0;
         state->ui.num_progress_bars = DEFAULT_NUM_PROGRESS_BARS;
         state->ui.chosen_node_id = 0;
@@ -0,0 +1,963 @@
+#ifndef _DEFAULT_SOURCE
+#define _DEFAULT_SOURCE
+#endif
+
+/**
+ * @file duration_probe.c
+ * @brief Header-only track duration probing.
+ *
+ * Container parsers, the path+mtime cache and the probe thread pool.
+ */
+
+#include "duration_probe.h"
+
+#include "common/path_max.h"
+
+#include "data/playlist_writer.h"
+
+#include "utils/k_log.h"
+#include "utils/utils.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define PROBE_THREADS 2
+#define PROBE_BUCKETS 65536
+#define PROBE_TAIL_SIZE 65536
+#define PROBE_SYNC_WINDOW 16384
+#define PROBE_MAX_BOXES 256
+#define PROBE_APPLY_INTERVAL_MS 500
+
+static const char DURATION_CACHE_FILE[] = "durations.cache";
+
+// --- Container parsers ---
+
+static bool read_at(FILE *f, int64_t offset, void *buf, size_t size)
+{
+        if (offset < 0 || fseeko(f, (off_t)offset, SEEK_SET) != 0)
+                return false;
+
+        return fread(buf, 1, size, f) == size;
+}
+
+static uint32_t be32(const unsigned char *p)
+{
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static uint64_t be64(const unsigned char *p)
+{
+        return ((uint64_t)be32(p) << 32) | be32(p + 4);
+}
+
+static uint32_t le32(const unsigned char *p)
+{
+        return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+static uint64_t le64(const unsigned char *p)
+{
+        return ((uint64_t)le32(p + 4) << 32) | le32(p);
+}
+
+// Returns the offset of the first byte after an ID3v2 tag, or 0 if there is none
+static int64_t skip_id3v2(FILE *f)
+{
+        unsigned char hdr[10];
+
+        if (!read_at(f, 0, hdr, sizeof(hdr)) || memcmp(hdr, "ID3", 3) != 0)
+                return 0;
+
+        int64_t size = ((int64_t)(hdr[6] & 0x7f) << 21) | ((hdr[7] & 0x7f) << 14) |
+                       ((hdr[8] & 0x7f) << 7) | (hdr[9] & 0x7f);
+
+        return 10 + size + ((hdr[5] & 0x10) ? 10 : 0);
+}
+
+static const int mp3_bitrates[5][16] = {
+    {0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448, 0}, // MPEG1 Layer I
+    {0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 0},    // MPEG1 Layer II
+    {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0},     // MPEG1 Layer III
+    {0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256, 0},    // MPEG2/2.5 Layer I
+    {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0}};        // MPEG2/2.5 Layer II/III
+
+static const int mp3_sample_rates[3] = {44100, 48000, 32000};
+
+typedef struct
+{
+        int version; // 3 = MPEG1, 2 = MPEG2, 0 = MPEG2.5
+        int layer;   // 1, 2 or 3
+        int bitrate; // kbps
+        int sample_rate;
+        int samples_per_frame;
+        int frame_length;
+        bool mono;
+} Mp3Header;
+
+static bool parse_mp3_header(const unsigned char *p, Mp3Header *h)
+{
+        if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0)
+                return false;
+
+        int version = (p[1] >> 3) & 3;
+        int layer_bits = (p[1] >> 1) & 3;
+        int bitrate_index = p[2] >> 4;
+        int sr_index = (p[2] >> 2) & 3;
+
+        if (version == 1 || layer_bits == 0 || bitrate_index == 0 || bitrate_index == 15 || sr_index == 3)
+                return false;
+
+        h->version = version;
+        h->layer = 4 - layer_bits;
+        h->mono = (p[3] >> 6) == 3;
+
+        int table = (version == 3) ? h->layer - 1 : (h->layer == 1 ? 3 : 4);
+        h->bitrate = mp3_bitrates[table][bitrate_index];
+
+        h->sample_rate = mp3_sample_rates[sr_index];
+        if (version == 2)
+                h->sample_rate /= 2;
+        else if (version == 0)
+                h->sample_rate /= 4;
+
+        if (h->layer == 1)
+                h->samples_per_frame = 384;
+        else if (h->layer == 2 || version == 3)
+                h->samples_per_frame = 1152;
+        else
+                h->samples_per_frame = 576;
+
+        int padding = (p[2] >> 1) & 1;
+        int slot_bytes = (h->layer == 1) ? 4 : 1;
+
+        h->frame_length = (h->samples_per_frame / 8 / slot_bytes * h->bitrate * 1000 / h->sample_rate + padding) * slot_bytes;
+
+        return h->frame_length > 4;
+}
+
+static double probe_mp3(FILE *f, int64_t start, int64_t file_size)
+{
+        unsigned char buf[PROBE_SYNC_WINDOW];
+
+        if (fseeko(f, (off_t)start, SEEK_SET) != 0)
+                return 0.0;
+
+        size_t len = fread(buf, 1, sizeof(buf), f);
+        if (len < 4)
+                return 0.0;
+
+        for (size_t i = 0; i + 4 <= len; i++) {
+                Mp3Header h;
+
+                if (!parse_mp3_header(buf + i, &h))
+                        continue;
+
+                // Require a second frame right behind the first to rule out false syncs
+                Mp3Header next;
+                if (i + h.frame_length + 4 <= len && !parse_mp3_header(buf + i + h.frame_length, &next))
+                        continue;
+
+                int64_t frame_offset = start + (int64_t)i;
+
+                // Xing/Info tag sits right after the side information
+                int side_info = (h.version == 3) ? (h.mono ? 17 : 32) : (h.mono ? 9 : 17);
+                unsigned char tag[16];
+
+                if (read_at(f, frame_offset + 4 + side_info, tag, sizeof(tag)) &&
+                    (memcmp(tag, "Xing", 4) == 0 || memcmp(tag, "Info", 4) == 0)) {
+                        uint32_t flags = be32(tag + 4);
+                        if ((flags & 1) && h.sample_rate > 0) {
+                                uint32_t frames = be32(tag + 8);
+                                return (double)frames * h.samples_per_frame / h.sample_rate;
+                        }
+                }
+
+                // VBRI tag is always 32 bytes after the frame header
+                unsigned char vbri[18];
+
+                if (read_at(f, frame_offset + 4 + 32, vbri, sizeof(vbri)) && memcmp(vbri, "VBRI", 4) == 0) {
+                        uint32_t frames = be32(vbri + 14);
+                        if (h.sample_rate > 0)
+                                return (double)frames * h.samples_per_frame / h.sample_rate;
+                }
+
+                // No VBR header, assume constant bitrate
+                int64_t audio_bytes = file_size - frame_offset;
+                unsigned char id3v1[3];
+
+                if (file_size >= 128 && read_at(f, file_size - 128, id3v1, sizeof(id3v1)) &&
+                    memcmp(id3v1, "TAG", 3) == 0)
+                        audio_bytes -= 128;
+
+                if (h.bitrate <= 0 || audio_bytes <= 0)
+                        return 0.0;
+
+                return (double)audio_bytes * 8.0 / (h.bitrate * 1000.0);
+        }
+
+        return 0.0;
+}
+
+static double probe_flac(FILE *f, int64_t start)
+{
+        unsigned char block[4 + 4 + 34];
+
+        if (!read_at(f, start, block, sizeof(block)) || memcmp(block, "fLaC", 4) != 0)
+                return 0.0;
+
+        // STREAMINFO is mandated to be the first metadata block
+        if ((block[4] & 0x7F) != 0)
+                return 0.0;
+
+        const unsigned char *s = block + 8;
+        uint32_t sample_rate = ((uint32_t)s[10] << 12) | ((uint32_t)s[11] << 4) | (s[12] >> 4);
+        uint64_t total_samples = ((uint64_t)(s[13] & 0x0F) << 32) | ((uint64_t)s[14] << 24) |
+                                 ((uint64_t)s[15] << 16) | ((uint64_t)s[16] << 8) | s[17];
+
+        if (sample_rate == 0)
+                return 0.0;
+
+        return (double)total_samples / sample_rate;
+}
+
+static double probe_ogg(FILE *f, int64_t file_size)
+{
+        unsigned char page[27 + 255 + 19];
+
+        if (!read_at(f, 0, page, 27) || memcmp(page, "OggS", 4) != 0)
+                return 0.0;
+
+        uint32_t serial = le32(page + 14);
+        int segments = page[26];
+
+        if (!read_at(f, 0, page, 27 + segments + 19))
+                return 0.0;
+
+        const unsigned char *packet = page + 27 + segments;
+        uint32_t rate = 0;
+        uint64_t pre_skip = 0;
+
+        if (memcmp(packet, "OpusHead", 8) == 0) {
+                rate = 48000; // Opus granule positions always count 48 kHz samples
+                pre_skip = packet[10] | (packet[11] << 8);
+        } else if (packet[0] == 0x01 && memcmp(packet + 1, "vorbis", 6) == 0) {
+                rate = le32(packet + 12);
+        }
+
+        if (rate == 0)
+                return 0.0;
+
+        int64_t tail_size = file_size < PROBE_TAIL_SIZE ? file_size : PROBE_TAIL_SIZE;
+        unsigned char *tail = malloc((size_t)tail_size);
+        if (tail == NULL)
+                return 0.0;
+
+        double duration = 0.0;
+
+        if (read_at(f, file_size - tail_size, tail, (size_t)tail_size)) {
+                for (int64_t i = tail_size - 27; i >= 0; i--) {
+                        if (memcmp(tail + i, "OggS", 4) != 0 || le32(tail + i + 14) != serial)
+                                continue;
+
+                        uint64_t granule = le64(tail + i + 6);
+                        if (granule == UINT64_MAX)
+                                continue;
+
+                        if (granule > pre_skip)
+                                duration = (double)(granule - pre_skip) / rate;
+                        break;
+                }
+        }
+
+        free(tail);
+
+        return duration;
+}
+
+// Finds the first box of the given type between start and end. Returns the payload range.
+static bool mp4_find_box(FILE *f, int64_t start, int64_t end, const char *type,
+                         int64_t *payload_start, int64_t *payload_end)
+{
+        int64_t pos = start;
+
+        for (int n = 0; n < PROBE_MAX_BOXES && pos + 8 <= end; n++) {
+                unsigned char hdr[16];
+
+                if (!read_at(f, pos, hdr, 8))
+                        return false;
+
+                int64_t size = be32(hdr);
+                int64_t header_size = 8;
+
+                if (size == 1) {
+                        if (!read_at(f, pos + 8, hdr + 8, 8))
+                                return false;
+                        size = (int64_t)be64(hdr + 8);
+                        header_size = 16;
+                } else if (size == 0) {
+                        size = end - pos;
+                }
+
+                if (size < header_size || pos + size > end)
+                        return false;
+
+                if (memcmp(hdr + 4, type, 4) == 0) {
+                        *payload_start = pos + header_size;
+                        *payload_end = pos + size;
+                        return true;
+                }
+
+                pos += size;
+        }
+
+        return false;
+}
+
+// mvhd and mdhd share the same layout for timescale and duration
+static double mp4_header_duration(FILE *f, int64_t payload_start)
+{
+        unsigned char b[32];
+
+        if (!read_at(f, payload_start, b, sizeof(b)))
+                return 0.0;
+
+        uint32_t timescale;
+        uint64_t duration;
+
+        if (b[0] == 1) {
+                timescale = be32(b + 20);
+                duration = be64(b + 24);
+        } else {
+                timescale = be32(b + 12);
+                duration = be32(b + 16);
+        }
+
+        if (timescale == 0 || duration == UINT64_MAX || (b[0] != 1 && duration == UINT32_MAX))
+                return 0.0;
+
+        return (double)duration / timescale;
+}
+
+static double probe_mp4(FILE *f, int64_t file_size)
+{
+        int64_t moov_start, moov_end, start, end;
+
+        if (!mp4_find_box(f, 0, file_size, "moov", &moov_start, &moov_end))
+                return 0.0;
+
+        double duration = 0.0;
+
+        if (mp4_find_box(f, moov_start, moov_end, "mvhd", &start, &end))
+                duration = mp4_header_duration(f, start);
+
+        if (duration > 0.0)
+                return duration;
+
+        // Some muxers leave mvhd empty, fall back to the first track's media header
+        int64_t trak_start, trak_end, mdia_start, mdia_end;
+
+        if (mp4_find_box(f, moov_start, moov_end, "trak", &trak_start, &trak_end) &&
+            mp4_find_box(f, trak_start, trak_end, "mdia", &mdia_start, &mdia_end) &&
+            mp4_find_box(f, mdia_start, mdia_end, "mdhd", &start, &end))
+                duration = mp4_header_duration(f, start);
+
+        return duration;
+}
+
+#define EBML_ID_HEADER 0x1A45DFA3
+#define EBML_ID_SEGMENT 0x18538067
+#define EBML_ID_INFO 0x1549A966
+#define EBML_ID_CLUSTER 0x1F43B675
+#define EBML_ID_TIMECODE_SCALE 0x2AD7B1
+#define EBML_ID_DURATION 0x4489
+#define EBML_UNKNOWN_SIZE UINT64_MAX
+
+// Reads an EBML variable length integer. IDs keep their marker bit, sizes do not.
+static bool ebml_read_vint(FILE *f, int64_t *pos, bool keep_marker, uint64_t *value)
+{
+        unsigned char b[8];
+
+        if (!read_at(f, *pos, b, 1))
+                return false;
+
+        int len = 1;
+        while (len <= 8 && !(b[0] & (0x80 >> (len - 1))))
+                len++;
+
+        if (len > 8 || (len > 1 && !read_at(f, *pos + 1, b + 1, len - 1)))
+                return false;
+
+        uint64_t v = keep_marker ? b[0] : (b[0] & ((0x80 >> (len - 1)) - 1));
+        bool all_ones = (v == (uint64_t)((0x80 >> (len - 1)) - 1));
+
+        for (int i = 1; i < len; i++) {
+                v = (v << 8) | b[i];
+                if (b[i] != 0xFF)
+                        all_ones = false;
+        }
+
+        *value = (!keep_marker && all_ones) ? EBML_UNKNOWN_SIZE : v;
+        *pos += len;
+
+        return true;
+}
+
+static double probe_webm(FILE *f, int64_t file_size)
+{
+        int64_t pos = 0;
+        uint64_t id, size;
+
+        if (!ebml_read_vint(f, &pos, true, &id) || id != EBML_ID_HEADER ||
+            !ebml_read_vint(f, &pos, false, &size) || size == EBML_UNKNOWN_SIZE)
+                return 0.0;
+
+        pos += (int64_t)size;
+
+        if (!ebml_read_vint(f, &pos, true, &id) || id != EBML_ID_SEGMENT ||
+            !ebml_read_vint(f, &pos, false, &size))
+                return 0.0;
+
+        int64_t segment_end = (size == EBML_UNKNOWN_SIZE) ? file_size : pos + (int64_t)size;
+
+        for (int n = 0; n < PROBE_MAX_BOXES && pos < segment_end; n++) {
+                if (!ebml_read_vint(f, &pos, true, &id) || !ebml_read_vint(f, &pos, false, &size))
+                        return 0.0;
+
+                if (id == EBML_ID_CLUSTER || size == EBML_UNKNOWN_SIZE)
+                        return 0.0; // Info always precedes the first cluster
+
+                if (id != EBML_ID_INFO) {
+                        pos += (int64_t)size;
+                        continue;
+                }
+
+                int64_t info_end = pos + (int64_t)size;
+                uint64_t timecode_scale = 1000000;
+                double ticks = 0.0;
+
+                while (pos < info_end) {
+                        if (!ebml_read_vint(f, &pos, true, &id) || !ebml_read_vint(f, &pos, false, &size) ||
+                            size == EBML_UNKNOWN_SIZE)
+                                return 0.0;
+
+                        unsigned char b[8];
+
+                        if (id == EBML_ID_TIMECODE_SCALE && size > 0 && size <= 8 && read_at(f, pos, b, (size_t)size)) {
+                                timecode_scale = 0;
+                                for (uint64_t i = 0; i < size; i++)
+                                        timecode_scale = (timecode_scale << 8) | b[i];
+                        } else if (id == EBML_ID_DURATION && (size == 4 || size == 8) && read_at(f, pos, b, (size_t)size)) {
+                                if (size == 4) {
+                                        uint32_t bits = be32(b);
+                                        float fv;
+                                        memcpy(&fv, &bits, sizeof(fv));
+                                        ticks = fv;
+                                } else {
+                                        uint64_t bits = be64(b);
+                                        double dv;
+                                        memcpy(&dv, &bits, sizeof(dv));
+                                        ticks = dv;
+                                }
+                        }
+
+                        pos += (int64_t)size;
+                }
+
+                return ticks * (double)timecode_scale / 1e9;
+        }
+
+        return 0.0;
+}
+
+static double probe_wav(FILE *f, int64_t file_size)
+{
+        int64_t pos = 12;
+        uint32_t byte_rate = 0;
+
+        for (int n = 0; n < PROBE_MAX_BOXES && pos + 8 <= file_size; n++) {
+                unsigned char hdr[8 + 12];
+
+                if (!read_at(f, pos, hdr, 8))
+                        return 0.0;
+
+                uint32_t size = le32(hdr + 4);
+
+                if (memcmp(hdr, "fmt ", 4) == 0 && size >= 12 && read_at(f, pos + 8, hdr + 8, 12))
+                        byte_rate = le32(hdr + 8 + 8);
+                else if (memcmp(hdr, "data", 4) == 0)
+                        return byte_rate > 0 ? (double)size / byte_rate : 0.0;
+
+                pos += 8 + (int64_t)size + (size & 1);
+        }
+
+        return 0.0;
+}
+
+double duration_probe_file(const char *file_path)
+{
+        if (file_path == NULL)
+                return 0.0;
+
+        FILE *f = fopen(file_path, "rb");
+        if (f == NULL)
+                return 0.0;
+
+        double duration = 0.0;
+        unsigned char magic[12];
+        int64_t file_size = 0;
+
+        if (fseeko(f, 0, SEEK_END) == 0)
+                file_size = (int64_t)ftello(f);
+
+        int64_t start = skip_id3v2(f);
+
+        if (file_size > 0 && read_at(f, start, magic, sizeof(magic))) {
+                if (memcmp(magic, "fLaC", 4) == 0)
+                        duration = probe_flac(f, start);
+                else if (start == 0 && memcmp(magic, "OggS", 4) == 0)
+                        duration = probe_ogg(f, file_size);
+                else if (start == 0 && memcmp(magic + 4, "ftyp", 4) == 0)
+                        duration = probe_mp4(f, file_size);
+                else if (start == 0 && be32(magic) == EBML_ID_HEADER)
+                        duration = probe_webm(f, file_size);
+                else if (start == 0 && memcmp(magic, "RIFF", 4) == 0 && memcmp(magic + 8, "WAVE", 4) == 0)
+                        duration = probe_wav(f, file_size);
+                else
+                        duration = probe_mp3(f, start, file_size);
+        }
+
+        fclose(f);
+
+        if (duration < 0.0 || duration != duration)
+                duration = 0.0;
+
+        return duration;
+}
+
+// --- Path + mtime cache ---
+
+typedef enum {
+        PROBE_UNVERIFIED, // Loaded from disk, mtime not checked yet
+        PROBE_PENDING,    // Queued for a probe thread
+        PROBE_DONE
+} ProbeState;
+
+typedef struct ProbeEntry {
+        char *path;
+        time_t mtime;
+        double duration;
+        ProbeState state;
+        struct ProbeEntry *next;
+} ProbeEntry;
+
+typedef struct ProbeJob {
+        ProbeEntry *entry;
+        struct ProbeJob *next;
+} ProbeJob;
+
+static ProbeEntry **buckets = NULL;
+static ProbeJob *jobs_head = NULL;
+static ProbeJob *jobs_tail = NULL;
+static pthread_mutex_t probe_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t probe_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t probe_threads[PROBE_THREADS];
+static int num_probe_threads = 0;
+static bool stop_probing = false;
+static bool cache_dirty = false;
+static atomic_ulong results_generation = 0;
+static unsigned long applied_generation = 0;
+static struct timespec last_apply = {0, 0};
+
+static size_t path_hash(const char *path)
+{
+        // FNV-1a
+        size_t hash = 2166136261u;
+        for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+                hash ^= *p;
+                hash *= 16777619u;
+        }
+        return hash & (PROBE_BUCKETS - 1);
+}
+
+// Caller holds probe_mutex
+static ProbeEntry *find_entry(const char *path)
+{
+        if (buckets == NULL)
+                return NULL;
+
+        for (ProbeEntry *e = buckets[path_hash(path)]; e != NULL; e = e->next) {
+                if (strcmp(e->path, path) == 0)
+                        return e;
+        }
+
+        return NULL;
+}
+
+// Caller holds probe_mutex
+static ProbeEntry *add_entry(const char *path, time_t mtime, double duration, ProbeState state)
+{
+        if (buckets == NULL)
+                return NULL;
+
+        ProbeEntry *e = malloc(sizeof(ProbeEntry));
+        if (e == NULL)
+                return NULL;
+
+        e->path = strdup(path);
+        if (e->path == NULL) {
+                free(e);
+                return NULL;
+        }
+
+        size_t bucket = path_hash(path);
+        e->mtime = mtime;
+        e->duration = duration;
+        e->state = state;
+        e->next = buckets[bucket];
+        buckets[bucket] = e;
+
+        return e;
+}
+
+static void load_cache(void)
+{
+        char *cache_path = get_file_path(DURATION_CACHE_FILE);
+        if (cache_path == NULL)
+                return;
+
+        FILE *f = fopen(cache_path, "r");
+        free(cache_path);
+
+        if (f == NULL)
+                return;
+
+        char line[KEW_PATH_MAX + 64];
+
+        pthread_mutex_lock(&probe_mutex);
+
+        while (fgets(line, sizeof(line), f)) {
+                long long mtime;
+                double duration;
+                int consumed = 0;
+
+                line[strcspn(line, "\r\n")] = '\0';
+
+                if (sscanf(line, "%lld\t%lf\t%n", &mtime, &duration, &consumed) < 2 || consumed == 0)
+                        continue;
+
+                const char *path = line + consumed;
+
+                if (*path == '\0' || duration <= 0.0 || find_entry(path) != NULL)
+                        continue;
+
+                add_entry(path, (time_t)mtime, duration, PROBE_UNVERIFIED);
+        }
+
+        pthread_mutex_unlock(&probe_mutex);
+
+        fclose(f);
+}
+
+// Entries from earlier sessions that nothing looked at this time are only
+// kept if their file is still there, so the cache doesn't grow forever
+static bool keep_in_cache(const ProbeEntry *e)
+{
+        if (e->duration <= 0.0 || e->state == PROBE_PENDING)
+                return false;
+
+        if (e->state == PROBE_UNVERIFIED) {
+                struct stat st;
+                return stat(e->path, &st) == 0;
+        }
+
+        return true;
+}
+
+static void save_cache(void)
+{
+        if (!cache_dirty || buckets == NULL)
+                return;
+
+        char *cache_path = get_file_path(DURATION_CACHE_FILE);
+        if (cache_path == NULL)
+                return;
+
+        size_t capacity = 64 * 1024;
+        size_t size = 0;
+        char *data = malloc(capacity);
+
+        for (size_t i = 0; i < PROBE_BUCKETS && data != NULL; i++) {
+                for (ProbeEntry *e = buckets[i]; e != NULL; e = e->next) {
+                        if (!keep_in_cache(e))
+                                continue;
+
+                        // Two numbers, two tabs and a newline fit in 64 bytes
+                        size_t needed = strlen(e->path) + 64;
+
+                        if (capacity - size < needed) {
+                                capacity = (capacity + needed) * 2;
+                                char *bigger = realloc(data, capacity);
+                                if (bigger == NULL) {
+                                        free(data);
+                                        data = NULL;
+                                        break;
+                                }
+                                data = bigger;
+                        }
+
+                        size += snprintf(data + size, capacity - size, "%lld\t%.3f\t%s\n",
+                                         (long long)e->mtime, e->duration, e->path);
+                }
+        }
+
+        if (data == NULL) {
+                k_log("Failed to write duration cache.\n");
+                free(cache_path);
+                return;
+        }
+
+        // Written to a temporary file and renamed into place, so a crash
+        // while saving leaves the previous cache intact
+        playlist_writer_submit(cache_path, data, size);
+
+        free(cache_path);
+}
+
+static void *probe_thread(void *arg)
+{
+        (void)arg;
+
+        pthread_mutex_lock(&probe_mutex);
+
+        while (!stop_probing) {
+                if (jobs_head == NULL) {
+                        pthread_cond_wait(&probe_cond, &probe_mutex);
+                        continue;
+                }
+
+                ProbeJob *job = jobs_head;
+                jobs_head = job->next;
+                if (jobs_head == NULL)
+                        jobs_tail = NULL;
+
+                ProbeEntry *entry = job->entry;
+                free(job);
+
+                // Entries are never freed while the threads run, so the path stays valid
+                const char *path = entry->path;
+                time_t cached_mtime = entry->mtime;
+                double cached_duration = entry->duration;
+
+                pthread_mutex_unlock(&probe_mutex);
+
+                struct stat st;
+                time_t mtime = (stat(path, &st) == 0) ? st.st_mtime : 0;
+                double duration = cached_duration;
+
+                if (cached_duration <= 0.0 || mtime != cached_mtime)
+                        duration = duration_probe_file(path);
+
+                pthread_mutex_lock(&probe_mutex);
+
+                if (duration != cached_duration || mtime != cached_mtime)
+                        cache_dirty = true;
+
+                entry->mtime = mtime;
+                entry->duration = duration;
+                entry->state = PROBE_DONE;
+
+                atomic_fetch_add_explicit(&results_generation, 1, memory_order_release);
+        }
+
+        pthread_mutex_unlock(&probe_mutex);
+
+        return NULL;
+}
+
+void duration_probe_init(void)
+{
+        if (buckets != NULL)
+                return;
+
+        buckets = calloc(PROBE_BUCKETS, sizeof(ProbeEntry *));
+        if (buckets == NULL) {
+                k_log("duration_probe_init: calloc\n");
+                return;
+        }
+
+        load_cache();
+
+        stop_probing = false;
+
+        for (int i = 0; i < PROBE_THREADS; i++) {
+                if (pthread_create(&probe_threads[i], NULL, probe_thread, NULL) != 0) {
+                        k_log("Failed to create duration probe thread.\n");
+                        break;
+                }
+                num_probe_threads++;
+        }
+}
+
+void duration_probe_shutdown(void)
+{
+        if (buckets == NULL)
+                return;
+
+        pthread_mutex_lock(&probe_mutex);
+        stop_probing = true;
+        pthread_cond_broadcast(&probe_cond);
+        pthread_mutex_unlock(&probe_mutex);
+
+        for (int i = 0; i < num_probe_threads; i++)
+                pthread_join(probe_threads[i], NULL);
+        num_probe_threads = 0;
+
+        save_cache();
+
+        while (jobs_head != NULL) {
+                ProbeJob *next = jobs_head->next;
+                free(jobs_head);
+                jobs_head = next;
+        }
+        jobs_tail = NULL;
+
+        for (size_t i = 0; i < PROBE_BUCKETS; i++) {
+                ProbeEntry *e = buckets[i];
+                while (e != NULL) {
+                        ProbeEntry *next = e->next;
+                        free(e->path);
+                        free(e);
+                        e = next;
+                }
+        }
+
+        free(buckets);
+        buckets = NULL;
+}
+
+void duration_probe_queue_snapshot(const PlaylistSnapshot *snap)
+{
+        if (snap == NULL || buckets == NULL || num_probe_threads == 0)
+                return;
+
+        bool queued = false;
+        bool have_results = false;
+
+        pthread_mutex_lock(&probe_mutex);
+
+        for (int i = snap->appended_from; i < snap->count; i++) {
+                const PlaylistSnapshotEntry *se = &snap->entries[i];
+
+                if (se->duration > 0.0 || se->file_path == NULL)
+                        continue;
+
+                ProbeEntry *entry = find_entry(se->file_path);
+
+                if (entry == NULL)
+                        entry = add_entry(se->file_path, 0, 0.0, PROBE_PENDING);
+                else if (entry->state == PROBE_UNVERIFIED)
+                        entry->state = PROBE_PENDING;
+                else {
+                        have_results = have_results || (entry->state == PROBE_DONE && entry->duration > 0.0);
+                        continue;
+                }
+
+                ProbeJob *job = entry ? malloc(sizeof(ProbeJob)) : NULL;
+                if (job == NULL)
+                        continue;
+
+                job->entry = entry;
+                job->next = NULL;
+
+                if (jobs_tail)
+                        jobs_tail->next = job;
+                else
+                        jobs_head = job;
+                jobs_tail = job;
+
+                queued = true;
+        }
+
+        if (queued)
+                pthread_cond_broadcast(&probe_cond);
+
+        pthread_mutex_unlock(&probe_mutex);
+
+        // Nodes added for paths probed earlier only need copying in
+        if (have_results)
+                atomic_fetch_add_explicit(&results_generation, 1, memory_order_release);
+}
+
+// Copies cached durations into nodes that lack one. Caller holds list->mutex.
+static void apply_to_list(PlayList *list)
+{
+        bool changed = false;
+
+        pthread_mutex_lock(&probe_mutex);
+
+        for (Node *node = list->head; node != NULL; node = node->next) {
+                if (node->song.duration > 0.0 || node->song.file_path == NULL)
+                        continue;
+
+                ProbeEntry *entry = find_entry(node->song.file_path);
+
+                if (entry != NULL && entry->state == PROBE_DONE && entry->duration > 0.0) {
+                        node->song.duration = entry->duration;
+                        changed = true;
+                }
+        }
+
+        pthread_mutex_unlock(&probe_mutex);
+
+        if (changed)
+                playlist_mark_changed(list);
+}
+
+void duration_probe_update(PlayList *lists[], int count)
+{
+        unsigned long generation = atomic_load_explicit(&results_generation, memory_order_acquire);
+
+        if (generation == applied_generation || buckets == NULL)
+                return;
+
+        // While a large queue is being probed, results arrive continuously.
+        // Walking the lists on every tick would be wasteful.
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        long elapsed_ms = (now.tv_sec - last_apply.tv_sec) * 1000 +
+                          (now.tv_nsec - last_apply.tv_nsec) / 1000000;
+
+        if (elapsed_ms < PROBE_APPLY_INTERVAL_MS)
+                return;
+
+        bool all_applied = true;
+
+        for (int i = 0; i < count; i++) {
+                PlayList *list = lists[i];
+
+                if (list == NULL)
+                        continue;
+
+                if (pthread_mutex_trylock(&list->mutex) != 0) {
+                        all_applied = false;
+                        continue;
+                }
+
+                apply_to_list(list);
+
+                pthread_mutex_unlock(&list->mutex);
+        }
+
+        last_apply = now;
+
+        if (all_applied)
+                applied_generation = generation;
+}
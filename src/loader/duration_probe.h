@@ -0,0 +1,65 @@
+/**
+ * @file duration_probe.h
+ * @brief Header-only track duration probing.
+ *
+ * Reads just enough of a file's container headers to know its length
+ * (Xing/Info/VBRI or CBR size for MP3, STREAMINFO for FLAC, the last
+ * granule position for Ogg Vorbis/Opus, mvhd/mdhd for MP4, the segment
+ * Info for WebM and the fmt/data chunks for WAV), without going through
+ * TagLib or decoding any cover art.
+ *
+ * A small pool of background threads probes the queue and keeps the
+ * results in a cache keyed by path and mtime, which is persisted between
+ * runs.
+ */
+
+#ifndef DURATION_PROBE_H
+#define DURATION_PROBE_H
+
+#include "data/playlist_snapshot.h"
+#include "data/playlist_type.h"
+
+/**
+ * @brief Probes the duration of a single file from its headers.
+ *
+ * Synchronous and uncached.
+ *
+ * @param file_path Path to the audio file.
+ * @return The duration in seconds, or 0.0 if it could not be determined.
+ */
+double duration_probe_file(const char *file_path);
+
+/**
+ * @brief Loads the persisted cache and starts the probe threads.
+ */
+void duration_probe_init(void);
+
+/**
+ * @brief Stops the probe threads and saves the cache to disk.
+ */
+void duration_probe_shutdown(void);
+
+/**
+ * @brief Queues the entries of a snapshot that have no duration yet.
+ *
+ * Only looks at the entries the snapshot added to the previous one, and
+ * entries that are already cached or queued are skipped, so this can be
+ * called every time a new snapshot is published.
+ *
+ * @param snap The published playlist snapshot.
+ */
+void duration_probe_queue_snapshot(const PlaylistSnapshot *snap);
+
+/**
+ * @brief Copies finished probe results into the playlists' nodes.
+ *
+ * Does nothing unless new results arrived since the last successful
+ * update. Never blocks on a playlist mutex; contended lists are retried
+ * on the next call. Must be called from the main loop thread.
+ *
+ * @param lists The playlists to fill.
+ * @param count Number of playlists.
+ */
+void duration_probe_update(PlayList *lists[], int count);
+
+#endif
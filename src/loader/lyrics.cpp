@@ -18,6 +18,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <mutex>
+#include <string>
+#include <vector>
 
 #include "lyrics.h"
 
@@ -33,6 +37,21 @@
 #include <taglib/vorbisfile.h>
 #include <taglib/xiphcomment.h>
 
+// Number of folders whose .lrc files are remembered
+#define LRC_INDEX_SIZE 16
+
+// Length of the text shown for lines sharing a timestamp
+#define JOINED_MAX_LENGTH 1023
+
+struct LrcFolderIndex {
+        std::string folder;
+        time_t mtime;
+        std::vector<std::string> names;
+};
+
+static std::vector<LrcFolderIndex> lrcIndex; // Most recently used last
+static std::mutex lrcIndexMutex;
+
 // LRC Compare function
 static bool compareLyricsLine(const LyricsLine &a, const LyricsLine &b)
 {
@@ -65,6 +84,20 @@ char* parseTimestamp(char* lyricSlice, double* timestamp, char openerChar) {
     return NULL;
 }
 
+// Appends up to len bytes of src, as much as fits in dst
+static void appendBounded(char *dst, size_t size, const char *src, size_t len)
+{
+        size_t used = strlen(dst);
+
+        if (used + 1 >= size)
+                return;
+
+        if (len > size - used - 1)
+                len = size - used - 1;
+
+        strncat(dst, src, len);
+}
+
 int parseKaraokeLine(char* ptr, Lyrics* lyrics, double firstStamp) {
         double timestampArr[METADATA_MAX_LENGTH] = {0};
         int numberOfTimestamps = 0;
@@ -73,18 +106,21 @@ int parseKaraokeLine(char* ptr, Lyrics* lyrics, double firstStamp) {
         char *end;
         double timestamp = 0.0f;
 
+        lyrics->lines[lyrics->count].text = NULL;
+
         if (*ptr != '<') {
             ptr = strchr(start, '<');
             if (ptr == NULL) ptr = start;
             else {
-                strncat(karaokeString, start, ptr - start);
+                appendBounded(karaokeString, sizeof(karaokeString), start, ptr - start);
                 timestampArr[numberOfTimestamps++] = firstStamp;
             }
         }
 
-        while (*ptr == '<') {
+        // Lines can be of any length, extra words are dropped
+        while (*ptr == '<' && numberOfTimestamps < METADATA_MAX_LENGTH) {
             ptr = parseTimestamp(ptr, &timestamp, '<');
-            if (ptr == NULL) continue;
+            if (ptr == NULL) break;
             timestampArr[numberOfTimestamps++] = timestamp;
             lyrics->isKaraoke = 1;
             if (*ptr == '>') ptr++;
@@ -94,14 +130,13 @@ int parseKaraokeLine(char* ptr, Lyrics* lyrics, double firstStamp) {
             if (end == NULL)
                 end = ptr + strlen(ptr);
 
-            strncat(karaokeString, ptr, end - ptr);
+            appendBounded(karaokeString, sizeof(karaokeString), ptr, end - ptr);
 
             ptr = end;
         }
 
-        if (karaokeString[0] != '\0') {
-            lyrics->lines[lyrics->count].text = strdup(karaokeString);
-        }
+        // Empty for a line of timestamps only, NULL means out of memory
+        lyrics->lines[lyrics->count].text = strdup(karaokeString);
 
         if (numberOfTimestamps > 0) {
                 for (int i = 0; i < numberOfTimestamps &&
@@ -149,6 +184,7 @@ int parseTimedLyricsLine(char* line, Lyrics* lyrics, size_t* lyricsCapacity) {
                                         free(lyrics->lines[i].text);
                                 free(lyrics->lines);
                                 lyrics->lines = NULL;
+                                lyrics->count = 0;
                                 return 0;
                         }
 
@@ -183,18 +219,51 @@ int parseTimedLyricsLine(char* line, Lyrics* lyrics, size_t* lyricsCapacity) {
         return numberOfTimestamps + 1; // include the first, non-karaoke timestamp
 }
 
+// Splits off the next line of text, NULL at the end
+static char *nextLine(char **cursor)
+{
+        char *line = *cursor;
+
+        if (line == NULL || *line == '\0')
+                return NULL;
+
+        char *newline = strchr(line, '\n');
+
+        if (newline) {
+                *newline = '\0';
+                *cursor = newline + 1;
+        } else {
+                *cursor = line + strlen(line);
+        }
+
+        return line;
+}
+
+static bool hasTimestamps(const char *text)
+{
+        for (const char *line = text; line != NULL; line = strchr(line, '\n')) {
+                if (*line == '\n')
+                        line++;
+
+                if (line[0] == '[' && isdigit((unsigned char)line[1]))
+                        return true;
+        }
+
+        return false;
+}
+
 // LRC Loader
-static int loadTimedLyrics(FILE *file, Lyrics *lyrics)
+static int loadTimedLyrics(char *text, Lyrics *lyrics)
 {
         size_t capacity = 64;
         lyrics->lines = (LyricsLine *)malloc(sizeof(LyricsLine) * capacity);
         if (!lyrics->lines)
                 return 0;
 
-        char lineBuffer[1024];
+        char *line;
 
-        while (fgets(lineBuffer, sizeof(lineBuffer), file)) {
-            parseTimedLyricsLine(lineBuffer, lyrics, &capacity);
+        while ((line = nextLine(&text))) {
+            parseTimedLyricsLine(line, lyrics, &capacity);
         }
         std::stable_sort(lyrics->lines, lyrics->lines + lyrics->count, compareLyricsLine);
 
@@ -202,22 +271,22 @@ static int loadTimedLyrics(FILE *file, Lyrics *lyrics)
         return 1;
 }
 
-static int loadUntimedLyrics(FILE *file, Lyrics *lyrics)
+static int loadUntimedLyrics(char *text, Lyrics *lyrics)
 {
         size_t capacity = 64;
         lyrics->lines = (LyricsLine *)malloc(sizeof(LyricsLine) * capacity);
         if (!lyrics->lines)
                 return 0;
 
-        char lineBuffer[1024];
+        char *line;
         lyrics->count = 0;
 
-        while (fgets(lineBuffer, sizeof(lineBuffer), file)) {
-                char *newline = strpbrk(lineBuffer, "\r\n");
+        while ((line = nextLine(&text))) {
+                char *newline = strpbrk(line, "\r\n");
                 if (newline)
                         *newline = '\0';
 
-                if (lineBuffer[0] == '\0')
+                if (line[0] == '\0')
                         continue;
 
                 if (lyrics->count == capacity) {
@@ -229,7 +298,7 @@ static int loadUntimedLyrics(FILE *file, Lyrics *lyrics)
                 }
 
                 lyrics->lines[lyrics->count].timestamp = 0.0;
-                lyrics->lines[lyrics->count].text = strdup(lineBuffer);
+                lyrics->lines[lyrics->count].text = strdup(line);
                 if (!lyrics->lines[lyrics->count].text)
                         return 0;
 
@@ -240,34 +309,91 @@ static int loadUntimedLyrics(FILE *file, Lyrics *lyrics)
         return 1;
 }
 
-//helper function findLRC that find wether current folder have a .lrc file match the word
-static char *findLRC(const char *folder, const char *word)
+// Reads the whole file, so that it's only read once
+static char *readLyricsFile(FILE *file)
+{
+        std::string text;
+        char buffer[4096];
+        size_t n;
+
+        while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+                text.append(buffer, n);
+
+        if (ferror(file))
+                return NULL;
+
+        return strdup(text.c_str());
+}
+
+// Returns the .lrc files of a folder. Listed once and then remembered until
+// the folder changes. Caller holds lrcIndexMutex.
+static const std::vector<std::string> *getLrcFiles(const char *folder)
 {
-        static char result[KEW_PATH_MAX];
+        struct stat st;
+
+        if (stat(folder, &st) != 0)
+                return NULL;
+
+        for (auto it = lrcIndex.begin(); it != lrcIndex.end(); ++it) {
+                if (it->folder != folder)
+                        continue;
+
+                if (it->mtime != st.st_mtime) {
+                        lrcIndex.erase(it);
+                        break;
+                }
+
+                std::rotate(it, it + 1, lrcIndex.end());
+                return &lrcIndex.back().names;
+        }
+
         DIR *d = opendir(folder);
 
         if (!d)
                 return NULL;
 
+        LrcFolderIndex entry;
+        entry.folder = folder;
+        entry.mtime = st.st_mtime;
+
         struct dirent *e;
 
         while ((e = readdir(d))) {
-                if (!strstr(e->d_name, ".lrc") || !strstr(e->d_name, word))
-                        continue;
+                if (strstr(e->d_name, ".lrc"))
+                        entry.names.push_back(e->d_name);
+        }
 
-                if (strlen(folder) + strlen(e->d_name) + 2 > sizeof(result))
+        closedir(d);
+
+        if (lrcIndex.size() >= LRC_INDEX_SIZE)
+                lrcIndex.erase(lrcIndex.begin());
+
+        lrcIndex.push_back(std::move(entry));
+
+        return &lrcIndex.back().names;
+}
+
+//helper function findLRC that find wether current folder have a .lrc file match the word
+static bool findLRC(const char *folder, const char *word, char *result, size_t size)
+{
+        std::lock_guard<std::mutex> lock(lrcIndexMutex);
+
+        const std::vector<std::string> *names = getLrcFiles(folder);
+
+        if (!names)
+                return false;
+
+        for (const std::string &name : *names) {
+                if (!strstr(name.c_str(), word))
                         continue;
 
-                strcpy(result, folder);
-                strcat(result, "/");
-                strcat(result, e->d_name);
+                if (snprintf(result, size, "%s/%s", folder, name.c_str()) >= (int)size)
+                        continue;
 
-                closedir(d);
-                return result;
+                return true;
         }
 
-        closedir(d);
-        return NULL;
+        return false;
 }
 
 Lyrics *loadLyricsFromLRC(const char *path,SongData *songdata)
@@ -303,9 +429,9 @@ Lyrics *loadLyricsFromLRC(const char *path,SongData *songdata)
                 if (snprintf(curFolder, slash - lrcPath + 1, "%s", lrcPath) >= KEW_PATH_MAX)
                         return nullptr;
 
-                char *fallbackPath = findLRC(curFolder, corrTitle);
+                char fallbackPath[KEW_PATH_MAX];
 
-                if (!fallbackPath) {
+                if (!findLRC(curFolder, corrTitle, fallbackPath, sizeof(fallbackPath))) {
                         return nullptr;
                 }
 
@@ -324,21 +450,18 @@ Lyrics *loadLyricsFromLRC(const char *path,SongData *songdata)
 
         lyrics->max_length = 1024;
 
-        // Detect if there are timestamps
-        char lineBuffer[1024];
-        int foundTimestamp = 0;
-        while (fgets(lineBuffer, sizeof(lineBuffer), file)) {
-                if (lineBuffer[0] == '[' && isdigit((unsigned char)lineBuffer[1])) {
-                        foundTimestamp = 1;
-                        break;
-                }
-        }
+        char *text = readLyricsFile(file);
 
-        rewind(file);
+        fclose(file);
+
+        if (!text) {
+                freeLyrics(lyrics);
+                return nullptr;
+        }
 
-        int ok = foundTimestamp ? loadTimedLyrics(file, lyrics) : loadUntimedLyrics(file, lyrics);
+        int ok = hasTimestamps(text) ? loadTimedLyrics(text, lyrics) : loadUntimedLyrics(text, lyrics);
 
-        fclose(file);
+        free(text);
 
         if (!ok) {
                 freeLyrics(lyrics);
@@ -348,13 +471,76 @@ Lyrics *loadLyricsFromLRC(const char *path,SongData *songdata)
         return lyrics;
 }
 
+void indexLyrics(Lyrics *lyrics)
+{
+        if (!lyrics || lyrics->count == 0 || lyrics->timestamps)
+                return;
+
+        if (lyrics->isTimed)
+                std::stable_sort(lyrics->lines, lyrics->lines + lyrics->count, compareLyricsLine);
+
+        double *timestamps = (double *)malloc(sizeof(double) * lyrics->count);
+        char **joined = (char **)calloc(lyrics->count, sizeof(char *));
+
+        if (!timestamps || !joined) {
+                free(timestamps);
+                free(joined);
+                return;
+        }
+
+        size_t first = 0; // First line with the current timestamp
+
+        for (size_t i = 0; i < lyrics->count; i++) {
+                timestamps[i] = lyrics->lines[i].timestamp;
+
+                if (lyrics->lines[i].timestamp != lyrics->lines[first].timestamp)
+                        first = i;
+
+                bool last = i + 1 == lyrics->count ||
+                            lyrics->lines[i + 1].timestamp != lyrics->lines[i].timestamp;
+
+                if (!last || first == i)
+                        continue;
+
+                std::string text;
+
+                for (size_t j = first; j <= i; j++) {
+                        if (j > first)
+                                text += " | ";
+                        text += lyrics->lines[j].text ? lyrics->lines[j].text : "";
+                }
+
+                if (text.size() > JOINED_MAX_LENGTH)
+                        text.resize(JOINED_MAX_LENGTH);
+
+                joined[i] = strdup(text.c_str());
+        }
+
+        lyrics->timestamps = timestamps;
+        lyrics->joined = joined;
+}
+
+static void freeLyricsIndex(Lyrics *lyrics)
+{
+        if (lyrics->joined) {
+                for (size_t i = 0; i < lyrics->count; i++)
+                        free(lyrics->joined[i]);
+        }
+        free(lyrics->joined);
+        free(lyrics->timestamps);
+        lyrics->joined = NULL;
+        lyrics->timestamps = NULL;
+}
+
 void freeLyricLines(Lyrics *lyrics) {
         if (!lyrics)
                 return;
+        freeLyricsIndex(lyrics);
         for (size_t i = 0; i < lyrics->count; i++)
                 free(lyrics->lines[i].text);
         free(lyrics->lines);
         lyrics->lines = NULL;
+        lyrics->count = 0;
 }
 
 // Free & Access
@@ -362,6 +548,7 @@ void freeLyrics(Lyrics *lyrics)
 {
         if (!lyrics)
                 return;
+        freeLyricsIndex(lyrics);
         for (size_t i = 0; i < lyrics->count; i++)
                 free(lyrics->lines[i].text);
         free(lyrics->lines);
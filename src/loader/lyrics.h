@@ -82,6 +82,16 @@ int parseTimedLyricsLine(char* line, Lyrics* lyrics, size_t* lyricsCapacity);
  */
 Lyrics *loadLyricsFromLRC(const char *path,SongData *songdata);
 
+/**
+ * Prepares loaded lyrics for display.
+ *
+ * Sorts timed lyrics, copies the timestamps to an array that can be binary
+ * searched, and joins lines that share a timestamp ahead of time.
+ *
+ * @param lyrics Pointer to the Lyrics structure to operate on
+ */
+void indexLyrics(Lyrics *lyrics);
+
 /**
  * Releases all allocated LyricLines in a Lyrics struct,
  * as well as their text buffers
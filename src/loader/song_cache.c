@@ -0,0 +1,434 @@
+/**
+ * @file song_cache.c
+ * @brief Recently loaded songs, kept for instant reuse.
+ *
+ * Entries live in a doubly linked list, most recently used first. The
+ * list is short, so lookups are linear.
+ */
+
+#include "song_cache.h"
+
+#include "song_loader.h"
+
+#include "common/path_max.h"
+
+#include "utils/file.h"
+#include "utils/k_log.h"
+#include "utils/utils.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <sys/resource.h>
+#endif
+
+#define PREFETCH_QUEUE_SIZE 4
+
+typedef struct SongCacheEntry {
+        SongData *songdata;
+        time_t mtime;
+        size_t bytes;
+        struct SongCacheEntry *prev;
+        struct SongCacheEntry *next;
+} SongCacheEntry;
+
+static SongCacheEntry *head = NULL; // Most recently used
+static SongCacheEntry *tail = NULL;
+static int entry_count = 0;
+static size_t total_bytes = 0;
+
+static int limit_entries = SONG_CACHE_DEFAULT_ENTRIES;
+static size_t limit_bytes = (size_t)SONG_CACHE_DEFAULT_MB * 1024 * 1024;
+
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static char prefetch_queue[PREFETCH_QUEUE_SIZE][KEW_PATH_MAX];
+static int prefetch_count = 0;
+static pthread_mutex_t prefetch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t prefetch_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t prefetch_thread;
+static bool prefetch_running = false;
+static bool prefetch_stop = false;
+
+static bool get_mtime(const char *file_path, time_t *mtime)
+{
+        struct stat st;
+
+        if (stat(file_path, &st) != 0)
+                return false;
+
+        *mtime = st.st_mtime;
+
+        return true;
+}
+
+static size_t songdata_bytes(const SongData *songdata)
+{
+        // Includes the inline palettes, kmeans_palette and cover_palettes
+        size_t bytes = sizeof(SongData);
+
+        if (songdata->metadata)
+                bytes += sizeof(TagSettings);
+
+        if (songdata->cover)
+                bytes += (size_t)songdata->coverWidth * songdata->coverHeight * 4;
+
+        bytes += songdata->cover_data_size;
+
+        if (songdata->lyrics) {
+                bytes += sizeof(Lyrics) + songdata->lyrics->count * sizeof(LyricsLine);
+
+                for (size_t i = 0; i < songdata->lyrics->count; i++) {
+                        if (songdata->lyrics->lines[i].text)
+                                bytes += strlen(songdata->lyrics->lines[i].text) + 1;
+                }
+
+                // The search index built when the lyrics are loaded
+                if (songdata->lyrics->timestamps)
+                        bytes += songdata->lyrics->count * sizeof(double);
+
+                if (songdata->lyrics->joined) {
+                        bytes += songdata->lyrics->count * sizeof(char *);
+
+                        for (size_t i = 0; i < songdata->lyrics->count; i++) {
+                                if (songdata->lyrics->joined[i])
+                                        bytes += strlen(songdata->lyrics->joined[i]) + 1;
+                        }
+                }
+        }
+
+        return bytes;
+}
+
+// Caller holds cache_mutex
+static void unlink_entry(SongCacheEntry *e)
+{
+        if (e->prev)
+                e->prev->next = e->next;
+        else
+                head = e->next;
+
+        if (e->next)
+                e->next->prev = e->prev;
+        else
+                tail = e->prev;
+
+        e->prev = NULL;
+        e->next = NULL;
+}
+
+// Caller holds cache_mutex
+static void push_front(SongCacheEntry *e)
+{
+        e->prev = NULL;
+        e->next = head;
+
+        if (head)
+                head->prev = e;
+        head = e;
+
+        if (tail == NULL)
+                tail = e;
+}
+
+// Caller holds cache_mutex. Returns the entry's song, for the caller to
+// release outside the lock.
+static SongData *remove_entry(SongCacheEntry *e)
+{
+        SongData *songdata = e->songdata;
+
+        unlink_entry(e);
+
+        entry_count--;
+        total_bytes -= e->bytes;
+
+        free(e);
+
+        return songdata;
+}
+
+// Caller holds cache_mutex
+static SongCacheEntry *find_entry(const char *file_path)
+{
+        for (SongCacheEntry *e = head; e != NULL; e = e->next) {
+                if (strcmp(e->songdata->file_path, file_path) == 0)
+                        return e;
+        }
+
+        return NULL;
+}
+
+// Caller holds cache_mutex. Evicted songs are stored in evicted, which has
+// room for every entry.
+static int evict_over_limits(SongData **evicted)
+{
+        int n = 0;
+
+        while (tail != NULL && (entry_count > limit_entries || total_bytes > limit_bytes))
+                evicted[n++] = remove_entry(tail);
+
+        return n;
+}
+
+static void release_all(SongData **songs, int count)
+{
+        for (int i = 0; i < count; i++)
+                unload_song_data(&songs[i]);
+}
+
+void song_cache_set_limits(int max_entries, size_t max_bytes)
+{
+        pthread_mutex_lock(&cache_mutex);
+
+        limit_entries = max_entries > 0 ? max_entries : 0;
+        limit_bytes = max_bytes;
+
+        SongData **evicted = malloc(sizeof(SongData *) * (entry_count + 1));
+        int n = 0;
+
+        if (evicted != NULL)
+                n = evict_over_limits(evicted);
+
+        pthread_mutex_unlock(&cache_mutex);
+
+        release_all(evicted, n);
+        free(evicted);
+}
+
+SongData *song_cache_get(const char *file_path)
+{
+        if (file_path == NULL)
+                return NULL;
+
+        time_t mtime;
+        if (!get_mtime(file_path, &mtime))
+                return NULL;
+
+        SongData *found = NULL;
+        SongData *stale = NULL;
+
+        pthread_mutex_lock(&cache_mutex);
+
+        SongCacheEntry *e = find_entry(file_path);
+
+        if (e != NULL) {
+                if (e->mtime == mtime) {
+                        unlink_entry(e);
+                        push_front(e);
+                        found = songdata_ref(e->songdata);
+                } else {
+                        stale = remove_entry(e);
+                }
+        }
+
+        pthread_mutex_unlock(&cache_mutex);
+
+        unload_song_data(&stale);
+
+        return found;
+}
+
+void song_cache_put(SongData *songdata)
+{
+        if (songdata == NULL || songdata->hasErrors || songdata->magic != SONG_MAGIC)
+                return;
+
+        time_t mtime;
+        if (!get_mtime(songdata->file_path, &mtime))
+                return;
+
+        SongCacheEntry *e = malloc(sizeof(SongCacheEntry));
+        if (e == NULL)
+                return;
+
+        e->songdata = NULL;
+        e->mtime = mtime;
+        e->bytes = songdata_bytes(songdata);
+        e->prev = NULL;
+        e->next = NULL;
+
+        SongData *replaced = NULL;
+        SongData **evicted = NULL;
+        int n = 0;
+
+        pthread_mutex_lock(&cache_mutex);
+
+        SongCacheEntry *existing = find_entry(songdata->file_path);
+
+        if (limit_entries == 0 || e->bytes > limit_bytes ||
+            (existing != NULL && existing->mtime == mtime)) {
+                pthread_mutex_unlock(&cache_mutex);
+                free(e);
+                return;
+        }
+
+        if (existing != NULL)
+                replaced = remove_entry(existing);
+
+        e->songdata = songdata_ref(songdata);
+        push_front(e);
+        entry_count++;
+        total_bytes += e->bytes;
+
+        evicted = malloc(sizeof(SongData *) * entry_count);
+        if (evicted != NULL)
+                n = evict_over_limits(evicted);
+
+        pthread_mutex_unlock(&cache_mutex);
+
+        unload_song_data(&replaced);
+        release_all(evicted, n);
+        free(evicted);
+}
+
+void song_cache_remove(const char *file_path)
+{
+        if (file_path == NULL)
+                return;
+
+        SongData *removed = NULL;
+
+        pthread_mutex_lock(&cache_mutex);
+
+        SongCacheEntry *e = find_entry(file_path);
+        if (e != NULL)
+                removed = remove_entry(e);
+
+        pthread_mutex_unlock(&cache_mutex);
+
+        unload_song_data(&removed);
+}
+
+static bool is_cached(const char *file_path)
+{
+        pthread_mutex_lock(&cache_mutex);
+        bool cached = find_entry(file_path) != NULL;
+        pthread_mutex_unlock(&cache_mutex);
+
+        return cached;
+}
+
+static void *prefetch_loop(void *arg)
+{
+        (void)arg;
+
+#if defined(__linux__)
+        // Only the calling thread on Linux, stay out of the way of playback
+        setpriority(PRIO_PROCESS, 0, 10);
+#endif
+
+        char file_path[KEW_PATH_MAX];
+
+        pthread_mutex_lock(&prefetch_mutex);
+
+        while (!prefetch_stop) {
+                if (prefetch_count == 0) {
+                        pthread_cond_wait(&prefetch_cond, &prefetch_mutex);
+                        continue;
+                }
+
+                // Newest request first
+                prefetch_count--;
+                c_strcpy(file_path, prefetch_queue[prefetch_count], sizeof(file_path));
+
+                pthread_mutex_unlock(&prefetch_mutex);
+
+                if (!is_cached(file_path) && exists_file(file_path) >= 0) {
+                        SongData *songdata = load_song_data(file_path);
+                        song_cache_put(songdata);
+                        unload_song_data(&songdata);
+                }
+
+                pthread_mutex_lock(&prefetch_mutex);
+        }
+
+        pthread_mutex_unlock(&prefetch_mutex);
+
+        return NULL;
+}
+
+void song_cache_prefetch(const char *file_path)
+{
+        if (file_path == NULL || file_path[0] == '\0')
+                return;
+
+        pthread_mutex_lock(&cache_mutex);
+        bool skip = limit_entries == 0 || find_entry(file_path) != NULL;
+        pthread_mutex_unlock(&cache_mutex);
+
+        if (skip)
+                return;
+
+        pthread_mutex_lock(&prefetch_mutex);
+
+        if (!prefetch_running) {
+                prefetch_stop = false;
+
+                if (pthread_create(&prefetch_thread, NULL, prefetch_loop, NULL) != 0) {
+                        k_log("Failed to create prefetch thread.\n");
+                        pthread_mutex_unlock(&prefetch_mutex);
+                        return;
+                }
+
+                prefetch_running = true;
+        }
+
+        for (int i = 0; i < prefetch_count; i++) {
+                if (strcmp(prefetch_queue[i], file_path) == 0) {
+                        pthread_mutex_unlock(&prefetch_mutex);
+                        return;
+                }
+        }
+
+        // Forget the oldest request
+        if (prefetch_count == PREFETCH_QUEUE_SIZE) {
+                memmove(prefetch_queue[0], prefetch_queue[1], sizeof(prefetch_queue[0]) * (PREFETCH_QUEUE_SIZE - 1));
+                prefetch_count--;
+        }
+
+        c_strcpy(prefetch_queue[prefetch_count], file_path, sizeof(prefetch_queue[0]));
+        prefetch_count++;
+
+        pthread_cond_signal(&prefetch_cond);
+        pthread_mutex_unlock(&prefetch_mutex);
+}
+
+void song_cache_shutdown(void)
+{
+        pthread_mutex_lock(&prefetch_mutex);
+
+        bool running = prefetch_running;
+
+        prefetch_stop = true;
+        prefetch_count = 0;
+        pthread_cond_signal(&prefetch_cond);
+
+        pthread_mutex_unlock(&prefetch_mutex);
+
+        if (running)
+                pthread_join(prefetch_thread, NULL);
+
+        prefetch_running = false;
+
+        pthread_mutex_lock(&cache_mutex);
+
+        SongData **evicted = malloc(sizeof(SongData *) * (entry_count + 1));
+        int n = 0;
+
+        while (head != NULL) {
+                SongData *songdata = remove_entry(head);
+
+                if (evicted != NULL)
+                        evicted[n++] = songdata;
+        }
+
+        pthread_mutex_unlock(&cache_mutex);
+
+        release_all(evicted, n);
+        free(evicted);
+}
@@ -0,0 +1,71 @@
+/**
+ * @file song_cache.h
+ * @brief Recently loaded songs, kept for instant reuse.
+ *
+ * A bounded LRU of fully loaded SongData (tags, cover bitmap, colors,
+ * palette and lyrics), keyed by path and mtime. Entries are shared by
+ * reference, so they must not be modified once cached. Tracks next to the
+ * current one can be loaded into it ahead of time by a low priority
+ * prefetch thread.
+ */
+
+#ifndef SONG_CACHE_H
+#define SONG_CACHE_H
+
+#include "songdatatype.h"
+
+#include <stddef.h>
+
+#define SONG_CACHE_DEFAULT_ENTRIES 8
+#define SONG_CACHE_DEFAULT_MB 64
+
+/**
+ * @brief Sets the size limits, evicting entries if needed.
+ *
+ * @param max_entries Maximum number of songs, 0 disables the cache.
+ * @param max_bytes Maximum memory used by the cached songs.
+ */
+void song_cache_set_limits(int max_entries, size_t max_bytes);
+
+/**
+ * @brief Looks up a song.
+ *
+ * @param file_path Path to the audio file.
+ * @return A new reference to the cached SongData, to be released with
+ *         unload_song_data(), or NULL if it isn't cached or the file
+ *         changed since.
+ */
+SongData *song_cache_get(const char *file_path);
+
+/**
+ * @brief Adds a song, unless the same file is already cached.
+ *
+ * The cache takes its own reference. Songs with errors are ignored.
+ *
+ * @param songdata The loaded song.
+ */
+void song_cache_put(SongData *songdata);
+
+/**
+ * @brief Drops a song from the cache.
+ *
+ * @param file_path Path to the audio file.
+ */
+void song_cache_remove(const char *file_path);
+
+/**
+ * @brief Loads a song into the cache in the background.
+ *
+ * Only the most recent few requests are kept. Does nothing if the song
+ * is already cached.
+ *
+ * @param file_path Path to the audio file.
+ */
+void song_cache_prefetch(const char *file_path);
+
+/**
+ * @brief Stops the prefetch thread and releases all entries.
+ */
+void song_cache_shutdown(void);
+
+#endif
@@ -11,10 +11,14 @@
 
 #include "loader/songdatatype.h"
 #include "lyrics.h"
+#include "song_cache.h"
+#include "thumbnail_cache.h"
 
 #include "data/artists.h"
 #include "data/cache.h"
 
+#include "sound/audio_file_info.h"
+
 #include "utils/file.h"
 #include "utils/img_utils.h"
 #include "utils/k_log.h"
@@ -40,6 +44,9 @@ LoaderData loader_data;
 
 Cache *tmpCache;
 
+// Songs are loaded and released on several threads
+static pthread_mutex_t tmp_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 LoaderData *get_loader_data(void)
 {
         return &loader_data;
@@ -88,6 +95,11 @@ void unload_song_data(SongData **songdata)
 
         SongData *data = *songdata;
 
+        *songdata = NULL;
+
+        if (atomic_fetch_sub(&data->refs, 1) > 1)
+                return;
+
         data->magic = 0;
 
         if (data->cover != NULL) {
@@ -95,12 +107,19 @@ void unload_song_data(SongData **songdata)
                 data->cover = NULL;
         }
 
-        if (exists_in_cache(tmpCache, data->cover_art_path) &&
-            is_in_temp_dir(data->cover_art_path)) {
-                delete_file(data->cover_art_path);
-                data->cover_art_path[0] = '\0';
+        free(data->cover_data);
+        data->cover_data = NULL;
+
+        pthread_mutex_lock(&tmp_cache_mutex);
+
+        if (data->cover_tmp_path != NULL) {
+                delete_file(data->cover_tmp_path);
+                free(data->cover_tmp_path);
+                data->cover_tmp_path = NULL;
         }
 
+        pthread_mutex_unlock(&tmp_cache_mutex);
+
         unload_lyrics(data);
 
         free(data->metadata);
@@ -111,8 +130,15 @@ void unload_song_data(SongData **songdata)
 
         data->track_id = NULL;
 
-        free(*songdata);
-        *songdata = NULL;
+        free(data);
+}
+
+SongData *songdata_ref(SongData *songdata)
+{
+        if (songdata != NULL)
+                atomic_fetch_add(&songdata->refs, 1);
+
+        return songdata;
 }
 
 void song_loader_unload_song_A(void)
@@ -153,14 +179,98 @@ void song_loader_unload_songs(void)
         song_loader_unload_song_B();
 }
 
+// Remembers which image was picked as the cover of a folder, so only the
+// first track of an album scans it. Checked against the folder's mtime.
+#define ALBUM_ART_CACHE_SIZE 32
+
+typedef struct {
+        char *dir_path;
+        char *art_path; // NULL if the folder has no usable image
+        time_t mtime;
+        unsigned long last_use;
+} AlbumArtEntry;
+
+static AlbumArtEntry album_art_cache[ALBUM_ART_CACHE_SIZE];
+static unsigned long album_art_clock = 0;
+static pthread_mutex_t album_art_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Returns true if the folder is cached, art_path is then a copy of the
+// cached path, or NULL.
+static bool album_art_cache_get(const char *dir_path, time_t mtime, char **art_path)
+{
+        bool found = false;
+
+        pthread_mutex_lock(&album_art_mutex);
+
+        for (int i = 0; i < ALBUM_ART_CACHE_SIZE; i++) {
+                AlbumArtEntry *e = &album_art_cache[i];
+
+                if (e->dir_path != NULL && e->mtime == mtime && strcmp(e->dir_path, dir_path) == 0) {
+                        e->last_use = ++album_art_clock;
+                        *art_path = e->art_path ? strdup(e->art_path) : NULL;
+                        found = true;
+                        break;
+                }
+        }
+
+        pthread_mutex_unlock(&album_art_mutex);
+
+        return found;
+}
+
+static void album_art_cache_put(const char *dir_path, time_t mtime, const char *art_path)
+{
+        pthread_mutex_lock(&album_art_mutex);
+
+        AlbumArtEntry *slot = &album_art_cache[0];
+
+        for (int i = 0; i < ALBUM_ART_CACHE_SIZE; i++) {
+                AlbumArtEntry *e = &album_art_cache[i];
+
+                // Replace a stale entry for the same folder
+                if (e->dir_path == NULL || strcmp(e->dir_path, dir_path) == 0) {
+                        slot = e;
+                        break;
+                }
+
+                if (e->last_use < slot->last_use)
+                        slot = e;
+        }
+
+        free(slot->dir_path);
+        free(slot->art_path);
+
+        slot->dir_path = strdup(dir_path);
+        slot->art_path = art_path ? strdup(art_path) : NULL;
+        slot->mtime = mtime;
+        slot->last_use = ++album_art_clock;
+
+        pthread_mutex_unlock(&album_art_mutex);
+}
+
+static void album_art_cache_clear(void)
+{
+        pthread_mutex_lock(&album_art_mutex);
+
+        for (int i = 0; i < ALBUM_ART_CACHE_SIZE; i++) {
+                free(album_art_cache[i].dir_path);
+                free(album_art_cache[i].art_path);
+                album_art_cache[i] = (AlbumArtEntry){0};
+        }
+
+        pthread_mutex_unlock(&album_art_mutex);
+}
+
 void song_loader_destroy()
 {
         song_loader_unload_songs();
+        song_cache_shutdown();
+        album_art_cache_clear();
         delete_cache(tmpCache);
         pthread_mutex_destroy(&(loader_data.mutex));
 }
 
-static guint track_counter = 0;
+static atomic_uint track_counter = 0;
 
 void make_file_path(const char *dir_path, char *file_path, size_t file_path_size,
                     const struct dirent *entry)
@@ -503,8 +613,7 @@ char *find_largest_image_file(const char *directory_path, char *largest_image_fi
 gchar *generate_track_id(void)
 {
         gchar *track_id =
-            g_strdup_printf("/org/kew/tracklist/track%d", track_counter);
-        track_counter++;
+            g_strdup_printf("/org/kew/tracklist/track%u", atomic_fetch_add(&track_counter, 1));
         return track_id;
 }
 
@@ -515,6 +624,25 @@ int load_color(SongData *songdata)
                                &(songdata->green), &(songdata->blue));
 }
 
+// Shared songs are never written, so these are set before the song is cached
+static void load_duration(SongData *songdata)
+{
+        // TagLib doesn't read WebM
+        if (songdata->duration <= 0.0 && path_ends_with(songdata->file_path, ".webm"))
+                songdata->duration = get_webm_duration(songdata->file_path);
+
+        struct stat st;
+
+        if (songdata->duration <= 0.0 || stat(songdata->file_path, &st) != 0)
+                return;
+
+        // In kbps
+        songdata->avg_bit_rate = (int)((double)st.st_size * 8.0 / songdata->duration / 1000.0);
+
+        if (path_ends_with(songdata->file_path, ".mp3") && songdata->avg_bit_rate > 320)
+                songdata->avg_bit_rate = 320;
+}
+
 void load_meta_data(SongData *songdata)
 {
         Model *model = get_model();
@@ -529,15 +657,16 @@ void load_meta_data(SongData *songdata)
         songdata->metadata->replaygainAlbum = 0.0;
         songdata->metadata->artist[0] = '\0';
 
-        generate_temp_file_path(songdata->cover_art_path, KEW_PATH_MAX, "cover", ".jpg");
-
         int res = extractTags(songdata->file_path, songdata->metadata,
-                              &(songdata->duration), songdata->cover_art_path, &(songdata->lyrics), model->state.settings.useAristsLink);
+                              &(songdata->duration), &(songdata->cover_data), &(songdata->cover_data_size),
+                              &(songdata->lyrics), model->state.settings.useAristsLink);
 
         if (!songdata->lyrics) {
                 songdata->lyrics = loadLyricsFromLRC(songdata->file_path,songdata);
         }
 
+        indexLyrics(songdata->lyrics);
+
         if (res == -2) {
                 songdata->hasErrors = true;
                 return;
@@ -565,10 +694,19 @@ void load_meta_data(SongData *songdata)
                 expand_path(model->library->full_path, library_expanded, KEW_PATH_MAX);
                 bool search_sub_dirs = !paths_equal(path, library_expanded);
 
-                tmp = choose_album_art(path, file_arr, 12, 0, search_sub_dirs);
+                struct stat dir_stat;
+                bool have_mtime = stat(path, &dir_stat) == 0;
 
-                if (tmp == NULL) {
-                        tmp = find_largest_image_file(path, tmp, &size);
+                if (!have_mtime || !album_art_cache_get(path, dir_stat.st_mtime, &tmp)) {
+
+                        tmp = choose_album_art(path, file_arr, 12, 0, search_sub_dirs);
+
+                        if (tmp == NULL) {
+                                tmp = find_largest_image_file(path, tmp, &size);
+                        }
+
+                        if (have_mtime)
+                                album_art_cache_put(path, dir_stat.st_mtime, tmp);
                 }
 
                 if (tmp != NULL) {
@@ -579,12 +717,16 @@ void load_meta_data(SongData *songdata)
                 } else
                         c_strcpy(songdata->cover_art_path, "",
                                  sizeof(songdata->cover_art_path));
-        } else {
-                add_to_cache(tmpCache, songdata->cover_art_path);
         }
 
-        songdata->cover = get_bitmap(songdata->cover_art_path, &(songdata->coverWidth),
-                                &(songdata->coverHeight));
+        // Embedded covers are decoded straight from the tag, a file is
+        // only written if something outside kew needs one
+        if (songdata->cover_data != NULL)
+                songdata->cover = thumbnail_cache_get(songdata->cover_data, songdata->cover_data_size,
+                                                      &(songdata->coverWidth), &(songdata->coverHeight));
+        else
+                songdata->cover = thumbnail_cache_get_file(songdata->cover_art_path, &(songdata->coverWidth),
+                                                           &(songdata->coverHeight));
 
         // Fetch homepage from aritst db
         if (model->state.settings.useAristsLink) {
@@ -609,94 +751,70 @@ void load_meta_data(SongData *songdata)
         }
 }
 
-SongData *songdata_clone(const SongData *src)
+const char *songdata_cover_path(SongData *songdata)
 {
-        if (!src)
+        if (songdata == NULL)
                 return NULL;
 
-        LoaderData *loader_data = get_loader_data();
+        if (songdata->cover_data == NULL)
+                return songdata->cover_art_path;
 
-        pthread_mutex_lock(&(loader_data->mutex));
+        pthread_mutex_lock(&tmp_cache_mutex);
 
-        SongData *dst = calloc(1, sizeof(*dst));
-        if (!dst)
-                return NULL;
+        if (songdata->cover_tmp_path == NULL) {
+                char path[KEW_PATH_MAX];
+                generate_temp_file_path(path, sizeof(path), "cover", ".jpg");
 
-        // Copy all value fields
-        *dst = *src;
+                FILE *file = fopen(path, "wb");
 
-        // Clear owned pointers
-        dst->track_id = NULL;
-        dst->metadata = NULL;
-        dst->cover = NULL;
-        dst->lyrics = NULL;
+                if (file != NULL) {
+                        bool ok = fwrite(songdata->cover_data, 1, songdata->cover_data_size, file) ==
+                                  songdata->cover_data_size;
 
-        // Track_id
-        if (src->track_id) {
-                dst->track_id = g_strdup(src->track_id);
-                if (!dst->track_id)
-                        goto error;
-        }
+                        if (fclose(file) != 0)
+                                ok = false;
 
-        // Metadata
-        load_meta_data(dst);
-
-        // load Metadata except lyrics
-        unload_lyrics(dst);
-
-        // Deep-copy lyrics
-        if (src->lyrics) {
-                dst->lyrics = calloc(1, sizeof(*dst->lyrics));
-                if (!dst->lyrics)
-                        goto error;
-
-                dst->lyrics->count = src->lyrics->count;
-                dst->lyrics->max_length = src->lyrics->max_length;
-                dst->lyrics->isTimed = src->lyrics->isTimed;
-                dst->lyrics->isKaraoke = src->lyrics->isKaraoke;
-
-                if (src->lyrics->count > 0) {
-                        dst->lyrics->lines =
-                            calloc(src->lyrics->count,
-                                   sizeof(*dst->lyrics->lines));
-
-                        if (!dst->lyrics->lines)
-                                goto error;
-
-                        for (size_t i = 0; i < src->lyrics->count; i++) {
-                                dst->lyrics->lines[i].timestamp =
-                                    src->lyrics->lines[i].timestamp;
-                                dst->lyrics->lines[i].numberOfTimestamps =
-                                    src->lyrics->lines[i].numberOfTimestamps;
-                                
-                                if (dst->lyrics->isKaraoke) {
-                                    memcpy(dst->lyrics->lines[i].timestampArray,
-                                           src->lyrics->lines[i].timestampArray,
-                                           METADATA_MAX_LENGTH * sizeof(double));
-                                }
-                                
-                                if (src->lyrics->lines[i].text) {
-                                        dst->lyrics->lines[i].text =
-                                            g_strdup(src->lyrics->lines[i].text);
+                        if (ok)
+                                songdata->cover_tmp_path = strdup(path);
 
-                                        if (!dst->lyrics->lines[i].text)
-                                                goto error;
-                                }
-                        }
+                        if (songdata->cover_tmp_path != NULL)
+                                add_to_cache(tmpCache, songdata->cover_tmp_path);
+                        else
+                                delete_file(path);
                 }
         }
 
-        pthread_mutex_unlock(&(loader_data->mutex));
+        // Written once and never changed after, so it can be used unlocked
+        const char *cover_path = songdata->cover_tmp_path ? songdata->cover_tmp_path : "";
+
+        pthread_mutex_unlock(&tmp_cache_mutex);
+
+        return cover_path;
+}
+
+SongData *songdata_share(SongData *src)
+{
+        if (!src)
+                return NULL;
+
+        LoaderData *loader_data = get_loader_data();
+
+        // The slots are only released under the mutex
+        pthread_mutex_lock(&(loader_data->mutex));
 
-        return dst;
+        SongData *shared = (src->magic == SONG_MAGIC) ? songdata_ref(src) : NULL;
 
-error:
         pthread_mutex_unlock(&(loader_data->mutex));
-        unload_song_data(&dst);
-        return NULL;
+
+        return shared;
 }
 
 SongData *load_song_data(char *file_path)
+{
+        return load_song_data_cancellable(file_path, NULL);
+}
+
+SongData *load_song_data_cancellable(char *file_path, const atomic_bool *cancelled)
 {
 #ifdef DEBUG
         k_log("loading %s", file_path);
@@ -704,6 +822,7 @@ SongData *load_song_data(char *file_path)
         SongData *songdata = NULL;
         songdata = malloc(sizeof(SongData));
         songdata->magic = SONG_MAGIC;
+        atomic_init(&songdata->refs, 1);
         songdata->track_id = generate_track_id();
         songdata->hasErrors = false;
         c_strcpy(songdata->file_path, "", sizeof(songdata->file_path));
@@ -713,13 +832,24 @@ SongData *load_song_data(char *file_path)
         songdata->blue = -1;
         songdata->metadata = NULL;
         songdata->cover = NULL;
+        songdata->cover_data = NULL;
+        songdata->cover_data_size = 0;
+        songdata->cover_tmp_path = NULL;
         songdata->duration = 0.0;
         songdata->avg_bit_rate = 0;
         songdata->lyrics = NULL;
         c_strcpy(songdata->file_path, file_path, sizeof(songdata->file_path));
         load_meta_data(songdata);
+        load_duration(songdata);
+
+        if (cancelled != NULL && atomic_load(cancelled)) {
+                unload_song_data(&songdata);
+                return NULL;
+        }
+
         load_color(songdata);
         load_kmeans_palette(songdata->cover, songdata->coverWidth, songdata->coverHeight, songdata->kmeans_palette);
+        load_cover_palettes(songdata->cover, songdata->coverWidth, songdata->coverHeight, &songdata->cover_palettes);
 
         return songdata;
 }
@@ -10,6 +10,7 @@
 #include "common/path_max.h"
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 
 /**
@@ -72,9 +73,22 @@ LoaderData *get_loader_data(void);
 SongData *load_song_data(char *file_path);
 
 /**
- * @brief Frees all resources associated with a SongData object.
+ * @brief Like load_song_data(), but gives up early once cancelled is set.
  *
- * Releases:
+ * The flag is checked after the tags and cover have been read, before the
+ * colors are computed from the cover.
+ *
+ * @param file_path Path to the audio file.
+ * @param cancelled Cancellation flag, may be NULL.
+ *
+ * @return The SongData, or NULL if the load was cancelled.
+ */
+SongData *load_song_data_cancellable(char *file_path, const atomic_bool *cancelled);
+
+/**
+ * @brief Releases a reference to a SongData object.
+ *
+ * When the last reference is released, this frees:
  * - Cover bitmap memory
  * - Temporary cached cover art file (if applicable)
  * - Lyrics data
@@ -82,7 +96,7 @@ SongData *load_song_data(char *file_path);
  * - Track ID string
  * - The SongData structure itself
  *
- * Sets the provided pointer to NULL after cleanup.
+ * Always sets the provided pointer to NULL.
  *
  * @param songdata Address of the SongData pointer to unload.
  *
@@ -91,6 +105,17 @@ SongData *load_song_data(char *file_path);
  */
 void unload_song_data(SongData **songdata);
 
+/**
+ * @brief Takes another reference to a SongData object.
+ *
+ * Each reference is released with unload_song_data(). A shared SongData
+ * must not be modified.
+ *
+ * @param songdata The song, may be NULL.
+ * @return songdata.
+ */
+SongData *songdata_ref(SongData *songdata);
+
 /**
  * @brief Initializes the song loader module.
  *
@@ -110,14 +135,26 @@ int song_loader_init(void);
 
 
 /**
- * @brief Deep copies a songdata.
+ * @brief Returns the path of a file with the song's cover.
+ *
+ * Embedded covers are kept in memory. The first call writes one to a temp
+ * file, for consumers that need a path, like notifications and MPRIS.
+ *
+ * @param songdata The song.
+ * @return The path, empty if the song has no cover.
+ */
+const char *songdata_cover_path(SongData *songdata);
+
+/**
+ * @brief Takes a reference to a songdata held by the loader slots.
  *
- * @param src The songdata to be copied.
- * @return The copy of src.
+ * Songs are immutable once loaded, so sharing replaces copying.
  *
- * @note This assumes that the cover is loaded using 4 byes (RGBA).
+ * @param src The songdata to share.
+ * @return src with one more reference, to be released with
+ *         unload_song_data(), or NULL if it has already been unloaded.
  */
-SongData *songdata_clone(const SongData *src);
+SongData *songdata_share(SongData *src);
 
 /**
  * @brief Destroys the song loader module and releases allocated resources.
@@ -10,11 +10,16 @@
 
 #include "common/path_max.h"
 
+#include "utils/cover_palette.h"
 #include "utils/img_utils.h"
 #include <gio/gio.h>
 #include <stdbool.h>
 #include <stdint.h>
 
+#ifndef __cplusplus
+#include <stdatomic.h>
+#endif
+
 #define METADATA_MAX_LENGTH 256
 
 #define SONG_MAGIC 0x534F4E47 // "SONG"
@@ -30,6 +35,8 @@ typedef struct
         char album[METADATA_MAX_LENGTH];
         char date[METADATA_MAX_LENGTH];
         char url[2048];
+        uint32_t track;
+        uint32_t disc;
         double replaygainTrack;
         double replaygainAlbum;
 } TagSettings;
@@ -47,6 +54,8 @@ typedef struct {
         int max_length;
         int isTimed;
         int isKaraoke;
+        double *timestamps; // Copy of the line timestamps, for searching
+        char **joined;      // Lines sharing a timestamp, joined on the last one
 } Lyrics;
 
 /**
@@ -64,10 +73,16 @@ typedef struct
         int blue;
 
         PixelData kmeans_palette[3];
+        CoverPalettes cover_palettes;
 
         TagSettings *metadata;
 
         unsigned char *cover;
+        unsigned char *cover_data; // Embedded cover, still encoded
+        size_t cover_data_size;
+        // A temp file with the embedded cover, the one field written after
+        // the song is shared. Only access it through songdata_cover_path().
+        char *cover_tmp_path;
         int avg_bit_rate;
         int coverWidth;
         int coverHeight;
@@ -76,6 +91,13 @@ typedef struct
         bool hasErrors;
 
         Lyrics *lyrics;
+
+        // Shared between the loader slots and the song cache, see songdata_ref()
+#ifdef __cplusplus
+        int refs;
+#else
+        atomic_int refs;
+#endif
 } SongData;
 
 #endif
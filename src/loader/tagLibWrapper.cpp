@@ -15,10 +15,10 @@
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <fstream>
 #include <iostream>
 #include <map>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "lyrics.h"
@@ -43,11 +43,6 @@
 #include <taglib/wavfile.h>
 #include <taglib/xiphcomment.h>
 
-#if defined(__linux__)
-#include <opus/opusfile.h>
-#else
-#include <opusfile.h>
-#endif
 #include "tagLibWrapper.h"
 
 // Base64 character map for decoding
@@ -330,7 +325,7 @@ void parseFlacPictureBlock(const std::vector<unsigned char> &data,
 #if HAVE_COMPLEXPROPERTIES
 
 bool extractCoverArtFromOgg(TagLib::FileRef *f,
-                            const std::string &outputFileName)
+                            std::vector<unsigned char> &cover)
 {
         if (!f->file() || !f->file()->isOpen()) {
                 std::cerr
@@ -353,16 +348,8 @@ bool extractCoverArtFromOgg(TagLib::FileRef *f,
                 if (it_data == pic.end())
                         continue; // Skip if no data
 
-                // Write the image data to a file
-                std::ofstream outFile(outputFileName, std::ios::binary);
-                if (!outFile) {
-                        std::cerr << "Error: Could not write to output "
-                                     "file.\n";
-                        return false;
-                }
                 TagLib::ByteVector bv = it_data->second.toByteVector();
-                outFile.write(bv.data(), bv.size());
-                outFile.close();
+                cover.assign(bv.data(), bv.data() + bv.size());
 
                 return true;
         }
@@ -375,39 +362,14 @@ bool extractCoverArtFromOgg(TagLib::FileRef *f,
 #else
 
 bool extractCoverArtFromOgg(TagLib::FileRef *f,
-                            const std::string &outputFileName)
+                            std::vector<unsigned char> &cover)
 {
-        TagLib::Tag *tag = nullptr;
-
-        TagLib::File *file =
-            dynamic_cast<TagLib::Vorbis::File *>(f->file());
-
-        // Try to open as Ogg Vorbis
-
-        if (!file->isValid()) {
-                delete file;
-                // Try to open as Opus
-                file =
-                    dynamic_cast<TagLib::Ogg::Opus::File *>(f->file());
-                ;
-
-                if (!file->isValid()) {
-                        delete file;
-                        std::cerr << "Error: File not found or not a "
-                                     "valid Ogg Vorbis or Opus file."
-                                  << std::endl;
-                        return false; // File not found or invalid
-                }
-        }
-
-        tag = file->tag();
-
+        // Vorbis and Opus files both keep their tags in a XiphComment
         const TagLib::Ogg::XiphComment *xiphComment =
-            dynamic_cast<TagLib::Ogg::XiphComment *>(tag);
+            dynamic_cast<TagLib::Ogg::XiphComment *>(f->tag());
         if (!xiphComment) {
                 std::cerr << "Error: No XiphComment found in the file."
                           << std::endl;
-                delete file;
                 return false; // No cover art found
         }
 
@@ -425,21 +387,8 @@ bool extractCoverArtFromOgg(TagLib::FileRef *f,
                 std::vector<unsigned char> imageData;
                 parseFlacPictureBlock(decodedData, mimeType, imageData);
 
-                std::ofstream outFile(outputFileName, std::ios::binary);
-                if (!outFile) {
-                        std::cerr
-                            << "Error: Could not write to output file."
-                            << std::endl;
-                        delete file;
-                        return false; // Could not write to output file
-                }
-                outFile.write(
-                    reinterpret_cast<const char *>(imageData.data()),
-                    imageData.size());
-
-                outFile.close();
-                delete file;
-                return true; // Success
+                cover = std::move(imageData);
+                return !cover.empty();
         }
 
         // Check COVERART and COVERARTMIME
@@ -450,27 +399,11 @@ bool extractCoverArtFromOgg(TagLib::FileRef *f,
         if (!coverArtList.isEmpty() && !coverArtMimeList.isEmpty()) {
                 std::string base64Data =
                     coverArtList.front().to8Bit(true);
-                std::vector<unsigned char> imageData =
-                    decodeBase64(base64Data);
-
-                std::ofstream outFile(outputFileName, std::ios::binary);
-                if (!outFile) {
-                        std::cerr
-                            << "Error: Could not write to output file."
-                            << std::endl;
-                        delete file;
-                        return false; // Could not write to output file
-                }
-                outFile.write(
-                    reinterpret_cast<const char *>(imageData.data()),
-                    imageData.size());
-                outFile.close();
-                delete file;
+                cover = decodeBase64(base64Data);
                 return true; // Success
         }
 
         std::cerr << "No cover art found in the file." << std::endl;
-        delete file;
         return false; // No cover art found
 }
 
@@ -518,7 +451,7 @@ bool isAudioOggStreamHeader(const ogg_packet &headerPacket)
 }
 
 bool extractCoverArtFromOggVideo(const std::string &audioFilePath,
-                                 const std::string &outputFileName)
+                                 std::vector<unsigned char> &cover)
 {
         FILE *oggFile = fopen(audioFilePath.c_str(), "rb");
         if (!oggFile) {
@@ -593,23 +526,12 @@ bool extractCoverArtFromOggVideo(const std::string &audioFilePath,
         ogg_sync_clear(&oy);
         fclose(oggFile);
 
-        // Write out a valid image stream
+        // Use the first valid image stream
         for (auto &kv : streamPackets) {
-                const auto &data = kv.second;
+                auto &data = kv.second;
                 if (looksLikeJpeg(data) || looksLikePng(data) ||
                     looksLikeWebp(data)) {
-                        std::ofstream outFile(outputFileName,
-                                              std::ios::binary);
-                        if (!outFile) {
-                                std::cerr << "Error: Could not write "
-                                             "to output file."
-                                          << std::endl;
-                                return false;
-                        }
-                        outFile.write(
-                            reinterpret_cast<const char *>(data.data()),
-                            data.size());
-                        outFile.close();
+                        cover = std::move(data);
                         return true;
                 }
         }
@@ -619,7 +541,7 @@ bool extractCoverArtFromOggVideo(const std::string &audioFilePath,
 }
 
 bool extractCoverArtFromMp3(TagLib::FileRef *f,
-                            const std::string &coverFilePath)
+                            std::vector<unsigned char> &cover)
 {
         TagLib::MPEG::File *file =
             dynamic_cast<TagLib::MPEG::File *>(f->file());
@@ -646,42 +568,17 @@ bool extractCoverArtFromMp3(TagLib::FileRef *f,
                                                 AttachedPictureFrame *>(
                                             *it);
                                 if (picFrame) {
-                                        // Access picture data and MIME
-                                        // type
+                                        // Only the first image is
+                                        // needed
                                         TagLib::ByteVector pictureData =
                                             picFrame->picture();
-                                        TagLib::String mimeType =
-                                            picFrame->mimeType();
-
-                                        // Construct the output file
-                                        // path
-                                        std::string outputFilePath =
-                                            coverFilePath;
-
-                                        // Write the image data to a
-                                        // file
-                                        FILE *outFile = fopen(
-                                            outputFilePath.c_str(),
-                                            "wb");
-                                        if (outFile) {
-                                                fwrite(
-                                                    pictureData.data(),
-                                                    1,
-                                                    pictureData.size(),
-                                                    outFile);
-                                                fclose(outFile);
-
-                                                return true;
-                                        } else {
-                                                return false; // Failed
-                                                              // to open
-                                                              // output
-                                                              // file
-                                        }
 
-                                        // Break if only the first image
-                                        // is needed
-                                        break;
+                                        cover.assign(
+                                            pictureData.data(),
+                                            pictureData.data() +
+                                                pictureData.size());
+
+                                        return true;
                                 }
                         }
                 } else {
@@ -695,7 +592,7 @@ bool extractCoverArtFromMp3(TagLib::FileRef *f,
 }
 
 bool extractCoverArtFromFlac(TagLib::FileRef *f,
-                             const std::string &coverFilePath)
+                             std::vector<unsigned char> &cover)
 {
         TagLib::FLAC::File *file =
             dynamic_cast<TagLib::FLAC::File *>(f->file());
@@ -704,17 +601,10 @@ bool extractCoverArtFromFlac(TagLib::FileRef *f,
                 const TagLib::FLAC::Picture *picture =
                     file->pictureList().front();
                 if (picture) {
-                        FILE *coverFile =
-                            fopen(coverFilePath.c_str(), "wb");
-                        if (coverFile) {
-                                fwrite(picture->data().data(), 1,
-                                       picture->data().size(),
-                                       coverFile);
-                                fclose(coverFile);
-                                return true;
-                        } else {
-                                return false;
-                        }
+                        TagLib::ByteVector pictureData = picture->data();
+                        cover.assign(pictureData.data(),
+                                     pictureData.data() + pictureData.size());
+                        return true;
                 }
         }
 
@@ -722,7 +612,7 @@ bool extractCoverArtFromFlac(TagLib::FileRef *f,
 }
 
 bool extractCoverArtFromWav(TagLib::FileRef *f,
-                            const std::string &coverFilePath)
+                            std::vector<unsigned char> &cover)
 {
 
         TagLib::RIFF::WAV::File *file =
@@ -749,42 +639,17 @@ bool extractCoverArtFromWav(TagLib::FileRef *f,
                                                 AttachedPictureFrame *>(
                                             *it);
                                 if (picFrame) {
-                                        // Access picture data and MIME
-                                        // type
+                                        // Only the first image is
+                                        // needed
                                         TagLib::ByteVector pictureData =
                                             picFrame->picture();
-                                        TagLib::String mimeType =
-                                            picFrame->mimeType();
-
-                                        // Construct the output file
-                                        // path
-                                        std::string outputFilePath =
-                                            coverFilePath;
-
-                                        // Write the image data to a
-                                        // file
-                                        FILE *outFile = fopen(
-                                            outputFilePath.c_str(),
-                                            "wb");
-                                        if (outFile) {
-                                                fwrite(
-                                                    pictureData.data(),
-                                                    1,
-                                                    pictureData.size(),
-                                                    outFile);
-                                                fclose(outFile);
-
-                                                return true;
-                                        } else {
-                                                return false; // Failed
-                                                              // to open
-                                                              // output
-                                                              // file
-                                        }
 
-                                        // Break if only the first image
-                                        // is needed
-                                        break;
+                                        cover.assign(
+                                            pictureData.data(),
+                                            pictureData.data() +
+                                                pictureData.size());
+
+                                        return true;
                                 }
                         }
                 } else {
@@ -797,161 +662,8 @@ bool extractCoverArtFromWav(TagLib::FileRef *f,
         return true; // Success
 }
 
-bool extractCoverArtFromOpus(const std::string &audioFilePath,
-                             const std::string &outputFileName)
-{
-        int error;
-        OggOpusFile *of = op_open_file(audioFilePath.c_str(), &error);
-        if (error != OPUS_OK || of == nullptr) {
-                std::cerr << "Error: Failed to open Opus file."
-                          << std::endl;
-                return false;
-        }
-
-        const OpusTags *tags = op_tags(of, -1);
-        if (!tags) {
-                std::cerr << "Error: No tags found in Opus file."
-                          << std::endl;
-                op_free(of);
-                return false;
-        }
-
-        // Search through the metadata for an attached picture (if
-        // present)
-        for (int i = 0; i < tags->comments; ++i) {
-                // Check for METADATA_BLOCK_PICTURE
-                const char *comment = tags->user_comments[i];
-                if (strncasecmp(comment,
-                                "METADATA_BLOCK_PICTURE=", 23) == 0) {
-                        // Extract the value after
-                        // "METADATA_BLOCK_PICTURE="
-                        std::string metadataBlockPicture(comment + 23);
-
-                        // Base64-decode this value to get the binary
-                        // PICTURE block
-                        std::vector<unsigned char> pictureBlock =
-                            decodeBase64(metadataBlockPicture);
-
-                        if (pictureBlock.empty()) {
-                                std::cerr
-                                    << "Failed to decode Base64 data."
-                                    << std::endl;
-                                op_free(of);
-                                return false;
-                        }
-
-                        // Now parse the binary pictureBlock to extract
-                        // the image data
-                        size_t offset = 0;
-
-                        if (pictureBlock.size() < 32) {
-                                std::cerr << "Picture block too small."
-                                          << std::endl;
-                                op_free(of);
-                                return false;
-                        }
-
-                        // Read PICTURE TYPE
-                        read_uint32_be(pictureBlock.data(),
-                                       pictureBlock.size(), offset);
-                        offset += 4;
-
-                        // Read MIME TYPE LENGTH
-                        unsigned int mimeTypeLength =
-                            read_uint32_be(pictureBlock.data(),
-                                           pictureBlock.size(), offset);
-                        offset += 4;
-
-                        // Read MIME TYPE
-                        if (offset + mimeTypeLength >
-                            pictureBlock.size()) {
-                                op_free(of);
-                                return false;
-                        }
-                        offset += mimeTypeLength;
-
-                        // Read DESCRIPTION LENGTH
-                        unsigned int descriptionLength =
-                            read_uint32_be(pictureBlock.data(),
-                                           pictureBlock.size(), offset);
-                        offset += 4;
-
-                        // Read DESCRIPTION
-                        if (offset + descriptionLength >
-                            pictureBlock.size()) {
-                                op_free(of);
-                                return false;
-                        }
-                        offset += descriptionLength;
-                        // Optionally print or ignore description
-
-                        // Read WIDTH
-                        read_uint32_be(pictureBlock.data(),
-                                       pictureBlock.size(), offset);
-                        offset += 4;
-
-                        // Read HEIGHT
-                        read_uint32_be(pictureBlock.data(),
-                                       pictureBlock.size(), offset);
-                        offset += 4;
-                        ;
-
-                        // Read COLOR DEPTH
-                        read_uint32_be(pictureBlock.data(),
-                                       pictureBlock.size(), offset);
-                        offset += 4;
-
-                        // Read NUMBER OF COLORS
-                        read_uint32_be(pictureBlock.data(),
-                                       pictureBlock.size(), offset);
-                        offset += 4;
-
-                        // Read DATA LENGTH
-                        unsigned int dataLength =
-                            read_uint32_be(pictureBlock.data(),
-                                           pictureBlock.size(), offset);
-                        offset += 4;
-
-                        if (offset + dataLength > pictureBlock.size()) {
-                                std::cerr
-                                    << "Invalid image data length."
-                                    << std::endl;
-                                op_free(of);
-                                return false;
-                        }
-
-                        // Extract image data
-                        std::vector<unsigned char> imageData(
-                            pictureBlock.begin() + offset,
-                            pictureBlock.begin() + offset + dataLength);
-
-                        // Save image data to file
-                        std::ofstream outFile(outputFileName,
-                                              std::ios::binary);
-                        if (!outFile) {
-                                std::cerr << "Error: Could not write "
-                                             "to output file."
-                                          << std::endl;
-                                op_free(of);
-                                return false;
-                        }
-                        outFile.write(reinterpret_cast<const char *>(
-                                          imageData.data()),
-                                      imageData.size());
-                        outFile.close();
-
-                        op_free(of);
-                        return true;
-                }
-        }
-
-        std::cerr << "No cover art found in the metadata." << std::endl;
-        op_free(of);
-        return false;
-}
-
 bool extractCoverArtFromMp4(TagLib::FileRef *f,
-                            const std::string &coverFilePath)
+                            std::vector<unsigned char> &cover)
 {
 
         TagLib::MP4::File *file =
@@ -969,21 +681,10 @@ bool extractCoverArtFromMp4(TagLib::FileRef *f,
                 if (!coverArtList.isEmpty()) {
                         const TagLib::MP4::CoverArt &coverArt =
                             coverArtList.front();
-                        FILE *coverFile =
-                            fopen(coverFilePath.c_str(), "wb");
-                        if (coverFile) {
-                                fwrite(coverArt.data().data(), 1,
-                                       coverArt.data().size(),
-                                       coverFile);
-                                fclose(coverFile);
-                                return true; // Success
-                        } else {
-                                fprintf(
-                                    stderr, "Could not open output file '%s'\n",
-                                    coverFilePath.c_str());
-                                return false; // Failed to open the
-                                              // output file
-                        }
+                        TagLib::ByteVector pictureData = coverArt.data();
+                        cover.assign(pictureData.data(),
+                                     pictureData.data() + pictureData.size());
+                        return true; // Success
                 }
         }
 
@@ -1428,31 +1129,9 @@ static bool loadLyricsFromUSLTTag(TagLib::ID3v2::Tag *id3v2Tag,
         return true;
 }
 
-void getTrackInfo(const char *filepath, uint32_t *track, uint32_t *disc)
+static void readTrackInfo(TagLib::File *file, const TagLib::Tag *tag,
+                          uint32_t *track, uint32_t *disc)
 {
-
-#ifdef _WIN32
-        std::wstring wpath = utf8ToWide(filepath);
-        TagLib::FileRef file(wpath.c_str());
-#else
-        TagLib::FileRef file(filepath);
-#endif
-
-        if (file.isNull() || !file.file()) {
-                fprintf(stderr, "FileRef is null or file could not be opened: "
-                                "'%s'\n",
-                        filepath);
-
-                return;
-        }
-
-        const TagLib::Tag *tag = file.tag();
-        if (!tag) {
-                fprintf(stderr, "Tag is null for file '%s'\n",
-                        filepath);
-                return;
-        }
-
         uint32_t trackNumber = tag->track();
 
         if (track != NULL)
@@ -1460,7 +1139,7 @@ void getTrackInfo(const char *filepath, uint32_t *track, uint32_t *disc)
         if (disc == NULL)
                 return;
 
-        auto mpeg = dynamic_cast<TagLib::MPEG::File *>(file.file());
+        auto mpeg = dynamic_cast<TagLib::MPEG::File *>(file);
         if (mpeg == NULL || !mpeg->isValid())
                 return;
 
@@ -1482,8 +1161,34 @@ void getTrackInfo(const char *filepath, uint32_t *track, uint32_t *disc)
         char *delimiter;
         uint32_t disc_number = strtoul(raw.c_str(), &delimiter, 10);
         *disc = disc_number;
+}
 
-        return;
+void getTrackInfo(const char *filepath, uint32_t *track, uint32_t *disc)
+{
+        // Only the tags are needed, don't scan the audio stream
+#ifdef _WIN32
+        std::wstring wpath = utf8ToWide(filepath);
+        TagLib::FileRef file(wpath.c_str(), false);
+#else
+        TagLib::FileRef file(filepath, false);
+#endif
+
+        if (file.isNull() || !file.file()) {
+                fprintf(stderr, "FileRef is null or file could not be opened: "
+                                "'%s'\n",
+                        filepath);
+
+                return;
+        }
+
+        const TagLib::Tag *tag = file.tag();
+        if (!tag) {
+                fprintf(stderr, "Tag is null for file '%s'\n",
+                        filepath);
+                return;
+        }
+
+        readTrackInfo(file.file(), tag, track, disc);
 }
 
 static std::string getComment(TagLib::File *file)
@@ -1592,19 +1297,26 @@ bool isAllowedUrl(std::string &url)
 }
 
 int extractTags(const char *input_file, TagSettings *tag_settings,
-                double *duration, const char *coverFilePath, Lyrics **lyrics, bool get_url)
+                double *duration, unsigned char **cover_data, size_t *cover_size,
+                Lyrics **lyrics, bool get_url)
 {
+        *cover_data = nullptr;
+        *cover_size = 0;
+
         memset(tag_settings, 0,
                sizeof(TagSettings)); // Initialize tag settings
 
         tag_settings->replaygainTrack = 0.0;
         tag_settings->replaygainAlbum = 0.0;
 
+        // Everything below is read from this one open file. Fast only
+        // parses the stream headers for the duration, instead of scanning
+        // VBR files for an exact length.
 #ifdef _WIN32
         std::wstring wpath = utf8ToWide(input_file);
-        TagLib::FileRef f(wpath.c_str());
+        TagLib::FileRef f(wpath.c_str(), true, TagLib::AudioProperties::Fast);
 #else
-        TagLib::FileRef f(input_file);
+        TagLib::FileRef f(input_file, true, TagLib::AudioProperties::Fast);
 #endif
 
         if (f.isNull() || !f.file()) {
@@ -1667,6 +1379,8 @@ int extractTags(const char *input_file, TagSettings *tag_settings,
                 }
         }
 
+        readTrackInfo(f.file(), tag, &tag_settings->track, &tag_settings->disc);
+
         if (*lyrics == nullptr) {
                 if (auto mpegFile = dynamic_cast<TagLib::MPEG::File *>(f.file())) {
                         // 1) True synchronized lyrics (SYLT)
@@ -1815,37 +1529,45 @@ int extractTags(const char *input_file, TagSettings *tag_settings,
         std::string filename(input_file);
         std::string extension = toLower(filename.substr(filename.find_last_of('.') + 1));
         bool coverArtExtracted = false;
+        std::vector<unsigned char> cover;
 
         if (extension == "mp3") {
                 coverArtExtracted =
-                    extractCoverArtFromMp3(&f, coverFilePath);
+                    extractCoverArtFromMp3(&f, cover);
         } else if (extension == "flac") {
                 coverArtExtracted =
-                    extractCoverArtFromFlac(&f, coverFilePath);
+                    extractCoverArtFromFlac(&f, cover);
         } else if (extension == "m4a" || extension == "aac") {
                 coverArtExtracted =
-                    extractCoverArtFromMp4(&f, coverFilePath);
+                    extractCoverArtFromMp4(&f, cover);
         }
         if (extension == "opus") {
                 coverArtExtracted =
-                    extractCoverArtFromOpus(input_file, coverFilePath);
+                    extractCoverArtFromOgg(&f, cover);
         } else if (extension == "ogg") {
                 coverArtExtracted =
-                    extractCoverArtFromOgg(&f, coverFilePath);
+                    extractCoverArtFromOgg(&f, cover);
 
                 if (!coverArtExtracted) {
                         coverArtExtracted = extractCoverArtFromOggVideo(
-                            input_file, coverFilePath);
+                            input_file, cover);
                 }
         } else if (extension == "wav" || extension == "aiff") {
                 coverArtExtracted =
-                    extractCoverArtFromWav(&f, coverFilePath);
+                    extractCoverArtFromWav(&f, cover);
         }
 
-        if (coverArtExtracted) {
-                return 0;
-        } else {
+        if (!coverArtExtracted || cover.empty())
                 return -1;
-        }
+
+        // Handed to C, which frees it with free()
+        *cover_data = static_cast<unsigned char *>(malloc(cover.size()));
+        if (*cover_data == nullptr)
+                return -1;
+
+        memcpy(*cover_data, cover.data(), cover.size());
+        *cover_size = cover.size();
+
+        return 0;
 }
 }
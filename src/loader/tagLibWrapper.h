@@ -29,8 +29,11 @@ extern "C" {
  * the duration is stored in the `duration` pointer, and any lyrics are stored
  * in the `lyrics` pointer.
  *
+ * The file is opened only once for all of this, and the duration is read
+ * with TagLib's fast audio properties.
+ *
  * The function performs the following tasks:
- * - Extracts title, artist, album, and year.
+ * - Extracts title, artist, album, year, and track and disc numbers.
  * - Retrieves replay gain information (track and album gains).
  * - Loads lyrics (if available) from multiple formats (e.g., SYLT, USLT, Vorbis).
  * - Extracts the audio file's duration.
@@ -40,7 +43,9 @@ extern "C" {
  * @param tag_settings A pointer to a TagSettings structure to store extracted
  *                     metadata (title, artist, album, replay gain, etc.).
  * @param duration A pointer to store the extracted audio duration in seconds.
- * @param cover_file_path The path where the extracted cover art should be saved.
+ * @param cover_data Set to the embedded cover image, still encoded (JPEG, PNG...).
+ *                   Allocated with malloc(), the caller frees it. NULL if none.
+ * @param cover_size Set to the size of cover_data in bytes.
  * @param lyrics A pointer to a Lyrics structure that will be populated with
  *               any lyrics found in the audio file.
  *
@@ -55,11 +60,15 @@ extern "C" {
  *          initialize the tag settings, and fallback behavior will be applied.
  */
 int extractTags(const char *input_file, TagSettings *tag_settings,
-                double *duration, const char *coverFilePath, Lyrics **lyrics, bool get_url);
+                double *duration, unsigned char **cover_data, size_t *cover_size,
+                Lyrics **lyrics, bool get_url);
 
 /*
  * @brief Extracts disc and track number from tags
  *
+ * Reads the tags only, for sorting files that aren't loaded. Loaded songs
+ * get the same numbers from extractTags().
+ *
  * @param filepath full file path
  * @param track A pointer to the variable where the extracted track number will be stored
  * @param disc A pointer to the variable where the extracted disc number will be stored
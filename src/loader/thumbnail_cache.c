@@ -0,0 +1,461 @@
+/**
+ * @file thumbnail_cache.c
+ * @brief Downscaled cover bitmaps, cached on disk.
+ *
+ * The files follow the QOI format (https://qoiformat.org), which is
+ * lossless, compresses covers well and decodes much faster than JPEG.
+ * The least recently used ones are deleted once the directory grows past
+ * THUMBNAIL_DIR_MAX_BYTES.
+ */
+
+#include "thumbnail_cache.h"
+
+#include "common/path_max.h"
+
+#include "utils/file.h"
+#include "utils/img_utils.h"
+#include "utils/utils.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THUMBNAIL_DIR "thumbnails"
+
+// Least recently used thumbnails are deleted above this size
+#define THUMBNAIL_DIR_MAX_BYTES (256LL * 1024 * 1024)
+
+// The size is checked on the first store, then every PRUNE_INTERVAL stores
+#define PRUNE_INTERVAL 64
+
+// Larger cover files are not read into memory
+#define MAX_COVER_FILE_SIZE (64 * 1024 * 1024)
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF 0x40
+#define QOI_OP_LUMA 0x80
+#define QOI_OP_RUN 0xc0
+#define QOI_OP_RGB 0xfe
+#define QOI_OP_RGBA 0xff
+#define QOI_MASK_2 0xc0
+
+#define QOI_HEADER_SIZE 14
+#define QOI_PADDING_SIZE 8
+
+static const unsigned char qoi_padding[QOI_PADDING_SIZE] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+static atomic_uint tmp_counter = 0;
+static atomic_uint store_count = 0;
+
+typedef struct {
+        unsigned char r, g, b, a;
+} QoiPixel;
+
+static int qoi_hash(QoiPixel p)
+{
+        return (p.r * 3 + p.g * 5 + p.b * 7 + p.a * 11) % 64;
+}
+
+static bool qoi_equal(QoiPixel a, QoiPixel b)
+{
+        return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+static void write_u32_be(unsigned char *out, uint32_t v)
+{
+        out[0] = (unsigned char)(v >> 24);
+        out[1] = (unsigned char)(v >> 16);
+        out[2] = (unsigned char)(v >> 8);
+        out[3] = (unsigned char)v;
+}
+
+static uint32_t read_u32_be(const unsigned char *in)
+{
+        return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) |
+               ((uint32_t)in[2] << 8) | (uint32_t)in[3];
+}
+
+static unsigned char *qoi_encode(const unsigned char *pixels, int width, int height, size_t *out_size)
+{
+        size_t count = (size_t)width * height;
+        size_t max_size = QOI_HEADER_SIZE + count * 5 + QOI_PADDING_SIZE;
+
+        unsigned char *out = malloc(max_size);
+        if (out == NULL)
+                return NULL;
+
+        memcpy(out, "qoif", 4);
+        write_u32_be(out + 4, (uint32_t)width);
+        write_u32_be(out + 8, (uint32_t)height);
+        out[12] = 4; // RGBA
+        out[13] = 0; // sRGB
+
+        size_t p = QOI_HEADER_SIZE;
+        QoiPixel index[64];
+        memset(index, 0, sizeof(index));
+
+        QoiPixel prev = {0, 0, 0, 255};
+        int run = 0;
+
+        for (size_t i = 0; i < count; i++) {
+                const unsigned char *src = pixels + i * 4;
+                QoiPixel px = {src[0], src[1], src[2], src[3]};
+
+                if (qoi_equal(px, prev)) {
+                        run++;
+                        if (run == 62 || i == count - 1) {
+                                out[p++] = QOI_OP_RUN | (run - 1);
+                                run = 0;
+                        }
+                        continue;
+                }
+
+                if (run > 0) {
+                        out[p++] = QOI_OP_RUN | (run - 1);
+                        run = 0;
+                }
+
+                int h = qoi_hash(px);
+
+                if (qoi_equal(index[h], px)) {
+                        out[p++] = QOI_OP_INDEX | h;
+                } else {
+                        index[h] = px;
+
+                        if (px.a == prev.a) {
+                                signed char vr = (signed char)(px.r - prev.r);
+                                signed char vg = (signed char)(px.g - prev.g);
+                                signed char vb = (signed char)(px.b - prev.b);
+                                signed char vg_r = (signed char)(vr - vg);
+                                signed char vg_b = (signed char)(vb - vg);
+
+                                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                                        out[p++] = QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2);
+                                } else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 &&
+                                           vg_b > -9 && vg_b < 8) {
+                                        out[p++] = QOI_OP_LUMA | (vg + 32);
+                                        out[p++] = (vg_r + 8) << 4 | (vg_b + 8);
+                                } else {
+                                        out[p++] = QOI_OP_RGB;
+                                        out[p++] = px.r;
+                                        out[p++] = px.g;
+                                        out[p++] = px.b;
+                                }
+                        } else {
+                                out[p++] = QOI_OP_RGBA;
+                                out[p++] = px.r;
+                                out[p++] = px.g;
+                                out[p++] = px.b;
+                                out[p++] = px.a;
+                        }
+                }
+
+                prev = px;
+        }
+
+        memcpy(out + p, qoi_padding, QOI_PADDING_SIZE);
+        p += QOI_PADDING_SIZE;
+
+        *out_size = p;
+
+        return out;
+}
+
+static unsigned char *qoi_decode(const unsigned char *data, size_t size, int *width, int *height)
+{
+        if (size < QOI_HEADER_SIZE + QOI_PADDING_SIZE || memcmp(data, "qoif", 4) != 0)
+                return NULL;
+
+        uint32_t w = read_u32_be(data + 4);
+        uint32_t h = read_u32_be(data + 8);
+
+        if (w == 0 || h == 0 || w > THUMBNAIL_MAX_EDGE || h > THUMBNAIL_MAX_EDGE || data[12] != 4)
+                return NULL;
+
+        size_t count = (size_t)w * h;
+        unsigned char *pixels = malloc(count * 4);
+        if (pixels == NULL)
+                return NULL;
+
+        size_t p = QOI_HEADER_SIZE;
+        size_t end = size - QOI_PADDING_SIZE;
+        QoiPixel index[64];
+        memset(index, 0, sizeof(index));
+
+        QoiPixel px = {0, 0, 0, 255};
+        int run = 0;
+
+        for (size_t i = 0; i < count; i++) {
+                if (run > 0) {
+                        run--;
+                } else if (p < end) {
+                        int b1 = data[p++];
+
+                        if (b1 == QOI_OP_RGB) {
+                                if (p + 3 > end)
+                                        goto error;
+                                px.r = data[p++];
+                                px.g = data[p++];
+                                px.b = data[p++];
+                        } else if (b1 == QOI_OP_RGBA) {
+                                if (p + 4 > end)
+                                        goto error;
+                                px.r = data[p++];
+                                px.g = data[p++];
+                                px.b = data[p++];
+                                px.a = data[p++];
+                        } else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX) {
+                                px = index[b1];
+                        } else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF) {
+                                px.r += ((b1 >> 4) & 0x03) - 2;
+                                px.g += ((b1 >> 2) & 0x03) - 2;
+                                px.b += (b1 & 0x03) - 2;
+                        } else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+                                if (p + 1 > end)
+                                        goto error;
+                                int b2 = data[p++];
+                                int vg = (b1 & 0x3f) - 32;
+                                px.r += vg - 8 + ((b2 >> 4) & 0x0f);
+                                px.g += vg;
+                                px.b += vg - 8 + (b2 & 0x0f);
+                        } else {
+                                run = b1 & 0x3f;
+                        }
+
+                        index[qoi_hash(px)] = px;
+                } else {
+                        goto error;
+                }
+
+                unsigned char *dst = pixels + i * 4;
+                dst[0] = px.r;
+                dst[1] = px.g;
+                dst[2] = px.b;
+                dst[3] = px.a;
+        }
+
+        *width = (int)w;
+        *height = (int)h;
+
+        return pixels;
+
+error:
+        free(pixels);
+        return NULL;
+}
+
+static uint64_t content_hash(const unsigned char *data, size_t size)
+{
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; i++) {
+                hash ^= data[i];
+                hash *= 1099511628211ull;
+        }
+        return hash ^ (uint64_t)size;
+}
+
+static bool get_cache_dir(char *dir, size_t dir_size, bool create_dir)
+{
+        char *configdir = get_config_path();
+        if (configdir == NULL)
+                return false;
+
+        int written = snprintf(dir, dir_size, "%s/%s", configdir, THUMBNAIL_DIR);
+
+        free(configdir);
+
+        if (written < 0 || (size_t)written >= dir_size)
+                return false;
+
+        return !create_dir || create_directory(dir) >= 0;
+}
+
+static bool get_cache_file(uint64_t hash, char *out, size_t out_size, bool create_dir)
+{
+        char dir[KEW_PATH_MAX];
+
+        if (!get_cache_dir(dir, sizeof(dir), create_dir))
+                return false;
+
+        int written = snprintf(out, out_size, "%s/%016llx_%d.qoi", dir,
+                               (unsigned long long)hash, THUMBNAIL_MAX_EDGE);
+
+        return written > 0 && (size_t)written < out_size;
+}
+
+static void prune_thumbnails(void)
+{
+        if (atomic_fetch_add(&store_count, 1) % PRUNE_INTERVAL != 0)
+                return;
+
+        char dir[KEW_PATH_MAX];
+
+        if (get_cache_dir(dir, sizeof(dir), false))
+                prune_directory(dir, ".qoi", THUMBNAIL_DIR_MAX_BYTES);
+}
+
+// Reads a whole file into memory
+static unsigned char *read_file(const char *path, size_t *size)
+{
+        FILE *f = fopen(path, "rb");
+        if (f == NULL)
+                return NULL;
+
+        unsigned char *data = NULL;
+        long len = -1;
+
+        if (fseek(f, 0, SEEK_END) == 0)
+                len = ftell(f);
+
+        if (len > 0 && len <= MAX_COVER_FILE_SIZE && fseek(f, 0, SEEK_SET) == 0) {
+                data = malloc((size_t)len);
+
+                if (data != NULL && fread(data, 1, (size_t)len, f) != (size_t)len) {
+                        free(data);
+                        data = NULL;
+                }
+        }
+
+        fclose(f);
+
+        if (data != NULL)
+                *size = (size_t)len;
+
+        return data;
+}
+
+static unsigned char *load_thumbnail(uint64_t hash, int *width, int *height)
+{
+        char cache_file[KEW_PATH_MAX];
+
+        if (!get_cache_file(hash, cache_file, sizeof(cache_file), false))
+                return NULL;
+
+        size_t size;
+        unsigned char *data = read_file(cache_file, &size);
+        if (data == NULL)
+                return NULL;
+
+        unsigned char *pixels = qoi_decode(data, size, width, height);
+
+        free(data);
+
+        // Pruning goes by mtime, so mark it as used
+        if (pixels != NULL)
+                touch_file(cache_file);
+
+        return pixels;
+}
+
+static void store_thumbnail(uint64_t hash, const unsigned char *pixels, int width, int height)
+{
+        char cache_file[KEW_PATH_MAX];
+        char tmp_file[KEW_PATH_MAX + 16];
+
+        if (!get_cache_file(hash, cache_file, sizeof(cache_file), true))
+                return;
+
+        size_t size;
+        unsigned char *encoded = qoi_encode(pixels, width, height, &size);
+        if (encoded == NULL)
+                return;
+
+        // Tracks of the same album can be loaded at the same time
+        snprintf(tmp_file, sizeof(tmp_file), "%s.%u.tmp", cache_file,
+                 atomic_fetch_add(&tmp_counter, 1));
+
+        FILE *f = fopen(tmp_file, "wb");
+        if (f == NULL) {
+                free(encoded);
+                return;
+        }
+
+        bool ok = fwrite(encoded, 1, size, f) == size;
+
+        if (fclose(f) != 0)
+                ok = false;
+
+        free(encoded);
+
+        // Write and rename, so a reader never sees half an image
+#ifdef _WIN32
+        if (ok)
+                remove(cache_file);
+#endif
+        if (!ok || rename(tmp_file, cache_file) != 0) {
+                remove(tmp_file);
+                return;
+        }
+
+        prune_thumbnails();
+}
+
+unsigned char *thumbnail_cache_get(const unsigned char *data, size_t size, int *width, int *height)
+{
+        if (data == NULL || size == 0)
+                return NULL;
+
+        uint64_t hash = content_hash(data, size);
+
+        unsigned char *pixels = load_thumbnail(hash, width, height);
+        if (pixels != NULL)
+                return pixels;
+
+        int w, h;
+        pixels = get_bitmap_from_memory(data, size, &w, &h);
+        if (pixels == NULL)
+                return NULL;
+
+        if (w > THUMBNAIL_MAX_EDGE || h > THUMBNAIL_MAX_EDGE) {
+                float scale = (float)THUMBNAIL_MAX_EDGE / (float)(w > h ? w : h);
+                int tw = (int)(w * scale + 0.5f);
+                int th = (int)(h * scale + 0.5f);
+
+                tw = tw < 1 ? 1 : (tw > THUMBNAIL_MAX_EDGE ? THUMBNAIL_MAX_EDGE : tw);
+                th = th < 1 ? 1 : (th > THUMBNAIL_MAX_EDGE ? THUMBNAIL_MAX_EDGE : th);
+
+                unsigned char *scaled = malloc((size_t)tw * th * 4);
+
+                if (scaled != NULL && image_resize_uint8_srgb(pixels, w, h, scaled, tw, th, 4) != NULL) {
+                        image_free(pixels);
+                        pixels = scaled;
+                        w = tw;
+                        h = th;
+                } else {
+                        // Too big to cache, but still usable
+                        free(scaled);
+                        *width = w;
+                        *height = h;
+                        return pixels;
+                }
+        }
+
+        store_thumbnail(hash, pixels, w, h);
+
+        *width = w;
+        *height = h;
+
+        return pixels;
+}
+
+unsigned char *thumbnail_cache_get_file(const char *image_path, int *width, int *height)
+{
+        if (image_path == NULL || image_path[0] == '\0')
+                return NULL;
+
+        size_t size;
+        unsigned char *data = read_file(image_path, &size);
+
+        if (data == NULL)
+                return get_bitmap(image_path, width, height);
+
+        unsigned char *pixels = thumbnail_cache_get(data, size, width, height);
+
+        free(data);
+
+        return pixels;
+}
@@ -0,0 +1,43 @@
+/**
+ * @file thumbnail_cache.h
+ * @brief Downscaled cover bitmaps, cached on disk.
+ *
+ * Covers are often thousands of pixels wide, while the terminal shows
+ * them at a few hundred. A cover is decoded and scaled down once, and the
+ * result is stored as a QOI image in the thumbnails directory of the
+ * config directory, keyed by a hash of the encoded image and the target
+ * size. Every later load of the same cover, for instance by the other
+ * tracks of the album, reads the small bitmap back instead.
+ */
+
+#ifndef THUMBNAIL_CACHE_H
+#define THUMBNAIL_CACHE_H
+
+#include <stddef.h>
+
+// Longest edge of a cached cover, in pixels
+#define THUMBNAIL_MAX_EDGE 1024
+
+/**
+ * @brief Returns the RGBA bitmap of an encoded cover image.
+ *
+ * @param data   The encoded image (JPEG, PNG...).
+ * @param size   Size of data in bytes.
+ * @param width  Output, the width of the bitmap.
+ * @param height Output, the height of the bitmap.
+ * @return The pixels, at most THUMBNAIL_MAX_EDGE on either side, or NULL
+ *         if the image can't be decoded. Free with image_free().
+ */
+unsigned char *thumbnail_cache_get(const unsigned char *data, size_t size, int *width, int *height);
+
+/**
+ * @brief Like thumbnail_cache_get(), for a cover stored as an image file.
+ *
+ * @param image_path Path to the image file.
+ * @param width      Output, the width of the bitmap.
+ * @param height     Output, the height of the bitmap.
+ * @return The pixels, or NULL if the file can't be read or decoded.
+ */
+unsigned char *thumbnail_cache_get_file(const char *image_path, int *width, int *height);
+
+#endif
@@ -231,21 +231,22 @@ void *update_library_thread(void *arg)
 
         model->library = tmp;
 
-        model->library_updated = true;
-
         model->state.ui.numDirectoryTreeEntries = tmp_directory_tree_entries;
 
         free_tree(old);
 
-        c_sleep(1000); // Don't refresh immediately or we risk the error message
-                       // not clearing
+        pthread_mutex_unlock(&(model->state.library_mutex));
+
+        // Don't refresh immediately or we risk the error message not
+        // clearing. Sleep outside the lock so the main loop keeps ticking.
+        c_sleep(1000);
+
+        model->library_updated = true;
 
         free(args->path);
         free(args);
         model->updating_library = false;
 
-        pthread_mutex_unlock(&(model->state.library_mutex));
-
         return NULL;
 }
 
@@ -160,5 +160,5 @@ SongData *get_current_song_data(SongData *previous_songdata)
         // Log basic stats
         k_log("New songdata: %s duration: %f", song_data->file_path, song_data->duration);
 #endif
-        return songdata_clone(song_data);
+        return songdata_share(song_data);
 }
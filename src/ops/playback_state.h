@@ -117,7 +117,7 @@ void set_volume(int vol);
  *
  * Returns the validated SongData associated with the current playlist entry.
  * Ensures the data is not deleted and contains valid metadata.
- * The previous_songdata is returned if the one fetched is the same, otherwise a deep copy is returned and the previous_songdata is freed.
+ * The previous_songdata is returned if the one fetched is the same, otherwise a new reference to the current song is returned and the previous_songdata is released.
  *
  * @param previous_songdata The previous songdata
  * @return Pointer to the active SongData, or NULL if unavailable or invalid.
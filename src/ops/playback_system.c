@@ -14,6 +14,8 @@
 
 #include "data/theme.h"
 
+#include "loader/song_cache.h"
+
 #include "sound/sound_facade.h"
 
 atomic_bool start_audio;
@@ -36,6 +38,10 @@ int sound_system_init(void)
 
         if (result >= 0) {
                 sound_system_set_replay_gain_check_first(sound_sys, model->state.settings.replayGainCheckFirst);
+                sound_system_set_buffer_mode(sound_sys, model->state.settings.bufferMode);
+                sound_system_set_crossfade_curve(sound_sys, model->state.settings.crossfade_curve);
+                song_cache_set_limits(model->state.settings.song_cache_entries,
+                                      (size_t)model->state.settings.song_cache_mb * 1024 * 1024);
                 sound_system_set_always_crossfade(sound_sys, model->state.settings.always_crossfade, model->state.settings.fade_medium_ms);
                 start_playing(true);
                 atomic_store(&sound_sys->track_frames_sent, 0);
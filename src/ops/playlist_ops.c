@@ -45,7 +45,7 @@ Node *choose_next_song(void)
         if (next_song != NULL)
                 return next_song;
         else if (current != NULL && current->next != NULL) {
-                return current->next;
+                return get_list_next(current);
         } else {
                 return NULL;
         }
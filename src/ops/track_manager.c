@@ -13,6 +13,9 @@
 #include "common/common.h"
 
 #include "common/model.h"
+
+#include "loader/song_cache.h"
+
 #include "playback_clock.h"
 #include "playback_ops.h"
 #include "playback_state.h"
@@ -66,6 +69,15 @@ void load_song(Node *song, bool is_first_decoder, bool replace_next_song)
                 if (sound_result == SOUND_ERROR_SONG)
                         ps->songHasErrors = true;
         }
+
+        // Have the neighbours ready in case the user skips. The newest
+        // request is served first, so the next song goes last.
+        if (song->prev != NULL)
+                song_cache_prefetch(song->prev->song.file_path);
+
+        Node *next = get_list_next(song);
+        if (next != NULL)
+                song_cache_prefetch(next->song.file_path);
 }
 
 void load_next_song(bool replace_next_song)
@@ -88,10 +100,10 @@ int load_first(Node *song)
         Node *current = get_current_song();
         PlaybackState *ps = get_playback_state();
 
-        while (ps->songHasErrors && current->next != NULL) {
+        while (ps->songHasErrors && get_list_next(current) != NULL) {
                 ps->songHasErrors = false;
                 ps->loadedNextSong = false;
-                current = current->next;
+                current = get_list_next(current);
                 set_current_song(current);
                 load_song(current, true, false);
         }
@@ -203,10 +215,10 @@ void try_load_next(bool is_first_decoder, bool replace_next_song)
         ps->clearingErrors = true;
 
         if (try_next_song == NULL && current != NULL) {
-                try_next_song = current->next;
+                try_next_song = get_list_next(current);
                 set_try_next_song(try_next_song);
         } else if (try_next_song != NULL) {
-                try_next_song = try_next_song->next;
+                try_next_song = get_list_next(try_next_song);
                 set_try_next_song(try_next_song);
         }
         if (try_next_song != NULL) {
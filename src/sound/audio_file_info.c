@@ -70,6 +70,20 @@ void get_webm_file_info(const char *filename, ma_format *format,
         }
         (void)channel_map;
 }
+
+double get_webm_duration(const char *filename)
+{
+        double duration = 0.0;
+        ma_webm tmp;
+
+        if (ma_webm_init_file(filename, NULL, NULL, &tmp) == MA_SUCCESS) {
+                duration = tmp.duration;
+                ma_webm_uninit(&tmp, NULL);
+        }
+
+        return duration;
+}
+
 #ifdef USE_FAAD
 void get_m4a_file_info_full(const char *filename, ma_format *format,
                             ma_uint32 *channels, ma_uint32 *sample_rate,
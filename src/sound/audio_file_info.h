@@ -69,6 +69,14 @@ void get_opus_file_info(const char *filename, ma_format *format, ma_uint32 *chan
  */
 void get_webm_file_info(const char *filename, ma_format *format, ma_uint32 *channels, ma_uint32 *sample_rate, ma_channel *channel_map);
 
+/**
+ * @brief Gets the duration of a WebM audio file.
+ *
+ * @param filename The path to the WebM file.
+ * @return The duration in seconds, 0 if it can't be read.
+ */
+double get_webm_duration(const char *filename);
+
 /**
  * @brief Gets detailed information about an M4A audio file (Full Information).
  *
@@ -7,6 +7,8 @@
  */
 #include "audiobuffer.h"
 
+#include "utils/dsp_kernels.h"
+
 #include <stdatomic.h>
 #include <string.h>
 
@@ -101,13 +103,29 @@ void prepare_visualizer_audiobuffer(ma_uint32 sample_rate, ma_uint32 channels)
         ma_uint32 to_consume = samples_per_frame;
 
         while (to_consume >= channels && write_head < fft_size) {
-                float sum = 0.0f;
-                for (ma_uint32 ch = 0; ch < channels; ch++) {
-                        sum += viz_rb[(read + ch) & VIZ_RB_MASK];
+                ma_uint32 pos = read & VIZ_RB_MASK;
+                ma_uint32 frames = to_consume / channels;
+
+                // Downmix the frames that don't wrap around the end of the ring in one go
+                ma_uint32 contiguous = (VIZ_RB_SIZE - pos) / channels;
+                if (frames > contiguous)
+                        frames = contiguous;
+                if (frames > (ma_uint32)(fft_size - write_head))
+                        frames = fft_size - write_head;
+
+                if (frames > 0) {
+                        dsp_downmix_f32(&viz_rb[pos], &audio_buffer[write_head], frames, channels);
+                } else {
+                        float frame[MA_MAX_CHANNELS];
+                        for (ma_uint32 ch = 0; ch < channels; ch++)
+                                frame[ch] = viz_rb[(read + ch) & VIZ_RB_MASK];
+                        dsp_downmix_f32(frame, &audio_buffer[write_head], 1, channels);
+                        frames = 1;
                 }
-                read += channels;
-                to_consume -= channels;
-                audio_buffer[write_head++] = sum / channels;
+
+                read += frames * channels;
+                to_consume -= frames * channels;
+                write_head += frames;
 
                 if (write_head >= fft_size) {
                         set_buffer_ready(true);
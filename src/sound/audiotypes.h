@@ -22,6 +22,18 @@ typedef enum {
         SOUND_STATE_PAUSED
 } sound_playback_state_t;
 
+typedef enum {
+        SOUND_BUFFER_BALANCED = 0,
+        SOUND_BUFFER_POWER_SAVING,
+        SOUND_BUFFER_LOW_LATENCY
+} sound_buffer_mode_t;
+
+typedef enum {
+        SOUND_FADE_EQUAL_POWER = 0,
+        SOUND_FADE_LINEAR,
+        SOUND_FADE_S_CURVE
+} sound_fade_curve_t;
+
 typedef enum {
         SOUND_STATE_REPEAT_OFF = 0,
         SOUND_STATE_REPEAT,
@@ -46,18 +58,19 @@ struct sound_system {
         ma_uint64 current_frame;
         ma_uint64 total_frames;
         ma_uint64 total_song_frames;
+        ma_uint64 preroll_frames; // Lead-in frames already in the ring buffer
 
         ma_uint32 avg_bit_rate;
 
         SongData *songdataA;
         SongData *songdataB;
 
-        ma_uint32 chunk_frames;
+        ma_uint32 chunk_frames;  // Frames decoded per step
+        ma_uint32 refill_frames; // Free space that wakes the decoder to refill
         pthread_t decode_thread;
 
 #ifndef __cplusplus
         atomic_llong track_frames_sent;
-        atomic_llong track_end_frame;
         atomic_llong fade_boundary;
         atomic_bool end_of_list_reached;
         atomic_bool decode_thread_running;
@@ -65,8 +78,8 @@ struct sound_system {
         atomic_bool request_switch_metadata;
         atomic_bool request_switch_decoder;
         atomic_bool buffer_ready;
+        atomic_bool deferred_open; // Output started from the lead-in, the decoder isn't open yet
         atomic_bool using_song_slot_A;
-        atomic_bool clock_reset_done;
         atomic_bool fade_boundary_reached;
         atomic_int clock_reset_ms;
 #endif
@@ -74,13 +87,16 @@ struct sound_system {
         float volume;
         sound_playback_state_t state;
 
-        int ring_buffer_secs;
+        int buffer_mode;         // sound_buffer_mode_t
+        int applied_buffer_mode; // The mode the current device was built with
+        int ring_buffer_ms;
 
         bool always_fade;
         int always_fade_ms;
         bool fade_allowed;
         bool fade_requested;
         bool fade_seek_performed;
+        int fade_curve; // sound_fade_curve_t
         int fade_ms;
         int fade_enter_song_ms;
         ma_uint64 fade_enter_frame;
@@ -9,14 +9,19 @@
 
 #include "playback.h"
 
+#include "common/path_max.h"
+
 #include "audiotypes.h"
+#include "utils/k_log.h"
 #include "utils/utils.h"
-#include <sys/stat.h>
+#include <pthread.h>
+#include <string.h>
 
 #ifdef USE_FAAD
 #include "m4a.h"
 #endif
 
+#include "seek_table.h"
 #include "sound/audio_file_info.h"
 #include "webm.h"
 
@@ -34,9 +39,46 @@ static _Atomic(void *) current_decoder = NULL;
 static void *decoders[MAX_DECODERS];
 static int decoder_index = -1;
 static atomic_int decoder_decoder_type = NONE;
+static atomic_int decoder_output_format = ma_format_f32;
+
+// The decoder that plays gaplessly after another one. It isn't linked with
+// ma_data_source_set_next(), which would read straight into it in the
+// previous track's layout.
+
+static void *chain_from = NULL;
+static void *chain_to = NULL;
+static pthread_mutex_t chain_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Format conversion data */
+
+// Tracks in one chain can differ in sample rate and channel count from the
+// device. Their output goes through a converter, one per decoder.
+
+#define MAX_CONVERTERS (MAX_DECODERS + 1)
+#define CONVERTER_SCRATCH_FRAMES 4096
+
+typedef struct {
+        void *decoder;
+        ma_uint32 in_channels;
+        ma_uint32 in_sample_rate;
+        ma_uint32 out_channels;
+        ma_uint32 out_sample_rate;
+        ma_data_converter converter;
+        void *scratch;
+} DecoderConverter;
+
+static DecoderConverter converters[MAX_CONVERTERS];
+static pthread_mutex_t converter_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /* Init decoder wrappers */
 
+// Remembers its file, so an MP3 seek table built after the decoder was
+// opened can still be bound when it seeks
+typedef struct {
+        ma_decoder decoder;
+        char file_path[KEW_PATH_MAX];
+} BuiltinDecoder;
+
 static ma_result init_ma_decoder_wrapper(
     const char *filepath,
     ma_decoding_backend_config *config,
@@ -49,13 +91,21 @@ static ma_result init_ma_decoder_wrapper(
                 0,
                 0);
 
-        decConfig.seekPointCount = 256;
+        // Seek tables come from the disk cache, building one reads the whole
+        // file. The loader builds it after the song is published.
+        decConfig.seekPointCount = 0;
+
+        BuiltinDecoder *builtin = decoder;
+        c_strcpy(builtin->file_path, filepath, sizeof(builtin->file_path));
 
         ma_result result =
             ma_decoder_init_file(
                 filepath,
                 &decConfig,
-                (ma_decoder *)decoder);
+                &builtin->decoder);
+
+        if (result == MA_SUCCESS && config->seekPointCount > 0)
+                seek_table_attach(&builtin->decoder, filepath, false);
 
         return (int)result;
 }
@@ -188,7 +238,13 @@ static ma_result ma_decoder_seek_to_pcm_frame_wrapper(
     void *pDecoder, long long int frame_index, ma_seek_origin origin)
 {
         (void)origin;
-        return ma_decoder_seek_to_pcm_frame((ma_decoder *)pDecoder, frame_index);
+
+        BuiltinDecoder *builtin = pDecoder;
+
+        // The table may have been built since the decoder was opened
+        seek_table_attach(&builtin->decoder, builtin->file_path, false);
+
+        return ma_decoder_seek_to_pcm_frame(&builtin->decoder, frame_index);
 }
 
 static ma_result ma_libvorbis_seek_to_pcm_frame_wrapper(
@@ -326,7 +382,7 @@ static const CodecEntry codec_ops_list[] = {
         .decoder_type         = BUILTIN,
         .supportsGapless  = true,
         .setup_decoder    = setup_ma_decoder,
-        .decoderSize      = sizeof(ma_decoder),
+        .decoderSize      = sizeof(BuiltinDecoder),
         .init             = (init_func)init_ma_decoder_wrapper,
         .uninit           = uninit_ma_decoder
     }},
@@ -459,6 +515,16 @@ enum decoder_type_t get_current_decoder_decoder_type(void)
         return atomic_load(&decoder_decoder_type);
 }
 
+void set_decoder_output_format(ma_format format)
+{
+        atomic_store(&decoder_output_format, format);
+}
+
+ma_format get_decoder_output_format(void)
+{
+        return (ma_format)atomic_load(&decoder_output_format);
+}
+
 int can_decoder_seek(void *decoder)
 {
 #ifdef USE_FAAD
@@ -490,6 +556,279 @@ void switch_decoder_index(void)
         atomic_store_explicit(&current_decoder, decoders[decoder_index], memory_order_release);
 }
 
+/* Decoder chain */
+
+static void set_chained_decoder(void *from, void *to)
+{
+        pthread_mutex_lock(&chain_mutex);
+
+        chain_from = from;
+        chain_to = to;
+
+        pthread_mutex_unlock(&chain_mutex);
+}
+
+// Returns the decoder chained after from, once
+static void *take_chained_decoder(void *from)
+{
+        void *next = NULL;
+
+        pthread_mutex_lock(&chain_mutex);
+
+        if (chain_from == from && from != NULL) {
+                next = chain_to;
+                chain_from = NULL;
+                chain_to = NULL;
+        }
+
+        pthread_mutex_unlock(&chain_mutex);
+
+        return next;
+}
+
+/* Format conversion */
+
+static bool get_decoder_layout(void *decoder, ma_uint32 *channels, ma_uint32 *sample_rate)
+{
+        const CodecOps *ops = get_codec_ops(get_current_decoder_decoder_type());
+
+        if (decoder == NULL || ops == NULL || ops->get_decoder_format == NULL)
+                return false;
+
+        ma_format format;
+        ma_channel channel_map[MA_MAX_CHANNELS];
+
+        if (ops->get_decoder_format(decoder, &format, channels, sample_rate, channel_map, MA_MAX_CHANNELS) != MA_SUCCESS)
+                return false;
+
+        return *channels > 0 && *sample_rate > 0;
+}
+
+static void free_converter(DecoderConverter *conv)
+{
+        if (conv->decoder == NULL)
+                return;
+
+        ma_data_converter_uninit(&conv->converter, NULL);
+        free(conv->scratch);
+        memset(conv, 0, sizeof(*conv));
+}
+
+static void release_converter(void *decoder)
+{
+        if (decoder == NULL)
+                return;
+
+        pthread_mutex_lock(&converter_mutex);
+
+        for (int i = 0; i < MAX_CONVERTERS; i++) {
+                if (converters[i].decoder == decoder)
+                        free_converter(&converters[i]);
+        }
+
+        pthread_mutex_unlock(&converter_mutex);
+}
+
+// Must be called with converter_mutex held
+static DecoderConverter *get_converter(void *decoder,
+                                       ma_uint32 in_channels, ma_uint32 in_sample_rate,
+                                       ma_uint32 out_channels, ma_uint32 out_sample_rate)
+{
+        DecoderConverter *free_slot = NULL;
+
+        for (int i = 0; i < MAX_CONVERTERS; i++) {
+                DecoderConverter *conv = &converters[i];
+
+                if (conv->decoder == decoder) {
+                        if (conv->in_channels == in_channels && conv->in_sample_rate == in_sample_rate &&
+                            conv->out_channels == out_channels && conv->out_sample_rate == out_sample_rate)
+                                return conv;
+
+                        free_converter(conv);
+                }
+
+                if (conv->decoder == NULL && free_slot == NULL)
+                        free_slot = conv;
+        }
+
+        if (free_slot == NULL)
+                return NULL;
+
+        ma_format format = get_decoder_output_format();
+
+        ma_data_converter_config config = ma_data_converter_config_init(
+            format, format,
+            in_channels, out_channels,
+            in_sample_rate, out_sample_rate);
+
+        config.resampling.algorithm = ma_resample_algorithm_linear;
+        config.channelMixMode = ma_channel_mix_mode_rectangular;
+
+        if (ma_data_converter_init(&config, NULL, &free_slot->converter) != MA_SUCCESS) {
+                k_log("Failed to create a format converter.\n");
+                return NULL;
+        }
+
+        free_slot->scratch = malloc((size_t)CONVERTER_SCRATCH_FRAMES * ma_get_bytes_per_frame(format, in_channels));
+        if (free_slot->scratch == NULL) {
+                ma_data_converter_uninit(&free_slot->converter, NULL);
+                return NULL;
+        }
+
+        free_slot->decoder = decoder;
+        free_slot->in_channels = in_channels;
+        free_slot->in_sample_rate = in_sample_rate;
+        free_slot->out_channels = out_channels;
+        free_slot->out_sample_rate = out_sample_rate;
+
+        return free_slot;
+}
+
+// Reads a single decoder, converted to the output layout
+static ma_result read_converted(void *decoder, void *frames_out, ma_uint64 frame_count,
+                                ma_uint32 out_channels, ma_uint32 out_sample_rate,
+                                ma_uint64 *frames_read)
+{
+        ma_uint32 in_channels = 0;
+        ma_uint32 in_sample_rate = 0;
+
+        *frames_read = 0;
+
+        if (!get_decoder_layout(decoder, &in_channels, &in_sample_rate) ||
+            (in_channels == out_channels && in_sample_rate == out_sample_rate))
+                return ma_data_source_read_pcm_frames(decoder, frames_out, frame_count, frames_read);
+
+        pthread_mutex_lock(&converter_mutex);
+
+        DecoderConverter *conv = get_converter(decoder, in_channels, in_sample_rate,
+                                               out_channels, out_sample_rate);
+
+        pthread_mutex_unlock(&converter_mutex);
+
+        if (conv == NULL)
+                return MA_OUT_OF_MEMORY;
+
+        // The slot is only freed along with its decoder, never while it is
+        // being read, so the reads below don't need the lock
+
+        ma_result result = MA_SUCCESS;
+        ma_uint64 total = 0;
+        ma_uint32 out_frame_size = ma_get_bytes_per_frame(get_decoder_output_format(), out_channels);
+
+        while (total < frame_count) {
+                ma_uint64 out_wanted = frame_count - total;
+                ma_uint64 in_wanted = 0;
+
+                ma_data_converter_get_required_input_frame_count(&conv->converter, out_wanted, &in_wanted);
+
+                if (in_wanted == 0)
+                        in_wanted = 1;
+                if (in_wanted > CONVERTER_SCRATCH_FRAMES)
+                        in_wanted = CONVERTER_SCRATCH_FRAMES;
+
+                ma_uint64 in_read = 0;
+                result = ma_data_source_read_pcm_frames(decoder, conv->scratch, in_wanted, &in_read);
+
+                ma_uint64 in_count = in_read;
+                ma_uint64 out_count = out_wanted;
+
+                ma_data_converter_process_pcm_frames(&conv->converter,
+                                                     conv->scratch, &in_count,
+                                                     (ma_uint8 *)frames_out + total * out_frame_size, &out_count);
+
+                total += out_count;
+
+                if (result != MA_SUCCESS || in_read < in_wanted || (in_count == 0 && out_count == 0))
+                        break;
+        }
+
+        *frames_read = total;
+
+        if (total > 0)
+                return MA_SUCCESS;
+
+        return (result == MA_SUCCESS) ? MA_AT_END : result;
+}
+
+ma_result decoder_read_pcm_frames(void *decoder, void *frames_out, ma_uint64 frame_count,
+                                  ma_uint32 out_channels, ma_uint32 out_sample_rate,
+                                  ma_uint64 *frames_read)
+{
+        ma_result result = MA_SUCCESS;
+        ma_uint64 total = 0;
+        ma_uint32 out_frame_size = ma_get_bytes_per_frame(get_decoder_output_format(), out_channels);
+
+        *frames_read = 0;
+
+        // Chained tracks can differ in layout, so the chain is followed here,
+        // one track and converter at a time
+        while (total < frame_count) {
+                void *running = ma_data_source_get_current(decoder);
+                ma_uint64 wanted = frame_count - total;
+                ma_uint64 read = 0;
+
+                result = read_converted(running,
+                                        (ma_uint8 *)frames_out + total * out_frame_size,
+                                        wanted, out_channels, out_sample_rate, &read);
+
+                total += read;
+
+                // Short reads happen mid-track too, only an empty one is the end
+                if (read > 0)
+                        continue;
+
+                if (result != MA_SUCCESS && result != MA_AT_END)
+                        break;
+
+                void *next = take_chained_decoder(running);
+
+                if (next == NULL)
+                        break;
+
+                ma_data_source_set_current(decoder, next);
+        }
+
+        *frames_read = total;
+
+        if (total > 0)
+                return MA_SUCCESS;
+
+        return (result == MA_SUCCESS) ? MA_AT_END : result;
+}
+
+void decoder_reset_converter(void *decoder)
+{
+        pthread_mutex_lock(&converter_mutex);
+
+        for (int i = 0; i < MAX_CONVERTERS; i++) {
+                if (converters[i].decoder == decoder && decoder != NULL)
+                        ma_data_converter_reset(&converters[i].converter);
+        }
+
+        pthread_mutex_unlock(&converter_mutex);
+}
+
+ma_uint64 decoder_frames_to_output(void *decoder, ma_uint64 frames, ma_uint32 out_sample_rate)
+{
+        ma_uint32 channels, sample_rate;
+
+        if (!get_decoder_layout(decoder, &channels, &sample_rate) || sample_rate == out_sample_rate)
+                return frames;
+
+        return (ma_uint64)((double)frames * out_sample_rate / sample_rate);
+}
+
+ma_uint64 decoder_frames_from_output(void *decoder, ma_uint64 frames, ma_uint32 out_sample_rate)
+{
+        ma_uint32 channels, sample_rate;
+
+        if (!get_decoder_layout(decoder, &channels, &sample_rate) || sample_rate == out_sample_rate ||
+            out_sample_rate == 0)
+                return frames;
+
+        return (ma_uint64)((double)frames * sample_rate / out_sample_rate);
+}
+
 /* Decoder uninit previous */
 
 void uninit_previous_decoder(void **decoder_array, int index, uninit_func uninit)
@@ -501,6 +840,7 @@ void uninit_previous_decoder(void **decoder_array, int index, uninit_func uninit
         void *to_uninit = decoder_array[1 - index];
 
         if (to_uninit != NULL) {
+                release_converter(to_uninit);
                 uninit(to_uninit);
                 free(to_uninit);
                 decoder_array[1 - index] = NULL;
@@ -522,12 +862,7 @@ bool is_decoder_native(const char *file_path)
 
 void clear_decoder_chain(void)
 {
-        void *current =
-            (decoder_index == -1)
-                ? first_decoder
-                : decoders[decoder_index];
-
-        ma_data_source_set_next(current, NULL);
+        set_chained_decoder(NULL, NULL);
 }
 
 /* Reset decoders */
@@ -547,6 +882,7 @@ void reset_decoders(void)
 
         if (first_decoder != NULL) {
                 if (ops) {
+                        release_converter(first_decoder);
                         ops->uninit(first_decoder);
                         free(first_decoder);
                         first_decoder = NULL;
@@ -556,6 +892,7 @@ void reset_decoders(void)
         for (int i = 0; i < MAX_DECODERS; i++) {
                 if (decoders[i] != NULL) {
                         if (ops) {
+                                release_converter(decoders[i]);
                                 ops->uninit(decoders[i]);
                                 free(decoders[i]);
                                 decoders[i] = NULL;
@@ -592,6 +929,7 @@ void set_next_decoder(void *decoder, const enum decoder_type_t new_decoder_type)
         {
                 if (decoders[0] != NULL) {
                         if (cur_ops) {
+                                release_converter(decoders[0]);
                                 cur_ops->uninit(decoders[0]);
                                 free(decoders[0]);
                                 decoders[0] = NULL;
@@ -603,6 +941,7 @@ void set_next_decoder(void *decoder, const enum decoder_type_t new_decoder_type)
                 int next_index = 1 - decoder_index;
                 if (decoders[next_index] != NULL) {
                         if (cur_ops) {
+                                release_converter(decoders[next_index]);
                                 cur_ops->uninit(decoders[next_index]);
                                 free(decoders[next_index]);
                                 decoders[next_index] = NULL;
@@ -631,52 +970,12 @@ int is_decoding_possible(const char *filepath, const CodecOps *ops)
         return 0;
 }
 
-long long get_file_size(const char *filename)
-{
-        struct stat st;
-        if (stat(filename, &st) == 0) {
-                return (long long)st.st_size;
-        } else {
-                return -1;
-        }
-}
-
-int calc_avg_bit_rate(double duration, const char *file_path)
-{
-        long long file_size = get_file_size(file_path); // in bytes
-        int avg_bit_rate = 0;
-
-        if (duration > 0.0)
-                avg_bit_rate = (int)((file_size * 8.0) / duration /
-                                     1000.0); // use 1000 for kbps
-
-        return avg_bit_rate;
-}
-
-static void set_avg_bit_rate(SongData *song_data, const char *file_path)
-{
-        if (path_ends_with(file_path, ".mp3") && song_data) {
-                int avg_bit_rate = calc_avg_bit_rate(song_data->duration, file_path);
-                if (avg_bit_rate > 320)
-                        avg_bit_rate = 320;
-                song_data->avg_bit_rate = avg_bit_rate;
-        }
-        else {
-                song_data->avg_bit_rate = calc_avg_bit_rate(song_data->duration, file_path);
-        }
-}
-
 /* Prepare next decoder */
 
-int prepare_next_decoder(const char *filepath, SongData *song, const CodecOps *ops)
+int prepare_next_decoder(const char *filepath, const CodecOps *ops)
 {
         void *current = get_current_decoder();
 
-        ma_format format = 0;
-        ma_uint32 channels = 0;
-        ma_uint32 sampleRate = 0;
-        ma_channel channel_map[MA_MAX_CHANNELS];
-
         enum decoder_type_t cur_implType = atomic_load(&decoder_decoder_type);
 
         bool same_impl_type = (cur_implType == ops->decoder_type);
@@ -684,41 +983,35 @@ int prepare_next_decoder(const char *filepath, SongData *song, const CodecOps *o
         if (current) {
                 const CodecOps *cur_ops = get_codec_ops(cur_implType);
                 if (cur_ops) {
-                        cur_ops->get_decoder_format(current, &format, &channels, &sampleRate, channel_map, MA_MAX_CHANNELS);
+                        // The previous next decoder may still be chained
+                        clear_decoder_chain();
                         uninit_previous_decoder(decoders, decoder_index, (uninit_func)cur_ops->uninit);
                 }
         }
 
         void *decoder = malloc(ops->decoderSize);
         ma_decoding_backend_config config = {0};
-        config.preferredFormat = ma_format_f32;
-        config.seekPointCount = 0;
+        config.preferredFormat = get_decoder_output_format();
+        config.seekPointCount = SEEK_TABLE_POINTS;
 
         if (ops->init(filepath, &config, decoder) != MA_SUCCESS) {
                 free(decoder);
                 return -1;
         }
 
-        ma_format nformat;
-        ma_uint32 nchannels;
-        ma_uint32 nsampleRate;
-        ma_channel nchannelMap[MA_MAX_CHANNELS];
-        ops->get_decoder_format(decoder, &nformat, &nchannels, &nsampleRate, nchannelMap, MA_MAX_CHANNELS);
-
-        bool sameFormat = (current == NULL || !ops->supportsGapless ||
-                           (ops->decoder_type == cur_implType &&
-                            format == nformat &&
-                            channels == nchannels &&
-                            sampleRate == nsampleRate));
+        // A different sample rate or channel count is converted in the decode
+        // thread, only a different decoder type needs a new device
+        bool sameType = (current == NULL || !ops->supportsGapless ||
+                         ops->decoder_type == cur_implType);
 
 #ifdef USE_FAAD
         if (ops->decoder_type == M4A && current) {
-                sameFormat = sameFormat && (((ma_m4a *)current)->file_type == ((ma_m4a *)decoder)->file_type &&
-                                            ((ma_m4a *)current)->file_type != k_rawAAC);
+                sameType = sameType && (((ma_m4a *)current)->file_type == ((ma_m4a *)decoder)->file_type &&
+                                        ((ma_m4a *)current)->file_type != k_rawAAC);
         }
 #endif
 
-        if (!sameFormat) {
+        if (!sameType) {
                 ops->uninit(decoder);
                 free(decoder);
                 return -2;
@@ -727,20 +1020,15 @@ int prepare_next_decoder(const char *filepath, SongData *song, const CodecOps *o
         if (ops->setup_decoder)
                 ops->setup_decoder(decoder, first_decoder);
 
-        if (ops->decoder_type == WEBM)
-        {
-                song->duration = ((ma_webm *)decoder)->duration;
-        }
-
-        set_avg_bit_rate(song, song->file_path);
-
         set_next_decoder(decoder, ops->decoder_type);
 
+        // Each chained track is converted on its own, so tracks with a
+        // different sample rate or channel count are chained too
         if (same_impl_type && current && decoder && !pb_is_EOF_reached())
 #ifdef USE_FAAD
                 if (ops->decoder_type != M4A || (current && ((ma_m4a *)current)->file_type != k_rawAAC))
 #endif
-                        ma_data_source_set_next(current, decoder);
+                        set_chained_decoder(current, decoder);
 
         return 0;
 }
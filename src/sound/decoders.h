@@ -226,6 +226,22 @@ int can_decoder_seek(void *decoder);
  */
 enum decoder_type_t get_current_decoder_decoder_type(void);
 
+/**
+ * @brief Sets the sample format new decoders are opened with.
+ *
+ * Float unless the device plays an integer source untouched.
+ *
+ * @param format The sample format.
+ */
+void set_decoder_output_format(ma_format format);
+
+/**
+ * @brief Gets the sample format decoders are opened with.
+ *
+ * @return The sample format.
+ */
+ma_format get_decoder_output_format(void);
+
 /**
  * @brief Resets the decoders in the system.
  *
@@ -262,7 +278,7 @@ void set_next_decoder(void *decoder, const enum decoder_type_t decoder_type);
  * @param filepath The file path to prepare.
  * @return 0 on success, -1 on failure.
  */
-int prepare_next_decoder(const char *filepath, SongData *song, const CodecOps *ops);
+int prepare_next_decoder(const char *filepath, const CodecOps *ops);
 
 /**
  * @brief Checks if a song can be decoded.
@@ -274,4 +290,50 @@ int is_decoding_possible(const char *filepath, const CodecOps *ops);
 
 void *get_other_decoder(void);
 
+/**
+ * @brief Reads frames from a decoder in the device's layout.
+ *
+ * Decoders whose sample rate or channel count differ from the device
+ * are resampled and remixed on the fly. When the decoder ends, reading
+ * continues with the decoder chained after it, converted on its own.
+ *
+ * @param decoder The decoder to read from.
+ * @param frames_out Output buffer, in the decoder output format.
+ * @param frame_count Number of output frames wanted.
+ * @param out_channels Channel count of the device.
+ * @param out_sample_rate Sample rate of the device.
+ * @param frames_read Receives the number of output frames produced.
+ * @return MA_SUCCESS if any frames were produced.
+ */
+ma_result decoder_read_pcm_frames(void *decoder, void *frames_out, ma_uint64 frame_count,
+                                  ma_uint32 out_channels, ma_uint32 out_sample_rate,
+                                  ma_uint64 *frames_read);
+
+/**
+ * @brief Clears the converter history of a decoder, call after seeking it.
+ *
+ * @param decoder The decoder.
+ */
+void decoder_reset_converter(void *decoder);
+
+/**
+ * @brief Converts a frame count of a decoder to device frames.
+ *
+ * @param decoder The decoder.
+ * @param frames Frames at the decoder's sample rate.
+ * @param out_sample_rate Sample rate of the device.
+ * @return Frames at the device's sample rate.
+ */
+ma_uint64 decoder_frames_to_output(void *decoder, ma_uint64 frames, ma_uint32 out_sample_rate);
+
+/**
+ * @brief Converts a frame count at the device's rate to decoder frames.
+ *
+ * @param decoder The decoder.
+ * @param frames Frames at the device's sample rate.
+ * @param out_sample_rate Sample rate of the device.
+ * @return Frames at the decoder's sample rate.
+ */
+ma_uint64 decoder_frames_from_output(void *decoder, ma_uint64 frames, ma_uint32 out_sample_rate);
+
 #endif
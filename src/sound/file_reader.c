@@ -0,0 +1,305 @@
+/**
+ * @file file_reader.c
+ * @brief Positional reads of a file through one reusable buffer.
+ *
+ * pread on POSIX systems and ReadFile with an explicit offset on Windows.
+ * The window is refilled from the read position whenever a request falls
+ * outside it, and reads larger than the window bypass it.
+ */
+
+#include "file_reader.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define FILE_READER_WINDOW (256 * 1024)
+#define FILE_READER_ALIGN 4096
+
+static unsigned char *window_alloc(size_t size)
+{
+#ifdef _WIN32
+        return _aligned_malloc(size, FILE_READER_ALIGN);
+#else
+        void *ptr = NULL;
+
+        if (posix_memalign(&ptr, FILE_READER_ALIGN, size) != 0)
+                return NULL;
+
+        return ptr;
+#endif
+}
+
+static void window_free(unsigned char *window)
+{
+#ifdef _WIN32
+        _aligned_free(window);
+#else
+        free(window);
+#endif
+}
+
+#ifdef _WIN32
+static HANDLE open_file_utf8(const char *path)
+{
+        int size = MultiByteToWideChar(CP_UTF8, 0, path, -1, NULL, 0);
+        if (size <= 0)
+                return INVALID_HANDLE_VALUE;
+
+        wchar_t *wpath = malloc(size * sizeof(wchar_t));
+        if (!wpath)
+                return INVALID_HANDLE_VALUE;
+
+        HANDLE file = INVALID_HANDLE_VALUE;
+
+        if (MultiByteToWideChar(CP_UTF8, 0, path, -1, wpath, size) > 0)
+                file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                                   OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+        free(wpath);
+
+        return file;
+}
+
+static int open_handle(FileReader *fr, const char *path)
+{
+        HANDLE file = open_file_utf8(path);
+        if (file == INVALID_HANDLE_VALUE)
+                return -1;
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size)) {
+                CloseHandle(file);
+                return -1;
+        }
+
+        fr->handle = file;
+        fr->size = size.QuadPart;
+
+        return 0;
+}
+
+static void close_handle(FileReader *fr)
+{
+        CloseHandle(fr->handle);
+}
+
+static int64_t read_at(FileReader *fr, unsigned char *buf, size_t len, int64_t offset)
+{
+        size_t done = 0;
+
+        while (done < len) {
+                OVERLAPPED ov;
+                memset(&ov, 0, sizeof(ov));
+                ov.Offset = (DWORD)((uint64_t)(offset + done) & 0xFFFFFFFF);
+                ov.OffsetHigh = (DWORD)((uint64_t)(offset + done) >> 32);
+
+                size_t chunk = len - done;
+                if (chunk > 0x40000000)
+                        chunk = 0x40000000;
+
+                DWORD got = 0;
+                if (!ReadFile(fr->handle, buf + done, (DWORD)chunk, &got, &ov) || got == 0)
+                        break; // End of file, or the file shrank
+
+                done += got;
+        }
+
+        return (int64_t)done;
+}
+#else
+static int open_handle(FileReader *fr, const char *path)
+{
+        int fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return -1;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+                close(fd);
+                return -1;
+        }
+
+#ifdef POSIX_FADV_SEQUENTIAL
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+
+        fr->fd = fd;
+        fr->size = (int64_t)st.st_size;
+
+        return 0;
+}
+
+static void close_handle(FileReader *fr)
+{
+        close(fr->fd);
+}
+
+static int64_t read_at(FileReader *fr, unsigned char *buf, size_t len, int64_t offset)
+{
+        size_t done = 0;
+
+        while (done < len) {
+                ssize_t n = pread(fr->fd, buf + done, len - done, (off_t)(offset + done));
+
+                if (n < 0 && errno == EINTR)
+                        continue;
+
+                if (n <= 0)
+                        break; // End of file, or the file shrank
+
+                done += (size_t)n;
+        }
+
+        return (int64_t)done;
+}
+#endif
+
+int file_reader_open(FileReader *fr, const char *path)
+{
+        memset(fr, 0, sizeof(*fr));
+
+        if (open_handle(fr, path) != 0)
+                return -1;
+
+        fr->window = window_alloc(FILE_READER_WINDOW);
+
+        if (fr->window == NULL) {
+                close_handle(fr);
+                memset(fr, 0, sizeof(*fr));
+                return -1;
+        }
+
+        fr->capacity = FILE_READER_WINDOW;
+
+        return 0;
+}
+
+void file_reader_close(FileReader *fr)
+{
+        if (fr == NULL || fr->window == NULL)
+                return;
+
+        close_handle(fr);
+        window_free(fr->window);
+
+        memset(fr, 0, sizeof(*fr));
+}
+
+static int refill(FileReader *fr, size_t min_len)
+{
+        if (min_len > fr->capacity) {
+                // Only a frame bigger than the whole window gets here
+                unsigned char *bigger = window_alloc(min_len);
+                if (bigger == NULL)
+                        return -1;
+
+                window_free(fr->window);
+                fr->window = bigger;
+                fr->capacity = min_len;
+        }
+
+        int64_t got = read_at(fr, fr->window, fr->capacity, fr->pos);
+
+        fr->window_start = fr->pos;
+        fr->window_len = (size_t)got;
+
+        return 0;
+}
+
+static size_t buffered_at_pos(const FileReader *fr)
+{
+        if (fr->pos < fr->window_start || fr->pos >= fr->window_start + (int64_t)fr->window_len)
+                return 0;
+
+        return (size_t)(fr->window_start + (int64_t)fr->window_len - fr->pos);
+}
+
+const unsigned char *file_reader_peek(FileReader *fr, size_t len)
+{
+        if (fr->window == NULL)
+                return NULL;
+
+        if (buffered_at_pos(fr) < len) {
+                if (refill(fr, len) != 0 || fr->window_len < len)
+                        return NULL;
+        }
+
+        return fr->window + (fr->pos - fr->window_start);
+}
+
+size_t file_reader_read(FileReader *fr, void *buf, size_t len)
+{
+        unsigned char *out = buf;
+        size_t done = 0;
+
+        if (fr->window == NULL)
+                return 0;
+
+        while (done < len) {
+                size_t avail = buffered_at_pos(fr);
+
+                if (avail > 0) {
+                        size_t n = (len - done < avail) ? len - done : avail;
+                        memcpy(out + done, fr->window + (fr->pos - fr->window_start), n);
+                        fr->pos += n;
+                        done += n;
+                        continue;
+                }
+
+                if (len - done >= fr->capacity) {
+                        int64_t got = read_at(fr, out + done, len - done, fr->pos);
+                        fr->pos += got;
+                        done += (size_t)got;
+                        break;
+                }
+
+                if (refill(fr, 0) != 0 || fr->window_len == 0)
+                        break;
+        }
+
+        return done;
+}
+
+int file_reader_seek(FileReader *fr, int64_t offset, int whence)
+{
+        int64_t base;
+
+        switch (whence) {
+        case SEEK_SET:
+                base = 0;
+                break;
+        case SEEK_CUR:
+                base = fr->pos;
+                break;
+        case SEEK_END:
+                base = fr->size;
+                break;
+        default:
+                return -1;
+        }
+
+        int64_t pos = base + offset;
+
+        if (pos < 0 || pos > fr->size)
+                return -1;
+
+        fr->pos = pos;
+
+        return 0;
+}
+
+int64_t file_reader_tell(const FileReader *fr)
+{
+        return fr->pos;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file file_reader.h
+ * @brief Positional reads of a file through one reusable buffer.
+ *
+ * Used by the container readers that parse compressed frames straight
+ * out of the file. Bytes are read with pread into a page-aligned window
+ * that is allocated once per file, so frames can be handed to the codec
+ * without a copy or an allocation per frame. A file that shrinks while it
+ * is open just reads short, unlike a memory mapping which would fault.
+ */
+
+#ifndef FILE_READER_H
+#define FILE_READER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+        unsigned char *window; // NULL when closed
+        size_t capacity;
+        int64_t window_start; // File offset of window[0]
+        size_t window_len;    // Valid bytes in the window
+        int64_t size;         // File size when opened
+        int64_t pos;
+#ifdef _WIN32
+        void *handle;
+#else
+        int fd;
+#endif
+} FileReader;
+
+/**
+ * @brief Opens a file for reading.
+ *
+ * @param fr The reader to initialize.
+ * @param path Path to the file, UTF-8.
+ * @return 0 on success, -1 on failure.
+ */
+int file_reader_open(FileReader *fr, const char *path);
+
+/**
+ * @brief Closes the file. Safe to call on a zeroed or closed reader.
+ *
+ * @param fr The reader.
+ */
+void file_reader_close(FileReader *fr);
+
+/**
+ * @brief Gets a pointer to bytes at the read position without consuming them.
+ *
+ * The pointer is valid until the next call on the reader.
+ *
+ * @param fr The reader.
+ * @param len Number of bytes needed.
+ * @return Pointer into the window, or NULL if fewer than len bytes can be read.
+ */
+const unsigned char *file_reader_peek(FileReader *fr, size_t len);
+
+/**
+ * @brief Copies bytes from the read position and advances it.
+ *
+ * @param fr The reader.
+ * @param buf Destination.
+ * @param len Number of bytes wanted.
+ * @return Number of bytes copied, less than len at the end of the file.
+ */
+size_t file_reader_read(FileReader *fr, void *buf, size_t len);
+
+/**
+ * @brief Moves the read position.
+ *
+ * @param fr The reader.
+ * @param offset Offset relative to whence.
+ * @param whence SEEK_SET, SEEK_CUR or SEEK_END.
+ * @return 0 on success, -1 if the position would be outside the file.
+ */
+int file_reader_seek(FileReader *fr, int64_t offset, int whence);
+
+/**
+ * @brief Gets the read position.
+ *
+ * @param fr The reader.
+ * @return The offset from the start of the file.
+ */
+int64_t file_reader_tell(const FileReader *fr);
+
+#endif
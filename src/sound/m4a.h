@@ -15,6 +15,7 @@ extern "C" {
 #ifdef USE_FAAD
 
 #include "audiotypes.h"
+#include "file_reader.h"
 
 #include "../include/libmp4/include/libmp4.h"
 #include "neaacdec.h"
@@ -74,8 +75,9 @@ typedef struct m4a_decoder {
 
         ma_uint64 leftoverSampleCount;
 
-        // For m4a_decoder_init_file
-        FILE *file;
+        // Raw AAC frames are decoded straight from the reader's window,
+        // MP4 samples are read by libmp4 from its own descriptor
+        FileReader reader;
 
         ma_uint64 cursor;
 } m4a_decoder;
@@ -304,16 +306,6 @@ ma_data_source_vtable g_m4a_decoder_ds_vtable =
         NULL,
         (ma_uint64)0};
 
-static ma_result file_on_seek(void *pUserData, ma_int64 offset, ma_seek_origin origin)
-{
-        FILE *fp = (FILE *)pUserData;
-        int whence = (origin == ma_seek_origin_start) ? SEEK_SET : SEEK_CUR;
-        if (fseeko(fp, offset, whence) != 0) {
-                return MA_ERROR;
-        }
-        return MA_SUCCESS;
-}
-
 static ma_result m4a_decoder_init_internal(const ma_decoding_backend_config *p_config, m4a_decoder *pM4a)
 {
         if (pM4a == NULL) {
@@ -463,26 +455,22 @@ MA_API ma_result m4a_decoder_init(
         return MA_SUCCESS;
 }
 
-double calculate_aac_duration(FILE *fp, unsigned long sample_rate, unsigned long *totalFrames)
+double calculate_aac_duration(FileReader *fr, unsigned long sample_rate, unsigned long *totalFrames)
 {
-        if (fp == NULL || sample_rate == 0 || totalFrames == NULL) {
+        if (fr == NULL || sample_rate == 0 || totalFrames == NULL) {
                 return -1.0;
         }
 
         unsigned char buffer[7];
-        unsigned long file_size = 0;
         *totalFrames = 0;
 
-        // Get file size
-        fseek(fp, 0, SEEK_END);
-        file_size = ftell(fp);
-        fseek(fp, 0, SEEK_SET);
+        file_reader_seek(fr, 0, SEEK_SET);
 
         // Loop to count frames
-        while (ftell(fp) < (long)(file_size - 7)) // Ensure at least an ADTS header remains
+        while (file_reader_tell(fr) < fr->size - 7) // Ensure at least an ADTS header remains
         {
                 // Read header
-                if (fread(buffer, 1, 7, fp) < 7)
+                if (file_reader_read(fr, buffer, 7) < 7)
                         break;
 
                 // Extract frame size
@@ -492,7 +480,8 @@ double calculate_aac_duration(FILE *fp, unsigned long sample_rate, unsigned long
                         break;
 
                 // Skip to next frame
-                fseek(fp, frameSize - 7, SEEK_CUR);
+                if (file_reader_seek(fr, frameSize - 7, SEEK_CUR) != 0)
+                        break;
 
                 (*totalFrames)++;
         }
@@ -500,25 +489,25 @@ double calculate_aac_duration(FILE *fp, unsigned long sample_rate, unsigned long
         // Compute duration using: duration = (totalFrames * 1024) / sample_rate
         double duration = (double)(*totalFrames * 1024) / sample_rate;
 
-        fseek(fp, 0, SEEK_SET);
+        file_reader_seek(fr, 0, SEEK_SET);
 
         return duration;
 }
 
-uint32_t read_u32be(FILE *fp)
+uint32_t read_u32be(FileReader *fr)
 {
         unsigned char b[4];
-        if (fread(b, 1, 4, fp) != 4)
+        if (file_reader_read(fr, b, 4) != 4)
                 return 0;
         return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | ((uint32_t)b[3]);
 }
 
-int find_atom(FILE *fp, uint32_t atom_name, long max_search_length, uint32_t *atom_size_out)
+int find_atom(FileReader *fr, uint32_t atom_name, long max_search_length, uint32_t *atom_size_out)
 {
-        long start_pos = ftell(fp);
-        while ((ftell(fp) - start_pos) < max_search_length) {
+        int64_t start_pos = file_reader_tell(fr);
+        while ((file_reader_tell(fr) - start_pos) < max_search_length) {
                 unsigned char header[8];
-                if (fread(header, 1, 8, fp) != 8)
+                if (file_reader_read(fr, header, 8) != 8)
                         return 0;
 
                 uint32_t atom_size = (header[0] << 24) | (header[1] << 16) | (header[2] << 8) | header[3];
@@ -534,51 +523,51 @@ int find_atom(FILE *fp, uint32_t atom_name, long max_search_length, uint32_t *at
                         return 1; // Found
                 }
 
-                if (fseek(fp, atom_size - 8, SEEK_CUR) != 0)
+                if (file_reader_seek(fr, atom_size - 8, SEEK_CUR) != 0)
                         return 0;
         }
         return 0; // Not found
 }
 
-int is_alac(FILE *fp, uint8_t *dsi_out, size_t *dsi_size_out)
+int is_alac(FileReader *fr, uint8_t *dsi_out, size_t *dsi_size_out)
 {
-        fseek(fp, 0, SEEK_SET);
+        file_reader_seek(fr, 0, SEEK_SET);
         uint32_t atom_size;
 
-        if (!find_atom(fp, FOUR_CHAR_INT('m', 'o', 'o', 'v'), 0x7FFFFFFF, &atom_size))
+        if (!find_atom(fr, FOUR_CHAR_INT('m', 'o', 'o', 'v'), 0x7FFFFFFF, &atom_size))
                 return 0;
-        if (!find_atom(fp, FOUR_CHAR_INT('t', 'r', 'a', 'k'), atom_size, &atom_size))
+        if (!find_atom(fr, FOUR_CHAR_INT('t', 'r', 'a', 'k'), atom_size, &atom_size))
                 return 0;
-        if (!find_atom(fp, FOUR_CHAR_INT('m', 'd', 'i', 'a'), atom_size, &atom_size))
+        if (!find_atom(fr, FOUR_CHAR_INT('m', 'd', 'i', 'a'), atom_size, &atom_size))
                 return 0;
-        if (!find_atom(fp, FOUR_CHAR_INT('m', 'i', 'n', 'f'), atom_size, &atom_size))
+        if (!find_atom(fr, FOUR_CHAR_INT('m', 'i', 'n', 'f'), atom_size, &atom_size))
                 return 0;
-        if (!find_atom(fp, FOUR_CHAR_INT('s', 't', 'b', 'l'), atom_size, &atom_size))
+        if (!find_atom(fr, FOUR_CHAR_INT('s', 't', 'b', 'l'), atom_size, &atom_size))
                 return 0;
-        if (!find_atom(fp, FOUR_CHAR_INT('s', 't', 's', 'd'), atom_size, &atom_size))
+        if (!find_atom(fr, FOUR_CHAR_INT('s', 't', 's', 'd'), atom_size, &atom_size))
                 return 0;
 
-        fseek(fp, 8, SEEK_CUR); // Skip stsd header (version+entry)
+        file_reader_seek(fr, 8, SEEK_CUR); // Skip stsd header (version+entry)
 
-        read_u32be(fp); // uint32_t sample_entry_size
-        uint32_t sample_entry_fourcc = read_u32be(fp);
+        read_u32be(fr); // uint32_t sample_entry_size
+        uint32_t sample_entry_fourcc = read_u32be(fr);
         if (sample_entry_fourcc != FOUR_CHAR_INT('a', 'l', 'a', 'c'))
                 return 0;
 
-        fseek(fp, 28, SEEK_CUR); // Skip audio sample entry fields
+        file_reader_seek(fr, 28, SEEK_CUR); // Skip audio sample entry fields
 
-        uint32_t config_atom_size = read_u32be(fp);
-        uint32_t config_atom_fourcc = read_u32be(fp);
+        uint32_t config_atom_size = read_u32be(fr);
+        uint32_t config_atom_fourcc = read_u32be(fr);
         if (config_atom_fourcc != FOUR_CHAR_INT('a', 'l', 'a', 'c'))
                 return 0;
 
-        fseek(fp, 4, SEEK_CUR); // Skip 1-byte version and 3-byte flags (4 bytes total)!
+        file_reader_seek(fr, 4, SEEK_CUR); // Skip 1-byte version and 3-byte flags (4 bytes total)!
 
         uint32_t alac_dsi_size = config_atom_size - 12; // size(4)+fourcc(4)+version/flags(4) total=12 bytes overhead
         if (alac_dsi_size < 24 || alac_dsi_size > 64)
                 return 0; // Sanity check
 
-        if (fread(dsi_out, 1, alac_dsi_size, fp) != alac_dsi_size)
+        if (file_reader_read(fr, dsi_out, alac_dsi_size) != alac_dsi_size)
                 return 0;
         *dsi_size_out = alac_dsi_size;
 
@@ -602,34 +591,15 @@ MA_API ma_result m4a_decoder_init_file(
                 return result;
         }
 
-        FILE *fp = fopen(pFilePath, "rb");
-        if (fp == NULL) {
+        if (file_reader_open(&pM4a->reader, pFilePath) != 0) {
                 return MA_INVALID_FILE;
         }
 
-        // Get the file size
-        if (fseeko(fp, 0, SEEK_END) != 0) {
-                fclose(fp);
-                return MA_ERROR;
-        }
-
-        pM4a->file_size = ftello(fp);
-        if (pM4a->file_size < 0) {
-                fclose(fp);
-                return MA_ERROR;
-        }
-
-        if (fseeko(fp, 0, SEEK_SET) != 0) {
-                fclose(fp);
-                return MA_ERROR;
-        }
-
-        // Store the FILE pointer in the decoder struct
-        pM4a->file = fp;
+        pM4a->file_size = pM4a->reader.size;
 
         // Try to detect the file format (ADTS, MP4, LATM, etc.)
         unsigned char buffer[7];
-        size_t bytes_read = fread(buffer, 1, sizeof(buffer), fp);
+        size_t bytes_read = file_reader_read(&pM4a->reader, buffer, sizeof(buffer));
 
         // Check for ADTS header
         if (bytes_read >= 7 && buffer[0] == 0xFF && (buffer[1] & 0xF0) == 0xF0) {
@@ -637,7 +607,7 @@ MA_API ma_result m4a_decoder_init_file(
         } else {
                 // Check if it's an MP4 file (using MP4D_open or similar)
                 if (mp4_demux_open(pFilePath, &pM4a->mp4) < 0) {
-                        fclose(fp);
+                        file_reader_close(&pM4a->reader);
                         k_log("Error initializing decoder.\n");
                         set_error_message("Error initializing decoder (possibly a fragmented mp4 file) in the current or next file.");
                         return MA_ERROR;
@@ -655,13 +625,13 @@ MA_API ma_result m4a_decoder_init_file(
                 unsigned int frameSize = ((buffer[3] & 0x03) << 11) | ((buffer[4] & 0xFF) << 3) | ((buffer[5] & 0xE0) >> 5);
 
                 if (frameSize <= 7) {
-                        fclose(fp);
+                        file_reader_close(&pM4a->reader);
                         return MA_ERROR; // Invalid frame size
                 }
 
                 unsigned char *frameData = malloc(frameSize);
                 if (frameData == NULL) {
-                        fclose(fp);
+                        file_reader_close(&pM4a->reader);
                         return MA_ERROR; // Memory allocation failed
                 }
 
@@ -670,10 +640,10 @@ MA_API ma_result m4a_decoder_init_file(
 
                 // Read the rest of the frame (audio data)
                 size_t remainingBytes = frameSize - 7;
-                size_t additionalBytesRead = fread(frameData + 7, 1, remainingBytes, fp);
+                size_t additionalBytesRead = file_reader_read(&pM4a->reader, frameData + 7, remainingBytes);
                 if (additionalBytesRead < remainingBytes) {
                         free(frameData);
-                        fclose(fp);
+                        file_reader_close(&pM4a->reader);
                         return MA_ERROR; // Failed to read the full frame
                 }
 
@@ -697,7 +667,7 @@ MA_API ma_result m4a_decoder_init_file(
                         set_error_message("The current or next file is encoded with HE-AAC which is not supported.");
                         free(frameData);
                         free(decoder_config);
-                        fclose(fp);
+                        file_reader_close(&pM4a->reader);
                         return MA_ERROR;
                 }
 
@@ -713,7 +683,7 @@ MA_API ma_result m4a_decoder_init_file(
                         free(frameData);
                         free(decoder_config);
                         NeAACDecClose(pM4a->hDecoder);
-                        fclose(fp);
+                        file_reader_close(&pM4a->reader);
                         return MA_ERROR;
                 }
 
@@ -725,7 +695,7 @@ MA_API ma_result m4a_decoder_init_file(
                         set_error_message("The current or next file contains an invalid sample rate or channel count.");
                         free(frameData);
                         NeAACDecClose(pM4a->hDecoder);
-                        fclose(fp);
+                        file_reader_close(&pM4a->reader);
                         return MA_ERROR;
                 }
 
@@ -748,7 +718,7 @@ MA_API ma_result m4a_decoder_init_file(
                 } else {
                         // Unsupported format
                         NeAACDecClose(pM4a->hDecoder);
-                        fclose(fp);
+                        file_reader_close(&pM4a->reader);
                         return MA_ERROR;
                 }
                 NeAACDecSetConfiguration(pM4a->hDecoder, config_ptr);
@@ -757,7 +727,8 @@ MA_API ma_result m4a_decoder_init_file(
                 pM4a->leftoverSampleCount = 0;
                 pM4a->cursor = 0;
 
-                fseek(pM4a->file, 0, SEEK_SET);
+                // Decoding starts over from the first frame
+                file_reader_seek(&pM4a->reader, 0, SEEK_SET);
 
                 return MA_SUCCESS;
         } else {
@@ -791,7 +762,7 @@ MA_API ma_result m4a_decoder_init_file(
                 if (pM4a->audio_track_index == -1) {
                         // No audio track found
                         mp4_demux_close(pM4a->mp4);
-                        fclose(fp);
+                        file_reader_close(&pM4a->reader);
                         return MA_ERROR;
                 }
 
@@ -810,9 +781,12 @@ MA_API ma_result m4a_decoder_init_file(
                 uint8_t alac_dsi[32];
                 size_t alac_dsi_size;
 
-                long original_position = ftell(pM4a->file);
+                int alac = is_alac(&pM4a->reader, alac_dsi, &alac_dsi_size);
 
-                if (is_alac(fp, alac_dsi, &alac_dsi_size)) {
+                // libmp4 reads the samples from here on
+                file_reader_close(&pM4a->reader);
+
+                if (alac) {
                         // This is an alac file and is currently unsupported.
                         k_log("M4a files that use the ALAC encoder are not supported.");
                         set_error_message("The current or next file uses the ALAC encoder which is not supported.");
@@ -821,8 +795,6 @@ MA_API ma_result m4a_decoder_init_file(
                 {
                         pM4a->file_type = k_aac;
 
-                        fseek(pM4a->file, original_position, SEEK_SET);
-
                         // Initialize faad2 decoder
                         pM4a->hDecoder = NeAACDecOpen();
 
@@ -857,7 +829,7 @@ MA_API ma_result m4a_decoder_init_file(
                                 // Error initializing decoder
                                 NeAACDecClose(pM4a->hDecoder);
                                 mp4_demux_close(pM4a->mp4);
-                                fclose(fp);
+                                file_reader_close(&pM4a->reader);
                                 return MA_ERROR;
                         }
 
@@ -878,7 +850,7 @@ MA_API ma_result m4a_decoder_init_file(
                                 // Unsupported format
                                 NeAACDecClose(pM4a->hDecoder);
                                 mp4_demux_close(pM4a->mp4);
-                                fclose(fp);
+                                file_reader_close(&pM4a->reader);
                                 return MA_ERROR;
                         }
                         NeAACDecSetConfiguration(pM4a->hDecoder, config_ptr);
@@ -886,7 +858,6 @@ MA_API ma_result m4a_decoder_init_file(
                         // Initialize other fields
                         pM4a->leftoverSampleCount = 0;
                         pM4a->cursor = 0;
-                        fseek(pM4a->file, 0, SEEK_SET);
 
                         return MA_SUCCESS;
                 }
@@ -916,10 +887,7 @@ MA_API void m4a_decoder_uninit(m4a_decoder *pM4a, const ma_allocation_callbacks
                 pM4a->buffer_size = 0;
         }
 
-        if (pM4a->file) {
-                fclose(pM4a->file);
-                pM4a->file = NULL;
-        }
+        file_reader_close(&pM4a->reader);
 }
 
 MA_API ma_result m4a_decoder_read_pcm_frames(
@@ -956,9 +924,9 @@ MA_API ma_result m4a_decoder_read_pcm_frames(
         while (totalFramesProcessed < frame_count) {
                 if (pM4a->file_type == k_rawAAC) {
                         unsigned int headerSize = 7;
-                        uint8_t buffer[headerSize];
+                        const uint8_t *buffer = file_reader_peek(&pM4a->reader, headerSize);
 
-                        if (fread(buffer, 1, headerSize, pM4a->file) != headerSize) {
+                        if (buffer == NULL) {
                                 result = MA_ERROR;
                                 break;
                         }
@@ -970,31 +938,20 @@ MA_API ma_result m4a_decoder_read_pcm_frames(
                                 break;
                         }
 
-                        // Allocate memory for the frame
-                        unsigned char *sample_data = (unsigned char *)malloc(frame_bytes);
-                        if (!sample_data) {
-                                result = MA_OUT_OF_MEMORY;
-                                break;
-                        }
+                        // The whole frame, header included, straight from the file
+                        const unsigned char *sample_data = file_reader_peek(&pM4a->reader, frame_bytes);
 
-                        // Copy the header to the sample_data buffer
-                        memcpy(sample_data, buffer, headerSize);
-
-                        // Read the rest of the frame (audio data)
-                        size_t remaining_bytes = frame_bytes - headerSize;
-                        size_t additionalBytesRead = fread(sample_data + headerSize, 1, remaining_bytes, pM4a->file);
-
-                        if (additionalBytesRead < remaining_bytes) {
-                                free(sample_data);
+                        if (sample_data == NULL) {
                                 result = MA_ERROR;
-                                break; // Failed to read full frame
+                                break; // Truncated frame
                         }
 
+                        file_reader_seek(&pM4a->reader, frame_bytes, SEEK_CUR);
+
                         pM4a->current_sample++;
 
-                        // Decode the AAC frame using faad2
-                        void *decodedData = NeAACDecDecode(pM4a->hDecoder, &(pM4a->frameInfo), sample_data + 7, frame_bytes - 7);
-                        free(sample_data);
+                        // Decode the AAC frame using faad2, it doesn't write to the input
+                        void *decodedData = NeAACDecDecode(pM4a->hDecoder, &(pM4a->frameInfo), (unsigned char *)sample_data + 7, frame_bytes - 7);
 
                         if (pM4a->frameInfo.error > 0) {
                                 // Error in decoding, skip to the next frame.
@@ -1168,10 +1125,6 @@ MA_API ma_result m4a_decoder_seek_to_pcm_frame(m4a_decoder *pM4a, ma_uint64 fram
                         return MA_ERROR;
                 }
 
-                if (file_on_seek(pM4a->file, sample_offset, ma_seek_origin_start) != MA_SUCCESS) {
-                        return MA_ERROR;
-                }
-
                 pM4a->leftoverSampleCount = 0;
 
                 uint64_t actual_pcm_frame =
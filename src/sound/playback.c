@@ -81,6 +81,10 @@ bool request_crossfade(int fade_ms, int enter_song_ms)
         if (!sound_s->fade_allowed)
                 return false;
 
+        // Passthrough output is never mixed
+        if (sound_s->format != ma_format_f32)
+                return false;
+
         if (sound_s->fade_requested || atomic_load(&sound_s->request_switch_metadata) || atomic_load(&sound_s->request_switch_decoder))
                 return true; // Don't say it's disallowed, just don't perform the crossfade
 
@@ -112,6 +116,7 @@ void seek_percentage(float percent)
         if (percent >= 0.0f) {
                 seek_percent = percent;
                 set_seek_requested(true);
+                sound_wake_decoder();
         }
 }
 
@@ -193,6 +198,8 @@ sound_result_t sound_resume_playback(void)
 
         sound_s->state = SOUND_STATE_PLAYING;
 
+        sound_wake_decoder();
+
         return result;
 }
 
@@ -208,6 +215,8 @@ void request_pause_playback(void)
         sound_s->volume = vol; // this value is used when unpausing.
 
         sound_s->state = SOUND_STATE_PAUSED;
+
+        sound_wake_decoder();
 }
 
 void pause_playback(void)
@@ -378,6 +387,9 @@ bool is_skip_to_next(void)
 void set_skip_to_next(bool value)
 {
         atomic_store(&skip_to_next, value);
+
+        if (value)
+                sound_wake_decoder();
 }
 
 void clear_current_track(void)
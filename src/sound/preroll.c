@@ -0,0 +1,227 @@
+/**
+ * @file preroll.c
+ * @brief Decoded lead-in audio for tracks that are likely to play next.
+ *
+ * Small fixed set of slots keyed by path, filled on the loader thread
+ * and read when a decoder chain is created.
+ */
+
+#include "preroll.h"
+
+#include "common/path_max.h"
+
+#include "utils/utils.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PREROLL_MS 300
+
+// Next, current and previous track
+#define PREROLL_SLOTS 3
+
+typedef struct {
+        char file_path[KEW_PATH_MAX];
+        float *frames;
+        ma_uint64 frame_count;
+        ma_uint32 channels;
+        ma_uint32 sample_rate;
+        ma_format native_format;
+        unsigned long stamp;
+} PrerollSlot;
+
+static PrerollSlot slots[PREROLL_SLOTS];
+static unsigned long stamp_counter = 0;
+static pthread_mutex_t preroll_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static PrerollSlot *find_slot(const char *file_path)
+{
+        for (int i = 0; i < PREROLL_SLOTS; i++) {
+                if (slots[i].frames != NULL && strcmp(slots[i].file_path, file_path) == 0)
+                        return &slots[i];
+        }
+
+        return NULL;
+}
+
+static bool is_kept(const char *file_path)
+{
+        pthread_mutex_lock(&preroll_mutex);
+        bool kept = find_slot(file_path) != NULL;
+        pthread_mutex_unlock(&preroll_mutex);
+
+        return kept;
+}
+
+static float *decode_lead_in(const char *file_path, const CodecOps *ops,
+                             ma_uint64 *frame_count, ma_uint32 *channels,
+                             ma_uint32 *sample_rate)
+{
+        void *decoder = malloc(ops->decoderSize);
+        if (decoder == NULL)
+                return NULL;
+
+        ma_decoding_backend_config config = {0};
+        config.preferredFormat = ma_format_f32;
+        config.seekPointCount = 0;
+
+        if (ops->init(file_path, &config, decoder) != MA_SUCCESS) {
+                free(decoder);
+                return NULL;
+        }
+
+        if (ops->setup_decoder)
+                ops->setup_decoder(decoder, NULL);
+
+        ma_format format;
+        ma_channel channel_map[MA_MAX_CHANNELS];
+        *channels = 0;
+        *sample_rate = 0;
+        ops->get_decoder_format(decoder, &format, channels, sample_rate, channel_map, MA_MAX_CHANNELS);
+
+        float *frames = NULL;
+        *frame_count = 0;
+
+        if (*channels > 0 && *sample_rate > 0) {
+                ma_uint64 wanted = ((ma_uint64)*sample_rate * PREROLL_MS) / 1000;
+
+                frames = malloc(wanted * *channels * sizeof(float));
+
+                if (frames != NULL) {
+                        ma_data_source_read_pcm_frames(decoder, frames, wanted, frame_count);
+
+                        if (*frame_count == 0) {
+                                free(frames);
+                                frames = NULL;
+                        }
+                }
+        }
+
+        ops->uninit(decoder);
+        free(decoder);
+
+        return frames;
+}
+
+void preroll_prepare(const char *file_path, const CodecOps *ops)
+{
+        if (file_path == NULL || ops == NULL || ops->init == NULL)
+                return;
+
+        // Resuming mid-track after the lead-in needs an exact seek
+        if (!ops->supportsGapless || ops->decoder_type == M4A)
+                return;
+
+        if (is_kept(file_path))
+                return;
+
+        ma_uint64 frame_count;
+        ma_uint32 channels, sample_rate;
+        float *frames = decode_lead_in(file_path, ops, &frame_count, &channels, &sample_rate);
+
+        if (frames == NULL)
+                return;
+
+        // Kept so the output format can be chosen without opening the file again
+        ma_format native_format = ma_format_unknown;
+        ma_uint32 native_channels = 0, native_sample_rate = 0;
+        ma_channel channel_map[MA_MAX_CHANNELS];
+
+        if (ops->get_file_info)
+                ops->get_file_info(file_path, &native_format, &native_channels, &native_sample_rate, channel_map);
+
+        pthread_mutex_lock(&preroll_mutex);
+
+        PrerollSlot *slot = find_slot(file_path);
+
+        if (slot == NULL) {
+                slot = &slots[0];
+                for (int i = 1; i < PREROLL_SLOTS; i++) {
+                        if (slots[i].stamp < slot->stamp)
+                                slot = &slots[i];
+                }
+        }
+
+        free(slot->frames);
+
+        c_strcpy(slot->file_path, file_path, sizeof(slot->file_path));
+        slot->frames = frames;
+        slot->frame_count = frame_count;
+        slot->channels = channels;
+        slot->sample_rate = sample_rate;
+        slot->native_format = native_format;
+        slot->stamp = ++stamp_counter;
+
+        pthread_mutex_unlock(&preroll_mutex);
+}
+
+bool preroll_get_format(const char *file_path, ma_format *native_format,
+                        ma_uint32 *channels, ma_uint32 *sample_rate)
+{
+        if (file_path == NULL)
+                return false;
+
+        pthread_mutex_lock(&preroll_mutex);
+
+        PrerollSlot *slot = find_slot(file_path);
+
+        if (slot != NULL) {
+                *native_format = slot->native_format;
+                *channels = slot->channels;
+                *sample_rate = slot->sample_rate;
+        }
+
+        pthread_mutex_unlock(&preroll_mutex);
+
+        return slot != NULL;
+}
+
+ma_uint64 preroll_fill(const char *file_path, ma_uint32 channels,
+                       ma_uint32 sample_rate, ma_pcm_rb *rb)
+{
+        if (file_path == NULL || rb == NULL)
+                return 0;
+
+        ma_uint64 written = 0;
+
+        pthread_mutex_lock(&preroll_mutex);
+
+        PrerollSlot *slot = find_slot(file_path);
+
+        if (slot != NULL && slot->channels == channels && slot->sample_rate == sample_rate) {
+                while (written < slot->frame_count) {
+                        ma_uint32 to_write = (ma_uint32)(slot->frame_count - written);
+                        void *write_buffer = NULL;
+
+                        if (ma_pcm_rb_acquire_write(rb, &to_write, &write_buffer) != MA_SUCCESS ||
+                            to_write == 0 || write_buffer == NULL)
+                                break;
+
+                        memcpy(write_buffer, slot->frames + written * channels,
+                               to_write * channels * sizeof(float));
+
+                        ma_pcm_rb_commit_write(rb, to_write);
+
+                        written += to_write;
+                }
+
+                slot->stamp = ++stamp_counter;
+        }
+
+        pthread_mutex_unlock(&preroll_mutex);
+
+        return written;
+}
+
+void preroll_clear(void)
+{
+        pthread_mutex_lock(&preroll_mutex);
+
+        for (int i = 0; i < PREROLL_SLOTS; i++) {
+                free(slots[i].frames);
+                memset(&slots[i], 0, sizeof(slots[i]));
+        }
+
+        pthread_mutex_unlock(&preroll_mutex);
+}
@@ -0,0 +1,69 @@
+/**
+ * @file preroll.h
+ * @brief Decoded lead-in audio for tracks that are likely to play next.
+ *
+ * When a track is loaded as the next song, the first few hundred
+ * milliseconds are decoded with a private decoder and kept in memory.
+ * If the track is later started through a full decoder reinit (a skip,
+ * a skip back or a format change), the device is opened with the kept
+ * format and plays that audio straight away, while the real decoder is
+ * opened and seeked past it on the decode thread.
+ *
+ * Only tracks that decode to float and seek exactly get a lead-in. M4A
+ * and WebM are left out, as are tracks that play bit-exact on a
+ * passthrough device; those still open their decoder before output starts.
+ */
+
+#ifndef PREROLL_H
+#define PREROLL_H
+
+#include "decoders.h"
+
+#include <miniaudio.h>
+
+#include <stdbool.h>
+
+/**
+ * @brief Decodes and keeps the start of a track, unless it is already kept.
+ *
+ * Meant for the loader thread. A handful of tracks are kept, the oldest
+ * one is dropped when a new one is added.
+ *
+ * @param file_path Path to the audio file.
+ * @param ops Codec operations for the file.
+ */
+void preroll_prepare(const char *file_path, const CodecOps *ops);
+
+/**
+ * @brief Looks up the format of a kept track without opening the file.
+ *
+ * @param file_path Path to the audio file.
+ * @param native_format Set to the file's own sample format.
+ * @param channels Set to the channel count of the kept audio.
+ * @param sample_rate Set to the sample rate of the kept audio.
+ * @return true if the start of the track is kept.
+ */
+bool preroll_get_format(const char *file_path, ma_format *native_format,
+                        ma_uint32 *channels, ma_uint32 *sample_rate);
+
+/**
+ * @brief Writes the kept start of a track into a ring buffer.
+ *
+ * Nothing is written unless the kept audio has the same channel count
+ * and sample rate as the device.
+ *
+ * @param file_path Path to the audio file.
+ * @param channels Channel count of the playback device.
+ * @param sample_rate Sample rate of the playback device.
+ * @param rb The ring buffer to fill, must be empty.
+ * @return The number of frames written.
+ */
+ma_uint64 preroll_fill(const char *file_path, ma_uint32 channels,
+                       ma_uint32 sample_rate, ma_pcm_rb *rb);
+
+/**
+ * @brief Frees all kept audio.
+ */
+void preroll_clear(void);
+
+#endif
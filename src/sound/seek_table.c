@@ -0,0 +1,235 @@
+/**
+ * @file seek_table.c
+ * @brief Seek tables for MP3 files, cached on disk.
+ *
+ * One small file per track in the seektables directory of the config
+ * directory, named after a hash of the track's path. The file repeats the
+ * path, size and mtime so a hash collision or a changed track reads as a
+ * miss. The least recently used tables are deleted once the directory
+ * grows past SEEK_TABLE_DIR_MAX_BYTES.
+ */
+
+#include "seek_table.h"
+
+#include "common/path_max.h"
+
+#include "utils/file.h"
+#include "utils/utils.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define SEEK_TABLE_DIR "seektables"
+
+// Least recently used tables are deleted above this size
+#define SEEK_TABLE_DIR_MAX_BYTES (32LL * 1024 * 1024)
+
+// The size is checked on the first store, then every PRUNE_INTERVAL stores
+#define PRUNE_INTERVAL 64
+
+static atomic_uint tmp_counter = 0;
+static atomic_uint store_count = 0;
+
+static const char SEEK_TABLE_MAGIC[8] = {'K', 'E', 'W', 'S', 'E', 'E', 'K', '1'};
+
+typedef struct {
+        char magic[8];
+        int64_t size;
+        int64_t mtime;
+        uint32_t path_len;
+        uint32_t count;
+} SeekTableHeader;
+
+static uint64_t path_hash(const char *path)
+{
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+                hash ^= *p;
+                hash *= 1099511628211ull;
+        }
+        return hash;
+}
+
+static bool get_cache_dir(char *dir, size_t dir_size, bool create_dir)
+{
+        char *configdir = get_config_path();
+        if (configdir == NULL)
+                return false;
+
+        int written = snprintf(dir, dir_size, "%s/%s", configdir, SEEK_TABLE_DIR);
+
+        free(configdir);
+
+        if (written < 0 || (size_t)written >= dir_size)
+                return false;
+
+        return !create_dir || create_directory(dir) >= 0;
+}
+
+static bool get_cache_file(const char *file_path, char *out, size_t out_size, bool create_dir)
+{
+        char dir[KEW_PATH_MAX];
+
+        if (!get_cache_dir(dir, sizeof(dir), create_dir))
+                return false;
+
+        int written = snprintf(out, out_size, "%s/%016llx.seek", dir,
+                               (unsigned long long)path_hash(file_path));
+
+        return written > 0 && (size_t)written < out_size;
+}
+
+static void prune_seek_tables(void)
+{
+        if (atomic_fetch_add(&store_count, 1) % PRUNE_INTERVAL != 0)
+                return;
+
+        char dir[KEW_PATH_MAX];
+
+        if (get_cache_dir(dir, sizeof(dir), false))
+                prune_directory(dir, ".seek", SEEK_TABLE_DIR_MAX_BYTES);
+}
+
+static bool stat_file(const char *file_path, int64_t *size, int64_t *mtime)
+{
+        struct stat st;
+
+        if (stat(file_path, &st) != 0)
+                return false;
+
+        *size = (int64_t)st.st_size;
+        *mtime = (int64_t)st.st_mtime;
+
+        return true;
+}
+
+// Opens the cache file and checks that it belongs to the file as it is now
+static FILE *open_valid(const char *file_path, SeekTableHeader *header)
+{
+        int64_t size, mtime;
+        char cache_file[KEW_PATH_MAX];
+
+        if (!stat_file(file_path, &size, &mtime) ||
+            !get_cache_file(file_path, cache_file, sizeof(cache_file), false))
+                return NULL;
+
+        FILE *f = fopen(cache_file, "rb");
+        if (f == NULL)
+                return NULL;
+
+        size_t path_len = strlen(file_path);
+        char stored_path[KEW_PATH_MAX];
+
+        if (fread(header, sizeof(*header), 1, f) != 1 ||
+            memcmp(header->magic, SEEK_TABLE_MAGIC, sizeof(SEEK_TABLE_MAGIC)) != 0 ||
+            header->size != size || header->mtime != mtime ||
+            header->path_len != path_len || path_len >= sizeof(stored_path) ||
+            fread(stored_path, 1, path_len, f) != path_len ||
+            memcmp(stored_path, file_path, path_len) != 0) {
+                fclose(f);
+                return NULL;
+        }
+
+        return f;
+}
+
+int seek_table_load(const char *file_path, SeekPoint *points, uint32_t max_points, uint32_t *count)
+{
+        *count = 0;
+
+        if (file_path == NULL)
+                return -1;
+
+        SeekTableHeader header;
+        FILE *f = open_valid(file_path, &header);
+
+        if (f == NULL)
+                return -1;
+
+        if (header.count == 0 || header.count > max_points ||
+            fread(points, sizeof(SeekPoint), header.count, f) != header.count) {
+                fclose(f);
+                return -1;
+        }
+
+        fclose(f);
+
+        *count = header.count;
+
+        // Pruning goes by mtime, so mark it as used
+        char cache_file[KEW_PATH_MAX];
+
+        if (get_cache_file(file_path, cache_file, sizeof(cache_file), false))
+                touch_file(cache_file);
+
+        return 0;
+}
+
+bool seek_table_is_cached(const char *file_path)
+{
+        if (file_path == NULL)
+                return false;
+
+        SeekTableHeader header;
+        FILE *f = open_valid(file_path, &header);
+
+        if (f == NULL)
+                return false;
+
+        fclose(f);
+
+        return header.count > 0;
+}
+
+int seek_table_store(const char *file_path, const SeekPoint *points, uint32_t count)
+{
+        if (file_path == NULL || points == NULL || count == 0)
+                return -1;
+
+        SeekTableHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, SEEK_TABLE_MAGIC, sizeof(SEEK_TABLE_MAGIC));
+
+        char cache_file[KEW_PATH_MAX];
+        char tmp_file[KEW_PATH_MAX + 16];
+
+        if (!stat_file(file_path, &header.size, &header.mtime) ||
+            !get_cache_file(file_path, cache_file, sizeof(cache_file), true))
+                return -1;
+
+        header.path_len = (uint32_t)strlen(file_path);
+        header.count = count;
+
+        // The loader and the decoder can both be storing the same table
+        snprintf(tmp_file, sizeof(tmp_file), "%s.%u.tmp", cache_file,
+                 atomic_fetch_add(&tmp_counter, 1));
+
+        FILE *f = fopen(tmp_file, "wb");
+        if (f == NULL)
+                return -1;
+
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+                  fwrite(file_path, 1, header.path_len, f) == header.path_len &&
+                  fwrite(points, sizeof(SeekPoint), count, f) == count;
+
+        if (fclose(f) != 0)
+                ok = false;
+
+        // Write and rename, so a reader never sees half a table
+#ifdef _WIN32
+        if (ok)
+                remove(cache_file);
+#endif
+        if (!ok || rename(tmp_file, cache_file) != 0) {
+                remove(tmp_file);
+                return -1;
+        }
+
+        prune_seek_tables();
+
+        return 0;
+}
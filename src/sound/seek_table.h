@@ -0,0 +1,207 @@
+/**
+ * @file seek_table.h
+ * @brief Seek tables for MP3 files, cached on disk.
+ *
+ * MP3 files without a usable TOC can only be seeked by scanning frame
+ * headers from the start. The decoder can do this once and keep a table
+ * of seek points, but that means reading the whole file every time it is
+ * opened. Tables are instead built once, on the loader thread, and kept
+ * in the config directory keyed by path, size and mtime, so opening the
+ * file again just binds the stored table.
+ *
+ * The disk cache is in seek_table.c. The decoder glue needs miniaudio's
+ * internal MP3 types and is compiled together with the miniaudio
+ * implementation.
+ */
+
+#ifndef SEEK_TABLE_H
+#define SEEK_TABLE_H
+
+#include "miniaudio.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SEEK_TABLE_POINTS 256
+
+typedef struct {
+        uint64_t byte_pos;
+        uint64_t pcm_frame;
+        uint16_t mp3_frames_to_discard;
+        uint16_t pcm_frames_to_discard;
+} SeekPoint;
+
+/**
+ * @brief Reads the cached seek table of a file.
+ *
+ * Fails if there is none or if the file changed since it was stored.
+ *
+ * @param file_path Path to the audio file.
+ * @param points Output, room for max_points entries.
+ * @param max_points Capacity of points.
+ * @param count Number of points read.
+ * @return 0 on success, -1 otherwise.
+ */
+int seek_table_load(const char *file_path, SeekPoint *points, uint32_t max_points, uint32_t *count);
+
+/**
+ * @brief Stores the seek table of a file, replacing any older one.
+ *
+ * @param file_path Path to the audio file.
+ * @param points The seek points.
+ * @param count Number of points.
+ * @return 0 on success, -1 otherwise.
+ */
+int seek_table_store(const char *file_path, const SeekPoint *points, uint32_t count);
+
+/**
+ * @brief Checks whether an up to date table is cached for a file.
+ *
+ * @param file_path Path to the audio file.
+ * @return true if seek_table_load() would succeed.
+ */
+bool seek_table_is_cached(const char *file_path);
+
+/**
+ * @brief Gives an MP3 decoder its seek table.
+ *
+ * Binds the cached table if there is one. Otherwise, if build is set,
+ * scans the file to make one and caches it. Does nothing for decoders
+ * that aren't MP3.
+ *
+ * @param decoder A decoder opened with seekPointCount = 0.
+ * @param file_path Path the decoder was opened from.
+ * @param build Whether to scan the file on a cache miss.
+ * @return true if a table is bound.
+ */
+bool seek_table_attach(ma_decoder *decoder, const char *file_path, bool build);
+
+/**
+ * @brief Builds and caches the seek table of a file if it has none yet.
+ *
+ * Reads the whole file, so only call this off the audio threads.
+ *
+ * @param file_path Path to the audio file.
+ */
+void seek_table_prepare(const char *file_path);
+
+#endif
+
+#if defined(MINIAUDIO_IMPLEMENTATION) || defined(MA_IMPLEMENTATION)
+#ifndef SEEK_TABLE_IMPLEMENTATION
+#define SEEK_TABLE_IMPLEMENTATION
+
+#include "utils/utils.h"
+
+#if !defined(MA_NO_MP3)
+
+static ma_mp3 *seek_table_mp3_backend(ma_decoder *decoder)
+{
+        if (decoder == NULL || decoder->pBackend == NULL ||
+            decoder->pBackendVTable != &g_ma_decoding_backend_vtable_mp3)
+                return NULL;
+
+        return (ma_mp3 *)decoder->pBackend;
+}
+
+static bool seek_table_bind(ma_decoder *decoder, ma_mp3 *mp3,
+                            ma_dr_mp3_seek_point *points, ma_uint32 count)
+{
+        if (!ma_dr_mp3_bind_seek_table(&mp3->dr, count, points)) {
+                ma_free(points, &decoder->allocationCallbacks);
+                return false;
+        }
+
+        // ma_mp3_uninit frees the table
+        mp3->pSeekPoints = points;
+        mp3->seekPointCount = count;
+
+        return true;
+}
+
+bool seek_table_attach(ma_decoder *decoder, const char *file_path, bool build)
+{
+        ma_mp3 *mp3 = seek_table_mp3_backend(decoder);
+
+        if (mp3 == NULL || file_path == NULL)
+                return false;
+
+        if (mp3->pSeekPoints != NULL)
+                return true;
+
+        ma_dr_mp3_seek_point *points =
+            ma_malloc(sizeof(*points) * SEEK_TABLE_POINTS, &decoder->allocationCallbacks);
+
+        if (points == NULL)
+                return false;
+
+        SeekPoint cached[SEEK_TABLE_POINTS];
+        uint32_t count = 0;
+
+        if (seek_table_load(file_path, cached, SEEK_TABLE_POINTS, &count) == 0 && count > 0) {
+                for (uint32_t i = 0; i < count; i++) {
+                        points[i].seekPosInBytes = cached[i].byte_pos;
+                        points[i].pcmFrameIndex = cached[i].pcm_frame;
+                        points[i].mp3FramesToDiscard = cached[i].mp3_frames_to_discard;
+                        points[i].pcmFramesToDiscard = cached[i].pcm_frames_to_discard;
+                }
+
+                return seek_table_bind(decoder, mp3, points, count);
+        }
+
+        ma_uint32 built = SEEK_TABLE_POINTS;
+
+        if (!build || !ma_dr_mp3_calculate_seek_points(&mp3->dr, &built, points) || built == 0) {
+                ma_free(points, &decoder->allocationCallbacks);
+                return false;
+        }
+
+        for (ma_uint32 i = 0; i < built; i++) {
+                cached[i].byte_pos = points[i].seekPosInBytes;
+                cached[i].pcm_frame = points[i].pcmFrameIndex;
+                cached[i].mp3_frames_to_discard = points[i].mp3FramesToDiscard;
+                cached[i].pcm_frames_to_discard = points[i].pcmFramesToDiscard;
+        }
+
+        seek_table_store(file_path, cached, built);
+
+        return seek_table_bind(decoder, mp3, points, built);
+}
+
+void seek_table_prepare(const char *file_path)
+{
+        if (file_path == NULL || !path_ends_with(file_path, ".mp3") || seek_table_is_cached(file_path))
+                return;
+
+        ma_decoder_config config = ma_decoder_config_init(ma_format_f32, 0, 0);
+        config.seekPointCount = 0;
+
+        ma_decoder decoder;
+
+        if (ma_decoder_init_file(file_path, &config, &decoder) != MA_SUCCESS)
+                return;
+
+        seek_table_attach(&decoder, file_path, true);
+
+        ma_decoder_uninit(&decoder);
+}
+
+#else
+
+bool seek_table_attach(ma_decoder *decoder, const char *file_path, bool build)
+{
+        (void)decoder;
+        (void)file_path;
+        (void)build;
+
+        return false;
+}
+
+void seek_table_prepare(const char *file_path)
+{
+        (void)file_path;
+}
+
+#endif
+#endif
+#endif
@@ -26,10 +26,15 @@
 #include "audiobuffer.h"
 #include "audiotypes.h"
 #include "decoders.h"
+#include "preroll.h"
+#include "seek_table.h"
+#include "stream_markers.h"
 #include "volume.h"
 
+#include "loader/song_cache.h"
 #include "loader/song_loader.h"
 
+#include "utils/dsp_kernels.h"
 #include "utils/file.h"
 #include "utils/k_log.h"
 #include "utils/utils.h"
@@ -60,6 +65,23 @@ sound_playback_repeat_state_t repeat_state = SOUND_STATE_REPEAT_OFF;
 
 ma_pcm_rb pcm_rb;
 
+#define SPACE_WAIT_MS 100
+#define PAUSE_WAIT_MS 1000
+#define FINISHED_WAIT_MS 10000
+
+#define POWER_SAVING_RING_MS 30000
+#define POWER_SAVING_MAX_BYTES (32u * 1024 * 1024)
+
+// Set while the decode thread sleeps until the ring buffer drains to the watermark
+static atomic_bool waiting_for_space = false;
+static _Atomic ma_uint32 space_low_watermark = 0;
+
+// Set when the audio callback couldn't take the lock to wake the decode thread
+static atomic_bool decoder_wake_pending = false;
+
+// Orders opening a track that started from its lead-in before the next one
+static pthread_mutex_t deferred_open_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 sound_result_t create_audio_device(
     void *user_data,
     sound_system_t *sound,
@@ -68,6 +90,8 @@ sound_result_t create_audio_device(
     decoder_getter_func get_decoder,
     ma_data_callback_proc callback);
 
+static void open_deferred_decoder(sound_system_t *sound);
+
 bool valid_file_path(char *file_path)
 {
         if (file_path == NULL || file_path[0] == '\0' || file_path[0] == '\r')
@@ -79,6 +103,13 @@ bool valid_file_path(char *file_path)
         return true;
 }
 
+// Called with the device stopped, whenever the ring buffer is emptied
+static void reset_stream_markers(sound_system_t *sound)
+{
+        stream_markers_reset();
+        stream_markers_push(STREAM_MARKER_GAIN, sound->gain_linear);
+}
+
 static bool should_switch(ma_uint64 frames_to_read,
                           ma_result result, ma_uint64 cursor)
 {
@@ -97,10 +128,12 @@ static bool execute_seek(sound_system_t *sound, ma_decoder *decoder, ma_uint64 t
         ma_result result = ops->seek_to_pcm_frame(decoder, targetFrame, 0);
 
         if (result == MA_SUCCESS) {
+                decoder_reset_converter(decoder);
                 atomic_store(&sound->buffer_ready, 0);
                 ma_pcm_rb_reset(&pcm_rb);
+                reset_stream_markers(sound);
                 atomic_store(&sound->decode_finished, false);
-                sound->current_frame = targetFrame;
+                sound->current_frame = decoder_frames_to_output(decoder, targetFrame, sound->sample_rate);
 
                 uint64_t played = atomic_load_explicit(&sound_s->track_frames_sent, memory_order_relaxed);
                 sound->total_frames = played;
@@ -146,13 +179,11 @@ bool is_valid_gain(double gain)
         return gain > -50.0 && gain < 50.0 && !isnan(gain) && isfinite(gain) && gain != 0;
 }
 
-static bool compute_replay_gain(double *out_gain_db)
+static bool compute_replay_gain(SongData *song, double *out_gain_db)
 {
         bool result = false;
         double gain_db = 0.0f;
 
-        SongData *song = sound_get_current_song_data();
-
         if (song != NULL && song->magic == SONG_MAGIC && song->metadata != NULL) {
                 double track_gain = song->metadata->replaygainTrack;
                 double album_gain = song->metadata->replaygainAlbum;
@@ -181,14 +212,36 @@ static bool compute_replay_gain(double *out_gain_db)
         return result;
 }
 
-static inline void
-apply_gain_f32(float *restrict samples,
-               ma_uint64 total_samples,
-               float gain)
+// Integer sources are handed to the device untouched when nothing needs to be
+// done to the samples. Anything with gain or crossfading is decoded to float.
+static bool needs_float_output(const CodecOps *ops, SongData *song)
 {
-        for (ma_uint64 i = 0; i < total_samples; i++) {
-                samples[i] *= gain;
-        }
+        double gain_db;
+
+        return ops == NULL || ops->decoder_type != BUILTIN ||
+               sound_s->always_fade || compute_replay_gain(song, &gain_db);
+}
+
+static ma_format output_format_for_native(ma_format native)
+{
+        if (native == ma_format_s16 || native == ma_format_s24 || native == ma_format_s32)
+                return native;
+
+        return ma_format_f32;
+}
+
+static ma_format choose_output_format(const CodecOps *ops, const char *file_path, SongData *song)
+{
+        if (file_path == NULL || needs_float_output(ops, song))
+                return ma_format_f32;
+
+        ma_format native = ma_format_unknown;
+        ma_uint32 channels = 0, sample_rate = 0;
+        ma_channel channel_map[MA_MAX_CHANNELS];
+
+        ops->get_file_info(file_path, &native, &channels, &sample_rate, channel_map);
+
+        return output_format_for_native(native);
 }
 
 void reset_ring_buffer(sound_system_t *sound)
@@ -197,6 +250,7 @@ void reset_ring_buffer(sound_system_t *sound)
         stop_playback();
 
         ma_pcm_rb_reset(&pcm_rb);
+        reset_stream_markers(sound);
 
         if (resume)
                 sound_system_play(sound);
@@ -212,7 +266,7 @@ void set_replay_gain(sound_system_t *sound)
         sound->gain_linear = 1.0f;
 
         double gain_db = 0.0;
-        if (compute_replay_gain(&gain_db)) {
+        if (compute_replay_gain(sound_get_current_song_data(), &gain_db)) {
                 float g = (float)db_to_linear(gain_db);
 
                 if (g < 0.0001f)
@@ -226,8 +280,6 @@ void set_replay_gain(sound_system_t *sound)
 
 void switch_metadata(sound_system_t *sound)
 {
-        atomic_store_explicit(&sound_s->clock_reset_done, true, memory_order_relaxed);
-
         set_skip_to_next(false);
 
         if (atomic_load(&sound->request_pause) && !pb_is_paused()) {
@@ -284,21 +336,112 @@ void switch_current_decoder(sound_system_t *sound)
 
         switch_decoder_index();
 
+        // The new gain takes effect with the first frame written from here on
         set_replay_gain(sound);
+        stream_markers_push(STREAM_MARKER_GAIN, sound->gain_linear);
+
         set_EOF_reached(true);
 
         long long fade_boundary = atomic_load_explicit(&sound->fade_boundary, memory_order_acquire);
-        bool fade_boundary_reached = atomic_load_explicit(&sound->fade_boundary_reached, memory_order_acquire);
 
         if (fade_boundary < 0) {
                 atomic_store_explicit(&sound->clock_reset_ms, sound->fade_enter_song_ms, memory_order_release);
         }
 
-        if (fade_boundary < 0 || fade_boundary_reached) {
-                atomic_store_explicit(&sound_s->clock_reset_done, false, memory_order_relaxed);
+        pthread_mutex_unlock(&ps->switch_mutex);
+}
+
+void sound_wake_decoder(void)
+{
+        if (!sound_s)
+                return;
+
+        pthread_mutex_lock(&sound_s->decoder_mutex);
+        pthread_cond_signal(&sound_s->decoder_cond);
+        pthread_mutex_unlock(&sound_s->decoder_mutex);
+}
+
+static void deadline_in_ms(struct timespec *ts, long ms)
+{
+        clock_gettime(CLOCK_REALTIME, ts);
+
+        ts->tv_sec += ms / 1000;
+        ts->tv_nsec += (ms % 1000) * 1000000L;
+
+        if (ts->tv_nsec >= 1000000000L) {
+                ts->tv_sec++;
+                ts->tv_nsec -= 1000000000L;
+        }
+}
+
+static bool decoder_has_pending_work(sound_system_t *sound)
+{
+        return is_skip_to_next() || is_seek_requested() ||
+               atomic_load(&sound->request_pause) ||
+               atomic_load(&sound->request_switch_metadata) ||
+               atomic_load(&sound->request_switch_decoder) ||
+               get_current_decoder_type() != get_current_decoder_decoder_type() ||
+               is_decoder_type_switch_reached();
+}
+
+// How long the audio callback takes to free min_frames, plus some slack. Only
+// bounds a missed signal, so power saving sleeps through the whole drain.
+static long space_wait_ms(sound_system_t *sound, ma_uint32 writable, ma_uint32 min_frames)
+{
+        if (sound->sample_rate == 0 || writable >= min_frames)
+                return SPACE_WAIT_MS;
+
+        return (long)((ma_uint64)(min_frames - writable) * 1000 / sound->sample_rate) + SPACE_WAIT_MS;
+}
+
+// Sleeps until the audio callback has freed min_frames of the ring buffer or
+// something else needs the decode thread
+static ma_uint32 wait_for_ring_buffer_space(sound_system_t *sound, ma_uint32 min_frames)
+{
+        ma_uint32 writable = ma_pcm_rb_available_write(&pcm_rb);
+
+        if (writable >= min_frames)
+                return writable;
+
+        atomic_store(&sound->buffer_ready, 1);
+
+        pthread_mutex_lock(&sound->decoder_mutex);
+
+        atomic_store_explicit(&space_low_watermark, min_frames, memory_order_relaxed);
+        atomic_store(&waiting_for_space, true);
+
+        writable = ma_pcm_rb_available_write(&pcm_rb);
+
+        if (writable < min_frames &&
+            !(writable > 0 && decoder_has_pending_work(sound)) &&
+            atomic_load(&sound->decode_thread_running)) {
+                struct timespec ts;
+                deadline_in_ms(&ts, pb_is_paused() ? PAUSE_WAIT_MS : space_wait_ms(sound, writable, min_frames));
+
+                pthread_cond_timedwait(&sound->decoder_cond, &sound->decoder_mutex, &ts);
+
+                writable = ma_pcm_rb_available_write(&pcm_rb);
         }
 
-        pthread_mutex_unlock(&ps->switch_mutex);
+        atomic_store(&waiting_for_space, false);
+
+        pthread_mutex_unlock(&sound->decoder_mutex);
+
+        return writable;
+}
+
+static void wait_for_resume(sound_system_t *sound)
+{
+        pthread_mutex_lock(&sound->decoder_mutex);
+
+        if (pb_is_paused() && atomic_load(&sound->decode_thread_running)) {
+                struct timespec ts;
+                deadline_in_ms(&ts, PAUSE_WAIT_MS);
+
+                pthread_cond_timedwait(&sound->decoder_cond, &sound->decoder_mutex, &ts);
+        }
+
+        pthread_mutex_unlock(&sound->decoder_mutex);
 }
 
 void set_decode_thread_priority(pthread_t thread)
@@ -359,6 +502,72 @@ void drain_audio_and_pause(sound_system_t *sound)
         }
 }
 
+// Fade gains are computed for this many frames at a time
+#define CROSSFADE_BLOCK_FRAMES 256
+
+// Segments in the fade curve table, gains in between are interpolated
+#define FADE_TABLE_SIZE 1024
+
+static float fade_out_table[FADE_TABLE_SIZE + 1];
+static float fade_in_table[FADE_TABLE_SIZE + 1];
+static int fade_table_curve = -1;
+
+static void build_fade_table(int curve)
+{
+        if (curve == fade_table_curve)
+                return;
+
+        for (int i = 0; i <= FADE_TABLE_SIZE; i++) {
+                float t = (float)i / FADE_TABLE_SIZE;
+
+                switch (curve) {
+                case SOUND_FADE_LINEAR:
+                        fade_out_table[i] = 1.0f - t;
+                        fade_in_table[i] = t;
+                        break;
+
+                case SOUND_FADE_S_CURVE: {
+                        float s = t * t * (3.0f - 2.0f * t);
+                        fade_out_table[i] = 1.0f - s;
+                        fade_in_table[i] = s;
+                        break;
+                }
+
+                default: {
+                        // Equal-power fade
+                        float u = powf(t, 0.7f);
+                        fade_out_table[i] = cosf(u * MA_PI * 0.5f);
+                        fade_in_table[i] = sinf(u * MA_PI * 0.5f);
+                        break;
+                }
+                }
+        }
+
+        fade_table_curve = curve;
+}
+
+static void fill_fade_gains(ma_uint64 first_frame, ma_uint64 total_frames,
+                            float *fade_out, float *fade_in, ma_uint64 count)
+{
+        float step = (total_frames > 0) ? (float)FADE_TABLE_SIZE / (float)total_frames : (float)FADE_TABLE_SIZE;
+
+        for (ma_uint64 i = 0; i < count; i++) {
+                float pos = (float)(first_frame + i) * step;
+
+                if (pos >= FADE_TABLE_SIZE) {
+                        fade_out[i] = fade_out_table[FADE_TABLE_SIZE];
+                        fade_in[i] = fade_in_table[FADE_TABLE_SIZE];
+                        continue;
+                }
+
+                int idx = (int)pos;
+                float frac = pos - (float)idx;
+
+                fade_out[i] = fade_out_table[idx] + (fade_out_table[idx + 1] - fade_out_table[idx]) * frac;
+                fade_in[i] = fade_in_table[idx] + (fade_in_table[idx + 1] - fade_in_table[idx]) * frac;
+        }
+}
+
 void perform_crossfade(sound_system_t *sound, void *decoder, void *next_decoder, float *current_buf, float *next_buf, float *out_buf, ma_uint32 frames_to_decode, ma_uint64 *frames_to_read)
 {
         if (!sound->fade_seek_performed) {
@@ -366,7 +575,6 @@ void perform_crossfade(sound_system_t *sound, void *decoder, void *next_decoder,
                 clear_decoder_chain(); // Prevents a read at the end of decoder from spilling
                                        // over into the next decoder and resetting the position
 
-                atomic_store(&sound->clock_reset_done, false);
                 atomic_store_explicit(&sound_s->fade_boundary, -1, memory_order_release);
 
                 if (sound->fade_enter_song_ms > 0) {
@@ -378,27 +586,38 @@ void perform_crossfade(sound_system_t *sound, void *decoder, void *next_decoder,
 
                         ma_data_source_seek_to_pcm_frame(
                             next_decoder,
-                            sound->fade_enter_frame);
+                            decoder_frames_from_output(next_decoder, sound->fade_enter_frame, sound->sample_rate));
+
+                        decoder_reset_converter(next_decoder);
                 }
 
+                build_fade_table(sound->fade_curve);
+
                 sound->fade_current_frame = 0;
                 sound->fade_seek_performed = true;
                 atomic_store_explicit(&sound_s->fade_boundary, sound->total_frames, memory_order_release);
+
+                // The mix starts with the next frame written
+                stream_markers_push(STREAM_MARKER_TRACK_START, 0.0f);
         }
 
         ma_uint64 current_read = 0;
         ma_uint64 next_read = 0;
 
-        ma_data_source_read_pcm_frames(
+        decoder_read_pcm_frames(
             decoder,
             current_buf,
             (ma_uint64)frames_to_decode,
+            sound->channels,
+            sound->sample_rate,
             &current_read);
 
-        ma_data_source_read_pcm_frames(
+        decoder_read_pcm_frames(
             next_decoder,
             next_buf,
             current_read,
+            sound->channels,
+            sound->sample_rate,
             &next_read);
 
         ma_uint64 frames_read =
@@ -408,33 +627,23 @@ void perform_crossfade(sound_system_t *sound, void *decoder, void *next_decoder,
 
         if (frames_read > 0) {
 
-                float *mixed = out_buf;
-
-                for (ma_uint64 i = 0; i < frames_read; i++) {
-
-                        float t = (float)(sound->fade_current_frame + i) /
-                                  (float)sound->fade_total_frames;
-
-                        t = powf(t, 0.7f);
+                float fade_out[CROSSFADE_BLOCK_FRAMES];
+                float fade_in[CROSSFADE_BLOCK_FRAMES];
 
-                        if (t > 1.0f)
-                                t = 1.0f;
+                for (ma_uint64 start = 0; start < frames_read; start += CROSSFADE_BLOCK_FRAMES) {
 
-                        // Equal-power fade
-                        float fadeOut = cosf(t * MA_PI * 0.5f);
-                        float fadeIn = sinf(t * MA_PI * 0.5f);
+                        ma_uint64 count = frames_read - start;
+                        if (count > CROSSFADE_BLOCK_FRAMES)
+                                count = CROSSFADE_BLOCK_FRAMES;
 
-                        for (ma_uint32 ch = 0;
-                             ch < sound->channels;
-                             ch++) {
+                        fill_fade_gains(sound->fade_current_frame + start, sound->fade_total_frames,
+                                        fade_out, fade_in, count);
 
-                                ma_uint64 idx =
-                                    i * sound->channels + ch;
+                        ma_uint64 offset = start * sound->channels;
 
-                                mixed[idx] =
-                                    current_buf[idx] * fadeOut +
-                                    next_buf[idx] * fadeIn;
-                        }
+                        dsp_crossfade_f32(current_buf + offset, fade_out,
+                                          next_buf + offset, fade_in,
+                                          out_buf + offset, count, sound->channels);
                 }
 
                 *frames_to_read = frames_read;
@@ -459,12 +668,15 @@ void write_to_ring_buffer(sound_system_t *sound, ma_uint64 frames_to_read, float
                 if (wr != MA_SUCCESS || framesToWrite == 0 || pWriteBuffer == NULL)
                         break;
 
+                ma_uint32 frame_size = ma_get_bytes_per_frame(sound->format, sound->channels);
+
                 MA_COPY_MEMORY(
                     pWriteBuffer,
-                    (float *)out_buf + framesWritten * sound->channels,
-                    framesToWrite * sound->channels * sizeof(float));
+                    (ma_uint8 *)out_buf + framesWritten * frame_size,
+                    framesToWrite * frame_size);
 
                 ma_pcm_rb_commit_write(&pcm_rb, framesToWrite);
+                stream_markers_add_written(framesToWrite);
 
                 framesWritten += framesToWrite;
                 framesRemaining -= framesToWrite;
@@ -535,6 +747,7 @@ void *decode_loop(void *arg)
         }
 
         bool unpaused = false;
+        bool refilling = true;
         lastCursor = 0;
         set_decode_thread_priority(pthread_self());
 
@@ -546,6 +759,30 @@ void *decode_loop(void *arg)
         atomic_store_explicit(&sound->fade_boundary, -1, memory_order_release);
         atomic_store_explicit(&sound->clock_reset_ms, 0, memory_order_relaxed);
 
+        // The lead-in is already playing from the ring buffer, open the
+        // decoder if that hasn't been done yet and continue after it
+        if (sound->preroll_frames > 0) {
+                pthread_mutex_lock(&deferred_open_mutex);
+                open_deferred_decoder(sound);
+                pthread_mutex_unlock(&deferred_open_mutex);
+
+                decoder = get_current_decoder();
+                const CodecOps *ops = get_codec_ops(get_current_decoder_decoder_type());
+
+                if (decoder && ops && ops->seek_to_pcm_frame(decoder, sound->preroll_frames, 0) == MA_SUCCESS) {
+                        decoder_reset_converter(decoder);
+                        sound->current_frame = sound->preroll_frames;
+                } else if (decoder) {
+                        k_log("Failed to seek past the pre-rolled audio.\n");
+                } else {
+                        // Nothing to continue with, end the track after the lead-in
+                        stream_markers_push(STREAM_MARKER_TRACK_END, 0.0f);
+                        atomic_store_explicit(&sound->decode_finished, true, memory_order_release);
+                }
+
+                sound->preroll_frames = 0;
+        }
+
         while (atomic_load(&sound->decode_thread_running)) {
 
                 // Handle pending switch
@@ -573,23 +810,28 @@ void *decode_loop(void *arg)
                         break;
                 }
 
-                ma_uint32 writable = 0;
+                ma_uint32 writable = ma_pcm_rb_available_write(&pcm_rb);
+
+                // Once refilling, keep decoding until the ring is full, then sleep
+                // until it has drained to the refill watermark
+                if (writable < sound->chunk_frames)
+                        refilling = false;
 
+                ma_uint32 low_watermark = refilling ? sound->chunk_frames : sound->refill_frames;
+
+                // Don't hold up a skip, seek or switch
                 while (atomic_load(&sound->decode_thread_running)) {
 
-                        atomic_thread_fence(memory_order_seq_cst);
-                        writable = ma_pcm_rb_available_write(&pcm_rb);
+                        writable = wait_for_ring_buffer_space(sound, low_watermark);
 
-                        if (writable > 0) {
+                        if (writable >= low_watermark ||
+                            (writable > 0 && decoder_has_pending_work(sound))) {
                                 break;
                         }
-
-                        atomic_store(&sound->buffer_ready, 1);
-
-                        struct timespec ts = {0, 1000000}; // 1ms
-                        nanosleep(&ts, NULL);
                 }
 
+                refilling = true;
+
                 if (atomic_load(&sound->request_pause)) {
 
                         if (!atomic_load_explicit(&sound->request_switch_decoder, memory_order_acquire)) {
@@ -602,14 +844,10 @@ void *decode_loop(void *arg)
 
                 // Handle pause
                 unpaused = false;
-                while (atomic_load(&sound->decode_thread_running)) {
+                while (atomic_load(&sound->decode_thread_running) && pb_is_paused()) {
 
-                        if (pb_is_paused()) {
-                                c_sleep(10);
-                                unpaused = true;
-                        } else {
-                                break;
-                        }
+                        wait_for_resume(sound);
+                        unpaused = true;
                 }
 
                 if (unpaused)
@@ -639,7 +877,9 @@ void *decode_loop(void *arg)
                 void *next_decoder = get_other_decoder();
 
                 if (sound->total_song_frames == 0) {
-                        ma_data_source_get_length_in_pcm_frames(decoder, &sound->total_song_frames);
+                        ma_uint64 length = 0;
+                        ma_data_source_get_length_in_pcm_frames(decoder, &length);
+                        sound->total_song_frames = decoder_frames_to_output(decoder, length, sound->sample_rate);
 #ifdef DEBUG
                         k_log("Frame count: %" PRIu64, sound->total_song_frames);
 #endif
@@ -668,19 +908,22 @@ void *decode_loop(void *arg)
                         if (finished) {
                                 pthread_mutex_lock(&sound->decoder_mutex);
 
-                                struct timespec ts;
-                                clock_gettime(CLOCK_REALTIME, &ts);
-                                ts.tv_sec += 10;
+                                // The callback only signals when it gets the lock, so wait
+                                // in short steps and give up after FINISHED_WAIT_MS in total
+                                int timeouts = 0;
 
                                 while (atomic_load_explicit(&sound->decode_finished, memory_order_acquire) &&
                                        atomic_load_explicit(&sound->decode_thread_running, memory_order_acquire) &&
                                        !atomic_load_explicit(&sound->request_switch_metadata, memory_order_acquire)) {
 
+                                        struct timespec ts;
+                                        deadline_in_ms(&ts, SPACE_WAIT_MS);
+
                                         int rc = pthread_cond_timedwait(&sound->decoder_cond,
                                                                         &sound->decoder_mutex,
                                                                         &ts);
 
-                                        if (rc == ETIMEDOUT) {
+                                        if (rc == ETIMEDOUT && ++timeouts >= FINISHED_WAIT_MS / SPACE_WAIT_MS) {
                                                 k_log("Decoder thread timed out waiting for condition.");
                                                 atomic_store_explicit(&sound->decode_thread_running,
                                                                       false,
@@ -688,8 +931,7 @@ void *decode_loop(void *arg)
 
 #ifdef DEBUG
                                                 uint64_t played = atomic_load_explicit(&sound_s->track_frames_sent, memory_order_relaxed);
-                                                uint64_t boundary = atomic_load_explicit(&sound_s->track_end_frame, memory_order_relaxed);
-                                                k_log("Played: %" PRIu64 "Boundary: %" PRIu64, played, boundary);
+                                                k_log("Played: %" PRIu64, played);
 #endif
                                                 break;
                                         }
@@ -699,10 +941,12 @@ void *decode_loop(void *arg)
 
                                 continue;
                         } else {
-                                result = ma_data_source_read_pcm_frames(decoder,
-                                                                        mixed_buf,
-                                                                        frames_to_decode,
-                                                                        &frames_to_read);
+                                result = decoder_read_pcm_frames(decoder,
+                                                                 mixed_buf,
+                                                                 frames_to_decode,
+                                                                 sound->channels,
+                                                                 sound->sample_rate,
+                                                                 &frames_to_read);
 
                                 sound->current_frame += frames_to_read;
                                 sound->total_frames += frames_to_read;
@@ -738,7 +982,7 @@ void *decode_loop(void *arg)
                                 // Write the last frames before marking finished
                                 if (frames_to_read > 0) {
                                         ma_uint32 framesRemaining = (ma_uint32)frames_to_read;
-                                        while (framesRemaining > 0) {
+                                        while (framesRemaining > 0 && atomic_load(&sound->decode_thread_running)) {
 
                                                 ma_uint32 framesToWrite = framesRemaining;
                                                 void *pWriteBuffer = NULL;
@@ -746,27 +990,25 @@ void *decode_loop(void *arg)
 
                                                 if (wr != MA_SUCCESS || framesToWrite == 0) {
 
-                                                        struct timespec ts = {0, 500000};
-                                                        nanosleep(&ts, NULL);
+                                                        wait_for_ring_buffer_space(sound, framesRemaining);
                                                         continue;
                                                 }
 
+                                                ma_uint32 frame_size = ma_get_bytes_per_frame(sound->format, sound->channels);
+
                                                 memcpy(pWriteBuffer,
-                                                       mixed_buf + framesWritten * sound->channels,
-                                                       framesToWrite * sound->channels * sizeof(float));
+                                                       (ma_uint8 *)mixed_buf + framesWritten * frame_size,
+                                                       framesToWrite * frame_size);
 
                                                 ma_pcm_rb_commit_write(&pcm_rb, framesToWrite);
+                                                stream_markers_add_written(framesToWrite);
 
                                                 framesWritten += framesToWrite;
                                                 framesRemaining -= framesToWrite;
                                         }
                                 }
 
-                                atomic_thread_fence(memory_order_seq_cst);
-
-                                long long sent = atomic_load(&sound->track_frames_sent);
-                                sent = sent + (long long)ma_pcm_rb_available_read(&pcm_rb);
-                                atomic_store_explicit(&sound->track_end_frame, sent, memory_order_release);
+                                stream_markers_push(STREAM_MARKER_TRACK_END, 0.0f);
                                 atomic_store_explicit(&sound->decode_finished, true, memory_order_release);
                                 atomic_store_explicit(&sound->fade_boundary, -1, memory_order_release);
                                 atomic_store_explicit(&sound->clock_reset_ms, 0, memory_order_relaxed);
@@ -811,20 +1053,55 @@ void *decode_loop(void *arg)
 }
 
 // Audio callback, consumes data from the miniaudio ringbuffer, and feeds the output device
+#define VIZ_SCRATCH_SAMPLES 4096
+
+// Replay Gain of the frames being played, set by gain records. Audio callback only.
+static float output_gain = 1.0f;
+
+static void push_to_visualizer(const void *frames, ma_uint32 frame_count)
+{
+        ma_uint32 channels = sound_s->channels;
+
+        if (sound_s->format == ma_format_f32) {
+                visualizer_ringbuffer_push(frames, frame_count, channels);
+                return;
+        }
+
+        // Passthrough output, the visualizer works on float
+        static float scratch[VIZ_SCRATCH_SAMPLES];
+
+        ma_uint32 frames_per_pass = VIZ_SCRATCH_SAMPLES / channels;
+        ma_uint32 frame_size = ma_get_bytes_per_frame(sound_s->format, channels);
+        const ma_uint8 *src = frames;
+
+        while (frame_count > 0) {
+                ma_uint32 count = frame_count < frames_per_pass ? frame_count : frames_per_pass;
+
+                ma_pcm_convert(scratch, ma_format_f32, src, sound_s->format,
+                               (ma_uint64)count * channels, ma_dither_mode_none);
+                visualizer_ringbuffer_push(scratch, count, channels);
+
+                src += count * frame_size;
+                frame_count -= count;
+        }
+}
+
 void on_audio_frames(ma_device *device, void *pOutput, const void *input, ma_uint32 frameCount)
 {
         (void)device;
         (void)input;
 
+        const ma_uint32 frameSize = ma_get_bytes_per_frame(sound_s->format, sound_s->channels);
+
         if (!atomic_load(&sound_s->buffer_ready)) {
-                memset(pOutput, 0, frameCount * sound_s->channels * sizeof(float));
+                memset(pOutput, 0, frameCount * frameSize);
                 return;
         }
 
         // Handle audio drainage
         int remaining = atomic_load(&sound_s->drain_callbacks_remaining);
         if (remaining > 0) {
-                memset(pOutput, 0, frameCount * sound_s->channels * sizeof(float));
+                memset(pOutput, 0, frameCount * frameSize);
                 remaining--;
                 atomic_store(&sound_s->drain_callbacks_remaining, remaining);
                 return;
@@ -835,15 +1112,35 @@ void on_audio_frames(ma_device *device, void *pOutput, const void *input, ma_uin
                 sound_s->audio_thread_priority_set = MA_TRUE;
         }
 
-        const ma_uint32 frameSize = sound_s->channels * sizeof(float);
         ma_uint32 framesRemaining = frameCount;
         ma_uint32 totalFramesRead = 0;
         uint8_t *writePtr = (uint8_t *)pOutput;
-        bool boundary_handled = false;
+        bool wake_decoder = false;
 
         while (framesRemaining > 0) {
 
-                ma_uint32 framesToRead = framesRemaining;
+                // Act on the records that playback has reached
+                StreamMarker marker;
+
+                while (stream_markers_take_due(&marker)) {
+                        switch (marker.type) {
+                        case STREAM_MARKER_TRACK_START:
+                                atomic_store_explicit(&sound_s->fade_boundary_reached, true, memory_order_relaxed);
+                                atomic_store_explicit(&sound_s->request_switch_metadata, true, memory_order_release);
+                                wake_decoder = true;
+                                break;
+                        case STREAM_MARKER_TRACK_END:
+                                atomic_store_explicit(&sound_s->request_switch_metadata, true, memory_order_release);
+                                wake_decoder = true;
+                                break;
+                        case STREAM_MARKER_GAIN:
+                                output_gain = marker.gain;
+                                break;
+                        }
+                }
+
+                // Stop at the next record so it takes effect on the right frame
+                ma_uint32 framesToRead = stream_markers_clamp(framesRemaining);
                 void *pReadBuffer = NULL;
 
                 ma_result result = ma_pcm_rb_acquire_read(&pcm_rb, &framesToRead, &pReadBuffer);
@@ -858,66 +1155,43 @@ void on_audio_frames(ma_device *device, void *pOutput, const void *input, ma_uin
                         break;
                 }
 
-                // Success, copy data
-                float gain = sound_s->gain_linear;
-
-                // Determine how many frames to copy this iteration
-                ma_uint32 framesToCopy = framesToRead;
-
-                // Load current played and boundary
-                uint64_t played = atomic_load_explicit(&sound_s->track_frames_sent, memory_order_relaxed);
-                uint64_t boundary = atomic_load_explicit(&sound_s->track_end_frame, memory_order_relaxed);
-
-                atomic_load_explicit(&sound_s->fade_boundary, memory_order_acquire);
-                atomic_load_explicit(&sound_s->clock_reset_done, memory_order_acquire);
-                if (sound_s->fade_boundary >= 0 &&
-                    sound_s->fade_boundary <= (long long)played + framesToCopy &&
-                    !sound_s->clock_reset_done) {
-
-                        pthread_mutex_lock(&sound_s->decoder_mutex);
-
-                        atomic_store_explicit(&sound_s->fade_boundary_reached, true, memory_order_relaxed);
-                        atomic_store_explicit(&sound_s->request_switch_metadata, true, memory_order_relaxed);
+                // Copy frames
+                size_t bytesToCopy = framesToRead * frameSize;
+                MA_COPY_MEMORY(writePtr, pReadBuffer, bytesToCopy);
 
-                        pthread_cond_signal(&sound_s->decoder_cond);
-                        pthread_mutex_unlock(&sound_s->decoder_mutex);
+                // Apply Replay Gain, passthrough output never carries any
+                if (output_gain != 1.0f && sound_s->format == ma_format_f32) {
+                        ma_uint64 total = framesToRead * sound_s->channels;
+                        dsp_apply_gain_f32((float *)writePtr, total, output_gain);
                 }
 
-                if (!boundary_handled &&
-                    played + framesToCopy >= boundary &&
-                    atomic_load_explicit(&sound_s->decode_finished, memory_order_acquire)) {
+                ma_pcm_rb_commit_read(&pcm_rb, framesToRead);
+                stream_markers_add_read(framesToRead);
 
-                        pthread_mutex_lock(&sound_s->decoder_mutex);
+                writePtr += bytesToCopy;
+                totalFramesRead += framesToRead;
+                framesRemaining -= framesToRead;
+
+                atomic_fetch_add_explicit(&sound_s->track_frames_sent, framesToRead, memory_order_relaxed);
+        }
 
-                        // Only copy up to the track boundary
-                        framesToCopy = (ma_uint32)(boundary - played);
-                        atomic_store_explicit(&sound_s->request_switch_metadata, true, memory_order_relaxed);
-                        boundary_handled = true;
+        // Wake the decode thread for a track switch, or once it can refill a whole chunk
+        if (atomic_load_explicit(&waiting_for_space, memory_order_relaxed) &&
+            ma_pcm_rb_available_write(&pcm_rb) >= atomic_load_explicit(&space_low_watermark, memory_order_relaxed))
+                wake_decoder = true;
 
+        // Never block here, if the lock is taken try again on the next callback
+        if (wake_decoder || atomic_load_explicit(&decoder_wake_pending, memory_order_relaxed)) {
+                if (pthread_mutex_trylock(&sound_s->decoder_mutex) == 0) {
+                        atomic_store_explicit(&decoder_wake_pending, false, memory_order_relaxed);
                         pthread_cond_signal(&sound_s->decoder_cond);
                         pthread_mutex_unlock(&sound_s->decoder_mutex);
+                } else {
+                        atomic_store_explicit(&decoder_wake_pending, true, memory_order_relaxed);
                 }
-
-                // Copy frames
-                size_t bytesToCopy = framesToCopy * frameSize;
-                MA_COPY_MEMORY(writePtr, pReadBuffer, bytesToCopy);
-
-                // Apply Replay Gain
-                if (gain != 1.0f) {
-                        ma_uint64 total = framesToCopy * sound_s->channels;
-                        apply_gain_f32((float *)writePtr, total, gain);
-                }
-
-                ma_pcm_rb_commit_read(&pcm_rb, framesToCopy);
-
-                writePtr += bytesToCopy;
-                totalFramesRead += framesToCopy;
-                framesRemaining -= framesToCopy;
-
-                atomic_fetch_add_explicit(&sound_s->track_frames_sent, framesToCopy, memory_order_relaxed);
         }
 
-        visualizer_ringbuffer_push(pOutput, frameCount, sound_s->channels);
+        push_to_visualizer(pOutput, frameCount);
 }
 
 sound_result_t handle_codec(
@@ -940,14 +1214,21 @@ sound_result_t handle_codec(
         if (ops.decoder_type == M4A) {
                 get_m4a_file_info_full(file_path, &format, &channels, &sample_rate, channel_map, &avg_bit_rate, &file_type);
                 sound_s->avg_bit_rate = avg_bit_rate;
-        } else {
+        } else if (!preroll_get_format(file_path, &format, &channels, &sample_rate)) {
                 ops.get_file_info(file_path, &format, &channels, &sample_rate, channel_map);
         }
 #else
-        ops.get_file_info(file_path, &format, &channels, &sample_rate, channel_map);
+        // A kept lead-in already knows the format, don't open the file for it
+        if (!preroll_get_format(file_path, &format, &channels, &sample_rate))
+                ops.get_file_info(file_path, &format, &channels, &sample_rate, channel_map);
 #endif
 
-        format = ma_format_f32; // Hardcoded, float is used throughout
+        // A float pipeline carries any track. A passthrough one only carries
+        // tracks it can play untouched in the same format.
+        format = get_decoder_output_format();
+        if (format != ma_format_f32 &&
+            choose_output_format(&ops, file_path, sound_get_current_song_data()) != format)
+                format = ma_format_f32;
 
         void *decoder = get_current_decoder();
         if (decoder != NULL && ops.get_decoder_format)
@@ -968,8 +1249,10 @@ sound_result_t handle_codec(
 #endif
         }
 
+        // A changed buffer mode needs a new ring, so it takes effect on the next track
         if (repeat_state == SOUND_STATE_REPEAT ||
-            !(sameFormat && current_implementation == ops.decoder_type)) {
+            !(sameFormat && current_implementation == ops.decoder_type) ||
+            sound->buffer_mode != sound->applied_buffer_mode) {
                 set_decoder_type_switch_reached(true);
 
                 set_current_decoder_type(ops.decoder_type);
@@ -1073,7 +1356,7 @@ static int init_audio_data_from_codec_decoder(const CodecOps *ops, void *decoder
                 return -1;
         }
 
-        sound->format = ma_format_f32; // hard-coded. float is used throughout
+        sound->format = get_decoder_output_format();
 
         return 0;
 }
@@ -1096,7 +1379,9 @@ int init_first_datasource(sound_system_t *sound)
         if (!ops)
                 return MA_ERROR;
 
-        int result = prepare_next_decoder(file_path, song_data, ops);
+        set_decoder_output_format(choose_output_format(ops, file_path, song_data));
+
+        int result = prepare_next_decoder(file_path, ops);
         if (result == -1)
                 return -1;
 
@@ -1127,10 +1412,48 @@ void safe_ringbuffer_reset(ma_pcm_rb *pcm_rb)
         memset(pcm_rb, 0, sizeof(*pcm_rb)); // reset the entire struct safely
 }
 
+static void apply_buffer_mode(sound_system_t *sound)
+{
+        ma_uint32 rate = sound->sample_rate;
+
+        sound->applied_buffer_mode = sound->buffer_mode;
+
+        switch (sound->buffer_mode) {
+        case SOUND_BUFFER_POWER_SAVING: {
+                sound->ring_buffer_ms = POWER_SAVING_RING_MS;
+
+                ma_uint64 bytes_per_sec = (ma_uint64)rate * ma_get_bytes_per_frame(sound->format, sound->channels);
+                if (bytes_per_sec > 0 && bytes_per_sec * sound->ring_buffer_ms / 1000 > POWER_SAVING_MAX_BYTES)
+                        sound->ring_buffer_ms = (int)(POWER_SAVING_MAX_BYTES * 1000 / bytes_per_sec);
+
+                ma_uint32 ring_frames = (ma_uint32)(((ma_uint64)rate * sound->ring_buffer_ms) / 1000);
+
+                // Decode a second per step and only start once two thirds have drained
+                sound->chunk_frames = rate;
+                sound->refill_frames = ring_frames / 3 * 2;
+                break;
+        }
+
+        case SOUND_BUFFER_LOW_LATENCY:
+                sound->ring_buffer_ms = 500;
+                sound->chunk_frames = rate / 50;
+                sound->refill_frames = sound->chunk_frames;
+                break;
+
+        default:
+                sound->ring_buffer_ms = 3000;
+                sound->chunk_frames = rate / 10;
+                sound->refill_frames = sound->chunk_frames;
+                break;
+        }
+
+        if (sound->refill_frames < sound->chunk_frames)
+                sound->refill_frames = sound->chunk_frames;
+}
+
 int init_ring_buffer(sound_system_t *sound)
 {
-        // 3 seconds of buffer regardless of sample rate
-        ma_uint32 rbFrames = sound->sample_rate * sound->ring_buffer_secs;
+        ma_uint32 rbFrames = (ma_uint32)(((ma_uint64)sound->sample_rate * sound->ring_buffer_ms) / 1000);
 
         atomic_store(&sound->decode_finished, false);
         atomic_store(&sound->request_switch_metadata, false);
@@ -1154,6 +1477,58 @@ int init_ring_buffer(sound_system_t *sound)
         return 0;
 }
 
+// Sets up the device format from a kept lead-in so output can start before
+// the decoder is open. Only for tracks that would be decoded to float.
+static bool init_from_preroll(sound_system_t *sound)
+{
+        SongData *song_data = (sound->using_song_slot_A) ? sound->songdataA : sound->songdataB;
+
+        if (!song_data)
+                return false;
+
+        const CodecOps *ops = find_codec_ops(song_data->file_path);
+        ma_format native;
+        ma_uint32 channels, sample_rate;
+
+        if (!ops || !preroll_get_format(song_data->file_path, &native, &channels, &sample_rate))
+                return false;
+
+        if (!needs_float_output(ops, song_data) && output_format_for_native(native) != ma_format_f32)
+                return false;
+
+        set_decoder_output_format(ma_format_f32);
+
+        sound->format = ma_format_f32;
+        sound->channels = channels;
+        sound->sample_rate = sample_rate;
+        sound->current_frame = 0;
+        sound->fade_current_frame = 0;
+        sound->total_song_frames = 0;
+        sound->audio_thread_priority_set = MA_FALSE;
+
+        return true;
+}
+
+// Opens the decoder for a track whose output started from its lead-in. Runs
+// on the decode thread, or on the loader if it needs the decoder first.
+// Callers hold deferred_open_mutex.
+static void open_deferred_decoder(sound_system_t *sound)
+{
+        if (!atomic_exchange(&sound->deferred_open, false))
+                return;
+
+        // The device is already running in the lead-in's format
+        ma_uint32 channels = sound->channels;
+        ma_uint32 sample_rate = sound->sample_rate;
+
+        if (init_first_datasource(sound) != MA_SUCCESS)
+                k_log("Failed to open the decoder after the pre-rolled audio.\n");
+
+        sound->format = ma_format_f32;
+        sound->channels = channels;
+        sound->sample_rate = sample_rate;
+}
+
 sound_result_t create_audio_device(
     void *user_data,
     sound_system_t *sound,
@@ -1162,22 +1537,51 @@ sound_result_t create_audio_device(
     decoder_getter_func get_decoder,
     ma_data_callback_proc callback)
 {
-        ma_result result = init_first_datasource(sound_s);
+        // With the start of the track kept, output begins from that and the
+        // decoder is opened on the decode thread, so a skip doesn't wait on
+        // disk I/O or codec setup
+        bool deferred = init_from_preroll(sound_s);
 
-        sound_s->chunk_frames = sound_s->sample_rate / 10;
-        sound_s->ring_buffer_secs = 3;
+        if (!deferred) {
+                ma_result result = init_first_datasource(sound_s);
 
-        if (result != MA_SUCCESS)
-                return SOUND_ERROR;
+                if (result != MA_SUCCESS)
+                        return SOUND_ERROR;
 
-        void *decoder = get_decoder();
-        if (!decoder)
-                return SOUND_ERROR;
+                void *decoder = get_decoder();
+                if (!decoder)
+                        return SOUND_ERROR;
+        }
+
+        apply_buffer_mode(sound_s);
 
         init_ring_buffer(sound_s);
+        reset_stream_markers(sound_s);
 
         atomic_store(&sound_sys->track_frames_sent, 0);
-        sound_sys->total_frames = 0;
+
+        SongData *song_data = (sound_s->using_song_slot_A) ? sound_s->songdataA : sound_s->songdataB;
+
+        sound_s->preroll_frames = 0;
+
+        if (sound_s->format == ma_format_f32)
+                sound_s->preroll_frames = preroll_fill(song_data->file_path, sound_s->channels,
+                                                       sound_s->sample_rate, &pcm_rb);
+
+        // Dropped from the cache in the meantime, open the decoder here after all
+        if (deferred && sound_s->preroll_frames == 0) {
+                if (init_first_datasource(sound_s) != MA_SUCCESS || !get_decoder())
+                        return SOUND_ERROR;
+                deferred = false;
+        }
+
+        atomic_store(&sound_s->deferred_open, deferred);
+
+        stream_markers_add_written(sound_s->preroll_frames);
+        sound_sys->total_frames = sound_s->preroll_frames;
+
+        if (sound_s->preroll_frames > 0)
+                atomic_store(&sound_s->buffer_ready, 1);
 
         sound_result_t sound_result = init_playback_device(
             context,
@@ -1279,10 +1683,22 @@ int load_decoder(SongData *song_data, bool *song_data_deleted)
                 const CodecOps *ops = find_codec_ops(song_data->file_path);
                 if (!loader_data->loadingFirstDecoder) {
 
+                        // The current track has to be open before one can follow it
+                        pthread_mutex_lock(&deferred_open_mutex);
+                        open_deferred_decoder(sound_s);
+                        pthread_mutex_unlock(&deferred_open_mutex);
+
+                        ma_format output_format = get_decoder_output_format();
+
                         if (!ops)
                                 result = -1;
-                        else {
-                                result = prepare_next_decoder(song_data->file_path, song_data, ops);
+                        else if (output_format != ma_format_f32 &&
+                                 choose_output_format(ops, song_data->file_path, song_data) != output_format) {
+                                // Can't join a passthrough chain, start it on a new device instead
+                                result = -2;
+                                sound_s->fade_allowed = false;
+                        } else {
+                                result = prepare_next_decoder(song_data->file_path, ops);
                                 sound_s->fade_allowed = (result != -2);
                         }
                 } else {
@@ -1373,17 +1789,78 @@ int sound_get_bit_depth(ma_format format)
         return bit_depth;
 }
 
-void *song_data_reader_thread(void *arg)
+/* Song loader worker */
+
+// Loads run one at a time on a single worker. A request that makes an
+// older one pointless drops it from the queue, or cancels it if it is
+// already running.
+
+#define LOAD_QUEUE_SIZE 8
+
+typedef struct {
+        char file_path[KEW_PATH_MAX];
+        bool is_first_decoder;
+        bool replace_next_song;
+} LoadRequest;
+
+static LoadRequest load_queue[LOAD_QUEUE_SIZE];
+static int load_queue_count = 0;
+static LoadRequest active_load;
+static bool load_active = false;
+static atomic_bool active_load_cancelled = false;
+
+static pthread_mutex_t load_queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t load_queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t load_worker;
+static bool load_worker_running = false;
+static bool load_worker_stop = false;
+
+static atomic_ulong loads_started = 0;
+static atomic_ulong loads_completed = 0;
+static atomic_ulong loads_cancelled = 0;
+
+// Loading a first decoder starts over, and a replacement for the next song
+// makes an earlier next song load moot. Anything else depends on the loads
+// before it having finished.
+static bool load_supersedes(const LoadRequest *newer, const LoadRequest *older)
+{
+        return newer->is_first_decoder ||
+               (newer->replace_next_song && !older->is_first_decoder);
+}
+
+static bool load_is_cancelled(void)
 {
-        PlaybackState *ps = (PlaybackState *)arg;
+        return atomic_load_explicit(&active_load_cancelled, memory_order_acquire);
+}
+
+static void run_load(const LoadRequest *request)
+{
+        PlaybackState *ps = get_playback_state();
         LoaderData *loader_data = get_loader_data();
 
         pthread_mutex_lock(&(loader_data->mutex));
 
+        c_strcpy(loader_data->file_path, request->file_path, sizeof(loader_data->file_path));
+        loader_data->loadingFirstDecoder = request->is_first_decoder;
+        loader_data->replaceNextSong = request->replace_next_song;
+
         char filepath[KEW_PATH_MAX];
         c_strcpy(filepath, loader_data->file_path, sizeof(filepath));
 
-        SongData *songdata = exists_file(filepath) >= 0 ? load_song_data(filepath) : NULL;
+        SongData *songdata = song_cache_get(filepath);
+
+        if (songdata == NULL && exists_file(filepath) >= 0) {
+                songdata = load_song_data_cancellable(filepath, &active_load_cancelled);
+                song_cache_put(songdata);
+        }
+
+        // The request that replaced this one publishes its own result
+        if (load_is_cancelled()) {
+                unload_song_data(&songdata);
+                pthread_mutex_unlock(&(loader_data->mutex));
+                atomic_fetch_add(&loads_cancelled, 1);
+                return;
+        }
 
         if (loader_data->replaceNextSong) {
                 loader_data->loadInSlotA = !sound_is_using_slot_A();
@@ -1407,13 +1884,18 @@ void *song_data_reader_thread(void *arg)
 
         int result = assign_loaded_data();
 
-        if (result == -1)
+        if (result == -1) {
+                song_cache_remove(filepath);
                 songdata->hasErrors = true;
+        }
+
+        // Read before the slot can release its reference below
+        bool loaded = (songdata != NULL && !songdata->hasErrors);
 
         pthread_mutex_unlock(&(loader_data->mutex));
 
-        if (songdata == NULL || songdata->hasErrors) {
-                
+        if (!loaded) {
+
                 if (loader_data->loadInSlotA) {
 
                         song_loader_unload_song_A();
@@ -1438,14 +1920,127 @@ void *song_data_reader_thread(void *arg)
         ps->skipping = false;
         ps->songLoading = false;
 
+        atomic_fetch_add(&loads_completed, 1);
+
+        // Keep the start of the track decoded, so skipping to it is instant,
+        // and make sure seeking in it won't need a scan of the file
+        if (loaded && !load_is_cancelled())
+                preroll_prepare(filepath, find_codec_ops(filepath));
+
+        if (loaded && !load_is_cancelled())
+                seek_table_prepare(filepath);
+}
+
+static void *load_worker_thread(void *arg)
+{
+        (void)arg;
+
+        pthread_mutex_lock(&load_queue_mutex);
+
+        while (!load_worker_stop) {
+                if (load_queue_count == 0) {
+                        pthread_cond_wait(&load_queue_cond, &load_queue_mutex);
+                        continue;
+                }
+
+                active_load = load_queue[0];
+                load_queue_count--;
+                memmove(&load_queue[0], &load_queue[1], load_queue_count * sizeof(LoadRequest));
+
+                load_active = true;
+                atomic_store(&active_load_cancelled, false);
+
+                pthread_mutex_unlock(&load_queue_mutex);
+
+                atomic_fetch_add(&loads_started, 1);
+                run_load(&active_load);
+
+                pthread_mutex_lock(&load_queue_mutex);
+
+                load_active = false;
+        }
+
+        pthread_mutex_unlock(&load_queue_mutex);
+
         return NULL;
 }
 
-sound_result_t sound_load_song(const char *file_path, int is_first_decoder, int replace_next_song)
+static void queue_load(const LoadRequest *request)
 {
-        LoaderData *loader_data = get_loader_data();
-        PlaybackState *ps = get_playback_state();
+        pthread_mutex_lock(&load_queue_mutex);
+
+        if (!load_worker_running) {
+                load_worker_stop = false;
+
+                if (pthread_create(&load_worker, NULL, load_worker_thread, NULL) != 0) {
+                        k_log("Failed to create song loader thread.\n");
+                        pthread_mutex_unlock(&load_queue_mutex);
+                        return;
+                }
+
+                load_worker_running = true;
+        }
+
+        if (load_active && load_supersedes(request, &active_load))
+                atomic_store_explicit(&active_load_cancelled, true, memory_order_release);
+
+        int kept = 0;
+
+        for (int i = 0; i < load_queue_count; i++) {
+                if (load_supersedes(request, &load_queue[i])) {
+                        atomic_fetch_add(&loads_cancelled, 1);
+                        continue;
+                }
+
+                load_queue[kept++] = load_queue[i];
+        }
+
+        load_queue_count = kept;
+
+        if (load_queue_count == LOAD_QUEUE_SIZE) {
+                k_log("Song load queue full, dropping the oldest request.\n");
+                load_queue_count--;
+                memmove(&load_queue[0], &load_queue[1], load_queue_count * sizeof(LoadRequest));
+                atomic_fetch_add(&loads_cancelled, 1);
+        }
+
+        load_queue[load_queue_count++] = *request;
+
+        pthread_cond_signal(&load_queue_cond);
+        pthread_mutex_unlock(&load_queue_mutex);
+}
+
+static void stop_load_worker(void)
+{
+        pthread_mutex_lock(&load_queue_mutex);
+
+        if (!load_worker_running) {
+                pthread_mutex_unlock(&load_queue_mutex);
+                return;
+        }
+
+        load_worker_stop = true;
+        atomic_store(&active_load_cancelled, true);
+        atomic_fetch_add(&loads_cancelled, (unsigned long)load_queue_count);
+        load_queue_count = 0;
+
+        pthread_cond_signal(&load_queue_cond);
+        pthread_mutex_unlock(&load_queue_mutex);
+
+        pthread_join(load_worker, NULL);
+
+        load_worker_running = false;
+}
+
+void sound_get_load_stats(unsigned long *started, unsigned long *completed, unsigned long *cancelled)
+{
+        *started = atomic_load(&loads_started);
+        *completed = atomic_load(&loads_completed);
+        *cancelled = atomic_load(&loads_cancelled);
+}
 
+sound_result_t sound_load_song(const char *file_path, int is_first_decoder, int replace_next_song)
+{
         sound_result_t sound_result = SOUND_OK;
 
         if (find_codec_ops(file_path) == NULL) {
@@ -1453,14 +2048,12 @@ sound_result_t sound_load_song(const char *file_path, int is_first_decoder, int
                 return sound_result;
         }
 
-        c_strcpy(loader_data->file_path, file_path,
-                 sizeof(loader_data->file_path));
-
-        loader_data->loadingFirstDecoder = is_first_decoder;
-        loader_data->replaceNextSong = replace_next_song;
+        LoadRequest request;
+        c_strcpy(request.file_path, file_path, sizeof(request.file_path));
+        request.is_first_decoder = is_first_decoder;
+        request.replace_next_song = replace_next_song;
 
-        pthread_t loading_thread;
-        pthread_create(&loading_thread, NULL, song_data_reader_thread, ps);
+        queue_load(&request);
 
         return sound_result;
 }
@@ -1472,6 +2065,14 @@ void sound_switch_track_immediate(void)
 
 void sound_shutdown(void)
 {
+        stop_load_worker();
+
+#ifdef DEBUG
+        unsigned long started, completed, cancelled;
+        sound_get_load_stats(&started, &completed, &cancelled);
+        k_log("Song loads: %lu started, %lu completed, %lu cancelled\n", started, completed, cancelled);
+#endif
+
         pthread_mutex_destroy(&sound_s->decoder_mutex);
         pthread_cond_destroy(&sound_s->decoder_cond);
 
@@ -1479,6 +2080,8 @@ void sound_shutdown(void)
                 cleanup_playback_device();
                 cleanup_audio_context();
         }
+
+        preroll_clear();
 }
 
 void sound_ringbuffer_cleanup(void)
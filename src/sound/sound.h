@@ -80,6 +80,16 @@ sound_result_t sound_load_song(const char *file_path,
                      int is_first_decoder,
                      int is_next_song);
 
+/**
+ * @brief Gets counts of song loads since startup.
+ *
+ * @param started Loads the worker has begun.
+ * @param completed Loads whose result was published.
+ * @param cancelled Loads dropped from the queue or abandoned midway
+ *                  because a newer request replaced them.
+ */
+void sound_get_load_stats(unsigned long *started, unsigned long *completed, unsigned long *cancelled);
+
 /**
  * @brief Returns the currently active SongData.
  *
@@ -155,6 +165,15 @@ bool sound_is_using_slot_A(void);
  */
 int sound_get_bit_depth(ma_format format);
 
+/**
+ * @brief Wakes the decode thread.
+ *
+ * The decode thread sleeps while the ring buffer is full or playback is
+ * paused. Call this after requesting something it has to act on, such as
+ * a seek, a skip or resuming playback.
+ */
+void sound_wake_decoder(void);
+
 /**
  * @brief Starts a cross-fade
  *
@@ -27,6 +27,8 @@
 #include "sound/audiobuffer.h"
 #include "volume.h"
 
+#include "utils/dsp_kernels.h"
+
 sound_result_t sound_system_create(sound_system_t **out_system)
 {
         if (!out_system)
@@ -58,6 +60,8 @@ sound_result_t sound_system_create(sound_system_t **out_system)
 
         pthread_cond_init(&sound_s->decoder_cond, NULL);
 
+        dsp_kernels_init();
+
         sound_result_t sound_result = sound_create_audio_device();
 
         if (sound_result < 0) {
@@ -187,6 +191,7 @@ sound_result_t sound_system_stop_decoding(sound_system_t *system)
                 return SOUND_ERROR_NOT_INITIALIZED;
 
         set_current_decoder_type(NONE);
+        sound_wake_decoder();
 
         return SOUND_OK;
 }
@@ -343,6 +348,11 @@ int sound_system_get_bit_depth(const sound_system_t *system)
         return sound_get_bit_depth(system->format);
 }
 
+void sound_system_get_load_stats(unsigned long *started, unsigned long *completed, unsigned long *cancelled)
+{
+        sound_get_load_stats(started, completed, cancelled);
+}
+
 sound_result_t sound_system_set_buffer_ready(const sound_system_t *system, int value)
 {
         if (!system)
@@ -476,6 +486,32 @@ sound_result_t sound_system_set_replay_gain_check_first(sound_system_t *system,
         return SOUND_OK;
 }
 
+sound_result_t sound_system_set_buffer_mode(sound_system_t *system, int value)
+{
+        if (!system)
+                return SOUND_ERROR_NOT_INITIALIZED;
+
+        if (value < SOUND_BUFFER_BALANCED || value > SOUND_BUFFER_LOW_LATENCY)
+                value = SOUND_BUFFER_BALANCED;
+
+        system->buffer_mode = value;
+
+        return SOUND_OK;
+}
+
+sound_result_t sound_system_set_crossfade_curve(sound_system_t *system, int value)
+{
+        if (!system)
+                return SOUND_ERROR_NOT_INITIALIZED;
+
+        if (value < SOUND_FADE_EQUAL_POWER || value > SOUND_FADE_S_CURVE)
+                value = SOUND_FADE_EQUAL_POWER;
+
+        system->fade_curve = value;
+
+        return SOUND_OK;
+}
+
 sound_result_t sound_system_set_always_crossfade(sound_system_t *system, int value, int fade_ms)
 {
         if (!system)
@@ -499,7 +535,7 @@ int sound_system_get_sample_rate(const sound_system_t *system)
 
 int sound_system_get_fade_offset_seconds(const sound_system_t *system)
 {
-        return system->ring_buffer_secs;
+        return system->ring_buffer_ms / 1000;
 }
 
 int sound_system_is_deconding_possible(const sound_system_t *system, const char *file_path)
@@ -308,6 +308,34 @@ sound_result_t sound_system_set_end_of_list_reached(sound_system_t *system, int
  */
 sound_result_t sound_system_set_replay_gain_check_first(sound_system_t *system, int value);
 
+/**
+ * @brief Sets how the decoder fills the ring buffer.
+ *
+ * Balanced keeps a few seconds buffered and tops it up in small steps.
+ * Power saving keeps tens of seconds buffered and refills it in one burst
+ * once it has drained, so the decode thread and the disk can idle in
+ * between. Low latency keeps a short buffer. A change takes effect from
+ * the next track, which then gets a new audio device and ring buffer.
+ *
+ * @param system Pointer to the sound system instance.
+ * @param value  0=balanced, 1=power saving, 2=low latency.
+ *
+ * @return sound_result_t Status code indicating success or failure.
+ */
+sound_result_t sound_system_set_buffer_mode(sound_system_t *system, int value);
+
+/**
+ * @brief Sets the shape of crossfades.
+ *
+ * Takes effect from the next crossfade.
+ *
+ * @param system Pointer to the sound system instance.
+ * @param value  0=equal power, 1=linear, 2=S-curve.
+ *
+ * @return sound_result_t Status code indicating success or failure.
+ */
+sound_result_t sound_system_set_crossfade_curve(sound_system_t *system, int value);
+
 /**
  * @brief Sets whether the output audio buffer is ready.
  *
@@ -506,6 +534,18 @@ int sound_system_get_sample_rate(const sound_system_t *system);
  */
 int sound_system_get_bit_depth(const sound_system_t *system);
 
+/**
+ * @brief Gets counts of song loads since startup.
+ *
+ * A load is cancelled when a newer request makes it pointless, for
+ * instance when skipping through tracks faster than they load.
+ *
+ * @param started Output, loads begun.
+ * @param completed Output, loads finished.
+ * @param cancelled Output, loads dropped or abandoned.
+ */
+void sound_system_get_load_stats(unsigned long *started, unsigned long *completed, unsigned long *cancelled);
+
 /**
  * @brief Returns the current output audio buffer
  *
@@ -0,0 +1,99 @@
+/**
+ * @file stream_markers.c
+ * @brief Event records that travel alongside the PCM ring buffer.
+ *
+ * Fixed-size single producer, single consumer queue.
+ */
+
+#include "stream_markers.h"
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+// Power of two. A handful of records are in flight at most.
+#define MARKER_CAPACITY 64
+
+static StreamMarker markers[MARKER_CAPACITY];
+
+// head is only written by the producer, tail only by the consumer
+static atomic_uint head = 0;
+static atomic_uint tail = 0;
+
+static uint64_t frames_written = 0;
+static uint64_t frames_read = 0;
+
+void stream_markers_reset(void)
+{
+        atomic_store_explicit(&head, 0, memory_order_relaxed);
+        atomic_store_explicit(&tail, 0, memory_order_relaxed);
+
+        frames_written = 0;
+        frames_read = 0;
+
+        atomic_thread_fence(memory_order_seq_cst);
+}
+
+void stream_markers_add_written(uint64_t frames)
+{
+        frames_written += frames;
+}
+
+bool stream_markers_push(stream_marker_type_t type, float gain)
+{
+        unsigned h = atomic_load_explicit(&head, memory_order_relaxed);
+        unsigned t = atomic_load_explicit(&tail, memory_order_acquire);
+
+        if (h - t >= MARKER_CAPACITY)
+                return false;
+
+        StreamMarker *m = &markers[h & (MARKER_CAPACITY - 1)];
+        m->type = type;
+        m->frame = frames_written;
+        m->gain = gain;
+
+        atomic_store_explicit(&head, h + 1, memory_order_release);
+
+        return true;
+}
+
+void stream_markers_add_read(uint64_t frames)
+{
+        frames_read += frames;
+}
+
+static const StreamMarker *peek(void)
+{
+        unsigned t = atomic_load_explicit(&tail, memory_order_relaxed);
+        unsigned h = atomic_load_explicit(&head, memory_order_acquire);
+
+        if (t == h)
+                return NULL;
+
+        return &markers[t & (MARKER_CAPACITY - 1)];
+}
+
+bool stream_markers_take_due(StreamMarker *marker)
+{
+        const StreamMarker *m = peek();
+
+        if (m == NULL || m->frame > frames_read)
+                return false;
+
+        *marker = *m;
+
+        atomic_fetch_add_explicit(&tail, 1, memory_order_release);
+
+        return true;
+}
+
+uint32_t stream_markers_clamp(uint32_t frames)
+{
+        const StreamMarker *m = peek();
+
+        if (m == NULL || m->frame <= frames_read)
+                return frames;
+
+        uint64_t until = m->frame - frames_read;
+
+        return until < frames ? (uint32_t)until : frames;
+}
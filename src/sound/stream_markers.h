@@ -0,0 +1,78 @@
+/**
+ * @file stream_markers.h
+ * @brief Event records that travel alongside the PCM ring buffer.
+ *
+ * The decode thread stamps each record with the number of frames it has
+ * written to the ring buffer so far. The audio callback counts the frames
+ * it reads, and acts on a record when playback reaches that frame, so
+ * track boundaries and gain changes happen at the exact sample without
+ * the two threads comparing shared counters or taking a lock.
+ *
+ * Single producer (the decode thread), single consumer (the audio
+ * callback). stream_markers_reset() may only be called while the device
+ * is stopped, together with a reset of the ring buffer.
+ */
+
+#ifndef STREAM_MARKERS_H
+#define STREAM_MARKERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum {
+        STREAM_MARKER_TRACK_START, // A crossfade into the next track begins
+        STREAM_MARKER_TRACK_END,   // The last frame of a track has been played
+        STREAM_MARKER_GAIN         // Gain to apply from this frame on
+} stream_marker_type_t;
+
+typedef struct {
+        stream_marker_type_t type;
+        uint64_t frame;
+        float gain;
+} StreamMarker;
+
+/**
+ * @brief Drops all records and starts both frame counts from zero.
+ */
+void stream_markers_reset(void);
+
+/**
+ * @brief Counts frames committed to the ring buffer. Decode thread only.
+ *
+ * @param frames Number of frames written.
+ */
+void stream_markers_add_written(uint64_t frames);
+
+/**
+ * @brief Queues a record for the frame that will be written next. Decode thread only.
+ *
+ * @param type The kind of record.
+ * @param gain The linear gain for STREAM_MARKER_GAIN, ignored otherwise.
+ * @return false if the queue is full.
+ */
+bool stream_markers_push(stream_marker_type_t type, float gain);
+
+/**
+ * @brief Counts frames read from the ring buffer. Audio callback only.
+ *
+ * @param frames Number of frames read.
+ */
+void stream_markers_add_read(uint64_t frames);
+
+/**
+ * @brief Takes the next record if playback has reached it. Audio callback only.
+ *
+ * @param marker Output, the record.
+ * @return true if a record was due and has been removed from the queue.
+ */
+bool stream_markers_take_due(StreamMarker *marker);
+
+/**
+ * @brief Limits a read so it stops at the next record. Audio callback only.
+ *
+ * @param frames The number of frames the callback wants to read.
+ * @return frames, or fewer if a record falls inside them.
+ */
+uint32_t stream_markers_clamp(uint32_t frames);
+
+#endif
@@ -15,6 +15,8 @@ extern "C" {
 
 #include "miniaudio.h"
 
+#include "file_reader.h"
+
 #if !defined(MA_NO_WEBM)
 
 #include <nestegg/nestegg.h>
@@ -69,6 +71,9 @@ typedef struct
 
         float opusLeftoverBuffer[MAX_OPUS_SAMPLES * MAX_OPUS_CHANNELS];
         float vorbisLeftoverBuffer[MAX_VORBIS_PACKET_FRAMES * MAX_VORBIS_CHANNELS];
+
+        // For ma_webm_init_file, nestegg reads through a reusable window
+        FileReader file;
 #endif
 } ma_webm;
 
@@ -524,18 +529,16 @@ MA_API ma_result ma_webm_init(
 
 int nread(void *buf, size_t len, void *ud)
 {
-        FILE *f = (FILE *)ud;
-        size_t r = fread(buf, 1, len, f);
+        FileReader *f = (FileReader *)ud;
+        size_t r = file_reader_read(f, buf, len);
         if (r == len)
                 return 1;
-        if (feof(f))
-                return 0;
-        return -1;
+        return 0;
 }
 
 int nseek(int64_t o, int w, void *ud)
 {
-        FILE *f = (FILE *)ud;
+        FileReader *f = (FileReader *)ud;
         int wh;
         switch (w) {
         case NESTEGG_SEEK_SET:
@@ -550,13 +553,13 @@ int nseek(int64_t o, int w, void *ud)
         default:
                 return -1;
         }
-        return fseek(f, (long)o, wh);
+        return file_reader_seek(f, o, wh);
 }
 
 int64_t ntell(void *ud)
 {
-        FILE *f = (FILE *)ud;
-        return ftell(f);
+        FileReader *f = (FileReader *)ud;
+        return file_reader_tell(f);
 }
 
 MA_API ma_result ma_webm_init_file(const char *pFilePath, const ma_decoding_backend_config *p_config, const ma_allocation_callbacks *p_allocation_callbacks, ma_webm *p_webm)
@@ -571,15 +574,14 @@ MA_API ma_result ma_webm_init_file(const char *pFilePath, const ma_decoding_back
         }
 
 #if !defined(MA_NO_WEBM)
-        FILE *fp = fopen(pFilePath, "rb");
-        if (!fp)
+        if (file_reader_open(&p_webm->file, pFilePath) != 0)
                 return MA_INVALID_FILE;
 
-        nestegg_io io = {nread, nseek, ntell, fp};
+        nestegg_io io = {nread, nseek, ntell, &p_webm->file};
         nestegg *ctx = NULL;
 
         if (nestegg_init(&ctx, io, NULL, -1) < 0) {
-                fclose(fp);
+                file_reader_close(&p_webm->file);
                 return MA_INVALID_FILE;
         }
 
@@ -598,7 +600,7 @@ MA_API ma_result ma_webm_init_file(const char *pFilePath, const ma_decoding_back
         }
         if (p_webm->audio_track == (unsigned int)(-1)) {
                 nestegg_destroy(ctx);
-                fclose(fp);
+                file_reader_close(&p_webm->file);
                 return MA_ERROR;
         }
 
@@ -609,7 +611,7 @@ MA_API ma_result ma_webm_init_file(const char *pFilePath, const ma_decoding_back
                 nestegg_track_codec_data(ctx, p_webm->audio_track, 0, &header, &header_size);
                 if (header_size < 19 || memcmp(header, "OpusHead", 8) != 0) {
                         nestegg_destroy(ctx);
-                        fclose(fp);
+                        file_reader_close(&p_webm->file);
                         return MA_ERROR;
                 }
                 p_webm->channels = header[9];
@@ -622,7 +624,7 @@ MA_API ma_result ma_webm_init_file(const char *pFilePath, const ma_decoding_back
                 p_webm->opusDecoder = opus_decoder_create(48000, p_webm->channels, &opusErr);
                 if (!p_webm->opusDecoder) {
                         nestegg_destroy(ctx);
-                        fclose(fp);
+                        file_reader_close(&p_webm->file);
                         return MA_ERROR;
                 }
 
@@ -631,11 +633,12 @@ MA_API ma_result ma_webm_init_file(const char *pFilePath, const ma_decoding_back
         } else if (p_webm->codec_id == NESTEGG_CODEC_VORBIS) {
                 if (ma_webm_init_vorbis_decoder(ctx, p_webm->audio_track, p_webm) != 0) {
                         nestegg_destroy(ctx);
+                        file_reader_close(&p_webm->file);
                         return MA_INVALID_FILE;
                 }
         } else {
                 nestegg_destroy(ctx);
-                fclose(fp);
+                file_reader_close(&p_webm->file);
                 return MA_NOT_IMPLEMENTED;
         }
 
@@ -677,6 +680,8 @@ MA_API void ma_webm_uninit(ma_webm *p_webm, const ma_allocation_callbacks *p_all
                         nestegg_destroy(p_webm->ctx);
                         p_webm->ctx = NULL;
                 }
+
+                file_reader_close(&p_webm->file);
         }
 #else
         {
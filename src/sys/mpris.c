@@ -15,6 +15,10 @@
 
 #include "sys_integration.h"
 
+#include "data/playlist_snapshot.h"
+
+#include "loader/song_loader.h"
+
 #include "ui/control_ui.h"
 #include "ui/input.h"
 
@@ -620,7 +624,7 @@ static gboolean get_metadata(GDBusConnection *connection, const gchar *sender,
                     g_variant_new_string(current_song_data->metadata->date));
 
                 gchar *coverArtUrl =
-                    cover_art_path_to_uri(current_song_data->cover_art_path);
+                    cover_art_path_to_uri(songdata_cover_path(current_song_data));
                 if (coverArtUrl) {
                         g_variant_builder_add(&metadata_builder, "{sv}",
                                               "mpris:artUrl",
@@ -775,7 +779,7 @@ static gboolean get_can_go_next(GDBusConnection *connection,
         can_go_next =
             (current == NULL || current->next != NULL) ? TRUE : FALSE;
         can_go_next =
-            (is_repeat_list_enabled() && playlist->head != NULL) ? TRUE : can_go_next;
+            (is_repeat_list_enabled() && playlist_snapshot_count(playlist) > 0) ? TRUE : can_go_next;
 
         *value = g_variant_new_boolean(can_go_next);
 
@@ -822,7 +826,7 @@ static gboolean get_can_play(GDBusConnection *connection, const gchar *sender,
 
         Model *model = get_model();
 
-        if (get_current_song() == NULL && model->playlist->count == 0)
+        if (get_current_song() == NULL && playlist_snapshot_count(model->playlist) == 0)
                 can_play = FALSE;
         else
                 can_play = TRUE;
@@ -1365,7 +1369,7 @@ void emit_metadata_changed(const gchar *title, const gchar *artist,
         can_go_next =
             (current_song == NULL || current_song->next != NULL) ? TRUE : FALSE;
         can_go_next =
-            (is_repeat_list_enabled() && playlist->head != NULL) ? TRUE : can_go_next;
+            (is_repeat_list_enabled() && playlist_snapshot_count(playlist) > 0) ? TRUE : can_go_next;
 
         g_variant_builder_add(&changed_properties_builder, "{sv}", "CanGoNext",
                               g_variant_new_boolean(can_go_next));
@@ -20,6 +20,8 @@
 #endif
 #include "notifications.h"
 
+#include "loader/song_loader.h"
+
 #include "utils/file.h"
 #include "utils/term.h"
 #include "utils/utils.h"
@@ -225,7 +227,7 @@ void notify_mpris_switch(SongData *current_song_data)
         // Update mpris
         emit_metadata_changed(
             current_song_data->metadata->title, current_song_data->metadata->artist,
-            current_song_data->metadata->album, current_song_data->cover_art_path,
+            current_song_data->metadata->album, songdata_cover_path(current_song_data),
             current_song_data->track_id != NULL ? current_song_data->track_id : "",
             get_current_song(), length);
 }
@@ -241,7 +243,7 @@ void notify_song_switch(SongData *current_song_data)
 #ifdef USE_DBUS
                 display_song_notification(current_song_data->metadata->artist,
                                           current_song_data->metadata->title,
-                                          current_song_data->cover_art_path, ui);
+                                          songdata_cover_path(current_song_data), ui);
 #else
                 (void)ui;
 #endif
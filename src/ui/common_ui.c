@@ -198,6 +198,10 @@ void transfer_settings_to_ui(void)
         if (tmp >= 0)
                 ui->replayGainCheckFirst = tmp;
 
+        tmp = get_number(settings->bufferMode);
+        if (tmp >= 0 && tmp < 3)
+                ui->bufferMode = tmp;
+
         tmp = get_number(settings->mouseLeftClickAction);
 
         enum MsgType tmp_event = get_mouse_action(tmp);
@@ -550,37 +554,47 @@ PixelData get_gradient_color(PixelData base_color, int row, int max_list_size,
         return decrease_luminosity_pct(base_color, pct);
 }
 
+int get_lyrics_index(const Lyrics *lyrics, double elapsed_seconds)
+{
+        if (!lyrics || lyrics->count == 0)
+                return -1;
+
+        // Timestamps are sorted, find the first one still ahead
+        size_t lo = 0;
+        size_t hi = lyrics->count;
+
+        while (lo < hi) {
+                size_t mid = lo + (hi - lo) / 2;
+                double ts = lyrics->timestamps ? lyrics->timestamps[mid] : lyrics->lines[mid].timestamp;
+
+                if (ts <= elapsed_seconds)
+                        lo = mid + 1;
+                else
+                        hi = mid;
+        }
+
+        return (int)lo - 1;
+}
+
 const char *get_lyrics_line(const Lyrics *lyrics,
                     int* lyricIndex,
                     double elapsed_seconds
 ) {
-        if (!lyrics || lyrics->count == 0)
-                return "";
-
         static char line[1024];
         line[0] = '\0';
 
-        double last_timestamp = -1.0;
-        size_t i = 0;
-        for (; i < lyrics->count; i++) {
-                double ts = lyrics->lines[i].timestamp;
-                const char *text = lyrics->lines[i].text;
+        int i = get_lyrics_index(lyrics, elapsed_seconds);
 
-                if (elapsed_seconds < ts)
-                        break;
+        *lyricIndex = i > 0 ? i : 0;
 
-                if (ts == last_timestamp) {
-                        // Same timestamp → append
-                        strncat(line, " | ", sizeof(line) - strlen(line) - 1);
-                        strncat(line, text, sizeof(line) - strlen(line) - 1);
-                } else {
-                        // New timestamp → start fresh
-                        snprintf(line, sizeof(line), "%s", text);
-                        last_timestamp = ts;
-                }
-        }
+        if (i < 0)
+                return line;
+
+        // Lines sharing a timestamp were joined when the lyrics were loaded
+        const char *text = lyrics->joined && lyrics->joined[i] ? lyrics->joined[i] : lyrics->lines[i].text;
+
+        snprintf(line, sizeof(line), "%s", text ? text : "");
 
-        *lyricIndex = i > 0 ? i - 1 : 0;
         return line;
 }
 
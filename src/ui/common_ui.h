@@ -224,6 +224,15 @@ PixelData decrease_luminosity_pct(PixelData base, float pct);
  */
 PixelData get_gradient_color(PixelData base_color, int row, int max_list_size, int start_gradient, float min_pct);
 
+/**
+ * @brief Returns the index of the current line of timed lyrics.
+ *
+ * @param lyrics A struct containing the lyrics.
+ * @param elapsed_seconds How far we are into the song.
+ * @return The last line whose timestamp has passed, or -1 if none has.
+ */
+int get_lyrics_index(const Lyrics *lyrics, double elapsed_seconds);
+
 /**
  * @brief Returns the current line of lyrics.
  *
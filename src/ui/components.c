@@ -13,6 +13,7 @@
 
 #include "data/directorytree.h"
 #include "data/img_func.h"
+#include "data/playlist_snapshot.h"
 
 #include "ops/library_ops.h"
 #include "ops/playback_state.h"
@@ -60,22 +61,21 @@ void render_scroll_bar(DrawBuffer *buf, k_Rect region, k_ScrollBar scrollbar, Ce
         draw_buffer_set_string_truncated(buf, row + 2, region.col + region.width - 1, "█", 1, style);
 }
 
-void prepare_playlist_string(Node *node, char *buffer, int buffer_size)
+void prepare_playlist_string(const char *song_path, char *buffer, int buffer_size)
 {
-        if (node == NULL || buffer == NULL || node->song.file_path == NULL ||
-            buffer_size <= 0) {
+        if (buffer == NULL || song_path == NULL || buffer_size <= 0) {
                 if (buffer && buffer_size > 0)
                         buffer[0] = '\0';
                 return;
         }
 
-        if (strnlen(node->song.file_path, KEW_PATH_MAX) >= KEW_PATH_MAX) {
+        if (strnlen(song_path, KEW_PATH_MAX) >= KEW_PATH_MAX) {
                 buffer[0] = '\0';
                 return;
         }
 
         char file_path[KEW_PATH_MAX];
-        c_strcpy(file_path, node->song.file_path, sizeof(file_path));
+        c_strcpy(file_path, song_path, sizeof(file_path));
 
         char *last_slash = strrchr(file_path, '/');
         size_t len = strnlen(file_path, sizeof(file_path));
@@ -835,7 +835,7 @@ static void render_glimmer_frame(const Model *model, DrawBuffer *buf, const char
         draw_buffer_set_string_truncated(buf, row, draw_col, icons, max_width, style);
 }
 
-static int draw_cover_ascii(const TermSize *term_size, const char *path, int row, int col,
+static int draw_cover_ascii(const TermSize *term_size, const SongData *songdata, int row, int col,
                             unsigned int height, bool centered,
                             DrawBuffer *buf, DirtyFlags dirty)
 {
@@ -859,10 +859,12 @@ static int draw_cover_ascii(const TermSize *term_size, const char *path, int row
         float aspect = (float)cell_height / (float)cell_width;
         unsigned int corr_w = (unsigned int)(height * aspect);
 
-        int rwidth, rheight, rchannels;
+        int rwidth = songdata->coverWidth;
+        int rheight = songdata->coverHeight;
 
+        // Use the already decoded cover rather than reading the file again
         unsigned char *read_data =
-            image_load_rgb(path, &rwidth, &rheight, &rchannels);
+            image_rgba_to_rgb(songdata->cover, rwidth, rheight);
 
         if (!read_data)
                 return -1;
@@ -1031,7 +1033,7 @@ ComponentMsg component_side_cover(const Model *model, k_Rect region, DrawBuffer
                 if (dirty & DIRTY_SONG) {
 
                         if (ui->coverAnsi) {
-                                draw_cover_ascii(term_size, songdata->cover_art_path,
+                                draw_cover_ascii(term_size, songdata,
                                                  row, col, target_height,
                                                  false, buf, dirty);
                                 corrected_height = target_height + 1;
@@ -1124,7 +1126,7 @@ ComponentMsg component_cover(const Model *model, k_Rect region, DrawBuffer *buf,
                 return (ComponentMsg){0};
 
         if (state->settings.coverAnsi && songdata->cover) {
-                draw_cover_ascii(&model->term_size, songdata->cover_art_path,
+                draw_cover_ascii(&model->term_size, songdata,
                                  row, region.col,
                                  region.height, false, buf, dirty);
         }
@@ -1162,7 +1164,7 @@ ComponentMsg component_cover_centered(const Model *model, k_Rect region, DrawBuf
                 return (ComponentMsg){0};
 
         if (state->settings.coverAnsi && songdata->cover) {
-                draw_cover_ascii(&model->term_size, songdata->cover_art_path,
+                draw_cover_ascii(&model->term_size, songdata,
                                  region.row, region.col,
                                  region.height, true, buf, dirty);
         }
@@ -1241,7 +1243,7 @@ ComponentMsg component_landscape_cover(const Model *model, k_Rect region, DrawBu
                 return (ComponentMsg){0};
 
         if (ui->coverAnsi) {
-                draw_cover_ascii(&model->term_size, songdata->cover_art_path,
+                draw_cover_ascii(&model->term_size, songdata,
                                  row, col, target_height,
                                  false, buf, dirty);
         }
@@ -1616,9 +1618,12 @@ ComponentMsg component_playlist_rows(const Model *model, k_Rect region, DrawBuff
         (void)dirty;
 
         const UISettings *ui = &model->state.settings;
-        const PlayList *list = model->playlist;
         const UIState *uis = &model->state.ui;
 
+        // Read the published copy of the list, so rendering never walks nodes
+        // that a background enqueue may be relinking.
+        const PlaylistSnapshot *list = playlist_snapshot_get(model->unshuffled_playlist);
+
         if (!list)
                 return (ComponentMsg){0};
 
@@ -1634,13 +1639,26 @@ ComponentMsg component_playlist_rows(const Model *model, k_Rect region, DrawBuff
         bool clicked_song = false;
         long chosen_name_len = 0;
 
-        Node *node = model->state.ui.playlist_node;
-        Node *chosen_node = NULL;
+        int idx = start_iter;
+        int chosen_id = -1;
         CellStyle header = cell_style_from_theme(ui->theme.header);
         CellStyle playing_style = cell_style_from_theme(ui->theme.playlist_playing);
 
         draw_buffer_set_string(buf, row_offset, region.col, _("─ PLAYLIST ─"), header);
 
+        // Total length of the queue, filled in as durations get probed
+        if (list->total_duration > 0.0) {
+                char total[32];
+                int secs = (int)list->total_duration;
+
+                snprintf(total, sizeof(total), "%02d:%02d:%02d", secs / 3600, (secs / 60) % 60, secs % 60);
+
+                int total_len = utf8_display_width(total);
+
+                if (region.width > total_len + 16)
+                        draw_buffer_set_string(buf, row_offset, region.col + region.width - total_len - 2, total, header);
+        }
+
         row_offset++;
 
         bool found_chosen = false;
@@ -1657,7 +1675,9 @@ ComponentMsg component_playlist_rows(const Model *model, k_Rect region, DrawBuff
                 int draw_row = row_offset + printed;
                 int col = region.col;
 
-                if (node == NULL) {
+                const PlaylistSnapshotEntry *entry = (idx >= 0 && idx < list->count) ? &list->entries[idx] : NULL;
+
+                if (entry == NULL) {
                         draw_buffer_set_string_truncated(buf, draw_row, col, filename, region.width, cell_style_plain());
 
                         printed++;
@@ -1665,10 +1685,10 @@ ComponentMsg component_playlist_rows(const Model *model, k_Rect region, DrawBuff
                         continue;
                 }
 
-                prepare_playlist_string(node, buffer, KEW_NAME_MAX);
+                prepare_playlist_string(entry->file_path, buffer, KEW_NAME_MAX);
 
                 if (buffer[0] == '\0') {
-                        node = node->next;
+                        idx++;
                         i++;
                         continue;
                 }
@@ -1751,19 +1771,19 @@ ComponentMsg component_playlist_rows(const Model *model, k_Rect region, DrawBuff
                         }
                 }
 
-                if (node->next == NULL && !found_chosen)
+                if (idx == list->count - 1 && !found_chosen)
                         is_chosen = found_chosen = true; // Chose the last one if none has been found
 
                 bool is_playing = false;
 
                 Node *current = get_current_song();
                 if (current != NULL)
-                        is_playing = (current->id == node->id);
+                        is_playing = (current->id == entry->id);
 
                 if (is_chosen) {
                         process_name_scroll(model, buffer, filename, max_name_width, true, true);
                         chosen_row = i;
-                        chosen_node = node;
+                        chosen_id = entry->id;
                         found_chosen = true;
                 }
 
@@ -1780,7 +1800,7 @@ ComponentMsg component_playlist_rows(const Model *model, k_Rect region, DrawBuff
 
                 draw_buffer_set_string_truncated(buf, draw_row, col, filename, region.width, title_style);
 
-                node = node->next;
+                idx++;
                 printed++;
         }
 
@@ -1791,7 +1811,7 @@ ComponentMsg component_playlist_rows(const Model *model, k_Rect region, DrawBuff
         result.has_msg = true;
         result.msg = (struct Msg){
             .type = MSG_PLAYLIST_ROW_SELECTED,
-            .chosen_song = chosen_node,
+            .chosen_song_id = chosen_id,
             .chosen_row = chosen_row,
             .chosen_name_len = (int)chosen_name_len,
             .clicked_song = clicked_song};
@@ -2634,12 +2654,7 @@ ComponentMsg component_lyrics_page(const Model *model, k_Rect region, DrawBuffer
         int highlight = -1;
 
         if (lyrics->isTimed) {
-                for (int i = 0; i < (int)lyrics->count; i++) {
-                        if (lyrics->lines[i].timestamp <= seconds)
-                                highlight = i;
-                        else
-                                break;
-                }
+                highlight = get_lyrics_index(lyrics, seconds);
                 if (highlight > height / 2)
                         offset = highlight - (height / 2);
         } else {
@@ -20,6 +20,8 @@
 
 #include "common/appstate.h"
 
+#include "loader/song_cache.h"
+
 #include "ops/playback_state.h"
 
 #include "utils/file.h"
@@ -913,6 +915,8 @@ void set_default_config(AppSettings *settings)
         c_strcpy(settings->mouseEnabled, "1", sizeof(settings->mouseEnabled));
         c_strcpy(settings->replayGainCheckFirst, "0",
                  sizeof(settings->replayGainCheckFirst));
+        c_strcpy(settings->bufferMode, "0",
+                 sizeof(settings->bufferMode));
         c_strcpy(settings->visualizer_bar_width, "2",
                  sizeof(settings->visualizer_bar_width));
         c_strcpy(settings->visualizerBrailleMode, "0",
@@ -965,6 +969,9 @@ void set_default_config(AppSettings *settings)
         c_strcpy(settings->fade_quick_ms, "3000", sizeof(settings->fade_quick_ms));
         c_strcpy(settings->fade_medium_ms, "5000", sizeof(settings->fade_medium_ms));
         c_strcpy(settings->fade_slow_ms, "10000", sizeof(settings->fade_slow_ms));
+        c_strcpy(settings->crossfade_curve, "0", sizeof(settings->crossfade_curve));
+        snprintf(settings->song_cache_entries, sizeof(settings->song_cache_entries), "%d", SONG_CACHE_DEFAULT_ENTRIES);
+        snprintf(settings->song_cache_mb, sizeof(settings->song_cache_mb), "%d", SONG_CACHE_DEFAULT_MB);
 
         memcpy(settings->ansiTheme, "default", 8);
 }
@@ -1292,6 +1299,15 @@ void construct_app_settings(AppSettings *settings, KeyValuePair *pairs, int coun
                 } else if (strcmp(lowercase_key, "fadeslowms") == 0) {
                         snprintf(settings->fade_slow_ms, sizeof(settings->fade_slow_ms),
                                  "%s", pair->value);
+                } else if (strcmp(lowercase_key, "crossfadecurve") == 0) {
+                        snprintf(settings->crossfade_curve, sizeof(settings->crossfade_curve),
+                                 "%s", pair->value);
+                } else if (strcmp(lowercase_key, "songcacheentries") == 0) {
+                        snprintf(settings->song_cache_entries, sizeof(settings->song_cache_entries),
+                                 "%s", pair->value);
+                } else if (strcmp(lowercase_key, "songcachemb") == 0) {
+                        snprintf(settings->song_cache_mb, sizeof(settings->song_cache_mb),
+                                 "%s", pair->value);
                 } else if (strcmp(lowercase_key, "volumeup") == 0) {
                         snprintf(settings->volumeUp, sizeof(settings->volumeUp),
                                  "%s", pair->value);
@@ -1451,6 +1467,10 @@ void construct_app_settings(AppSettings *settings, KeyValuePair *pairs, int coun
                         snprintf(settings->replayGainCheckFirst,
                                  sizeof(settings->replayGainCheckFirst), "%s",
                                  pair->value);
+                } else if (strcmp(lowercase_key, "buffermode") == 0) {
+                        snprintf(settings->bufferMode,
+                                 sizeof(settings->bufferMode), "%s",
+                                 pair->value);
                 } else if (strcmp(lowercase_key, "visualizerbarwidth") == 0) {
                         snprintf(settings->visualizer_bar_width,
                                  sizeof(settings->visualizer_bar_width), "%s",
@@ -1908,6 +1928,21 @@ void load_settings_into_ui(AppSettings *settings, UISettings *ui)
                 ui->fade_slow_ms = tmp;
         }
 
+        tmp = get_number(settings->crossfade_curve);
+        if (tmp >= 0 && tmp < 3) {
+                ui->crossfade_curve = tmp;
+        }
+
+        tmp = get_number(settings->song_cache_entries);
+        if (tmp >= 0) {
+                ui->song_cache_entries = tmp;
+        }
+
+        tmp = get_number(settings->song_cache_mb);
+        if (tmp >= 0) {
+                ui->song_cache_mb = tmp;
+        }
+
         if (ui->colorMode != COLOR_MODE_ALBUM &&
             ui->colorMode != COLOR_MODE_ALBUM_ONE &&
             ui->colorMode != COLOR_MODE_DEFAULT &&
@@ -2290,6 +2325,11 @@ void set_config(AppSettings *settings, UISettings *ui)
                          sizeof(settings->replayGainCheckFirst), "%d",
                          ui->replayGainCheckFirst);
 
+        if (settings->bufferMode[0] == '\0')
+                snprintf(settings->bufferMode,
+                         sizeof(settings->bufferMode), "%d",
+                         ui->bufferMode);
+
         // Write the settings to the file
         fprintf(file, "# kew Settings\n\n");
         fprintf(file, "# IMPORTANT: kew doesn't write to this file, except for when you run kew path.\n");
@@ -2334,6 +2374,16 @@ void set_config(AppSettings *settings, UISettings *ui)
         fprintf(file, "replayGainCheckFirst=%s\n\n",
                 settings->replayGainCheckFirst);
 
+        fprintf(file, "# Audio buffering, can be either 0=balanced, 1=power saving "
+                      "(decodes in large bursts, lets the disk idle) or 2=low latency.\n");
+        fprintf(file, "bufferMode=%s\n\n",
+                settings->bufferMode);
+
+        fprintf(file, "# Loaded songs (tags, cover and lyrics) kept in memory for "
+                      "instant skipping, 0 disables it.\n");
+        fprintf(file, "songCacheEntries=%s\n", settings->song_cache_entries);
+        fprintf(file, "songCacheMb=%s\n\n", settings->song_cache_mb);
+
         fprintf(file, "# Save Repeat and Shuffle Settings.\n");
         fprintf(file, "saveRepeatShuffleSettings=%s\n\n",
                 settings->saveRepeatShuffleSettings);
@@ -2370,6 +2420,8 @@ void set_config(AppSettings *settings, UISettings *ui)
         fprintf(file, "fadeQuickMs=%s\n", settings->fade_quick_ms);
         fprintf(file, "fadeMediumMs=%s\n", settings->fade_medium_ms);
         fprintf(file, "fadeSlowMs=%s\n\n", settings->fade_slow_ms);
+        fprintf(file, "# Shape of the fade, 0=equal power, 1=linear or 2=S-curve.\n");
+        fprintf(file, "crossfadeCurve=%s\n\n", settings->crossfade_curve);
 
         fprintf(file, "\n[track cover]\n\n");
         fprintf(file, "coverEnabled=%s\n", settings->coverEnabled);
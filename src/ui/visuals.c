@@ -27,6 +27,7 @@
 
 #include "common/model.h"
 #include "loader/songdatatype.h"
+#include "utils/dsp_kernels.h"
 #include "utils/img_utils.h"
 #include "utils/k_log.h"
 
@@ -40,7 +41,7 @@
 
 #define MAX_BARS 26 // Counting 1/3 octave per bar, 50hz-10000hz range
 
-float *blackman_harris_window;
+#define FFT_CACHE_SIZE 4
 
 static void generate_legacy_palette(ColorPalette *palette, PixelData base, int height, int mode)
 {
@@ -54,407 +55,6 @@ static void generate_legacy_palette(ColorPalette *palette, PixelData base, int h
         }
 }
 
-static void generate_kmeans_palette(ColorPalette *palette, const unsigned char *pixels, int w, int h, int channels)
-{
-        int total_pixels = w * h;
-        if (total_pixels <= 0 || pixels == NULL) {
-                palette->count = 0;
-                return;
-        }
-
-        int bucket_best_r[8], bucket_best_g[8], bucket_best_b[8];
-        int bucket_best_vib[8];
-        for (int i = 0; i < 8; i++) {
-                bucket_best_r[i] = 0;
-                bucket_best_g[i] = 0;
-                bucket_best_b[i] = 0;
-                bucket_best_vib[i] = -1;
-        }
-
-        int step = total_pixels < 1600 ? 1 : total_pixels / 1600;
-        if (step < 1)
-                step = 1;
-
-        for (int s = 0; s < total_pixels; s += step) {
-                int idx = s * channels;
-                int r = pixels[idx];
-                int g = pixels[idx + 1];
-                int b = pixels[idx + 2];
-
-                int lum = (54 * r + 183 * g + 19 * b) >> 8;
-                int bucket = lum >> 5;
-                if (bucket > 7)
-                        bucket = 7;
-
-                int maxc = r;
-                if (g > maxc)
-                        maxc = g;
-                if (b > maxc)
-                        maxc = b;
-                int minc = r;
-                if (g < minc)
-                        minc = g;
-                if (b < minc)
-                        minc = b;
-                int sat = maxc - minc;
-                int brightness = maxc;
-                int vib = sat * 3 + brightness;
-
-                if (vib > bucket_best_vib[bucket]) {
-                        bucket_best_vib[bucket] = vib;
-                        bucket_best_r[bucket] = r;
-                        bucket_best_g[bucket] = g;
-                        bucket_best_b[bucket] = b;
-                }
-        }
-
-        int count = 0;
-        for (int i = 0; i < 8; i++) {
-                if (bucket_best_vib[i] >= 0) {
-                        palette->colors[count++] = (PixelData){
-                            .r = (unsigned char)bucket_best_r[i],
-                            .g = (unsigned char)bucket_best_g[i],
-                            .b = (unsigned char)bucket_best_b[i],
-                            .a = 255};
-                }
-        }
-        palette->count = count;
-}
-
-#define BIN_SHIFT 5
-#define BIN_SIZE (256 >> BIN_SHIFT)
-#define BIN_TOP 12
-
-static void generate_binning_palette(ColorPalette *palette, const unsigned char *pixels, int w, int h, int channels)
-{
-        int total_pixels = w * h;
-        if (total_pixels <= 0 || pixels == NULL) {
-                palette->count = 0;
-                return;
-        }
-
-        int bin_counts[BIN_SIZE][BIN_SIZE][BIN_SIZE];
-        memset(bin_counts, 0, sizeof(bin_counts));
-
-        for (int i = 0; i < total_pixels; i++) {
-                int idx = i * channels;
-                int br = pixels[idx] >> BIN_SHIFT;
-                int bg = pixels[idx + 1] >> BIN_SHIFT;
-                int bb = pixels[idx + 2] >> BIN_SHIFT;
-                int max_bin = BIN_SIZE - 1;
-                if (br > max_bin)
-                        br = max_bin;
-                if (bg > max_bin)
-                        bg = max_bin;
-                if (bb > max_bin)
-                        bb = max_bin;
-                bin_counts[br][bg][bb]++;
-        }
-
-        typedef struct {
-                int count, r_idx, g_idx, b_idx;
-        } BinEntry;
-        BinEntry top[BIN_TOP];
-        int top_count = 0;
-
-        for (int r = 0; r < BIN_SIZE; r++) {
-                for (int g = 0; g < BIN_SIZE; g++) {
-                        for (int b = 0; b < BIN_SIZE; b++) {
-                                int cnt = bin_counts[r][g][b];
-                                if (cnt == 0)
-                                        continue;
-                                int pos = top_count < BIN_TOP ? top_count : BIN_TOP - 1;
-                                for (int p = 0; p < top_count && p < BIN_TOP; p++) {
-                                        if (cnt > top[p].count) {
-                                                pos = p;
-                                                break;
-                                        }
-                                }
-                                if (top_count < BIN_TOP)
-                                        top_count++;
-                                for (int p = top_count - 1; p > pos; p--)
-                                        top[p] = top[p - 1];
-                                top[pos].count = cnt;
-                                top[pos].r_idx = r;
-                                top[pos].g_idx = g;
-                                top[pos].b_idx = b;
-                        }
-                }
-        }
-
-        palette->count = top_count;
-        for (int i = 0; i < top_count; i++) {
-                palette->colors[i] = (PixelData){
-                    .r = (unsigned char)((top[i].r_idx << BIN_SHIFT) | (BIN_SHIFT > 0 ? (1 << (BIN_SHIFT - 1)) : 0)),
-                    .g = (unsigned char)((top[i].g_idx << BIN_SHIFT) | (BIN_SHIFT > 0 ? (1 << (BIN_SHIFT - 1)) : 0)),
-                    .b = (unsigned char)((top[i].b_idx << BIN_SHIFT) | (BIN_SHIFT > 0 ? (1 << (BIN_SHIFT - 1)) : 0)),
-                    .a = 255};
-        }
-}
-
-#define TOPN_VIBRANT_N 8
-#define TOPN_SAMPLES 600
-#define TOPN_LUM_THRESHOLD 80
-#define TOPN_MIN_DIST_SQ 3600.0f
-#define TOPN_HALF (TOPN_VIBRANT_N / 2)
-
-typedef struct {
-        float score;
-        unsigned char r, g, b;
-} VibEntry;
-
-static void init_vib_entries(VibEntry *entries, int n)
-{
-        for (int i = 0; i < n; i++)
-                entries[i].score = -1.0f;
-}
-
-static int insert_vib_entry(VibEntry *entries, int count, int max, float vibrance, unsigned char r, unsigned char g, unsigned char b)
-{
-        int pos = -1;
-        for (int p = 0; p < count && p < max; p++) {
-                if (vibrance > entries[p].score) {
-                        pos = p;
-                        break;
-                }
-        }
-        if (pos == -1 && count < max)
-                pos = count;
-
-        if (pos < 0)
-                return count;
-
-        for (int p = 0; p < count; p++) {
-                if (p == pos)
-                        continue;
-                float dr = (float)r - entries[p].r;
-                float dg = (float)g - entries[p].g;
-                float db = (float)b - entries[p].b;
-                if (dr * dr + dg * dg + db * db < TOPN_MIN_DIST_SQ)
-                        return count;
-        }
-
-        for (int p = max - 1; p > pos; p--)
-                entries[p] = entries[p - 1];
-        entries[pos].score = vibrance;
-        entries[pos].r = r;
-        entries[pos].g = g;
-        entries[pos].b = b;
-        if (count < max)
-                count++;
-        return count;
-}
-
-static void generate_topn_vibrant_palette(ColorPalette *palette, const unsigned char *pixels, int w, int h, int channels)
-{
-        int total_pixels = w * h;
-        if (total_pixels <= 0 || pixels == NULL) {
-                palette->count = 0;
-                return;
-        }
-
-        VibEntry dark[TOPN_HALF];
-        VibEntry bright[TOPN_HALF];
-        init_vib_entries(dark, TOPN_HALF);
-        init_vib_entries(bright, TOPN_HALF);
-        int dark_count = 0;
-        int bright_count = 0;
-
-        int step = total_pixels / TOPN_SAMPLES;
-        if (step < 1)
-                step = 1;
-
-        for (int i = 0; i < total_pixels; i += step) {
-                int idx = i * channels;
-                unsigned char cr = pixels[idx];
-                unsigned char cg = pixels[idx + 1];
-                unsigned char cb = pixels[idx + 2];
-                float r = (float)cr;
-                float g = (float)cg;
-                float b = (float)cb;
-
-                float max_c = r > g ? r : g;
-                if (b > max_c)
-                        max_c = b;
-                float min_c = r < g ? r : g;
-                if (b < min_c)
-                        min_c = b;
-                float chroma = max_c - min_c;
-                float lum = 0.2126f * r + 0.7152f * g + 0.0722f * b;
-                float vibrance = chroma * (1.0f - fabsf(lum - 128.0f) / 128.0f);
-
-                if (lum < TOPN_LUM_THRESHOLD)
-                        dark_count = insert_vib_entry(dark, dark_count, TOPN_HALF, vibrance, cr, cg, cb);
-                else
-                        bright_count = insert_vib_entry(bright, bright_count, TOPN_HALF, vibrance, cr, cg, cb);
-        }
-
-        palette->count = 0;
-        for (int i = dark_count - 1; i >= 0 && palette->count < TOPN_VIBRANT_N; i--) {
-                palette->colors[palette->count++] = (PixelData){
-                    .r = dark[i].r, .g = dark[i].g, .b = dark[i].b, .a = 255};
-        }
-        for (int i = 0; i < bright_count && palette->count < TOPN_VIBRANT_N; i++) {
-                palette->colors[palette->count++] = (PixelData){
-                    .r = bright[i].r, .g = bright[i].g, .b = bright[i].b, .a = 255};
-        }
-}
-
-static void run_kmeans(PixelData *samples, int num_samples, PixelData centroids[3])
-{
-        if (num_samples < 3) {
-                for (int k = 0; k < 3; k++) {
-                        centroids[k] = (num_samples > 0) ? samples[0] : (PixelData){128, 128, 128, 255};
-                }
-                return;
-        }
-
-        centroids[0] = samples[0];
-        centroids[1] = samples[num_samples / 2];
-        centroids[2] = samples[num_samples - 1];
-
-        int assignments[1024];
-        if (num_samples > 1024)
-                num_samples = 1024;
-
-        long long sum_r[3], sum_g[3], sum_b[3];
-        int count[3];
-
-        for (int iter = 0; iter < 6; iter++) {
-                for (int i = 0; i < num_samples; i++) {
-                        double min_dist = 1e9;
-                        int best_k = 0;
-                        for (int k = 0; k < 3; k++) {
-                                double dr = (double)samples[i].r - centroids[k].r;
-                                double dg = (double)samples[i].g - centroids[k].g;
-                                double db = (double)samples[i].b - centroids[k].b;
-                                double dist = dr * dr + dg * dg + db * db;
-                                if (dist < min_dist) {
-                                        min_dist = dist;
-                                        best_k = k;
-                                }
-                        }
-                        assignments[i] = best_k;
-                }
-
-                memset(sum_r, 0, sizeof(sum_r));
-                memset(sum_g, 0, sizeof(sum_g));
-                memset(sum_b, 0, sizeof(sum_b));
-                memset(count, 0, sizeof(count));
-
-                for (int i = 0; i < num_samples; i++) {
-                        int k = assignments[i];
-                        sum_r[k] += samples[i].r;
-                        sum_g[k] += samples[i].g;
-                        sum_b[k] += samples[i].b;
-                        count[k]++;
-                }
-
-                for (int k = 0; k < 3; k++) {
-                        if (count[k] > 0) {
-                                centroids[k].r = (unsigned char)(sum_r[k] / count[k]);
-                                centroids[k].g = (unsigned char)(sum_g[k] / count[k]);
-                                centroids[k].b = (unsigned char)(sum_b[k] / count[k]);
-                        } else {
-                                centroids[k] = samples[rand() % num_samples];
-                        }
-                }
-        }
-
-        for (int i = 0; i < 2; i++) {
-                for (int j = i + 1; j < 3; j++) {
-                        if (count[j] > count[i]) {
-                                int tmp_c = count[i];
-                                count[i] = count[j];
-                                count[j] = tmp_c;
-                                PixelData tmp_p = centroids[i];
-                                centroids[i] = centroids[j];
-                                centroids[j] = tmp_p;
-                        }
-                }
-        }
-}
-
-static void check_if_bright_pixel(unsigned char r, unsigned char g, unsigned char b, bool *found)
-{
-        // Match main branch logic
-        unsigned char lum = (unsigned char)(0.2126f * r + 0.7152f * g + 0.0722f * b);
-        if (lum > 60 && !(r < g + 20 && r > g - 20 && g < b + 20 && g > b - 20) && !(r > 150 && g > 150 && b > 150)) {
-                *found = true;
-        }
-}
-
-static void generate_kmeans_clustering_palette(ColorPalette *palette, const unsigned char *pixels, int w, int h, int channels)
-{
-        if (w <= 0 || h <= 0 || pixels == NULL) {
-                palette->count = 0;
-                return;
-        }
-
-        int step_y = h / 16;
-        int step_x = w / 16;
-        if (step_y < 1)
-                step_y = 1;
-        if (step_x < 1)
-                step_x = 1;
-
-        PixelData samples[1024];
-        int num_samples = 0;
-
-        // Pass 1: Bright pixels
-        for (int y = 0; y < h && num_samples < 1024; y += step_y) {
-                for (int x = 0; x < w && num_samples < 1024; x += step_x) {
-                        int idx = (y * w + x) * channels;
-                        unsigned char r = pixels[idx];
-                        unsigned char g = pixels[idx + 1];
-                        unsigned char b = pixels[idx + 2];
-                        bool bright = false;
-                        check_if_bright_pixel(r, g, b, &bright);
-                        if (bright) {
-                                samples[num_samples++] = (PixelData){r, g, b, 255};
-                        }
-                }
-        }
-
-        // Pass 2: All pixels (if no bright pixels found)
-        if (num_samples == 0) {
-                for (int y = 0; y < h && num_samples < 1024; y += step_y) {
-                        for (int x = 0; x < w && num_samples < 1024; x += step_x) {
-                                int idx = (y * w + x) * channels;
-                                samples[num_samples++] = (PixelData){pixels[idx], pixels[idx + 1], pixels[idx + 2], 255};
-                        }
-                }
-        }
-
-        PixelData centroids[3];
-        run_kmeans(samples, num_samples, centroids);
-
-        palette->count = 3;
-        for (int i = 0; i < 3; i++) {
-                palette->colors[i] = centroids[i];
-                palette->colors[i].a = 255;
-        }
-}
-
-static float pixel_luminance(const PixelData *c)
-{
-        return 0.2126f * c->r + 0.7152f * c->g + 0.0722f * c->b;
-}
-
-static void sort_palette_by_luminosity(ColorPalette *palette)
-{
-        for (int a = 1; a < palette->count; a++) {
-                PixelData key = palette->colors[a];
-                float key_lum = pixel_luminance(&key);
-                int b = a - 1;
-                while (b >= 0 && pixel_luminance(&palette->colors[b]) > key_lum) {
-                        palette->colors[b + 1] = palette->colors[b];
-                        b--;
-                }
-                palette->colors[b + 1] = key;
-        }
-}
-
 void generate_all_visualizer_palettes(Model *model, int height)
 {
         const UISettings *ui = &model->state.settings;
@@ -470,39 +70,54 @@ void generate_all_visualizer_palettes(Model *model, int height)
         generate_legacy_palette(&model->state.ui.visualizer_palettes[VIZ_REVERSED], base_color, height, 1);
         generate_legacy_palette(&model->state.ui.visualizer_palettes[VIZ_FLAT], base_color, height, 1);
 
-        const unsigned char *cover = NULL;
-        int cover_w = 0, cover_h = 0, cover_ch = 0;
+        // The cover palettes were computed when the song was loaded
+        ColorPalette *palettes = model->state.ui.visualizer_palettes;
+
         if (model->songdata_ok && model->songdata && model->songdata->cover) {
-                cover = model->songdata->cover;
-                cover_w = model->songdata->coverWidth;
-                cover_h = model->songdata->coverHeight;
-                cover_ch = 4;
-        }
+                const CoverPalettes *cover = &model->songdata->cover_palettes;
 
-        if (cover && cover_w > 0 && cover_h > 0) {
-                generate_kmeans_palette(&model->state.ui.visualizer_palettes[VIZ_LUM_VIBRANT], cover, cover_w, cover_h, cover_ch);
-                sort_palette_by_luminosity(&model->state.ui.visualizer_palettes[VIZ_LUM_VIBRANT]);
-                generate_binning_palette(&model->state.ui.visualizer_palettes[VIZ_BINNING], cover, cover_w, cover_h, cover_ch);
-                if (model->state.ui.visualizer_palettes[VIZ_BINNING].count > 8)
-                        model->state.ui.visualizer_palettes[VIZ_BINNING].count = 8;
-                sort_palette_by_luminosity(&model->state.ui.visualizer_palettes[VIZ_BINNING]);
-                generate_topn_vibrant_palette(&model->state.ui.visualizer_palettes[VIZ_VIBRANT], cover, cover_w, cover_h, cover_ch);
-                generate_kmeans_clustering_palette(&model->state.ui.visualizer_palettes[VIZ_KMEANS_CLUSTERING], cover, cover_w, cover_h, cover_ch);
-                model->state.ui.visualizer_palettes[VIZ_GRADIENT] = model->state.ui.visualizer_palettes[VIZ_KMEANS_CLUSTERING];
+                palettes[VIZ_LUM_VIBRANT] = cover->lum_vibrant;
+                palettes[VIZ_BINNING] = cover->binning;
+                palettes[VIZ_VIBRANT] = cover->vibrant;
+                palettes[VIZ_KMEANS_CLUSTERING] = cover->kmeans_clustering;
+                palettes[VIZ_GRADIENT] = cover->kmeans_clustering;
         } else {
-                model->state.ui.visualizer_palettes[VIZ_LUM_VIBRANT].count = 0;
-                model->state.ui.visualizer_palettes[VIZ_BINNING].count = 0;
-                model->state.ui.visualizer_palettes[VIZ_VIBRANT].count = 0;
-                model->state.ui.visualizer_palettes[VIZ_KMEANS_CLUSTERING].count = 0;
+                palettes[VIZ_LUM_VIBRANT].count = 0;
+                palettes[VIZ_BINNING].count = 0;
+                palettes[VIZ_VIBRANT].count = 0;
+                palettes[VIZ_KMEANS_CLUSTERING].count = 0;
         }
 }
 
 static sound_system_t *sound_s;
 
-static float *fft_input = NULL;
-static fftwf_plan fft_plan = NULL;
-static fftwf_complex *fft_output = NULL;
-static ma_uint32 sample_rate = 0;
+// Buffers, window and plan for one FFT size. Kept when the size changes,
+// since the next track with the previous sample rate changes it back.
+typedef struct {
+        int size;
+        float *input;
+        fftwf_complex *output;
+        float *window;
+        fftwf_plan plan;
+} FftSetup;
+
+// Which FFT bins make up each bar, for one FFT size, sample rate and number
+// of bars
+typedef struct {
+        int fft_size;
+        ma_uint32 sample_rate;
+        int num_bars;
+        int used_bars;
+        int bin_lo[MAX_BARS];
+        int bin_count[MAX_BARS];    // -1 if the band is out of range
+        float scale[MAX_BARS];      // Turns a sum of squared bins into mean power
+        float correction[MAX_BARS]; // Pink noise compensation in dB
+} BandTable;
+
+static FftSetup fft_setups[FFT_CACHE_SIZE];
+static int fft_setup_count = 0;
+static int current_fft_size = 0;
+static BandTable band_table = {0};
 static float bar_height[MAX_BARS] = {0.0f};
 static float display_magnitudes[MAX_BARS] = {0.0f};
 static float magnitudes[MAX_BARS] = {0.0f};
@@ -514,7 +129,6 @@ static float decay = 0.14f;
 static float slow_attack = 0.15f;
 static int visualizer_bar_mode = 2;
 static int max_thin_bars_in_auto_mode = 20;
-static int prev_fft_size = 0;
 
 void clear_magnitudes(int num_bars, float *magnitudes)
 {
@@ -544,8 +158,7 @@ void apply_blackman_harris(float *restrict data,
                            const float *restrict window,
                            int n)
 {
-        for (int i = 0; i < n; i++)
-                data[i] *= window[i];
+        dsp_multiply_f32(data, window, n);
 }
 
 // Fill center freqs for 1/3-octave bands, given min/max freq and num_bands
@@ -578,30 +191,34 @@ void compute_band_centers(float min_freq, float sample_rate, int num_bands,
         }
 }
 
-void fill_eq_bands(const fftwf_complex *fft_output, int buffer_size,
-                   float sample_rate, float *band_db, int num_bands,
-                   const float *center_freqs)
+static void build_band_table(BandTable *table, int fft_size,
+                             ma_uint32 sample_rate, int num_bars)
 {
-        // Basic input checks
-        if (!fft_output || !band_db || !center_freqs || buffer_size <= 0 ||
-            num_bands <= 0 || sample_rate <= 0.0f)
-                return;
+        float center_freqs[MAX_BARS] = {0.0f};
 
-        // Guard against potential overflow in bin count computation
-        if (buffer_size > INT_MAX - 1)
-                return;
+        float min_freq = 25.0f;
+        float audible_half = 10000.0f;
+        float max_freq = fmin(audible_half, 0.5f * sample_rate);
+        float octave_fraction = 1.0f / 3.0f;
 
-        int num_bins = buffer_size / 2 + 1;
+        table->fft_size = fft_size;
+        table->sample_rate = sample_rate;
+        table->num_bars = num_bars;
 
-        // Safe bin_spacing computation
-        float bin_spacing = sample_rate / (float)buffer_size;
-        if (bin_spacing <= 0.0f || !isfinite(bin_spacing))
-                return;
+        // How many bars are actually in use, given we increase with 1/3
+        // octave per bar
+        table->used_bars = 0;
+        if (max_freq > 0.0f)
+                table->used_bars = floor(log2(max_freq / min_freq) / octave_fraction) + 1;
+        if (table->used_bars > MAX_BARS)
+                table->used_bars = MAX_BARS;
 
-        // Prevent division by zero in normalization
-        float norm_factor = (float)buffer_size;
-        if (norm_factor <= 0.0f)
-                return;
+        // Compute center frequencies for EQ bands
+        compute_band_centers(min_freq, max_freq, num_bars, center_freqs);
+
+        int num_bins = fft_size / 2 + 1;
+        float bin_spacing = (float)sample_rate / (float)fft_size;
+        float norm_factor = (float)fft_size;
 
         // Frequency window width for 1/3-octave bands
         const float width = powf(2.0f, 1.0f / 6.0f); // +/-1/6 octave
@@ -616,18 +233,18 @@ void fill_eq_bands(const fftwf_complex *fft_output, int buffer_size,
         if (!isfinite(reference_freq) || reference_freq <= 0.0f)
                 reference_freq = 1.0f;
 
-        for (int i = 0; i < num_bands; i++) {
+        for (int i = 0; i < num_bars; i++) {
                 float center = center_freqs[i];
 
-                if (!isfinite(center) || center <= 0.0f || center > nyquist) {
-                        band_db[i] = -INFINITY;
+                table->bin_count[i] = -1;
+
+                if (bin_spacing <= 0.0f || !isfinite(bin_spacing) ||
+                    !isfinite(center) || center <= 0.0f || center > nyquist)
                         continue;
-                }
 
                 float lo = center / width;
                 float hi = center * width;
 
-                // Avoid integer overflows in bin index computation
                 int bin_lo = (int)ceilf(lo / bin_spacing);
                 int bin_hi = (int)floorf(hi / bin_spacing);
 
@@ -635,33 +252,94 @@ void fill_eq_bands(const fftwf_complex *fft_output, int buffer_size,
                 bin_hi = (bin_hi >= num_bins) ? num_bins - 1 : bin_hi;
                 bin_hi = (bin_hi < bin_lo) ? bin_lo : bin_hi;
 
-                float sum_sq = 0.0f;
-                int count = 0;
+                int count = bin_lo < num_bins ? bin_hi - bin_lo + 1 : 0;
 
-                for (int k = bin_lo; k <= bin_hi; k++) {
-                        if (k < 0 || k >= num_bins)
-                                continue;
+                table->bin_lo[i] = bin_lo;
+                table->bin_count[i] = count;
+                table->scale[i] = count > 0 ? 1.0f / (count * norm_factor * norm_factor) : 0.0f;
 
-                        float real = crealf(fft_output[k]) / norm_factor;
-                        float imag = cimagf(fft_output[k]) / norm_factor;
-                        float mag = sqrtf(real * real + imag * imag);
-                        sum_sq += mag * mag;
-                        count++;
-                }
-
-                float rms = (count > 0) ? sqrtf(sum_sq / count)
-                                        : 1e-9f; // Small nonzero floor
-                band_db[i] = 20.0f * log10f(rms);
-
-                // Pink noise EQ compensation
                 float freq = fminf(center, max_freq_for_correction);
                 float octaves_above_ref = log2f(freq / reference_freq);
-                float correction =
+                table->correction[i] =
                     fmaxf(octaves_above_ref, 0.0f) * correction_per_octave;
-                band_db[i] += correction;
         }
 }
 
+static void fill_eq_bands(const fftwf_complex *fft_output, const BandTable *table,
+                          float *band_db)
+{
+        for (int i = 0; i < table->num_bars; i++) {
+                int count = table->bin_count[i];
+
+                if (count < 0) {
+                        band_db[i] = -INFINITY;
+                        continue;
+                }
+
+                if (count == 0) {
+                        band_db[i] = 20.0f * log10f(1e-9f) + table->correction[i]; // Small nonzero floor
+                        continue;
+                }
+
+                // Mean power of the band's bins, the complex values are
+                // interleaved real and imaginary floats
+                const float *bins = (const float *)(fft_output + table->bin_lo[i]);
+                float power = dsp_sum_squares_f32(bins, (size_t)count * 2) * table->scale[i];
+
+                band_db[i] = 10.0f * log10f(power) + table->correction[i];
+        }
+}
+
+static void free_fft_setup(FftSetup *setup)
+{
+        if (setup->plan != NULL)
+                fftwf_destroy_plan(setup->plan);
+        free(setup->input);
+        fftwf_free(setup->output);
+        free(setup->window);
+        memset(setup, 0, sizeof(FftSetup));
+}
+
+static FftSetup *get_fft_setup(int fft_size)
+{
+        for (int i = 0; i < fft_setup_count; i++) {
+                if (fft_setups[i].size == fft_size)
+                        return &fft_setups[i];
+        }
+
+        // Forget the oldest
+        if (fft_setup_count == FFT_CACHE_SIZE) {
+                free_fft_setup(&fft_setups[0]);
+                memmove(&fft_setups[0], &fft_setups[1], sizeof(FftSetup) * (FFT_CACHE_SIZE - 1));
+                fft_setup_count--;
+        }
+
+        FftSetup *setup = &fft_setups[fft_setup_count];
+        memset(setup, 0, sizeof(FftSetup));
+
+        setup->input = (float *)malloc(sizeof(float) * fft_size);
+        setup->output = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex) * fft_size);
+        setup->window = (float *)malloc(sizeof(float) * fft_size);
+
+        if (!setup->input || !setup->output || !setup->window) {
+                free_fft_setup(setup);
+                return NULL;
+        }
+
+        generate_blackman_harris_window(setup->window, fft_size);
+
+        setup->plan = fftwf_plan_dft_r2c_1d(fft_size, setup->input, setup->output, FFTW_ESTIMATE);
+        if (setup->plan == NULL) {
+                free_fft_setup(setup);
+                return NULL;
+        }
+
+        setup->size = fft_size;
+        fft_setup_count++;
+
+        return setup;
+}
+
 // Sign-extend s24
 ma_int32 unpack_s24_format(const ma_uint8 *p)
 {
@@ -679,15 +357,9 @@ int normalize_audio_samples(const void *audio_buffer, float *fft_input,
                 for (int i = 0; i < buffer_size; ++i)
                         fft_input[i] = ((float)buf[i] - 127.0f) / 128.0f;
         } else if (bit_depth == 16) {
-                const int16_t *buf = (const int16_t *)audio_buffer;
-                for (int i = 0; i < buffer_size; ++i)
-                        fft_input[i] = (float)buf[i] / 32768.0f;
+                dsp_s16_to_f32((const int16_t *)audio_buffer, fft_input, buffer_size);
         } else if (bit_depth == 24) {
-                const uint8_t *buf = (const uint8_t *)audio_buffer;
-                for (int i = 0; i < buffer_size; ++i) {
-                        int32_t sample = unpack_s24_format(buf + i * 3);
-                        fft_input[i] = (float)sample / 8388608.0f;
-                }
+                dsp_s24_to_f32((const uint8_t *)audio_buffer, fft_input, buffer_size);
         } else if (bit_depth == 32) {
                 const float *buf = (const float *)audio_buffer;
                 for (int i = 0; i < buffer_size; ++i)
@@ -700,10 +372,9 @@ int normalize_audio_samples(const void *audio_buffer, float *fft_input,
         return 0;
 }
 
-void calc_magnitudes(int height, int num_bars, void *audio_buffer, int bit_depth,
-                     float *fft_input, fftwf_complex *fft_output, int fft_size,
-                     float *magnitudes, fftwf_plan plan,
-                     float *display_magnitudes)
+static void calc_magnitudes(int height, void *audio_buffer, int bit_depth,
+                            FftSetup *fft, const BandTable *table,
+                            float *magnitudes, float *display_magnitudes)
 {
         // Only execute when we get the signal that we have enough samples
         // (fft_size)
@@ -717,33 +388,21 @@ void calc_magnitudes(int height, int num_bars, void *audio_buffer, int bit_depth
 
         sound_system_set_buffer_ready(sound_s, false);
 
-        normalize_audio_samples(audio_buffer, fft_input, fft_size, bit_depth);
+        normalize_audio_samples(audio_buffer, fft->input, fft->size, bit_depth);
 
         // Apply Blackman Harris window function
-        apply_blackman_harris(fft_input, blackman_harris_window, fft_size);
+        apply_blackman_harris(fft->input, fft->window, fft->size);
 
         // Compute fast fourier transform
-        fftwf_execute(plan);
+        fftwf_execute(fft->plan);
 
         // Clear previous magnitudes
         clear_magnitudes(MAX_BARS, magnitudes);
 
-        float center_freqs[num_bars];
-
-        float min_freq = 25.0f;
-        float audible_half = 10000.0f;
-        float max_freq = fmin(audible_half, 0.5f * sample_rate);
-        float octave_fraction = 1.0f / 3.0f;
-        int used_bars = floor(log2(max_freq / min_freq) / octave_fraction) +
-                        1; // How many bars are actually in use, given we
-                           // increase with 1/3 octave per bar
-
-        // Compute center frequencies for EQ bands
-        compute_band_centers(min_freq, max_freq, num_bars, center_freqs);
-
         // Fill magnitudes for EQ bands from FFT output
-        fill_eq_bands(fft_output, fft_size, sample_rate, magnitudes, num_bars,
-                      center_freqs);
+        fill_eq_bands(fft->output, table, magnitudes);
+
+        int used_bars = table->used_bars;
 
         // Map magnitudes (in dB) to bar heights with gating and emphasis
         // (pow/gated)
@@ -830,22 +489,12 @@ char *get_inbetween_char(float prev, float next)
 
 void free_visuals(void)
 {
-        if (fft_input != NULL) {
-                free(fft_input);
-                fft_input = NULL;
-        }
-        if (fft_output != NULL) {
-                fftwf_free(fft_output);
-                fft_output = NULL;
-        }
-        if (fft_plan != NULL) {
-                fftwf_destroy_plan(fft_plan);
-                fft_plan = NULL;
-        }
+        for (int i = 0; i < fft_setup_count; i++)
+                free_fft_setup(&fft_setups[i]);
 
-        if (blackman_harris_window != NULL) {
-                free(blackman_harris_window);
-        }
+        fft_setup_count = 0;
+        current_fft_size = 0;
+        band_table.fft_size = 0;
 }
 
 static PixelData interpolate_color(PixelData a, PixelData b, float t)
@@ -1177,50 +826,25 @@ void draw_spectrum_visualizer_to_buf(const Model *model, DrawBuffer *buf, sound_
 
         int fft_size = sound_system_get_fft_size(sound_s);
 
-        if (fft_size != prev_fft_size) {
-                free_visuals();
-
-                blackman_harris_window = malloc(sizeof(float) * fft_size);
-                if (!blackman_harris_window)
-                        return;
-
-                generate_blackman_harris_window(blackman_harris_window, fft_size);
+        FftSetup *fft = get_fft_setup(fft_size);
+        if (fft == NULL)
+                return;
 
+        // Setups move around in the cache, so compare sizes, not pointers
+        if (fft->size != current_fft_size) {
                 memset(display_magnitudes, 0, sizeof(display_magnitudes));
-
-                fft_input = (float *)malloc(sizeof(float) * fft_size);
-                if (fft_input == NULL) {
-                        for (int i = 0; i <= height; i++) {
-                                printf("\n");
-                        }
-                        return;
-                }
-
-                fft_output = (fftwf_complex *)fftwf_malloc(
-                    sizeof(fftwf_complex) * fft_size);
-                if (fft_output == NULL) {
-                        fftwf_free(fft_input);
-                        fft_input = NULL;
-                        for (int i = 0; i <= height; i++) {
-                                printf("\n");
-                        }
-                        return;
-                }
-
-                if (fft_plan != NULL) {
-                        fftwf_destroy_plan(fft_plan);
-                        fft_plan = NULL;
-                }
-
-                fft_plan = fftwf_plan_dft_r2c_1d(fft_size, fft_input, fft_output, FFTW_ESTIMATE);
-                prev_fft_size = fft_size;
+                current_fft_size = fft->size;
         }
 
         int bit_depth = sound_system_get_bit_depth(sound_s);
-        sample_rate = sound_system_get_sample_rate(sound_s);
+        ma_uint32 sample_rate = sound_system_get_sample_rate(sound_s);
+
+        if (band_table.fft_size != fft_size || band_table.sample_rate != sample_rate ||
+            band_table.num_bars != num_bars)
+                build_band_table(&band_table, fft_size, sample_rate, num_bars);
 
-        calc_magnitudes(height, num_bars, sound_system_get_audio_buffer(sound_s), bit_depth, fft_input,
-                        fft_output, fft_size, magnitudes, fft_plan, display_magnitudes);
+        calc_magnitudes(height, sound_system_get_audio_buffer(sound_s), bit_depth, fft,
+                        &band_table, magnitudes, display_magnitudes);
 
         draw_spectrum_to_buf(model, buf, row, col, height, num_bars,
                              visualizer_width, display_magnitudes);
@@ -1,5 +1,7 @@
 #include "messages.h"
 
+#include <pthread.h>
+
 #define MAX_MSG_QUEUE 256
 
 typedef struct {
@@ -10,35 +12,56 @@ typedef struct {
 
 static MsgQueue queue = {0};
 
+// Background workers (e.g. the playlist writer) post messages too
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 void dispatch_msg(struct Msg msg)
 {
+        pthread_mutex_lock(&queue_mutex);
+
         size_t next = (queue.tail + 1) % MAX_MSG_QUEUE;
 
         if (next == queue.head) {
+                pthread_mutex_unlock(&queue_mutex);
                 return;
         }
 
         queue.msgs[queue.tail] = msg;
         queue.tail = next;
+
+        pthread_mutex_unlock(&queue_mutex);
 }
 
 bool has_pending_msgs(void)
 {
-        return queue.head != queue.tail;
+        pthread_mutex_lock(&queue_mutex);
+        bool pending = queue.head != queue.tail;
+        pthread_mutex_unlock(&queue_mutex);
+
+        return pending;
 }
 
 bool next_msg(struct Msg *msg)
 {
-        if (queue.head == queue.tail)
+        pthread_mutex_lock(&queue_mutex);
+
+        if (queue.head == queue.tail) {
+                pthread_mutex_unlock(&queue_mutex);
                 return false;
+        }
 
         *msg = queue.msgs[queue.head];
         queue.head = (queue.head + 1) % MAX_MSG_QUEUE;
+
+        pthread_mutex_unlock(&queue_mutex);
+
         return true;
 }
 
 void reset_msg_queue_pointers(void)
 {
+    pthread_mutex_lock(&queue_mutex);
+
     size_t i = queue.head;
 
     while (i != queue.tail) {
@@ -49,4 +72,6 @@ void reset_msg_queue_pointers(void)
 
         i = (i + 1) % MAX_MSG_QUEUE;
     }
+
+    pthread_mutex_unlock(&queue_mutex);
 }
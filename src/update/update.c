@@ -430,7 +430,14 @@ UpdateResult update(Model *model, struct Msg *msg)
 
                 model->state.ui.resizeFlag = get_resize_flag();
 
-                model->current_path = model->songdata ? model->songdata->cover_art_path : NULL;
+                // Identifies the cover. An embedded cover has no path of its own
+                // until something outside kew asks for one.
+                if (model->songdata == NULL)
+                        model->current_path = NULL;
+                else if (model->songdata->cover_data != NULL)
+                        model->current_path = model->songdata->file_path;
+                else
+                        model->current_path = model->songdata->cover_art_path;
                 model->current_hash = model->current_path ? string_hash(model->current_path) : (size_t)-1;
 
                 model->should_refresh = is_refresh_triggered() ||
@@ -446,18 +453,15 @@ UpdateResult update(Model *model, struct Msg *msg)
 
                         if (model->songdata_ok) {
 
-                                if (model->songdata->red < 0)
-                                        model->songdata->red = model->state.settings.defaultColorRGB.b;
-
-                                if (model->songdata->green < 0)
-                                        model->songdata->green = model->state.settings.defaultColorRGB.b;
+                                // The song is shared, so the fallback isn't written back to it
+                                int fallback = model->state.settings.defaultColorRGB.b;
+                                int red = model->songdata->red < 0 ? fallback : model->songdata->red;
+                                int green = model->songdata->green < 0 ? fallback : model->songdata->green;
+                                int blue = model->songdata->blue < 0 ? fallback : model->songdata->blue;
 
-                                if (model->songdata->blue < 0)
-                                        model->songdata->blue = model->state.settings.defaultColorRGB.b;
-
-                                model->state.settings.color.r = (char)model->songdata->red;
-                                model->state.settings.color.g = (char)model->songdata->green;
-                                model->state.settings.color.b = (char)model->songdata->blue;
+                                model->state.settings.color.r = (char)red;
+                                model->state.settings.color.g = (char)green;
+                                model->state.settings.color.b = (char)blue;
 
                         } else {
 
@@ -467,7 +471,7 @@ UpdateResult update(Model *model, struct Msg *msg)
                         }
                 }
 
-                // FIXME remove this, do all pallette loading in the song loader
+                // Cheap, the cover palettes come precomputed with the song
                 static size_t cached_palette_song_hash = (size_t)-1;
                 if (model->current_hash != cached_palette_song_hash) {
                         cached_palette_song_hash = model->current_hash;
@@ -789,8 +793,8 @@ UpdateResult update(Model *model, struct Msg *msg)
 
                 if (msg->clicked_song) {
 
-                        if (msg->chosen_song)
-                                model->state.ui.chosen_node_id = msg->chosen_song->id;
+                        if (msg->chosen_song_id >= 0)
+                                model->state.ui.chosen_node_id = msg->chosen_song_id;
 
                         if (model->mouse_key == TB_KEY_MOUSE_LEFT || model->mouse_key == TB_KEY_MOUSE_MIDDLE)
                                 dispatch_msg((struct Msg){.type = MSG_ENQUEUE});
@@ -941,6 +945,14 @@ UpdateResult update(Model *model, struct Msg *msg)
 
                 break;
 
+        case MSG_PLAYLIST_SAVED:
+                if (!msg->ok) {
+                        set_error_message("Failed to save playlist.");
+                        set_dirty(DIRTY_FOOTER);
+                }
+
+                break;
+
         case MSG_PRE_RENDER:
                 set_scrollbar_positions();
 
@@ -0,0 +1,569 @@
+/**
+ * @file cover_palette.c
+ * @brief Visualizer palettes derived from the album cover.
+ *
+ * The generators only look at a thumbnail of at most PALETTE_EDGE pixels
+ * on either side, which is plenty for picking a handful of colors.
+ */
+
+#include "cover_palette.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Longest edge of the bitmap the palettes are computed from
+#define PALETTE_EDGE 64
+
+// Number of covers whose palettes are remembered
+#define PALETTE_CACHE_SIZE 16
+
+typedef struct {
+        uint64_t hash;
+        unsigned long last_used;
+        CoverPalettes palettes;
+} PaletteCacheEntry;
+
+static PaletteCacheEntry palette_cache[PALETTE_CACHE_SIZE];
+static int palette_cache_count = 0;
+static unsigned long palette_cache_clock = 0;
+static pthread_mutex_t palette_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void generate_kmeans_palette(ColorPalette *palette, const unsigned char *pixels, int w, int h, int channels)
+{
+        int total_pixels = w * h;
+        if (total_pixels <= 0 || pixels == NULL) {
+                palette->count = 0;
+                return;
+        }
+
+        int bucket_best_r[8], bucket_best_g[8], bucket_best_b[8];
+        int bucket_best_vib[8];
+        for (int i = 0; i < 8; i++) {
+                bucket_best_r[i] = 0;
+                bucket_best_g[i] = 0;
+                bucket_best_b[i] = 0;
+                bucket_best_vib[i] = -1;
+        }
+
+        int step = total_pixels < 1600 ? 1 : total_pixels / 1600;
+        if (step < 1)
+                step = 1;
+
+        for (int s = 0; s < total_pixels; s += step) {
+                int idx = s * channels;
+                int r = pixels[idx];
+                int g = pixels[idx + 1];
+                int b = pixels[idx + 2];
+
+                int lum = (54 * r + 183 * g + 19 * b) >> 8;
+                int bucket = lum >> 5;
+                if (bucket > 7)
+                        bucket = 7;
+
+                int maxc = r;
+                if (g > maxc)
+                        maxc = g;
+                if (b > maxc)
+                        maxc = b;
+                int minc = r;
+                if (g < minc)
+                        minc = g;
+                if (b < minc)
+                        minc = b;
+                int sat = maxc - minc;
+                int brightness = maxc;
+                int vib = sat * 3 + brightness;
+
+                if (vib > bucket_best_vib[bucket]) {
+                        bucket_best_vib[bucket] = vib;
+                        bucket_best_r[bucket] = r;
+                        bucket_best_g[bucket] = g;
+                        bucket_best_b[bucket] = b;
+                }
+        }
+
+        int count = 0;
+        for (int i = 0; i < 8; i++) {
+                if (bucket_best_vib[i] >= 0) {
+                        palette->colors[count++] = (PixelData){
+                            .r = (unsigned char)bucket_best_r[i],
+                            .g = (unsigned char)bucket_best_g[i],
+                            .b = (unsigned char)bucket_best_b[i],
+                            .a = 255};
+                }
+        }
+        palette->count = count;
+}
+
+#define BIN_SHIFT 5
+#define BIN_SIZE (256 >> BIN_SHIFT)
+#define BIN_TOP 12
+
+static void generate_binning_palette(ColorPalette *palette, const unsigned char *pixels, int w, int h, int channels)
+{
+        int total_pixels = w * h;
+        if (total_pixels <= 0 || pixels == NULL) {
+                palette->count = 0;
+                return;
+        }
+
+        int bin_counts[BIN_SIZE][BIN_SIZE][BIN_SIZE];
+        memset(bin_counts, 0, sizeof(bin_counts));
+
+        for (int i = 0; i < total_pixels; i++) {
+                int idx = i * channels;
+                int br = pixels[idx] >> BIN_SHIFT;
+                int bg = pixels[idx + 1] >> BIN_SHIFT;
+                int bb = pixels[idx + 2] >> BIN_SHIFT;
+                int max_bin = BIN_SIZE - 1;
+                if (br > max_bin)
+                        br = max_bin;
+                if (bg > max_bin)
+                        bg = max_bin;
+                if (bb > max_bin)
+                        bb = max_bin;
+                bin_counts[br][bg][bb]++;
+        }
+
+        typedef struct {
+                int count, r_idx, g_idx, b_idx;
+        } BinEntry;
+        BinEntry top[BIN_TOP];
+        int top_count = 0;
+
+        for (int r = 0; r < BIN_SIZE; r++) {
+                for (int g = 0; g < BIN_SIZE; g++) {
+                        for (int b = 0; b < BIN_SIZE; b++) {
+                                int cnt = bin_counts[r][g][b];
+                                if (cnt == 0)
+                                        continue;
+                                int pos = top_count < BIN_TOP ? top_count : BIN_TOP - 1;
+                                for (int p = 0; p < top_count && p < BIN_TOP; p++) {
+                                        if (cnt > top[p].count) {
+                                                pos = p;
+                                                break;
+                                        }
+                                }
+                                if (top_count < BIN_TOP)
+                                        top_count++;
+                                for (int p = top_count - 1; p > pos; p--)
+                                        top[p] = top[p - 1];
+                                top[pos].count = cnt;
+                                top[pos].r_idx = r;
+                                top[pos].g_idx = g;
+                                top[pos].b_idx = b;
+                        }
+                }
+        }
+
+        palette->count = top_count;
+        for (int i = 0; i < top_count; i++) {
+                palette->colors[i] = (PixelData){
+                    .r = (unsigned char)((top[i].r_idx << BIN_SHIFT) | (BIN_SHIFT > 0 ? (1 << (BIN_SHIFT - 1)) : 0)),
+                    .g = (unsigned char)((top[i].g_idx << BIN_SHIFT) | (BIN_SHIFT > 0 ? (1 << (BIN_SHIFT - 1)) : 0)),
+                    .b = (unsigned char)((top[i].b_idx << BIN_SHIFT) | (BIN_SHIFT > 0 ? (1 << (BIN_SHIFT - 1)) : 0)),
+                    .a = 255};
+        }
+}
+
+#define TOPN_VIBRANT_N 8
+#define TOPN_SAMPLES 600
+#define TOPN_LUM_THRESHOLD 80
+#define TOPN_MIN_DIST_SQ 3600.0f
+#define TOPN_HALF (TOPN_VIBRANT_N / 2)
+
+typedef struct {
+        float score;
+        unsigned char r, g, b;
+} VibEntry;
+
+static void init_vib_entries(VibEntry *entries, int n)
+{
+        for (int i = 0; i < n; i++)
+                entries[i].score = -1.0f;
+}
+
+static int insert_vib_entry(VibEntry *entries, int count, int max, float vibrance, unsigned char r, unsigned char g, unsigned char b)
+{
+        int pos = -1;
+        for (int p = 0; p < count && p < max; p++) {
+                if (vibrance > entries[p].score) {
+                        pos = p;
+                        break;
+                }
+        }
+        if (pos == -1 && count < max)
+                pos = count;
+
+        if (pos < 0)
+                return count;
+
+        for (int p = 0; p < count; p++) {
+                if (p == pos)
+                        continue;
+                float dr = (float)r - entries[p].r;
+                float dg = (float)g - entries[p].g;
+                float db = (float)b - entries[p].b;
+                if (dr * dr + dg * dg + db * db < TOPN_MIN_DIST_SQ)
+                        return count;
+        }
+
+        for (int p = max - 1; p > pos; p--)
+                entries[p] = entries[p - 1];
+        entries[pos].score = vibrance;
+        entries[pos].r = r;
+        entries[pos].g = g;
+        entries[pos].b = b;
+        if (count < max)
+                count++;
+        return count;
+}
+
+static void generate_topn_vibrant_palette(ColorPalette *palette, const unsigned char *pixels, int w, int h, int channels)
+{
+        int total_pixels = w * h;
+        if (total_pixels <= 0 || pixels == NULL) {
+                palette->count = 0;
+                return;
+        }
+
+        VibEntry dark[TOPN_HALF];
+        VibEntry bright[TOPN_HALF];
+        init_vib_entries(dark, TOPN_HALF);
+        init_vib_entries(bright, TOPN_HALF);
+        int dark_count = 0;
+        int bright_count = 0;
+
+        int step = total_pixels / TOPN_SAMPLES;
+        if (step < 1)
+                step = 1;
+
+        for (int i = 0; i < total_pixels; i += step) {
+                int idx = i * channels;
+                unsigned char cr = pixels[idx];
+                unsigned char cg = pixels[idx + 1];
+                unsigned char cb = pixels[idx + 2];
+                float r = (float)cr;
+                float g = (float)cg;
+                float b = (float)cb;
+
+                float max_c = r > g ? r : g;
+                if (b > max_c)
+                        max_c = b;
+                float min_c = r < g ? r : g;
+                if (b < min_c)
+                        min_c = b;
+                float chroma = max_c - min_c;
+                float lum = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+                float vibrance = chroma * (1.0f - fabsf(lum - 128.0f) / 128.0f);
+
+                if (lum < TOPN_LUM_THRESHOLD)
+                        dark_count = insert_vib_entry(dark, dark_count, TOPN_HALF, vibrance, cr, cg, cb);
+                else
+                        bright_count = insert_vib_entry(bright, bright_count, TOPN_HALF, vibrance, cr, cg, cb);
+        }
+
+        palette->count = 0;
+        for (int i = dark_count - 1; i >= 0 && palette->count < TOPN_VIBRANT_N; i--) {
+                palette->colors[palette->count++] = (PixelData){
+                    .r = dark[i].r, .g = dark[i].g, .b = dark[i].b, .a = 255};
+        }
+        for (int i = 0; i < bright_count && palette->count < TOPN_VIBRANT_N; i++) {
+                palette->colors[palette->count++] = (PixelData){
+                    .r = bright[i].r, .g = bright[i].g, .b = bright[i].b, .a = 255};
+        }
+}
+
+static void run_kmeans(PixelData *samples, int num_samples, PixelData centroids[3])
+{
+        if (num_samples < 3) {
+                for (int k = 0; k < 3; k++) {
+                        centroids[k] = (num_samples > 0) ? samples[0] : (PixelData){128, 128, 128, 255};
+                }
+                return;
+        }
+
+        centroids[0] = samples[0];
+        centroids[1] = samples[num_samples / 2];
+        centroids[2] = samples[num_samples - 1];
+
+        int assignments[1024];
+        if (num_samples > 1024)
+                num_samples = 1024;
+
+        long long sum_r[3], sum_g[3], sum_b[3];
+        int count[3];
+
+        for (int iter = 0; iter < 6; iter++) {
+                for (int i = 0; i < num_samples; i++) {
+                        double min_dist = 1e9;
+                        int best_k = 0;
+                        for (int k = 0; k < 3; k++) {
+                                double dr = (double)samples[i].r - centroids[k].r;
+                                double dg = (double)samples[i].g - centroids[k].g;
+                                double db = (double)samples[i].b - centroids[k].b;
+                                double dist = dr * dr + dg * dg + db * db;
+                                if (dist < min_dist) {
+                                        min_dist = dist;
+                                        best_k = k;
+                                }
+                        }
+                        assignments[i] = best_k;
+                }
+
+                memset(sum_r, 0, sizeof(sum_r));
+                memset(sum_g, 0, sizeof(sum_g));
+                memset(sum_b, 0, sizeof(sum_b));
+                memset(count, 0, sizeof(count));
+
+                for (int i = 0; i < num_samples; i++) {
+                        int k = assignments[i];
+                        sum_r[k] += samples[i].r;
+                        sum_g[k] += samples[i].g;
+                        sum_b[k] += samples[i].b;
+                        count[k]++;
+                }
+
+                for (int k = 0; k < 3; k++) {
+                        if (count[k] > 0) {
+                                centroids[k].r = (unsigned char)(sum_r[k] / count[k]);
+                                centroids[k].g = (unsigned char)(sum_g[k] / count[k]);
+                                centroids[k].b = (unsigned char)(sum_b[k] / count[k]);
+                        } else {
+                                centroids[k] = samples[rand() % num_samples];
+                        }
+                }
+        }
+
+        for (int i = 0; i < 2; i++) {
+                for (int j = i + 1; j < 3; j++) {
+                        if (count[j] > count[i]) {
+                                int tmp_c = count[i];
+                                count[i] = count[j];
+                                count[j] = tmp_c;
+                                PixelData tmp_p = centroids[i];
+                                centroids[i] = centroids[j];
+                                centroids[j] = tmp_p;
+                        }
+                }
+        }
+}
+
+static void check_if_bright_pixel(unsigned char r, unsigned char g, unsigned char b, bool *found)
+{
+        // Match main branch logic
+        unsigned char lum = (unsigned char)(0.2126f * r + 0.7152f * g + 0.0722f * b);
+        if (lum > 60 && !(r < g + 20 && r > g - 20 && g < b + 20 && g > b - 20) && !(r > 150 && g > 150 && b > 150)) {
+                *found = true;
+        }
+}
+
+static void generate_kmeans_clustering_palette(ColorPalette *palette, const unsigned char *pixels, int w, int h, int channels)
+{
+        if (w <= 0 || h <= 0 || pixels == NULL) {
+                palette->count = 0;
+                return;
+        }
+
+        int step_y = h / 16;
+        int step_x = w / 16;
+        if (step_y < 1)
+                step_y = 1;
+        if (step_x < 1)
+                step_x = 1;
+
+        PixelData samples[1024];
+        int num_samples = 0;
+
+        // Pass 1: Bright pixels
+        for (int y = 0; y < h && num_samples < 1024; y += step_y) {
+                for (int x = 0; x < w && num_samples < 1024; x += step_x) {
+                        int idx = (y * w + x) * channels;
+                        unsigned char r = pixels[idx];
+                        unsigned char g = pixels[idx + 1];
+                        unsigned char b = pixels[idx + 2];
+                        bool bright = false;
+                        check_if_bright_pixel(r, g, b, &bright);
+                        if (bright) {
+                                samples[num_samples++] = (PixelData){r, g, b, 255};
+                        }
+                }
+        }
+
+        // Pass 2: All pixels (if no bright pixels found)
+        if (num_samples == 0) {
+                for (int y = 0; y < h && num_samples < 1024; y += step_y) {
+                        for (int x = 0; x < w && num_samples < 1024; x += step_x) {
+                                int idx = (y * w + x) * channels;
+                                samples[num_samples++] = (PixelData){pixels[idx], pixels[idx + 1], pixels[idx + 2], 255};
+                        }
+                }
+        }
+
+        PixelData centroids[3];
+        run_kmeans(samples, num_samples, centroids);
+
+        palette->count = 3;
+        for (int i = 0; i < 3; i++) {
+                palette->colors[i] = centroids[i];
+                palette->colors[i].a = 255;
+        }
+}
+
+static float pixel_luminance(const PixelData *c)
+{
+        return 0.2126f * c->r + 0.7152f * c->g + 0.0722f * c->b;
+}
+
+static void sort_palette_by_luminosity(ColorPalette *palette)
+{
+        for (int a = 1; a < palette->count; a++) {
+                PixelData key = palette->colors[a];
+                float key_lum = pixel_luminance(&key);
+                int b = a - 1;
+                while (b >= 0 && pixel_luminance(&palette->colors[b]) > key_lum) {
+                        palette->colors[b + 1] = palette->colors[b];
+                        b--;
+                }
+                palette->colors[b + 1] = key;
+        }
+}
+
+// Nearest neighbour, so that the thumbnail only has colors of the cover
+static unsigned char *make_thumbnail(const unsigned char *pixels, int width, int height, int *thumb_w, int *thumb_h)
+{
+        int tw = width;
+        int th = height;
+
+        if (width > PALETTE_EDGE || height > PALETTE_EDGE) {
+                if (width >= height) {
+                        tw = PALETTE_EDGE;
+                        th = (int)((long long)height * PALETTE_EDGE / width);
+                } else {
+                        th = PALETTE_EDGE;
+                        tw = (int)((long long)width * PALETTE_EDGE / height);
+                }
+                if (tw < 1)
+                        tw = 1;
+                if (th < 1)
+                        th = 1;
+        }
+
+        unsigned char *thumb = malloc((size_t)tw * th * 4);
+        if (thumb == NULL)
+                return NULL;
+
+        for (int y = 0; y < th; y++) {
+                int sy = (int)(((long long)y * 2 + 1) * height / (2LL * th));
+
+                for (int x = 0; x < tw; x++) {
+                        int sx = (int)(((long long)x * 2 + 1) * width / (2LL * tw));
+
+                        memcpy(&thumb[((size_t)y * tw + x) * 4], &pixels[((size_t)sy * width + sx) * 4], 4);
+                }
+        }
+
+        *thumb_w = tw;
+        *thumb_h = th;
+
+        return thumb;
+}
+
+static uint64_t hash_thumbnail(const unsigned char *thumb, int width, int height)
+{
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ULL;
+        size_t size = (size_t)width * height * 4;
+
+        hash = (hash ^ (uint64_t)width) * 1099511628211ULL;
+        hash = (hash ^ (uint64_t)height) * 1099511628211ULL;
+
+        for (size_t i = 0; i < size; i++)
+                hash = (hash ^ thumb[i]) * 1099511628211ULL;
+
+        return hash;
+}
+
+static bool palette_cache_get(uint64_t hash, CoverPalettes *palettes)
+{
+        bool found = false;
+
+        pthread_mutex_lock(&palette_cache_mutex);
+
+        for (int i = 0; i < palette_cache_count; i++) {
+                if (palette_cache[i].hash == hash) {
+                        palette_cache[i].last_used = ++palette_cache_clock;
+                        *palettes = palette_cache[i].palettes;
+                        found = true;
+                        break;
+                }
+        }
+
+        pthread_mutex_unlock(&palette_cache_mutex);
+
+        return found;
+}
+
+static void palette_cache_put(uint64_t hash, const CoverPalettes *palettes)
+{
+        pthread_mutex_lock(&palette_cache_mutex);
+
+        int slot = palette_cache_count;
+
+        if (palette_cache_count == PALETTE_CACHE_SIZE) {
+                // Replace the least recently used
+                slot = 0;
+                for (int i = 1; i < PALETTE_CACHE_SIZE; i++) {
+                        if (palette_cache[i].last_used < palette_cache[slot].last_used)
+                                slot = i;
+                }
+        } else {
+                palette_cache_count++;
+        }
+
+        palette_cache[slot].hash = hash;
+        palette_cache[slot].last_used = ++palette_cache_clock;
+        palette_cache[slot].palettes = *palettes;
+
+        pthread_mutex_unlock(&palette_cache_mutex);
+}
+
+void load_cover_palettes(const unsigned char *pixels, int width, int height, CoverPalettes *palettes)
+{
+        memset(palettes, 0, sizeof(CoverPalettes));
+
+        if (pixels == NULL || width <= 0 || height <= 0)
+                return;
+
+        int w = 0, h = 0;
+        unsigned char *thumb = make_thumbnail(pixels, width, height, &w, &h);
+
+        if (thumb == NULL)
+                return;
+
+        uint64_t hash = hash_thumbnail(thumb, w, h);
+
+        if (palette_cache_get(hash, palettes)) {
+                free(thumb);
+                return;
+        }
+
+        generate_kmeans_palette(&palettes->lum_vibrant, thumb, w, h, 4);
+        sort_palette_by_luminosity(&palettes->lum_vibrant);
+
+        generate_binning_palette(&palettes->binning, thumb, w, h, 4);
+        if (palettes->binning.count > 8)
+                palettes->binning.count = 8;
+        sort_palette_by_luminosity(&palettes->binning);
+
+        generate_topn_vibrant_palette(&palettes->vibrant, thumb, w, h, 4);
+        generate_kmeans_clustering_palette(&palettes->kmeans_clustering, thumb, w, h, 4);
+
+        free(thumb);
+
+        palette_cache_put(hash, palettes);
+}
@@ -0,0 +1,35 @@
+/**
+ * @file cover_palette.h
+ * @brief Visualizer palettes derived from the album cover.
+ *
+ * All palettes of a cover are computed together, from a small copy of the
+ * bitmap, when the song is loaded. Results are remembered by the content
+ * of that copy, so the other tracks of an album reuse them.
+ */
+
+#ifndef COVER_PALETTE_H
+#define COVER_PALETTE_H
+
+#include "img_utils.h"
+
+/**
+ * @brief The palettes the visualizer can take from a cover.
+ */
+typedef struct {
+        ColorPalette lum_vibrant;       /**< Most vibrant color per luminance bucket. */
+        ColorPalette binning;           /**< Most common colors. */
+        ColorPalette vibrant;           /**< Most vibrant dark and bright colors. */
+        ColorPalette kmeans_clustering; /**< Three k-means clusters. */
+} CoverPalettes;
+
+/**
+ * @brief Computes the palettes of a cover.
+ *
+ * @param pixels   The RGBA cover bitmap, or NULL.
+ * @param width    Width of the bitmap.
+ * @param height   Height of the bitmap.
+ * @param palettes Output. Every palette is empty if there is no bitmap.
+ */
+void load_cover_palettes(const unsigned char *pixels, int width, int height, CoverPalettes *palettes);
+
+#endif
@@ -0,0 +1,635 @@
+/**
+ * @file dsp_kernels.c
+ * @brief Vectorized sample loops used by playback and the visualizer.
+ *
+ * Scalar reference kernels, x86 versions compiled per function for
+ * SSE4.1 and AVX2, NEON versions for 64-bit ARM, and the dispatch table.
+ */
+
+#include "dsp_kernels.h"
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DSP_X86 1
+#include <immintrin.h>
+#define DSP_TARGET(t) __attribute__((target(t)))
+#elif defined(__aarch64__)
+#define DSP_NEON 1
+#include <arm_neon.h>
+#endif
+
+#define S16_SCALE (1.0f / 32768.0f)
+#define S24_SCALE (1.0f / 8388608.0f)
+
+typedef struct {
+        const char *name;
+        void (*apply_gain)(float *samples, size_t count, float gain);
+        void (*crossfade)(const float *a, const float *gain_a,
+                          const float *b, const float *gain_b,
+                          float *out, size_t frames, unsigned channels);
+        void (*downmix)(const float *src, float *dst, size_t frames, unsigned channels);
+        void (*s16_to_f32)(const int16_t *src, float *dst, size_t count);
+        void (*s24_to_f32)(const uint8_t *src, float *dst, size_t count);
+        void (*multiply)(float *data, const float *window, size_t count);
+        float (*sum_squares)(const float *data, size_t count);
+} DspKernels;
+
+/* Scalar */
+
+static void apply_gain_scalar(float *samples, size_t count, float gain)
+{
+        for (size_t i = 0; i < count; i++)
+                samples[i] *= gain;
+}
+
+static void crossfade_scalar(const float *a, const float *gain_a,
+                             const float *b, const float *gain_b,
+                             float *out, size_t frames, unsigned channels)
+{
+        for (size_t i = 0; i < frames; i++) {
+                for (unsigned ch = 0; ch < channels; ch++) {
+                        size_t idx = i * channels + ch;
+                        float x = a[idx] * gain_a[i];
+                        float y = b[idx] * gain_b[i];
+                        out[idx] = x + y;
+                }
+        }
+}
+
+static void downmix_scalar(const float *src, float *dst, size_t frames, unsigned channels)
+{
+        for (size_t i = 0; i < frames; i++) {
+                const float *frame = src + i * channels;
+                float sum = frame[0];
+
+                for (unsigned ch = 1; ch < channels; ch++)
+                        sum += frame[ch];
+
+                dst[i] = sum / (float)channels;
+        }
+}
+
+static void s16_to_f32_scalar(const int16_t *src, float *dst, size_t count)
+{
+        for (size_t i = 0; i < count; i++)
+                dst[i] = (float)src[i] * S16_SCALE;
+}
+
+static inline int32_t unpack_s24(const uint8_t *p)
+{
+        // Place the sample in the top three bytes, the shift sign-extends it
+        uint32_t u = ((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 24);
+        return (int32_t)u >> 8;
+}
+
+static void s24_to_f32_scalar(const uint8_t *src, float *dst, size_t count)
+{
+        for (size_t i = 0; i < count; i++)
+                dst[i] = (float)unpack_s24(src + i * 3) * S24_SCALE;
+}
+
+static void multiply_scalar(float *data, const float *window, size_t count)
+{
+        for (size_t i = 0; i < count; i++)
+                data[i] *= window[i];
+}
+
+// Four running sums, like the SSE4.1 and NEON versions, so that the result
+// is the same whichever is used
+static float sum_squares_scalar(const float *data, size_t count)
+{
+        float lane[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        size_t i = 0;
+
+        for (; i + 4 <= count; i += 4) {
+                for (int j = 0; j < 4; j++)
+                        lane[j] += data[i + j] * data[i + j];
+        }
+
+        float sum = (lane[0] + lane[1]) + (lane[2] + lane[3]);
+
+        for (; i < count; i++)
+                sum += data[i] * data[i];
+
+        return sum;
+}
+
+static const DspKernels scalar_kernels = {
+    .name = "scalar",
+    .apply_gain = apply_gain_scalar,
+    .crossfade = crossfade_scalar,
+    .downmix = downmix_scalar,
+    .s16_to_f32 = s16_to_f32_scalar,
+    .s24_to_f32 = s24_to_f32_scalar,
+    .multiply = multiply_scalar,
+    .sum_squares = sum_squares_scalar,
+};
+
+#ifdef DSP_X86
+
+/* SSE4.1 */
+
+DSP_TARGET("sse4.1")
+static void apply_gain_sse41(float *samples, size_t count, float gain)
+{
+        __m128 g = _mm_set1_ps(gain);
+        size_t i = 0;
+
+        for (; i + 4 <= count; i += 4)
+                _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), g));
+
+        apply_gain_scalar(samples + i, count - i, gain);
+}
+
+DSP_TARGET("sse4.1")
+static void crossfade_sse41(const float *a, const float *gain_a,
+                            const float *b, const float *gain_b,
+                            float *out, size_t frames, unsigned channels)
+{
+        size_t i = 0;
+
+        if (channels == 1) {
+                for (; i + 4 <= frames; i += 4) {
+                        __m128 x = _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(gain_a + i));
+                        __m128 y = _mm_mul_ps(_mm_loadu_ps(b + i), _mm_loadu_ps(gain_b + i));
+                        _mm_storeu_ps(out + i, _mm_add_ps(x, y));
+                }
+        } else if (channels == 2) {
+                for (; i + 4 <= frames; i += 4) {
+                        __m128 ga = _mm_loadu_ps(gain_a + i);
+                        __m128 gb = _mm_loadu_ps(gain_b + i);
+                        const float *pa = a + i * 2;
+                        const float *pb = b + i * 2;
+
+                        // Repeat each frame's gain for both of its channels
+                        __m128 x0 = _mm_mul_ps(_mm_loadu_ps(pa), _mm_unpacklo_ps(ga, ga));
+                        __m128 x1 = _mm_mul_ps(_mm_loadu_ps(pa + 4), _mm_unpackhi_ps(ga, ga));
+                        __m128 y0 = _mm_mul_ps(_mm_loadu_ps(pb), _mm_unpacklo_ps(gb, gb));
+                        __m128 y1 = _mm_mul_ps(_mm_loadu_ps(pb + 4), _mm_unpackhi_ps(gb, gb));
+
+                        _mm_storeu_ps(out + i * 2, _mm_add_ps(x0, y0));
+                        _mm_storeu_ps(out + i * 2 + 4, _mm_add_ps(x1, y1));
+                }
+        }
+
+        crossfade_scalar(a + i * channels, gain_a + i, b + i * channels, gain_b + i,
+                         out + i * channels, frames - i, channels);
+}
+
+DSP_TARGET("sse4.1")
+static void downmix_sse41(const float *src, float *dst, size_t frames, unsigned channels)
+{
+        size_t i = 0;
+
+        if (channels == 2) {
+                __m128 div = _mm_set1_ps(2.0f);
+
+                for (; i + 4 <= frames; i += 4) {
+                        __m128 lo = _mm_loadu_ps(src + i * 2);
+                        __m128 hi = _mm_loadu_ps(src + i * 2 + 4);
+                        __m128 left = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+                        __m128 right = _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+                        _mm_storeu_ps(dst + i, _mm_div_ps(_mm_add_ps(left, right), div));
+                }
+        }
+
+        downmix_scalar(src + i * channels, dst + i, frames - i, channels);
+}
+
+DSP_TARGET("sse4.1")
+static void s16_to_f32_sse41(const int16_t *src, float *dst, size_t count)
+{
+        __m128 scale = _mm_set1_ps(S16_SCALE);
+        size_t i = 0;
+
+        for (; i + 8 <= count; i += 8) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+                __m128i lo = _mm_cvtepi16_epi32(v);
+                __m128i hi = _mm_cvtepi16_epi32(_mm_srli_si128(v, 8));
+                _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+                _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+        }
+
+        s16_to_f32_scalar(src + i, dst + i, count - i);
+}
+
+DSP_TARGET("sse4.1")
+static void s24_to_f32_sse41(const uint8_t *src, float *dst, size_t count)
+{
+        // Moves each 3-byte sample into the top of a 32-bit lane
+        const __m128i shuffle = _mm_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,
+                                              -1, 6, 7, 8, -1, 9, 10, 11);
+        __m128 scale = _mm_set1_ps(S24_SCALE);
+        size_t i = 0;
+
+        // Four samples use 12 bytes, but the load reads 16
+        for (; i + 6 <= count; i += 4) {
+                __m128i v = _mm_loadu_si128((const __m128i *)(src + i * 3));
+                __m128i s = _mm_srai_epi32(_mm_shuffle_epi8(v, shuffle), 8);
+                _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(s), scale));
+        }
+
+        s24_to_f32_scalar(src + i * 3, dst + i, count - i);
+}
+
+DSP_TARGET("sse4.1")
+static void multiply_sse41(float *data, const float *window, size_t count)
+{
+        size_t i = 0;
+
+        for (; i + 4 <= count; i += 4)
+                _mm_storeu_ps(data + i, _mm_mul_ps(_mm_loadu_ps(data + i), _mm_loadu_ps(window + i)));
+
+        multiply_scalar(data + i, window + i, count - i);
+}
+
+DSP_TARGET("sse4.1")
+static float sum_squares_sse41(const float *data, size_t count)
+{
+        __m128 acc = _mm_setzero_ps();
+        size_t i = 0;
+
+        for (; i + 4 <= count; i += 4) {
+                __m128 v = _mm_loadu_ps(data + i);
+                acc = _mm_add_ps(acc, _mm_mul_ps(v, v));
+        }
+
+        float lane[4];
+        _mm_storeu_ps(lane, acc);
+
+        float sum = (lane[0] + lane[1]) + (lane[2] + lane[3]);
+
+        for (; i < count; i++)
+                sum += data[i] * data[i];
+
+        return sum;
+}
+
+static const DspKernels sse41_kernels = {
+    .name = "sse4.1",
+    .apply_gain = apply_gain_sse41,
+    .crossfade = crossfade_sse41,
+    .downmix = downmix_sse41,
+    .s16_to_f32 = s16_to_f32_sse41,
+    .s24_to_f32 = s24_to_f32_sse41,
+    .multiply = multiply_sse41,
+    .sum_squares = sum_squares_sse41,
+};
+
+/* AVX2 */
+
+DSP_TARGET("avx2")
+static void apply_gain_avx2(float *samples, size_t count, float gain)
+{
+        __m256 g = _mm256_set1_ps(gain);
+        size_t i = 0;
+
+        for (; i + 8 <= count; i += 8)
+                _mm256_storeu_ps(samples + i, _mm256_mul_ps(_mm256_loadu_ps(samples + i), g));
+
+        apply_gain_scalar(samples + i, count - i, gain);
+}
+
+DSP_TARGET("avx2")
+static void crossfade_avx2(const float *a, const float *gain_a,
+                           const float *b, const float *gain_b,
+                           float *out, size_t frames, unsigned channels)
+{
+        size_t i = 0;
+
+        if (channels == 1) {
+                for (; i + 8 <= frames; i += 8) {
+                        __m256 x = _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(gain_a + i));
+                        __m256 y = _mm256_mul_ps(_mm256_loadu_ps(b + i), _mm256_loadu_ps(gain_b + i));
+                        _mm256_storeu_ps(out + i, _mm256_add_ps(x, y));
+                }
+        } else if (channels == 2) {
+                // Gain index for each lane: frames 0,0,1,1,2,2,3,3 of the group
+                const __m256i lo_idx = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+                const __m256i hi_idx = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+
+                for (; i + 8 <= frames; i += 8) {
+                        __m256 ga = _mm256_loadu_ps(gain_a + i);
+                        __m256 gb = _mm256_loadu_ps(gain_b + i);
+                        const float *pa = a + i * 2;
+                        const float *pb = b + i * 2;
+
+                        __m256 x0 = _mm256_mul_ps(_mm256_loadu_ps(pa), _mm256_permutevar8x32_ps(ga, lo_idx));
+                        __m256 x1 = _mm256_mul_ps(_mm256_loadu_ps(pa + 8), _mm256_permutevar8x32_ps(ga, hi_idx));
+                        __m256 y0 = _mm256_mul_ps(_mm256_loadu_ps(pb), _mm256_permutevar8x32_ps(gb, lo_idx));
+                        __m256 y1 = _mm256_mul_ps(_mm256_loadu_ps(pb + 8), _mm256_permutevar8x32_ps(gb, hi_idx));
+
+                        _mm256_storeu_ps(out + i * 2, _mm256_add_ps(x0, y0));
+                        _mm256_storeu_ps(out + i * 2 + 8, _mm256_add_ps(x1, y1));
+                }
+        }
+
+        crossfade_scalar(a + i * channels, gain_a + i, b + i * channels, gain_b + i,
+                         out + i * channels, frames - i, channels);
+}
+
+DSP_TARGET("avx2")
+static void downmix_avx2(const float *src, float *dst, size_t frames, unsigned channels)
+{
+        size_t i = 0;
+
+        if (channels == 2) {
+                __m256 div = _mm256_set1_ps(2.0f);
+
+                for (; i + 8 <= frames; i += 8) {
+                        __m256 lo = _mm256_loadu_ps(src + i * 2);
+                        __m256 hi = _mm256_loadu_ps(src + i * 2 + 8);
+
+                        // Shuffles stay within 128-bit lanes, which leaves
+                        // the frames in the order 0 1 4 5 2 3 6 7
+                        __m256 left = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0));
+                        __m256 right = _mm256_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1));
+                        __m256 mono = _mm256_div_ps(_mm256_add_ps(left, right), div);
+
+                        mono = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(mono),
+                                                                      _MM_SHUFFLE(3, 1, 2, 0)));
+                        _mm256_storeu_ps(dst + i, mono);
+                }
+        }
+
+        downmix_scalar(src + i * channels, dst + i, frames - i, channels);
+}
+
+DSP_TARGET("avx2")
+static void s16_to_f32_avx2(const int16_t *src, float *dst, size_t count)
+{
+        __m256 scale = _mm256_set1_ps(S16_SCALE);
+        size_t i = 0;
+
+        for (; i + 8 <= count; i += 8) {
+                __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+                _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+        }
+
+        s16_to_f32_scalar(src + i, dst + i, count - i);
+}
+
+DSP_TARGET("avx2")
+static void s24_to_f32_avx2(const uint8_t *src, float *dst, size_t count)
+{
+        const __m256i shuffle = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5,
+                                                 -1, 6, 7, 8, -1, 9, 10, 11,
+                                                 -1, 0, 1, 2, -1, 3, 4, 5,
+                                                 -1, 6, 7, 8, -1, 9, 10, 11);
+        __m256 scale = _mm256_set1_ps(S24_SCALE);
+        size_t i = 0;
+
+        // Eight samples use 24 bytes, the second 16-byte load ends at byte 28
+        for (; i + 10 <= count; i += 8) {
+                __m128i lo = _mm_loadu_si128((const __m128i *)(src + i * 3));
+                __m128i hi = _mm_loadu_si128((const __m128i *)(src + i * 3 + 12));
+                __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+                __m256i s = _mm256_srai_epi32(_mm256_shuffle_epi8(v, shuffle), 8);
+                _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(s), scale));
+        }
+
+        s24_to_f32_scalar(src + i * 3, dst + i, count - i);
+}
+
+DSP_TARGET("avx2")
+static void multiply_avx2(float *data, const float *window, size_t count)
+{
+        size_t i = 0;
+
+        for (; i + 8 <= count; i += 8)
+                _mm256_storeu_ps(data + i, _mm256_mul_ps(_mm256_loadu_ps(data + i), _mm256_loadu_ps(window + i)));
+
+        multiply_scalar(data + i, window + i, count - i);
+}
+
+static const DspKernels avx2_kernels = {
+    .name = "avx2",
+    .apply_gain = apply_gain_avx2,
+    .crossfade = crossfade_avx2,
+    .downmix = downmix_avx2,
+    .s16_to_f32 = s16_to_f32_avx2,
+    .s24_to_f32 = s24_to_f32_avx2,
+    .multiply = multiply_avx2,
+    .sum_squares = sum_squares_sse41, // Eight lanes would sum in another order
+};
+
+#endif
+
+#ifdef DSP_NEON
+
+/* NEON */
+
+static void apply_gain_neon(float *samples, size_t count, float gain)
+{
+        size_t i = 0;
+
+        for (; i + 4 <= count; i += 4)
+                vst1q_f32(samples + i, vmulq_n_f32(vld1q_f32(samples + i), gain));
+
+        apply_gain_scalar(samples + i, count - i, gain);
+}
+
+static void crossfade_neon(const float *a, const float *gain_a,
+                           const float *b, const float *gain_b,
+                           float *out, size_t frames, unsigned channels)
+{
+        size_t i = 0;
+
+        if (channels == 1) {
+                for (; i + 4 <= frames; i += 4) {
+                        float32x4_t x = vmulq_f32(vld1q_f32(a + i), vld1q_f32(gain_a + i));
+                        float32x4_t y = vmulq_f32(vld1q_f32(b + i), vld1q_f32(gain_b + i));
+                        vst1q_f32(out + i, vaddq_f32(x, y));
+                }
+        } else if (channels == 2) {
+                for (; i + 4 <= frames; i += 4) {
+                        float32x4x2_t va = vld2q_f32(a + i * 2);
+                        float32x4x2_t vb = vld2q_f32(b + i * 2);
+                        float32x4_t ga = vld1q_f32(gain_a + i);
+                        float32x4_t gb = vld1q_f32(gain_b + i);
+                        float32x4x2_t r;
+
+                        r.val[0] = vaddq_f32(vmulq_f32(va.val[0], ga), vmulq_f32(vb.val[0], gb));
+                        r.val[1] = vaddq_f32(vmulq_f32(va.val[1], ga), vmulq_f32(vb.val[1], gb));
+
+                        vst2q_f32(out + i * 2, r);
+                }
+        }
+
+        crossfade_scalar(a + i * channels, gain_a + i, b + i * channels, gain_b + i,
+                         out + i * channels, frames - i, channels);
+}
+
+static void downmix_neon(const float *src, float *dst, size_t frames, unsigned channels)
+{
+        size_t i = 0;
+
+        if (channels == 2) {
+                float32x4_t div = vdupq_n_f32(2.0f);
+
+                for (; i + 4 <= frames; i += 4) {
+                        float32x4x2_t v = vld2q_f32(src + i * 2);
+                        vst1q_f32(dst + i, vdivq_f32(vaddq_f32(v.val[0], v.val[1]), div));
+                }
+        }
+
+        downmix_scalar(src + i * channels, dst + i, frames - i, channels);
+}
+
+static void s16_to_f32_neon(const int16_t *src, float *dst, size_t count)
+{
+        size_t i = 0;
+
+        for (; i + 8 <= count; i += 8) {
+                int16x8_t v = vld1q_s16(src + i);
+                float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+                float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+                vst1q_f32(dst + i, vmulq_n_f32(lo, S16_SCALE));
+                vst1q_f32(dst + i + 4, vmulq_n_f32(hi, S16_SCALE));
+        }
+
+        s16_to_f32_scalar(src + i, dst + i, count - i);
+}
+
+static void multiply_neon(float *data, const float *window, size_t count)
+{
+        size_t i = 0;
+
+        for (; i + 4 <= count; i += 4)
+                vst1q_f32(data + i, vmulq_f32(vld1q_f32(data + i), vld1q_f32(window + i)));
+
+        multiply_scalar(data + i, window + i, count - i);
+}
+
+static float sum_squares_neon(const float *data, size_t count)
+{
+        float32x4_t acc = vdupq_n_f32(0.0f);
+        size_t i = 0;
+
+        for (; i + 4 <= count; i += 4) {
+                float32x4_t v = vld1q_f32(data + i);
+                acc = vaddq_f32(acc, vmulq_f32(v, v));
+        }
+
+        float lane[4];
+        vst1q_f32(lane, acc);
+
+        float sum = (lane[0] + lane[1]) + (lane[2] + lane[3]);
+
+        for (; i < count; i++)
+                sum += data[i] * data[i];
+
+        return sum;
+}
+
+static const DspKernels neon_kernels = {
+    .name = "neon",
+    .apply_gain = apply_gain_neon,
+    .crossfade = crossfade_neon,
+    .downmix = downmix_neon,
+    .s16_to_f32 = s16_to_f32_neon,
+    .s24_to_f32 = s24_to_f32_scalar,
+    .multiply = multiply_neon,
+    .sum_squares = sum_squares_neon,
+};
+
+#endif
+
+/* Dispatch */
+
+static const DspKernels *kernels = &scalar_kernels;
+
+void dsp_kernels_init(void)
+{
+#ifdef DSP_X86
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2"))
+                kernels = &avx2_kernels;
+        else if (__builtin_cpu_supports("sse4.1"))
+                kernels = &sse41_kernels;
+        else
+                kernels = &scalar_kernels;
+#elif defined(DSP_NEON)
+        kernels = &neon_kernels;
+#else
+        kernels = &scalar_kernels;
+#endif
+}
+
+const char *dsp_kernels_name(void)
+{
+        return kernels->name;
+}
+
+bool dsp_kernels_select(const char *name)
+{
+        if (strcmp(name, scalar_kernels.name) == 0) {
+                kernels = &scalar_kernels;
+                return true;
+        }
+
+#ifdef DSP_X86
+        __builtin_cpu_init();
+
+        if (strcmp(name, avx2_kernels.name) == 0 && __builtin_cpu_supports("avx2")) {
+                kernels = &avx2_kernels;
+                return true;
+        }
+
+        if (strcmp(name, sse41_kernels.name) == 0 && __builtin_cpu_supports("sse4.1")) {
+                kernels = &sse41_kernels;
+                return true;
+        }
+#elif defined(DSP_NEON)
+        if (strcmp(name, neon_kernels.name) == 0) {
+                kernels = &neon_kernels;
+                return true;
+        }
+#endif
+
+        return false;
+}
+
+void dsp_apply_gain_f32(float *samples, size_t count, float gain)
+{
+        kernels->apply_gain(samples, count, gain);
+}
+
+void dsp_crossfade_f32(const float *a, const float *gain_a,
+                       const float *b, const float *gain_b,
+                       float *out, size_t frames, unsigned channels)
+{
+        kernels->crossfade(a, gain_a, b, gain_b, out, frames, channels);
+}
+
+void dsp_downmix_f32(const float *src, float *dst, size_t frames, unsigned channels)
+{
+        if (channels == 1) {
+                memmove(dst, src, frames * sizeof(float));
+                return;
+        }
+
+        kernels->downmix(src, dst, frames, channels);
+}
+
+void dsp_s16_to_f32(const int16_t *src, float *dst, size_t count)
+{
+        kernels->s16_to_f32(src, dst, count);
+}
+
+void dsp_s24_to_f32(const uint8_t *src, float *dst, size_t count)
+{
+        kernels->s24_to_f32(src, dst, count);
+}
+
+void dsp_multiply_f32(float *data, const float *window, size_t count)
+{
+        kernels->multiply(data, window, count);
+}
+
+float dsp_sum_squares_f32(const float *data, size_t count)
+{
+        return kernels->sum_squares(data, count);
+}
@@ -0,0 +1,115 @@
+/**
+ * @file dsp_kernels.h
+ * @brief Vectorized sample loops used by playback and the visualizer.
+ *
+ * Each kernel has a scalar version and, where the CPU supports it, an
+ * SSE4.1, AVX2 or NEON version. The fastest available set is picked once
+ * by dsp_kernels_init(). Until then, and on other CPUs, the scalar
+ * versions are used. The vector versions do the same operations in the
+ * same order as the scalar ones, so the output doesn't depend on which
+ * set is active.
+ */
+
+#ifndef DSP_KERNELS_H
+#define DSP_KERNELS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Detects CPU features and selects the kernels to use.
+ *
+ * Call once at startup, before any audio thread is running.
+ */
+void dsp_kernels_init(void);
+
+/**
+ * @brief Gets the name of the selected kernel set, for logging.
+ *
+ * @return "scalar", "sse4.1", "avx2" or "neon".
+ */
+const char *dsp_kernels_name(void);
+
+/**
+ * @brief Selects a kernel set by name, for comparing them.
+ *
+ * @param name "scalar", "sse4.1", "avx2" or "neon".
+ * @return false if the set isn't built in or the CPU doesn't support it.
+ */
+bool dsp_kernels_select(const char *name);
+
+/**
+ * @brief Multiplies samples by a constant gain, in place.
+ *
+ * @param samples Samples to scale.
+ * @param count Number of samples.
+ * @param gain Linear gain.
+ */
+void dsp_apply_gain_f32(float *samples, size_t count, float gain);
+
+/**
+ * @brief Mixes two interleaved streams with a gain per frame for each.
+ *
+ * out = a * gain_a + b * gain_b, with the frame's gains applied to all
+ * of its channels.
+ *
+ * @param a First stream.
+ * @param gain_a Gain per frame for the first stream.
+ * @param b Second stream.
+ * @param gain_b Gain per frame for the second stream.
+ * @param out Output, may alias a or b.
+ * @param frames Number of frames.
+ * @param channels Channels per frame.
+ */
+void dsp_crossfade_f32(const float *a, const float *gain_a,
+                       const float *b, const float *gain_b,
+                       float *out, size_t frames, unsigned channels);
+
+/**
+ * @brief Averages the channels of interleaved frames into mono.
+ *
+ * @param src Interleaved input.
+ * @param dst Mono output, one sample per frame.
+ * @param frames Number of frames.
+ * @param channels Channels per frame.
+ */
+void dsp_downmix_f32(const float *src, float *dst, size_t frames, unsigned channels);
+
+/**
+ * @brief Converts signed 16-bit samples to float in [-1, 1).
+ *
+ * @param src Input samples.
+ * @param dst Output samples.
+ * @param count Number of samples.
+ */
+void dsp_s16_to_f32(const int16_t *src, float *dst, size_t count);
+
+/**
+ * @brief Converts packed little-endian signed 24-bit samples to float in [-1, 1).
+ *
+ * @param src Input, three bytes per sample.
+ * @param dst Output samples.
+ * @param count Number of samples.
+ */
+void dsp_s24_to_f32(const uint8_t *src, float *dst, size_t count);
+
+/**
+ * @brief Multiplies samples by a window of the same length, in place.
+ *
+ * @param data Samples to scale.
+ * @param window Window coefficients.
+ * @param count Number of samples.
+ */
+void dsp_multiply_f32(float *data, const float *window, size_t count);
+
+/**
+ * @brief Returns the sum of the squared samples.
+ *
+ * @param data Samples, or interleaved real and imaginary parts.
+ * @param count Number of floats.
+ * @return The sum.
+ */
+float dsp_sum_squares_f32(const float *data, size_t count);
+
+#endif
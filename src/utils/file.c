@@ -25,6 +25,7 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
+#include <utime.h>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -358,6 +359,96 @@ int delete_file(const char *file_path)
         }
 }
 
+void touch_file(const char *file_path)
+{
+        utime(file_path, NULL);
+}
+
+typedef struct {
+        char *path;
+        time_t mtime;
+        long long size;
+} PruneEntry;
+
+static int compare_prune_entries(const void *a, const void *b)
+{
+        const PruneEntry *ea = a;
+        const PruneEntry *eb = b;
+
+        if (ea->mtime != eb->mtime)
+                return (ea->mtime < eb->mtime) ? -1 : 1;
+
+        return 0;
+}
+
+void prune_directory(const char *dir_path, const char *suffix, long long max_bytes)
+{
+        DIR *dir = opendir(dir_path);
+        if (dir == NULL)
+                return;
+
+        PruneEntry *entries = NULL;
+        size_t count = 0, capacity = 0;
+        long long total = 0;
+        size_t suffix_len = strlen(suffix);
+        struct dirent *entry;
+
+        while ((entry = readdir(dir)) != NULL) {
+                size_t name_len = strlen(entry->d_name);
+
+                if (name_len <= suffix_len || strcmp(entry->d_name + name_len - suffix_len, suffix) != 0)
+                        continue;
+
+                char path[KEW_PATH_MAX];
+                struct stat st;
+
+                int written = snprintf(path, sizeof(path), "%s/%s", dir_path, entry->d_name);
+
+                if (written < 0 || (size_t)written >= sizeof(path) ||
+                    stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+                        continue;
+
+                if (count == capacity) {
+                        size_t new_capacity = capacity ? capacity * 2 : 256;
+                        PruneEntry *grown = realloc(entries, new_capacity * sizeof(PruneEntry));
+
+                        if (grown == NULL)
+                                break;
+
+                        entries = grown;
+                        capacity = new_capacity;
+                }
+
+                entries[count].path = strdup(path);
+                if (entries[count].path == NULL)
+                        break;
+
+                entries[count].mtime = st.st_mtime;
+                entries[count].size = (long long)st.st_size;
+                total += entries[count].size;
+                count++;
+        }
+
+        closedir(dir);
+
+        if (total > max_bytes) {
+                qsort(entries, count, sizeof(PruneEntry), compare_prune_entries);
+
+                // Go a quarter below the limit, so it isn't hit again right away
+                long long target = max_bytes - max_bytes / 4;
+
+                for (size_t i = 0; i < count && total > target; i++) {
+                        if (delete_file(entries[i].path) == 0)
+                                total -= entries[i].size;
+                }
+        }
+
+        for (size_t i = 0; i < count; i++)
+                free(entries[i].path);
+
+        free(entries);
+}
+
 int is_in_temp_dir(const char *path)
 {
         const char *tmp_dir = getenv("TMPDIR");
@@ -171,6 +171,28 @@ int create_directory(const char *path);
  */
 int delete_file(const char *file_path);
 
+/**
+ * @brief Sets the modification time of a file to now.
+ *
+ * Caches use it to mark an entry as recently used.
+ *
+ * @param file_path The path of the file.
+ */
+void touch_file(const char *file_path);
+
+/**
+ * @brief Deletes the least recently modified files of a cache directory.
+ *
+ * Only files ending in suffix count. If they add up to more than
+ * max_bytes, the oldest are deleted until they take up three quarters of
+ * it.
+ *
+ * @param dir_path The directory.
+ * @param suffix The suffix of the files to consider, like ".qoi".
+ * @param max_bytes The size limit.
+ */
+void prune_directory(const char *dir_path, const char *suffix, long long max_bytes);
+
 
 /**
  * @brief Checks if the given path is within the temporary directory.
@@ -12,7 +12,9 @@
 
 #include "img_utils.h"
 
+#include <limits.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 #define MACRO_STRLEN(s) (sizeof(s) / sizeof(s[0]))
 
@@ -36,12 +38,48 @@ unsigned char *get_bitmap(const char *image_path, int *width, int *height)
         return image;
 }
 
+unsigned char *get_bitmap_from_memory(const unsigned char *data, size_t size, int *width, int *height)
+{
+        if (data == NULL || size == 0 || size > INT_MAX)
+                return NULL;
+
+        int channels;
+
+        unsigned char *image = stbi_load_from_memory(data, (int)size, width, height, &channels, 4); // Force 4 channels (RGBA)
+        if (!image) {
+                fprintf(stderr, "Failed to decode embedded image\n");
+                return NULL;
+        }
+
+        return image;
+}
+
 unsigned char *image_load_rgb(const char *filepath, int *width, int *height, int *channels)
 {
         // Force 3 channels (RGB)
         return stbi_load(filepath, width, height, channels, 3);
 }
 
+unsigned char *image_rgba_to_rgb(const unsigned char *rgba, int width, int height)
+{
+        if (rgba == NULL || width <= 0 || height <= 0)
+                return NULL;
+
+        size_t pixels = (size_t)width * height;
+        unsigned char *rgb = malloc(pixels * 3);
+
+        if (rgb == NULL)
+                return NULL;
+
+        for (size_t i = 0; i < pixels; i++) {
+                rgb[i * 3 + 0] = rgba[i * 4 + 0];
+                rgb[i * 3 + 1] = rgba[i * 4 + 1];
+                rgb[i * 3 + 2] = rgba[i * 4 + 2];
+        }
+
+        return rgb;
+}
+
 unsigned char *image_resize_uint8_srgb(
     const unsigned char *src,
     int src_w,
@@ -3,6 +3,8 @@
 #ifndef IMG_UTILS_H
 #define IMG_UTILS_H
 
+#include <stddef.h>
+
 /**
  * @brief Represents an RGB pixel color.
  *
@@ -17,6 +19,14 @@ typedef struct
         int a; /**< Alpha component (0–255). */
 } PixelData;
 
+/**
+ * @brief A list of colors, such as the gradient of the visualizer.
+ */
+typedef struct {
+        PixelData colors[16];
+        int count;
+} ColorPalette;
+
 #define COLOR_DEFAULT      ((PixelData){ .r = 0, .g = 0, .b = 0, .a = -1 })
 #define COLOR_RGB(r, g, b) ((PixelData){ .r = r, .g = g, .b = b, .a = 255 })
 #define COLOR_RGBA(r,g,b,a)((PixelData){ .r = r, .g = g, .b = b, .a = a   })
@@ -32,6 +42,17 @@ typedef struct
  */
 unsigned char *get_bitmap(const char *image_path, int *width, int *height);
 
+/**
+ * @brief Decodes an image held in memory, such as an embedded cover.
+ *
+ * @param data   The encoded image (JPEG, PNG...).
+ * @param size   Size of data in bytes.
+ * @param width  Output parameter set to the image width in pixels.
+ * @param height Output parameter set to the image height in pixels.
+ * @return Pointer to the RGBA pixel data, or NULL on failure. Must be freed with image_free().
+ */
+unsigned char *get_bitmap_from_memory(const unsigned char *data, size_t size, int *width, int *height);
+
 /**
  * @brief Loads an image and decodes it into 8-bit RGB format.
  *
@@ -43,6 +64,16 @@ unsigned char *get_bitmap(const char *image_path, int *width, int *height);
  */
 unsigned char *image_load_rgb(const char *filepath, int *width, int *height, int *channels);
 
+/**
+ * @brief Copies RGBA pixel data into a new RGB buffer, dropping alpha.
+ *
+ * @param rgba   The RGBA pixel data.
+ * @param width  Width of the image in pixels.
+ * @param height Height of the image in pixels.
+ * @return Pointer to the RGB pixel data, or NULL on failure. Must be freed with image_free().
+ */
+unsigned char *image_rgba_to_rgb(const unsigned char *rgba, int width, int height);
+
 /**
  * @brief Resizes an 8-bit sRGB image into a caller-provided destination buffer.
  *